@@ -0,0 +1,988 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// Benchmarks.cpp - Microbenchmarks for the CPU side kernels of the sample: BVH builds, traversal,
+// triangle intersection, index decode and vertex fetch, framebuffer conversion, tonemapping, buffer
+// sub-allocation, render graph recording and trace scopes. Every kernel
+// runs on one thread and then on all of them, results go to the console and a JSON file.
+// -counters adds hardware performance counters to the single threaded runs, where available.
+//
+// Usage: Benchmarks [-threads N] [-triangles N] [-instances N] [-rays N] [-repeat N]
+//                   [-counters] [-label text] [-out benchmarks.json]
+//
+
+#include "stdafx.h"
+#include "StepTimer.h"
+#include "JobSystem.h"
+#include "SceneGenerator.h"
+#include "CpuBvh.h"
+#include "CpuTracer.h"
+#include "CpuFramebuffer.h"
+#include "Tonemapper.h"
+#include "ImageFile.h"
+#include "PerfCounters.h"
+#include "TraceRecorder.h"
+#include "LinearBufferAllocator.h"
+#include "RecordingDevice.h"
+#include "RenderGraph.h"
+#include <fstream>
+#include <random>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    struct Options
+    {
+        Options() :
+            threadCount(0),
+            triangleCount(256 * 1024),
+            instanceCount(16),
+            rayCount(1024 * 1024),
+            repeatCount(5),
+            perfCounters(false),
+            outputPath(L"benchmarks.json")
+        {
+        }
+
+        UINT    threadCount;        // For the multithreaded runs, 0 for all hardware threads.
+        UINT    triangleCount;
+        UINT    instanceCount;
+        UINT    rayCount;
+        UINT    repeatCount;
+        bool    perfCounters;
+        wstring label;
+        wstring outputPath;
+    };
+
+    struct Result
+    {
+        string  name;
+        UINT    threadCount;
+        UINT64  itemCount;
+        string  unit;
+        double  minNanoseconds;     // Per item, over all repeats.
+        double  medianNanoseconds;
+        double  nodeVisits;         // Per item, traversal only.
+        double  triangleTests;
+        bool    hasPerfCounters;
+        UINT64  perfCounters[PerfCounters::CounterCount];  // One run, valid where available.
+    };
+
+    // Keeps the optimizer from dropping results nobody reads.
+    volatile UINT64 g_sink;
+
+    // Rays per job, large enough to hide the job system's overhead.
+    const UINT c_raysPerJob = 4096;
+
+    struct alignas(64) ThreadCounters
+    {
+        CpuTraversalCounters    counters;
+        UINT64                  hitCount;
+    };
+
+    float Uniform(mt19937& random, float low, float high)
+    {
+        return low + (high - low) * static_cast<float>(random() - mt19937::min()) / static_cast<float>(mt19937::max() - mt19937::min());
+    }
+
+    XMFLOAT3 Normalize(const XMFLOAT3& v)
+    {
+        float length = sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+    }
+
+    XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    string Narrow(const wstring& text)
+    {
+        string result;
+        for (wchar_t c : text)
+        {
+            result += (c < 0x80 && c != L'"' && c != L'\\') ? static_cast<char>(c) : '?';
+        }
+        return result;
+    }
+
+    class BenchmarkRunner
+    {
+    public:
+        BenchmarkRunner(const Options& options) :
+            m_options(options),
+            m_jobs(options.threadCount ? options.threadCount - 1 : 0)
+        {
+            if (options.perfCounters)
+            {
+                m_perfCounters.reset(new PerfCounters());
+                if (!m_perfCounters->IsAnyAvailable())
+                {
+                    printf("Hardware performance counters aren't available, running without them.\n");
+                    m_perfCounters.reset();
+                }
+            }
+        }
+
+        // Runs kernel once to warm up, then repeatCount times. kernel gets the job system, or null
+        // for the single threaded run. With performance counters, single threaded kernels run once
+        // more between Start() and Stop(), so reading them doesn't disturb the timings.
+        template<typename Kernel>
+        Result& Run(const char* name, const char* unit, UINT64 itemCount, bool multithreaded, const Kernel& kernel)
+        {
+            JobSystem* jobs = multithreaded ? &m_jobs : nullptr;
+            kernel(jobs);
+
+            vector<double> nanoseconds(m_options.repeatCount);
+            for (double& sample : nanoseconds)
+            {
+                UINT64 start = StepTimer::GetCurrentTicks();
+                kernel(jobs);
+                sample = StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - start) * 1e9 / max<UINT64>(itemCount, 1);
+            }
+            sort(nanoseconds.begin(), nanoseconds.end());
+
+            Result result = {};
+            result.name = name;
+            result.threadCount = multithreaded ? m_jobs.GetThreadCount() : 1;
+            result.itemCount = itemCount;
+            result.unit = unit;
+            result.minNanoseconds = nanoseconds.front();
+            result.medianNanoseconds = nanoseconds[nanoseconds.size() / 2];
+            if (m_perfCounters && !multithreaded)
+            {
+                m_perfCounters->Reset();
+                m_perfCounters->Start();
+                kernel(jobs);
+                m_perfCounters->Stop();
+                result.hasPerfCounters = true;
+                for (UINT i = 0; i < PerfCounters::CounterCount; i++)
+                {
+                    result.perfCounters[i] = m_perfCounters->GetValue(static_cast<PerfCounters::Counter>(i));
+                }
+            }
+            m_results.push_back(result);
+
+            printf("%-28s %3u threads %12.2f ns/%-9s %10.3f M%s/s\n", name, result.threadCount, result.medianNanoseconds, unit,
+                result.medianNanoseconds > 0.0 ? 1e3 / result.medianNanoseconds : 0.0, unit);
+            if (result.hasPerfCounters)
+            {
+                for (UINT i = 0; i < PerfCounters::CounterCount; i++)
+                {
+                    auto counter = static_cast<PerfCounters::Counter>(i);
+                    if (m_perfCounters->IsAvailable(counter))
+                    {
+                        printf("  %s %.2f", PerfCounters::GetName(counter), static_cast<double>(result.perfCounters[i]) / max<UINT64>(itemCount, 1));
+                    }
+                }
+                printf(" per %s\n", unit);
+            }
+            return m_results.back();
+        }
+
+        // Splits [0, count) into jobs of itemsPerJob, or loops on the calling thread without jobs.
+        template<typename Body>
+        static void ForEach(JobSystem* jobs, UINT count, UINT itemsPerJob, const Body& body)
+        {
+            UINT jobCount = (count + itemsPerJob - 1) / itemsPerJob;
+            auto job = [&](UINT index, UINT threadIndex)
+            {
+                UINT end = min<UINT>(count, (index + 1) * itemsPerJob);
+                for (UINT i = index * itemsPerJob; i < end; i++)
+                {
+                    body(i, threadIndex);
+                }
+            };
+            if (jobs)
+            {
+                jobs->ParallelFor(jobCount, job);
+            }
+            else
+            {
+                for (UINT index = 0; index < jobCount; index++)
+                {
+                    job(index, 0);
+                }
+            }
+        }
+
+        void WriteJson(const SceneGenerator& scene) const
+        {
+            ofstream file(m_options.outputPath);
+            ThrowIfFalse(file.is_open(), L"Couldn't open the benchmark output file.");
+
+            file << fixed << setprecision(4)
+                << "{\n  \"label\": \"" << Narrow(m_options.label) << '"'
+                << ",\n  \"threads\": " << m_jobs.GetThreadCount()
+                << ",\n  \"repeat\": " << m_options.repeatCount
+                << ",\n  \"scene\": {\"mesh\": \"" << Narrow(SceneGenerator::GetMeshName(scene.GetDesc().mesh))
+                << "\", \"triangles\": " << scene.GetTriangleCount()
+                << ", \"layout\": \"" << Narrow(SceneGenerator::GetLayoutName(scene.GetDesc().layout))
+                << "\", \"instances\": " << scene.GetInstanceCount() << '}'
+                << ",\n  \"results\": [";
+            for (size_t i = 0; i < m_results.size(); i++)
+            {
+                const Result& result = m_results[i];
+                file << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << '"'
+                    << ", \"threads\": " << result.threadCount
+                    << ", \"items\": " << result.itemCount
+                    << ", \"unit\": \"" << result.unit << '"'
+                    << ", \"ns_per_item\": " << result.medianNanoseconds
+                    << ", \"min_ns_per_item\": " << result.minNanoseconds
+                    << ", \"items_per_second\": " << (result.medianNanoseconds > 0.0 ? 1e9 / result.medianNanoseconds : 0.0);
+                if (result.nodeVisits > 0.0)
+                {
+                    file << ", \"node_visits_per_item\": " << result.nodeVisits
+                        << ", \"triangle_tests_per_item\": " << result.triangleTests;
+                }
+                if (result.hasPerfCounters)
+                {
+                    // Per node visit only means something for traversal.
+                    double nodeVisits = result.nodeVisits * result.itemCount;
+                    file << ", \"counters\": {";
+                    const char* separator = "";
+                    for (UINT i = 0; i < PerfCounters::CounterCount; i++)
+                    {
+                        auto counter = static_cast<PerfCounters::Counter>(i);
+                        if (!m_perfCounters->IsAvailable(counter))
+                        {
+                            continue;
+                        }
+                        file << separator << '"' << PerfCounters::GetName(counter) << "\": {\"total\": " << result.perfCounters[i]
+                            << ", \"per_item\": " << static_cast<double>(result.perfCounters[i]) / max<UINT64>(result.itemCount, 1);
+                        if (nodeVisits > 0.0)
+                        {
+                            file << ", \"per_node_visit\": " << result.perfCounters[i] / nodeVisits;
+                        }
+                        file << '}';
+                        separator = ", ";
+                    }
+                    file << '}';
+                }
+                file << '}';
+            }
+            file << "\n  ]\n}\n";
+        }
+
+        // Accessors.
+        UINT GetThreadCount() const { return m_jobs.GetThreadCount(); }
+
+    private:
+        const Options&              m_options;
+        JobSystem                   m_jobs;
+        vector<Result>              m_results;
+        unique_ptr<PerfCounters>    m_perfCounters;     // Null unless asked for and available.
+    };
+
+    // Builds are single threaded, the multithreaded runs do one independent build per thread and
+    // report the combined throughput.
+    void BenchmarkBuilds(BenchmarkRunner& runner, const SceneGenerator& scene)
+    {
+        const auto& vertices = scene.GetVertices();
+        const auto& indices = scene.GetIndices();
+        UINT triangleCount = scene.GetTriangleCount();
+        vector<XMFLOAT3> boundsMin, boundsMax;
+        scene.GetInstanceBounds(&boundsMin, &boundsMax);
+        UINT instanceCount = scene.GetInstanceCount();
+
+        vector<CpuBvh> bvhs(runner.GetThreadCount());
+        for (bool multithreaded : { false, true })
+        {
+            UINT buildCount = multithreaded ? runner.GetThreadCount() : 1;
+            runner.Run("blas_build_binned_sah", "triangle", static_cast<UINT64>(triangleCount) * buildCount, multithreaded, [&](JobSystem* jobs)
+            {
+                BenchmarkRunner::ForEach(jobs, buildCount, 1, [&](UINT i, UINT)
+                {
+                    bvhs[i].BuildTriangles(vertices.data(), sizeof(SceneVertex), indices.data(), triangleCount);
+                });
+            });
+            runner.Run("tlas_build_binned_sah", "instance", static_cast<UINT64>(instanceCount) * buildCount, multithreaded, [&](JobSystem* jobs)
+            {
+                BenchmarkRunner::ForEach(jobs, buildCount, 1, [&](UINT i, UINT)
+                {
+                    bvhs[i].Build(boundsMin.data(), boundsMax.data(), instanceCount);
+                });
+            });
+        }
+    }
+
+    // Primary rays come from a pinhole camera looking at the whole scene, shadow rays go from their
+    // hits to a point light above it and incoherent rays start and point anywhere.
+    void BenchmarkTraversal(BenchmarkRunner& runner, const SceneGenerator& scene, const CpuTracer& tracer, UINT rayCount)
+    {
+        XMFLOAT3 boundsMin = scene.GetBoundsMin();
+        XMFLOAT3 boundsMax = scene.GetBoundsMax();
+        XMFLOAT3 center((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+        XMFLOAT3 extent(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z);
+        float radius = 0.5f * sqrt(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+
+        UINT width = max<UINT>(static_cast<UINT>(sqrt(static_cast<double>(rayCount))), 1);
+        UINT height = max<UINT>(rayCount / width, 1);
+        vector<CpuRay> primaryRays(static_cast<size_t>(width) * height);
+        {
+            XMFLOAT3 eye(center.x + 1.2f * radius, center.y + 0.9f * radius, center.z - 1.5f * radius);
+            XMFLOAT3 forward = Normalize(XMFLOAT3(center.x - eye.x, center.y - eye.y, center.z - eye.z));
+            XMFLOAT3 right = Normalize(Cross(XMFLOAT3(0.0f, 1.0f, 0.0f), forward));
+            XMFLOAT3 up = Cross(forward, right);
+            float tanHalfFov = tan(XM_PIDIV4 * 0.5f);
+            for (UINT y = 0; y < height; y++)
+            {
+                for (UINT x = 0; x < width; x++)
+                {
+                    float sx = ((x + 0.5f) / width * 2.0f - 1.0f) * tanHalfFov;
+                    float sy = (1.0f - (y + 0.5f) / height * 2.0f) * tanHalfFov;
+                    CpuRay& ray = primaryRays[static_cast<size_t>(y) * width + x];
+                    ray.origin = eye;
+                    ray.direction = XMFLOAT3(forward.x + sx * right.x + sy * up.x, forward.y + sx * right.y + sy * up.y, forward.z + sx * right.z + sy * up.z);
+                    ray.tMin = 0.0f;
+                    ray.tMax = FLT_MAX;
+                }
+            }
+        }
+
+        vector<CpuRay> shadowRays;
+        XMFLOAT3 light(center.x + 0.3f * radius, center.y + 2.0f * radius, center.z + 0.2f * radius);
+        for (const CpuRay& ray : primaryRays)
+        {
+            CpuHit hit;
+            if (tracer.TraceClosest(ray, &hit))
+            {
+                CpuRay shadow;
+                shadow.origin = XMFLOAT3(ray.origin.x + hit.t * ray.direction.x, ray.origin.y + hit.t * ray.direction.y, ray.origin.z + hit.t * ray.direction.z);
+                shadow.direction = XMFLOAT3(light.x - shadow.origin.x, light.y - shadow.origin.y, light.z - shadow.origin.z);
+                shadow.tMin = 1e-4f;
+                shadow.tMax = 1.0f;
+                shadowRays.push_back(shadow);
+            }
+        }
+
+        vector<CpuRay> incoherentRays(primaryRays.size());
+        mt19937 random(7);
+        for (CpuRay& ray : incoherentRays)
+        {
+            ray.origin = XMFLOAT3(Uniform(random, boundsMin.x, boundsMax.x), Uniform(random, boundsMin.y, boundsMax.y), Uniform(random, boundsMin.z, boundsMax.z));
+            float z = Uniform(random, -1.0f, 1.0f);
+            float phi = Uniform(random, 0.0f, XM_2PI);
+            float r = sqrt(max(0.0f, 1.0f - z * z));
+            ray.direction = XMFLOAT3(r * cos(phi), r * sin(phi), z);
+            ray.tMin = 0.0f;
+            ray.tMax = FLT_MAX;
+        }
+
+        vector<ThreadCounters> threadCounters(runner.GetThreadCount());
+        auto trace = [&](const char* name, const vector<CpuRay>& rays, bool anyHit, bool multithreaded)
+        {
+            auto kernel = [&](JobSystem* jobs)
+            {
+                fill(threadCounters.begin(), threadCounters.end(), ThreadCounters());
+                BenchmarkRunner::ForEach(jobs, static_cast<UINT>(rays.size()), c_raysPerJob, [&](UINT i, UINT threadIndex)
+                {
+                    ThreadCounters& counters = threadCounters[threadIndex];
+                    CpuHit hit;
+                    bool found = anyHit ? tracer.TraceAny(rays[i], &counters.counters) : tracer.TraceClosest(rays[i], &hit, &counters.counters);
+                    counters.hitCount += found;
+                });
+            };
+            Result& result = runner.Run(name, "ray", rays.size(), multithreaded, kernel);
+
+            // The counters are from the last repeat, they don't depend on timing.
+            CpuTraversalCounters total = {};
+            for (const ThreadCounters& counters : threadCounters)
+            {
+                total.nodeVisits += counters.counters.nodeVisits;
+                total.triangleTests += counters.counters.triangleTests;
+            }
+            result.nodeVisits = static_cast<double>(total.nodeVisits) / max<size_t>(rays.size(), 1);
+            result.triangleTests = static_cast<double>(total.triangleTests) / max<size_t>(rays.size(), 1);
+        };
+
+        for (bool multithreaded : { false, true })
+        {
+            trace("trace_primary", primaryRays, false, multithreaded);
+            trace("trace_shadow", shadowRays, true, multithreaded);
+            trace("trace_incoherent", incoherentRays, false, multithreaded);
+        }
+    }
+
+    // Every ray against every triangle of a small random set, so the tests are all leaf work.
+    void BenchmarkIntersection(BenchmarkRunner& runner)
+    {
+        const UINT triangleCount = 4096;
+        const UINT rayCount = 1024;
+        mt19937 random(11);
+        vector<CpuTriangle> triangles(triangleCount);
+        for (CpuTriangle& triangle : triangles)
+        {
+            triangle.v0 = XMFLOAT3(Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f));
+            triangle.edge1 = XMFLOAT3(Uniform(random, -0.5f, 0.5f), Uniform(random, -0.5f, 0.5f), Uniform(random, -0.5f, 0.5f));
+            triangle.edge2 = XMFLOAT3(Uniform(random, -0.5f, 0.5f), Uniform(random, -0.5f, 0.5f), Uniform(random, -0.5f, 0.5f));
+        }
+        vector<CpuRay> rays(rayCount);
+        for (CpuRay& ray : rays)
+        {
+            ray.origin = XMFLOAT3(Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f), -3.0f);
+            ray.direction = XMFLOAT3(Uniform(random, -0.2f, 0.2f), Uniform(random, -0.2f, 0.2f), 1.0f);
+            ray.tMin = 0.0f;
+            ray.tMax = FLT_MAX;
+        }
+
+        for (bool multithreaded : { false, true })
+        {
+            runner.Run("intersect_triangle", "test", static_cast<UINT64>(triangleCount) * rayCount, multithreaded, [&](JobSystem* jobs)
+            {
+                atomic<UINT64> hits(0);
+                BenchmarkRunner::ForEach(jobs, rayCount, 16, [&](UINT i, UINT)
+                {
+                    const CpuRay& ray = rays[i];
+                    UINT rayHits = 0;
+                    for (const CpuTriangle& triangle : triangles)
+                    {
+                        float t, u, v;
+                        rayHits += CpuTracer::IntersectTriangle(triangle, ray.origin, ray.direction, ray.tMin, ray.tMax, &t, &u, &v);
+                    }
+                    hits += rayHits;
+                });
+                g_sink = hits;
+            });
+        }
+    }
+
+    // What a closest hit shader does before shading: find the triangle's three indices, from 16 bit
+    // indices the way Raytracing.hlsl used to or from 32 bit ones as it does now, then fetch the
+    // vertices and interpolate their colors. Primitives are visited in random order, like hits.
+    void BenchmarkVertexFetch(BenchmarkRunner& runner, UINT hitCount)
+    {
+        const UINT vertexCount = 1 << 16;
+        const UINT triangleCount = 1 << 20;
+        mt19937 random(13);
+        vector<SceneVertex> vertices(vertexCount);
+        for (SceneVertex& vertex : vertices)
+        {
+            vertex.position = XMFLOAT3(Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f));
+            vertex.color = XMFLOAT3(Uniform(random, 0.0f, 1.0f), Uniform(random, 0.0f, 1.0f), Uniform(random, 0.0f, 1.0f));
+        }
+        vector<UINT32> indices32(3 * triangleCount);
+        for (UINT32& index : indices32)
+        {
+            index = random() % vertexCount;
+        }
+        // Padded so the last triangle's unaligned load stays inside, like a raw buffer view.
+        vector<uint8_t> indices16(indices32.size() * sizeof(UINT16) + sizeof(UINT32));
+        for (size_t i = 0; i < indices32.size(); i++)
+        {
+            UINT16 index = static_cast<UINT16>(indices32[i]);
+            memcpy(&indices16[i * sizeof(UINT16)], &index, sizeof(index));
+        }
+        vector<CpuHit> hits(hitCount);
+        for (CpuHit& hit : hits)
+        {
+            hit.primitiveIndex = random() % triangleCount;
+            hit.u = Uniform(random, 0.0f, 0.5f);
+            hit.v = Uniform(random, 0.0f, 0.5f);
+        }
+
+        auto load16 = [&](UINT primitiveIndex, UINT32 index[3])
+        {
+            UINT offsetBytes = primitiveIndex * 3 * sizeof(UINT16);
+            UINT dwordAlignedOffset = offsetBytes & ~3u;
+            UINT32 four16BitIndices[2];
+            memcpy(four16BitIndices, &indices16[dwordAlignedOffset], sizeof(four16BitIndices));
+            if (dwordAlignedOffset == offsetBytes)
+            {
+                index[0] = four16BitIndices[0] & 0xffff;
+                index[1] = (four16BitIndices[0] >> 16) & 0xffff;
+                index[2] = four16BitIndices[1] & 0xffff;
+            }
+            else
+            {
+                index[0] = (four16BitIndices[0] >> 16) & 0xffff;
+                index[1] = four16BitIndices[1] & 0xffff;
+                index[2] = (four16BitIndices[1] >> 16) & 0xffff;
+            }
+        };
+        auto load32 = [&](UINT primitiveIndex, UINT32 index[3])
+        {
+            memcpy(index, &indices32[3 * primitiveIndex], 3 * sizeof(UINT32));
+        };
+
+        auto decode = [&](const char* name, bool sixteenBit, bool multithreaded)
+        {
+            runner.Run(name, "triangle", hits.size(), multithreaded, [&](JobSystem* jobs)
+            {
+                atomic<UINT64> sum(0);
+                BenchmarkRunner::ForEach(jobs, hitCount, c_raysPerJob, [&](UINT i, UINT)
+                {
+                    UINT32 index[3];
+                    if (sixteenBit)
+                    {
+                        load16(hits[i].primitiveIndex, index);
+                    }
+                    else
+                    {
+                        load32(hits[i].primitiveIndex, index);
+                    }
+                    // Relaxed adds of every index keep the loads alive at little cost.
+                    sum.fetch_add(index[0] + index[1] + index[2], memory_order_relaxed);
+                });
+                g_sink = sum;
+            });
+        };
+
+        auto fetch = [&](const char* name, bool sixteenBit, bool multithreaded)
+        {
+            vector<XMFLOAT3> colors(hits.size());
+            runner.Run(name, "triangle", hits.size(), multithreaded, [&](JobSystem* jobs)
+            {
+                BenchmarkRunner::ForEach(jobs, hitCount, c_raysPerJob, [&](UINT i, UINT)
+                {
+                    UINT32 index[3];
+                    if (sixteenBit)
+                    {
+                        load16(hits[i].primitiveIndex, index);
+                    }
+                    else
+                    {
+                        load32(hits[i].primitiveIndex, index);
+                    }
+                    const XMFLOAT3& c0 = vertices[index[0]].color;
+                    const XMFLOAT3& c1 = vertices[index[1]].color;
+                    const XMFLOAT3& c2 = vertices[index[2]].color;
+                    float u = hits[i].u;
+                    float v = hits[i].v;
+                    float w = 1.0f - u - v;
+                    colors[i] = XMFLOAT3(w * c0.x + u * c1.x + v * c2.x, w * c0.y + u * c1.y + v * c2.y, w * c0.z + u * c1.z + v * c2.z);
+                });
+            });
+        };
+
+        for (bool multithreaded : { false, true })
+        {
+            decode("index_decode_16", true, multithreaded);
+            decode("index_decode_32", false, multithreaded);
+            fetch("vertex_fetch_interpolate_16", true, multithreaded);
+            fetch("vertex_fetch_interpolate_32", false, multithreaded);
+        }
+    }
+
+    void BenchmarkFramebuffer(BenchmarkRunner& runner)
+    {
+        const UINT width = 1920;
+        const UINT height = 1080;
+        CpuFramebuffer framebuffer;
+        framebuffer.Resize(width, height);
+        mt19937 random(17);
+        for (UINT y = 0; y < height; y++)
+        {
+            XMFLOAT4* row = framebuffer.GetRow(y);
+            for (UINT x = 0; x < width; x++)
+            {
+                // Slightly out of range on both sides so clamping is exercised.
+                row[x] = XMFLOAT4(Uniform(random, -0.1f, 1.1f), Uniform(random, -0.1f, 1.1f), Uniform(random, -0.1f, 1.1f), 1.0f);
+            }
+        }
+        vector<UINT32> rgba8(framebuffer.GetPixelCount());
+
+        for (bool multithreaded : { false, true })
+        {
+            runner.Run("framebuffer_to_rgba8", "pixel", framebuffer.GetPixelCount(), multithreaded, [&](JobSystem* jobs)
+            {
+                BenchmarkRunner::ForEach(jobs, height, 16, [&](UINT y, UINT)
+                {
+                    CpuFramebuffer::ConvertToRgba8(framebuffer.GetRow(y), &rgba8[static_cast<size_t>(y) * width], width);
+                });
+            });
+        }
+
+        // FrameWriter encodes each frame on one thread, so only the single threaded rate matters.
+        // Noise is the worst case for the PNG match search.
+        vector<uint8_t> encoded;
+        runner.Run("encode_png", "pixel", framebuffer.GetPixelCount(), false, [&](JobSystem*)
+        {
+            ImageFile::EncodePng(width, height, rgba8.data(), &encoded);
+        });
+        runner.Run("encode_pfm", "pixel", framebuffer.GetPixelCount(), false, [&](JobSystem*)
+        {
+            ImageFile::EncodePfm(width, height, framebuffer.GetPixels().data(), &encoded);
+        });
+        runner.Run("encode_exr", "pixel", framebuffer.GetPixelCount(), false, [&](JobSystem*)
+        {
+            ImageFile::EncodeExr(width, height, framebuffer.GetPixels().data(), &encoded);
+        });
+    }
+
+    // A 4K HDR frame through every operator with sRGB encoding, on each path the CPU has. The
+    // source alone is 127 MB, so a single thread is bound by memory bandwidth well before compute.
+    void BenchmarkTonemap(BenchmarkRunner& runner)
+    {
+        const UINT width = 3840;
+        const UINT height = 2160;
+        CpuFramebuffer framebuffer;
+        framebuffer.Resize(width, height);
+        mt19937 random(23);
+        for (UINT y = 0; y < height; y++)
+        {
+            XMFLOAT4* row = framebuffer.GetRow(y);
+            for (UINT x = 0; x < width; x++)
+            {
+                // Log uniform over 16 stops around 1, with some black.
+                auto channel = [&]() { return Uniform(random, 0.0f, 1.0f) < 0.05f ? 0.0f : exp2(Uniform(random, -10.0f, 6.0f)); };
+                row[x] = XMFLOAT4(channel(), channel(), channel(), 1.0f);
+            }
+        }
+        vector<UINT32> rgba8(framebuffer.GetPixelCount());
+
+        static const char* names[Tonemapper::PathCount][Tonemapper::OperatorCount] =
+        {
+            { "tonemap_none_scalar", "tonemap_reinhard_scalar", "tonemap_aces_scalar" },
+            { "tonemap_none_avx2", "tonemap_reinhard_avx2", "tonemap_aces_avx2" },
+        };
+        for (UINT path = 0; path < Tonemapper::PathCount; path++)
+        {
+            if (!Tonemapper::IsSupported(static_cast<Tonemapper::Path>(path)))
+            {
+                continue;
+            }
+            for (UINT op = 0; op < Tonemapper::OperatorCount; op++)
+            {
+                Tonemapper tonemapper(static_cast<Tonemapper::Operator>(op), 0.0f, true);
+                runner.Run(names[path][op], "pixel", framebuffer.GetPixelCount(), false, [&](JobSystem*)
+                {
+                    tonemapper.Resolve(static_cast<Tonemapper::Path>(path), framebuffer.GetPixels().data(), rgba8.data(), framebuffer.GetPixelCount());
+                });
+            }
+        }
+        Tonemapper aces(Tonemapper::OperatorAces, 0.0f, true);
+        runner.Run("tonemap_aces", "pixel", framebuffer.GetPixelCount(), true, [&](JobSystem* jobs)
+        {
+            aces.Resolve(framebuffer, rgba8.data(), jobs);
+        });
+    }
+
+    // LinearBufferAllocator over pages without memory behind them, so only the allocation logic is
+    // measured. GPU addresses are made up, each page 4GB apart.
+    class FakeHeapAllocator : public LinearBufferAllocator
+    {
+    public:
+        FakeHeapAllocator() : m_createdPageCount(0) {}
+
+    protected:
+        void CreatePageResource(Page* page) override
+        {
+            page->gpuBase = static_cast<D3D12_GPU_VIRTUAL_ADDRESS>(++m_createdPageCount) << 32;
+            page->cpuBase = nullptr;
+        }
+
+    private:
+        UINT64 m_createdPageCount;
+    };
+
+    // Many threads sub-allocating constant buffers, structured buffers and acceleration structures
+    // at once, the lock-free bump against the same bump behind a mutex. Pages rewound by Reset()
+    // are reused, so after the warm up run no page is created. Every run also checks the alignment
+    // and the byte count of what it got.
+    void BenchmarkAllocation(BenchmarkRunner& runner)
+    {
+        const UINT allocationCount = 1 << 20;
+        struct Request
+        {
+            UINT64  size;
+            UINT64  alignment;
+        };
+        const UINT64 alignments[] = { BufferAlignment::ConstantBuffer, BufferAlignment::ShaderResource(sizeof(SceneVertex)),
+            BufferAlignment::RawBuffer, BufferAlignment::AccelerationStructure };
+        mt19937 random(29);
+        vector<Request> requests(allocationCount);
+        UINT64 totalSize = 0;
+        for (Request& request : requests)
+        {
+            request.alignment = alignments[random() % ARRAYSIZE(alignments)];
+            request.size = 16 + random() % 1024;
+            totalSize += request.size;
+        }
+
+        FakeHeapAllocator allocator;
+        allocator.Create(nullptr, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON);
+        auto check = [&](UINT64 misaligned, UINT64 allocatedBytes)
+        {
+            ThrowIfFalse(misaligned == 0, L"An allocation isn't aligned.");
+            ThrowIfFalse(allocatedBytes == totalSize, L"The allocated bytes don't add up.");
+        };
+
+        for (bool multithreaded : { false, true })
+        {
+            runner.Run("linear_allocate", "allocation", allocationCount, multithreaded, [&](JobSystem* jobs)
+            {
+                allocator.Reset();
+                atomic<UINT64> misaligned(0);
+                BenchmarkRunner::ForEach(jobs, allocationCount, 256, [&](UINT i, UINT)
+                {
+                    BufferAllocation allocation = allocator.Allocate(requests[i].size, requests[i].alignment);
+                    if (allocation.offset % requests[i].alignment)
+                    {
+                        misaligned++;
+                    }
+                });
+                check(misaligned, allocator.GetAllocatedBytes());
+            });
+
+            // The baseline: one lock around the offset, and pages of the same size.
+            mutex lock;
+            UINT64 pageSize = allocator.GetPageSize();
+            runner.Run("locked_allocate", "allocation", allocationCount, multithreaded, [&](JobSystem* jobs)
+            {
+                UINT64 offset = 0, allocatedBytes = 0;
+                atomic<UINT64> misaligned(0);
+                BenchmarkRunner::ForEach(jobs, allocationCount, 256, [&](UINT i, UINT)
+                {
+                    const Request& request = requests[i];
+                    UINT64 allocationOffset;
+                    {
+                        lock_guard<mutex> guard(lock);
+                        UINT64 alignedOffset = (offset + request.alignment - 1) / request.alignment * request.alignment;
+                        if (alignedOffset + request.size > pageSize)
+                        {
+                            alignedOffset = 0;
+                        }
+                        offset = alignedOffset + request.size;
+                        allocatedBytes += request.size;
+                        allocationOffset = alignedOffset;
+                    }
+                    if (allocationOffset % request.alignment)
+                    {
+                        misaligned++;
+                    }
+                });
+                check(misaligned, allocatedBytes);
+            });
+        }
+    }
+
+    // What a TRACE_SCOPE costs around an empty body: recording a begin and an end event, and with
+    // the recorder disabled the two checks that remain. Each thread's ring buffer wraps many
+    // times over, as it does in a long traced run. trace_clock is the two timestamp reads alone,
+    // which virtual machines that trap the TSC make far more expensive than the rest.
+    void BenchmarkTraceScope(BenchmarkRunner& runner)
+    {
+        const UINT scopeCount = 1 << 22;
+        const double budgetNanoseconds = 50.0;
+        for (bool multithreaded : { false, true })
+        {
+            runner.Run("trace_clock", "scope", scopeCount, multithreaded, [&](JobSystem* jobs)
+            {
+                BenchmarkRunner::ForEach(jobs, scopeCount, 4096, [](UINT, UINT)
+                {
+                    g_sink = TraceRecorder::ReadTimestamp() + TraceRecorder::ReadTimestamp();
+                });
+            });
+        }
+        for (bool enabled : { false, true })
+        {
+            TraceRecorder::Enable(enabled);
+            for (bool multithreaded : { false, true })
+            {
+                Result& result = runner.Run(enabled ? "trace_scope" : "trace_scope_disabled", "scope", scopeCount, multithreaded, [&](JobSystem* jobs)
+                {
+                    BenchmarkRunner::ForEach(jobs, scopeCount, 4096, [](UINT, UINT)
+                    {
+                        TRACE_SCOPE("Benchmark");
+                    });
+                });
+                if (result.medianNanoseconds > budgetNanoseconds)
+                {
+                    printf("  over the %.0f ns budget of a trace scope\n", budgetNanoseconds);
+                }
+            }
+        }
+        TraceRecorder::Enable(false);
+    }
+
+    // A render graph recorded on the recording device, the frame the sample records with
+    // -recordingThreads 1 against the one ExecuteParallel() spreads over the job system. Each pass
+    // writes one of a ring of buffers and reads the one before it, so every pass has a barrier,
+    // and records dispatchesPerPass dispatches; the recording device only counts the calls, so
+    // this is the CPU cost of recording and of the graph's bookkeeping alone.
+    void BenchmarkRecording(BenchmarkRunner& runner)
+    {
+        const UINT passCount = 64;
+        const UINT bufferCount = 8;
+        const UINT dispatchesPerPass = 512;
+
+        ComPtr<ID3D12Device> device;
+        ThrowIfFailed(CreateRecordingDevice(make_shared<RecordingStatistics>(), IID_PPV_ARGS(&device)));
+        vector<ComPtr<ID3D12Resource>> buffers(bufferCount);
+        for (auto& buffer : buffers)
+        {
+            CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+            D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(64 * 1024, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+            ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&buffer)));
+        }
+        CommandListPool commandLists;
+        commandLists.Initialize(device.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT, 1, runner.GetThreadCount());
+        ResourceStateTracker resourceStates;
+
+        RenderGraph graph;
+        vector<RenderGraph::ResourceHandle> handles;
+        for (UINT i = 0; i < bufferCount; i++)
+        {
+            handles.push_back(graph.ImportResource(L"Buffer", buffers[i].Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+        }
+        for (UINT p = 0; p < passCount; p++)
+        {
+            auto pass = graph.AddPass(L"Pass", D3D12_COMMAND_LIST_TYPE_DIRECT, [=](ID3D12GraphicsCommandList* commandList)
+            {
+                for (UINT i = 0; i < dispatchesPerPass; i++)
+                {
+                    commandList->SetComputeRoot32BitConstant(0, i, 0);
+                    commandList->Dispatch(8, 8, 1);
+                }
+            });
+            graph.Read(pass, handles[(p + bufferCount - 1) % bufferCount], D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            graph.Write(pass, handles[p % bufferCount], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        }
+        graph.Compile();
+        ThrowIfFalse(graph.GetPlan().passes.size() == passCount, L"A recorded pass was culled.");
+
+        double medianNanoseconds[2] = {};
+        for (bool multithreaded : { false, true })
+        {
+            vector<ID3D12CommandList*> recorded;
+            medianNanoseconds[multithreaded] = runner.Run("graph_record", "pass", passCount, multithreaded, [&](JobSystem* jobs)
+            {
+                commandLists.BeginFrame(0);
+                resourceStates.BeginFrame();
+                recorded.clear();
+                if (jobs)
+                {
+                    graph.ExecuteParallel(resourceStates, *jobs, commandLists, recorded);
+                }
+                else
+                {
+                    auto commandList = commandLists.Acquire(0);
+                    graph.Execute(resourceStates, commandList);
+                    ThrowIfFailed(commandList->Close());
+                    recorded.push_back(commandList);
+                }
+            }).medianNanoseconds;
+        }
+
+        // The number the parallel recording is judged by, it only means something on several cores.
+        printf("  parallel recording takes %.2fx the single list's time on %u threads%s\n",
+            medianNanoseconds[0] > 0.0 ? medianNanoseconds[1] / medianNanoseconds[0] : 0.0, runner.GetThreadCount(),
+            thread::hardware_concurrency() > 1 ? "" : ", but there is only one hardware thread");
+    }
+
+    void ParseCommandLineArgs(wchar_t* argv[], int argc, Options* options)
+    {
+        auto value = [&](int* i)
+        {
+            ThrowIfFalse(*i + 1 < argc, L"Incorrect argument format passed in.");
+            return argv[++*i];
+        };
+
+        for (int i = 1; i < argc; ++i)
+        {
+            if (_wcsnicmp(argv[i], L"-threads", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/threads", wcslen(argv[i])) == 0)
+            {
+                options->threadCount = _wtoi(value(&i));
+                ThrowIfFalse(options->threadCount != 1, L"Thread count must be at least 2, or 0 for all hardware threads. The single threaded runs always happen.");
+            }
+            else if (_wcsnicmp(argv[i], L"-triangles", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/triangles", wcslen(argv[i])) == 0)
+            {
+                options->triangleCount = _wtoi(value(&i));
+                ThrowIfFalse(options->triangleCount > 0 && options->triangleCount <= SceneGenerator::c_maxTriangleCount, L"Triangle count is out of range.");
+            }
+            else if (_wcsnicmp(argv[i], L"-instances", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/instances", wcslen(argv[i])) == 0)
+            {
+                options->instanceCount = _wtoi(value(&i));
+                ThrowIfFalse(options->instanceCount > 0, L"Instance count must be positive.");
+            }
+            else if (_wcsnicmp(argv[i], L"-rays", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/rays", wcslen(argv[i])) == 0)
+            {
+                options->rayCount = _wtoi(value(&i));
+                ThrowIfFalse(options->rayCount > 0, L"Ray count must be positive.");
+            }
+            else if (_wcsnicmp(argv[i], L"-repeat", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/repeat", wcslen(argv[i])) == 0)
+            {
+                options->repeatCount = _wtoi(value(&i));
+                ThrowIfFalse(options->repeatCount > 0, L"Repeat count must be positive.");
+            }
+            else if (_wcsnicmp(argv[i], L"-counters", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/counters", wcslen(argv[i])) == 0)
+            {
+                options->perfCounters = true;
+            }
+            else if (_wcsnicmp(argv[i], L"-label", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/label", wcslen(argv[i])) == 0)
+            {
+                options->label = value(&i);
+            }
+            else if (_wcsnicmp(argv[i], L"-out", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/out", wcslen(argv[i])) == 0)
+            {
+                options->outputPath = value(&i);
+            }
+        }
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        Options options;
+        ParseCommandLineArgs(argv, argc, &options);
+        BenchmarkRunner runner(options);
+
+        SceneDesc desc;
+        desc.mesh = SceneDesc::MeshTerrain;
+        desc.triangleCount = options.triangleCount;
+        desc.layout = SceneDesc::LayoutGrid;
+        desc.instanceCount = options.instanceCount;
+        SceneGenerator scene;
+        scene.Generate(desc);
+
+        CpuTracer tracer;
+        tracer.Build(scene.GetVertices().data(), sizeof(SceneVertex), scene.GetIndices().data(), scene.GetTriangleCount(),
+            scene.GetInstanceTransforms().data(), scene.GetInstanceCount());
+
+        printf("%u triangles x %u instances, %u threads, median of %u\n",
+            scene.GetTriangleCount(), scene.GetInstanceCount(), runner.GetThreadCount(), options.repeatCount);
+        BenchmarkBuilds(runner, scene);
+        BenchmarkTraversal(runner, scene, tracer, options.rayCount);
+        BenchmarkIntersection(runner);
+        BenchmarkVertexFetch(runner, options.rayCount);
+        BenchmarkFramebuffer(runner);
+        BenchmarkTonemap(runner);
+        BenchmarkAllocation(runner);
+        BenchmarkRecording(runner);
+        BenchmarkTraceScope(runner);
+
+        runner.WriteJson(scene);
+        wprintf(L"Results written to %ls\n", options.outputPath.c_str());
+        return 0;
+    }
+    catch (const exception& e)
+    {
+        printf("Benchmarks failed: %s\n", e.what());
+        return 1;
+    }
+}
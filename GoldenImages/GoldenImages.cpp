@@ -0,0 +1,444 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// GoldenImages.cpp - Image regression tests. Renders procedural scenes with the CPU tracer and
+// compares them with stored references, and does the same for frames the sample rendered on the
+// GPU. Every image gets RMSE, the largest channel error and a FLIP style perceptual error, see
+// ImageCompare, and a difference and a FLIP error image. Results go to the console and a JSON
+// file, the exit code is 1 when any image is over a tolerance or has no reference.
+//
+// CPU images are rendered here, at -width by -height on orbits around each scene like the
+// sample's -benchmark camera. Their references at the default size are in GoldenImages/References.
+// GPU images come from a run of the sample such as
+//     D3D12HelloTriangle -scene sphere -benchmark 8 -writeFrames gpu -frameFormat pfm -noFrameDrops
+// whose frames gpu_00000.pfm, gpu_00001.pfm... are passed with -gpuFrames gpu. The camera
+// follows the same virtual clock every run, so frame N always shows the same view. A frame
+// missing from the run, or a reference without a frame, fails like an image that differs.
+//
+// -update writes the images of this run as the new references instead of comparing, and
+// removes GPU references the run has no frame for.
+//
+// Usage: GoldenImages -references dir [-update] [-gpuFrames prefix] [-out dir]
+//                     [-width N] [-height N] [-maxRmse x] [-maxError x] [-maxMeanFlip x]
+//
+
+#include "stdafx.h"
+#include "JobSystem.h"
+#include "SceneGenerator.h"
+#include "CpuTracer.h"
+#include "CpuRenderer.h"
+#include "CameraPath.h"
+#include "ImageCompare.h"
+#include "ImageFile.h"
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    struct Options
+    {
+        Options() :
+            update(false),
+            outputDirectory(L"golden"),
+            width(320),
+            height(180),
+            maxRmse(1e-3),
+            maxError(1.0),
+            maxMeanFlip(1e-3)
+        {
+        }
+
+        wstring referenceDirectory;
+        bool    update;
+        wstring gpuFramePrefix;
+        wstring outputDirectory;
+        UINT    width;
+        UINT    height;
+        double  maxRmse;
+        double  maxError;
+        double  maxMeanFlip;
+    };
+
+    // The scenes cover each mesh and layout once, the times spread the views around the orbits.
+    struct GoldenScene
+    {
+        const char*         name;
+        SceneDesc::Mesh     mesh;
+        UINT                triangleCount;
+        SceneDesc::Layout   layout;
+        UINT                instanceCount;
+        double              time;       // Seconds into the orbit.
+    };
+
+    const GoldenScene c_scenes[] =
+    {
+        { "terrain_grid",       SceneDesc::MeshTerrain, 8192, SceneDesc::LayoutGrid,        9,  0.0 },
+        { "sphere_clustered",   SceneDesc::MeshSphere,  5120, SceneDesc::LayoutClustered,   32, 2.5 },
+        { "soup_overlapping",   SceneDesc::MeshSoup,    4096, SceneDesc::LayoutOverlapping, 16, 5.0 },
+        { "sphere_single",      SceneDesc::MeshSphere,  1280, SceneDesc::LayoutGrid,        1,  7.5 },
+    };
+
+    struct CaseResult
+    {
+        string                  name;
+        bool                    hasReference;
+        ImageCompare::Result    metrics;
+        bool                    passed;
+    };
+
+    wstring Widen(const string& text)
+    {
+        return wstring(text.begin(), text.end());
+    }
+
+    string Narrow(const wstring& text)
+    {
+        string result;
+        for (wchar_t c : text)
+        {
+            result += (c < 0x80 && c != L'"' && c != L'\\') ? static_cast<char>(c) : '?';
+        }
+        return result;
+    }
+
+    bool FileExists(const wstring& path)
+    {
+        return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+    }
+
+    void LoadImage(const wstring& path, CpuFramebuffer* image)
+    {
+        UINT width, height;
+        vector<XMFLOAT4> pixels;
+        ImageFile::ReadPfm(path, &width, &height, &pixels);
+        image->Resize(width, height);
+        copy(pixels.begin(), pixels.end(), image->GetRow(0));
+    }
+
+    void SaveImage(const wstring& path, const CpuFramebuffer& image)
+    {
+        vector<uint8_t> encoded;
+        ImageFile::EncodePfm(image.GetWidth(), image.GetHeight(), image.GetPixels().data(), &encoded);
+        ImageFile::WriteFile(path, encoded);
+    }
+
+    void SavePng(const wstring& path, const CpuFramebuffer& image)
+    {
+        vector<UINT32> rgba8(image.GetPixelCount());
+        image.ConvertToRgba8(rgba8.data());
+        vector<uint8_t> encoded;
+        ImageFile::EncodePng(image.GetWidth(), image.GetHeight(), rgba8.data(), &encoded);
+        ImageFile::WriteFile(path, encoded);
+    }
+
+    // The sample's camera, see D3D12HelloTriangle::OnInit() and updateCameraMatrices().
+    CpuCamera OrbitCamera(const SceneGenerator& scene, double time, float aspectRatio)
+    {
+        XMFLOAT3 boundsMin = scene.GetBoundsMin();
+        XMFLOAT3 boundsMax = scene.GetBoundsMax();
+        glm::vec3 sceneCenter = 0.5f * (glm::vec3(boundsMin.x, boundsMin.y, boundsMin.z) + glm::vec3(boundsMax.x, boundsMax.y, boundsMax.z));
+        float sceneRadius = 0.5f * glm::length(glm::vec3(boundsMax.x, boundsMax.y, boundsMax.z) - glm::vec3(boundsMin.x, boundsMin.y, boundsMin.z));
+        CameraPath orbit = CameraPath::CreateOrbit(sceneCenter, 2.f * sceneRadius, 0.4f * sceneRadius, 10.0, 64);
+
+        glm::vec3 eye, center, up;
+        orbit.Evaluate(time, &eye, &center, &up);
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(eye.x, eye.y, eye.z, 0.0f), XMVectorSet(center.x, center.y, center.z, 0.0f), XMVectorSet(up.x, up.y, up.z, 0.0f));
+        XMMATRIX projection = XMMatrixPerspectiveFovRH(90.0f * XM_PI / 180.0f, aspectRatio, 0.1f, 1000.0f);
+
+        CpuCamera camera;
+        XMStoreFloat4x4(&camera.projectionToWorld, XMMatrixInverse(nullptr, view * projection));
+        camera.position = XMFLOAT3(eye.x, eye.y, eye.z);
+        return camera;
+    }
+
+    class GoldenImageTester
+    {
+    public:
+        explicit GoldenImageTester(const Options& options) :
+            m_options(options)
+        {
+        }
+
+        // Compares image with the reference called name, or replaces the reference with -update.
+        void Check(const string& name, const CpuFramebuffer& image)
+        {
+            wstring referencePath = m_options.referenceDirectory + L"/" + Widen(name) + L".pfm";
+            wstring outputPath = m_options.outputDirectory + L"/" + Widen(name);
+
+            CaseResult result = {};
+            result.name = name;
+            if (m_options.update)
+            {
+                SaveImage(referencePath, image);
+                printf("  %-20s reference updated\n", name.c_str());
+                return;
+            }
+
+            SaveImage(outputPath + L".pfm", image);
+            result.hasReference = FileExists(referencePath);
+            if (!result.hasReference)
+            {
+                printf("  %-20s FAIL, no reference\n", name.c_str());
+                m_results.push_back(result);
+                return;
+            }
+
+            CpuFramebuffer reference;
+            LoadImage(referencePath, &reference);
+            if (reference.GetWidth() != image.GetWidth() || reference.GetHeight() != image.GetHeight())
+            {
+                printf("  %-20s FAIL, the reference is %ux%u, the image %ux%u\n", name.c_str(),
+                    reference.GetWidth(), reference.GetHeight(), image.GetWidth(), image.GetHeight());
+                result.hasReference = false;
+                m_results.push_back(result);
+                return;
+            }
+
+            result.metrics = m_compare.Compare(reference, image);
+            result.passed = result.metrics.rmse <= m_options.maxRmse
+                && result.metrics.maxError <= m_options.maxError
+                && result.metrics.meanFlip <= m_options.maxMeanFlip;
+
+            // One 8-bit step is the smallest scale, so noise in the last bit doesn't look like a bug.
+            CpuFramebuffer errorImage;
+            m_compare.FillFlipImage(&errorImage);
+            SavePng(outputPath + L"_flip.png", errorImage);
+            m_compare.FillDifferenceImage(max<float>(static_cast<float>(result.metrics.maxError), 1.0f / 255.0f), &errorImage);
+            SavePng(outputPath + L"_diff.png", errorImage);
+
+            const ImageCompare::Result& m = result.metrics;
+            printf("  %-20s %s  rmse %.6f  max %.4f at (%u, %u)  flip mean %.6f max %.4f  %llu pixels differ\n",
+                name.c_str(), result.passed ? "pass" : "FAIL", m.rmse, m.maxError, m.maxErrorX, m.maxErrorY,
+                m.meanFlip, m.maxFlip, static_cast<unsigned long long>(m.differentPixels));
+            m_results.push_back(result);
+        }
+
+        bool AllPassed() const
+        {
+            for (const auto& result : m_results)
+            {
+                if (!result.passed)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void WriteJson(const wstring& path) const
+        {
+            ofstream file(path);
+            ThrowIfFalse(file.is_open(), L"Couldn't open the results file.");
+            file << fixed << setprecision(6)
+                << "{\n  \"references\": \"" << Narrow(m_options.referenceDirectory) << '"'
+                << ",\n  \"tolerances\": {\"rmse\": " << m_options.maxRmse << ", \"max_error\": " << m_options.maxError
+                << ", \"mean_flip\": " << m_options.maxMeanFlip << '}'
+                << ",\n  \"passed\": " << (AllPassed() ? "true" : "false")
+                << ",\n  \"images\": [";
+            for (size_t i = 0; i < m_results.size(); i++)
+            {
+                const CaseResult& result = m_results[i];
+                const ImageCompare::Result& m = result.metrics;
+                file << (i ? "," : "") << "\n    {\"name\": \"" << result.name << "\", \"passed\": " << (result.passed ? "true" : "false");
+                if (result.hasReference)
+                {
+                    file << ", \"rmse\": " << m.rmse << ", \"max_error\": " << m.maxError
+                        << ", \"max_error_x\": " << m.maxErrorX << ", \"max_error_y\": " << m.maxErrorY
+                        << ", \"mean_flip\": " << m.meanFlip << ", \"max_flip\": " << m.maxFlip
+                        << ", \"different_pixels\": " << m.differentPixels;
+                }
+                file << '}';
+            }
+            file << "\n  ]\n}\n";
+        }
+
+        // There is a reference called name but no image to compare with it. With -update the
+        // reference is removed instead.
+        void CheckMissing(const string& name)
+        {
+            if (m_options.update)
+            {
+                DeleteFileW((m_options.referenceDirectory + L"/" + Widen(name) + L".pfm").c_str());
+                printf("  %-20s reference removed\n", name.c_str());
+                return;
+            }
+
+            printf("  %-20s FAIL, no image\n", name.c_str());
+            CaseResult result = {};
+            result.name = name;
+            m_results.push_back(result);
+        }
+
+        // Accessors.
+        size_t GetResultCount() const { return m_results.size(); }
+
+    private:
+        const Options&          m_options;
+        ImageCompare            m_compare;
+        vector<CaseResult>      m_results;
+    };
+
+    void TestCpuImages(const Options& options, GoldenImageTester* tester)
+    {
+        JobSystem jobs;
+        for (const GoldenScene& golden : c_scenes)
+        {
+            SceneDesc desc;
+            desc.mesh = golden.mesh;
+            desc.triangleCount = golden.triangleCount;
+            desc.layout = golden.layout;
+            desc.instanceCount = golden.instanceCount;
+            SceneGenerator scene;
+            scene.Generate(desc);
+
+            CpuTracer tracer;
+            tracer.Build(scene.GetVertices().data(), sizeof(SceneVertex), scene.GetIndices().data(), scene.GetTriangleCount(),
+                scene.GetInstanceTransforms().data(), scene.GetInstanceCount());
+
+            CpuFramebuffer image;
+            image.Resize(options.width, options.height);
+            CpuRenderer renderer;
+            CpuCamera camera = OrbitCamera(scene, golden.time, static_cast<float>(options.width) / options.height);
+            renderer.Render(tracer, scene.GetVertices().data(), scene.GetIndices().data(), camera, CpuRenderer::OutputColor, &image, &jobs);
+            tester->Check(string("cpu_") + golden.name, image);
+        }
+    }
+
+    // Runs until neither a frame nor a reference is left, so a dropped frame or a run shorter
+    // than the references fails rather than ending the list early.
+    void TestGpuImages(const Options& options, GoldenImageTester* tester)
+    {
+        UINT frameCount = 0;
+        for (UINT frame = 0;; frame++)
+        {
+            wstringstream suffix;
+            suffix << L"_" << setw(5) << setfill(L'0') << frame;
+            string name = "gpu" + Narrow(suffix.str());
+            wstring path = options.gpuFramePrefix + suffix.str() + L".pfm";
+            if (FileExists(path))
+            {
+                CpuFramebuffer image;
+                LoadImage(path, &image);
+                tester->Check(name, image);
+                frameCount++;
+            }
+            else if (FileExists(options.referenceDirectory + L"/" + Widen(name) + L".pfm"))
+            {
+                tester->CheckMissing(name);
+            }
+            else
+            {
+                ThrowIfFalse(frameCount > 0, L"No GPU frames found, pass the sample's -writeFrames prefix.");
+                return;
+            }
+        }
+    }
+
+    void ParseCommandLineArgs(wchar_t* argv[], int argc, Options* options)
+    {
+        auto value = [&](int* i)
+        {
+            ThrowIfFalse(*i + 1 < argc, L"Incorrect argument format passed in.");
+            return argv[++*i];
+        };
+
+        for (int i = 1; i < argc; ++i)
+        {
+            if (_wcsnicmp(argv[i], L"-references", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/references", wcslen(argv[i])) == 0)
+            {
+                options->referenceDirectory = value(&i);
+            }
+            else if (_wcsnicmp(argv[i], L"-update", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/update", wcslen(argv[i])) == 0)
+            {
+                options->update = true;
+            }
+            else if (_wcsnicmp(argv[i], L"-gpuFrames", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/gpuFrames", wcslen(argv[i])) == 0)
+            {
+                options->gpuFramePrefix = value(&i);
+            }
+            else if (_wcsnicmp(argv[i], L"-out", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/out", wcslen(argv[i])) == 0)
+            {
+                options->outputDirectory = value(&i);
+            }
+            else if (_wcsnicmp(argv[i], L"-width", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/width", wcslen(argv[i])) == 0)
+            {
+                options->width = _wtoi(value(&i));
+                ThrowIfFalse(options->width > 0, L"Width must be positive.");
+            }
+            else if (_wcsnicmp(argv[i], L"-height", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/height", wcslen(argv[i])) == 0)
+            {
+                options->height = _wtoi(value(&i));
+                ThrowIfFalse(options->height > 0, L"Height must be positive.");
+            }
+            else if (_wcsnicmp(argv[i], L"-maxRmse", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/maxRmse", wcslen(argv[i])) == 0)
+            {
+                options->maxRmse = _wtof(value(&i));
+            }
+            else if (_wcsnicmp(argv[i], L"-maxError", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/maxError", wcslen(argv[i])) == 0)
+            {
+                options->maxError = _wtof(value(&i));
+            }
+            else if (_wcsnicmp(argv[i], L"-maxMeanFlip", wcslen(argv[i])) == 0 ||
+                _wcsnicmp(argv[i], L"/maxMeanFlip", wcslen(argv[i])) == 0)
+            {
+                options->maxMeanFlip = _wtof(value(&i));
+            }
+        }
+        ThrowIfFalse(!options->referenceDirectory.empty(), L"Pass the reference image directory with -references.");
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        Options options;
+        ParseCommandLineArgs(argv, argc, &options);
+        CreateDirectoryW(options.referenceDirectory.c_str(), nullptr);
+        CreateDirectoryW(options.outputDirectory.c_str(), nullptr);
+
+        GoldenImageTester tester(options);
+        printf("CPU, %ux%u\n", options.width, options.height);
+        TestCpuImages(options, &tester);
+        if (!options.gpuFramePrefix.empty())
+        {
+            printf("GPU\n");
+            TestGpuImages(options, &tester);
+        }
+
+        if (options.update)
+        {
+            wprintf(L"References written to %ls\n", options.referenceDirectory.c_str());
+            return 0;
+        }
+        wstring resultsPath = options.outputDirectory + L"/golden.json";
+        tester.WriteJson(resultsPath);
+        printf("%s, results written to %ls\n", tester.AllPassed() ? "All images match" : "Images differ", resultsPath.c_str());
+        return tester.AllPassed() ? 0 : 1;
+    }
+    catch (const exception& e)
+    {
+        printf("GoldenImages failed: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,209 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "AccelerationStructureManager.h"
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    const UINT64 c_postbuildInfoSize = sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+}
+
+AccelerationStructureManager::AccelerationStructureManager() :
+    m_device(nullptr),
+    m_scratchBudget(AccelerationStructurePlanner::c_defaultScratchBudget)
+{
+}
+
+AccelerationStructureManager::~AccelerationStructureManager()
+{
+    Release();
+}
+
+void AccelerationStructureManager::Create(ID3D12Device5* device, UINT64 scratchBudget, LPCWSTR name)
+{
+    Release();
+
+    m_device = device;
+    m_scratchBudget = scratchBudget;
+    m_name = name ? name : L"AccelerationStructures";
+}
+
+void AccelerationStructureManager::Release()
+{
+    ReleaseBuildMemory();
+    m_resultPool.Reset();
+    m_compactedPool.Reset();
+    m_inputs.clear();
+    m_planner.Clear();
+}
+
+void AccelerationStructureManager::CreateBuffer(UINT64 size, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES initialState, LPCWSTR suffix, ID3D12Resource** resource)
+{
+    auto heapProperties = CD3DX12_HEAP_PROPERTIES(heapType);
+    auto flags = heapType == D3D12_HEAP_TYPE_DEFAULT ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+    ThrowIfFailed(m_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        initialState,
+        nullptr,
+        IID_PPV_ARGS(resource)));
+
+    wstring name = m_name + L" " + suffix;
+    (*resource)->SetName(name.c_str());
+}
+
+UINT AccelerationStructureManager::AddBottomLevel(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs)
+{
+    ThrowIfFalse(m_device != nullptr, L"AccelerationStructureManager used before Create().\n");
+    ThrowIfFalse(inputs.Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL);
+    ThrowIfFalse(inputs.DescsLayout == D3D12_ELEMENTS_LAYOUT_ARRAY);
+
+    unique_ptr<BottomLevelInputs> copy(new BottomLevelInputs());
+    copy->geometryDescs.assign(inputs.pGeometryDescs, inputs.pGeometryDescs + inputs.NumDescs);
+    copy->inputs = inputs;
+    copy->inputs.pGeometryDescs = copy->geometryDescs.data();
+    copy->inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+
+    // Size the build with the compaction flag set, it can change the prebuild estimate.
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+    m_device->GetRaytracingAccelerationStructurePrebuildInfo(&copy->inputs, &prebuildInfo);
+    ThrowIfFalse(prebuildInfo.ResultDataMaxSizeInBytes > 0);
+
+    UINT index = m_planner.AddBuild(prebuildInfo.ResultDataMaxSizeInBytes, prebuildInfo.ScratchDataSizeInBytes);
+    m_inputs.push_back(move(copy));
+    return index;
+}
+
+void AccelerationStructureManager::RecordBuilds(ID3D12GraphicsCommandList4* commandList)
+{
+    ThrowIfFalse(!m_inputs.empty(), L"No acceleration structures to build.\n");
+
+    m_planner.PlanBuilds(m_scratchBudget);
+    auto stats = m_planner.GetStatistics();
+
+    // A resource cannot transition out of the acceleration structure state, so results and scratch live in separate buffers.
+    CreateBuffer(stats.resultPoolSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, L"ResultPool", &m_resultPool);
+    CreateBuffer(stats.scratchPoolSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"ScratchPool", &m_scratchPool);
+    CreateBuffer(m_inputs.size() * c_postbuildInfoSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"PostbuildInfo", &m_postbuildInfo);
+    CreateBuffer(m_inputs.size() * c_postbuildInfoSize, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST, L"PostbuildReadback", &m_postbuildReadback);
+    m_resourceStates.Register(m_postbuildInfo.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    D3D12_GPU_VIRTUAL_ADDRESS resultBase = m_resultPool->GetGPUVirtualAddress();
+    D3D12_GPU_VIRTUAL_ADDRESS scratchBase = m_scratchPool->GetGPUVirtualAddress();
+    D3D12_GPU_VIRTUAL_ADDRESS postbuildBase = m_postbuildInfo->GetGPUVirtualAddress();
+
+    for (UINT b = 0; b < m_planner.GetBatchCount(); b++)
+    {
+        const auto& batch = m_planner.GetBatch(b);
+
+        // The previous batch has to be done with the scratch memory before this one reuses it.
+        if (b > 0)
+        {
+            m_resourceStates.UAVBarrier(m_scratchPool.Get());
+            m_resourceStates.Flush(commandList);
+        }
+
+        for (UINT i = batch.firstBuild; i < batch.firstBuild + batch.buildCount; i++)
+        {
+            const auto& build = m_planner.GetBuild(i);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
+            buildDesc.Inputs = m_inputs[i]->inputs;
+            buildDesc.DestAccelerationStructureData = resultBase + build.resultOffset;
+            buildDesc.ScratchAccelerationStructureData = scratchBase + build.scratchOffset;
+
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildDesc = {};
+            postbuildDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+            postbuildDesc.DestBuffer = postbuildBase + i * c_postbuildInfoSize;
+
+            commandList->BuildRaytracingAccelerationStructure(&buildDesc, 1, &postbuildDesc);
+        }
+    }
+
+    // Make the results visible to whatever reads them next and copy the compacted sizes to the CPU.
+    m_resourceStates.UAVBarrier(m_resultPool.Get());
+    m_resourceStates.Transition(m_postbuildInfo.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+    m_resourceStates.Flush(commandList);
+    commandList->CopyResource(m_postbuildReadback.Get(), m_postbuildInfo.Get());
+}
+
+void AccelerationStructureManager::RecordCompaction(ID3D12GraphicsCommandList4* commandList)
+{
+    ThrowIfFalse(m_resultPool.Get() != nullptr && m_postbuildReadback.Get() != nullptr, L"RecordCompaction() called before RecordBuilds().\n");
+
+    vector<UINT64> compactedSizes(m_inputs.size());
+    {
+        void* mappedData;
+        CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(m_inputs.size() * c_postbuildInfoSize));
+        ThrowIfFailed(m_postbuildReadback->Map(0, &readRange, &mappedData));
+        auto postbuildInfo = static_cast<const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*>(mappedData);
+        for (size_t i = 0; i < compactedSizes.size(); i++)
+        {
+            compactedSizes[i] = postbuildInfo[i].CompactedSizeInBytes;
+        }
+        CD3DX12_RANGE writeRange(0, 0);
+        m_postbuildReadback->Unmap(0, &writeRange);
+    }
+    m_planner.PlanCompaction(compactedSizes.data());
+
+    // The builds have completed, scratch and postbuild memory are no longer needed.
+    m_resourceStates.Unregister(m_postbuildInfo.Get());
+    m_scratchPool.Reset();
+    m_postbuildInfo.Reset();
+    m_postbuildReadback.Reset();
+
+    CreateBuffer(m_planner.GetStatistics().compactedPoolSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, L"CompactedPool", &m_compactedPool);
+
+    D3D12_GPU_VIRTUAL_ADDRESS resultBase = m_resultPool->GetGPUVirtualAddress();
+    D3D12_GPU_VIRTUAL_ADDRESS compactedBase = m_compactedPool->GetGPUVirtualAddress();
+    for (UINT i = 0; i < m_planner.GetBuildCount(); i++)
+    {
+        const auto& build = m_planner.GetBuild(i);
+        commandList->CopyRaytracingAccelerationStructure(
+            compactedBase + build.compactedOffset,
+            resultBase + build.resultOffset,
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+    }
+
+    m_resourceStates.UAVBarrier(m_compactedPool.Get());
+    m_resourceStates.Flush(commandList);
+}
+
+void AccelerationStructureManager::ReleaseBuildMemory()
+{
+    m_resourceStates.Clear();
+    m_scratchPool.Reset();
+    m_postbuildInfo.Reset();
+    m_postbuildReadback.Reset();
+
+    // Without compaction the results are the final structures.
+    if (m_planner.IsCompactionPlanned())
+    {
+        m_resultPool.Reset();
+    }
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS AccelerationStructureManager::GetAddress(UINT index) const
+{
+    const auto& build = m_planner.GetBuild(index);
+    if (m_planner.IsCompactionPlanned())
+    {
+        return m_compactedPool->GetGPUVirtualAddress() + build.compactedOffset;
+    }
+    ThrowIfFalse(m_resultPool.Get() != nullptr, L"Acceleration structures have not been built.\n");
+    return m_resultPool->GetGPUVirtualAddress() + build.resultOffset;
+}
@@ -0,0 +1,75 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// AccelerationStructureManager.h - Batched bottom level builds with shared scratch and compaction
+//
+
+#pragma once
+
+#include "AccelerationStructurePlanner.h"
+#include "ResourceStateTracker.h"
+
+namespace DX
+{
+    // Builds any number of bottom level acceleration structures in three steps:
+    //  1. RecordBuilds():      all builds go into one result pool, batches share one scratch pool
+    //                          and every build emits its compacted size.
+    //  2. RecordCompaction():  once the GPU is done, the compacted sizes are read back and each
+    //                          result is copied into a tightly packed compacted pool.
+    //  3. ReleaseBuildMemory(): once the copies are done, only the compacted pool is kept.
+    // The caller executes the command list and waits for the GPU between the steps.
+    class AccelerationStructureManager
+    {
+    public:
+        AccelerationStructureManager();
+        ~AccelerationStructureManager();
+
+        void Create(ID3D12Device5* device, UINT64 scratchBudget = AccelerationStructurePlanner::c_defaultScratchBudget, LPCWSTR name = nullptr);
+        void Release();
+
+        // The geometry descs are copied, the buffers they point at must stay alive until the builds have executed.
+        UINT AddBottomLevel(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs);
+
+        void RecordBuilds(ID3D12GraphicsCommandList4* commandList);
+        void RecordCompaction(ID3D12GraphicsCommandList4* commandList);
+        void ReleaseBuildMemory();
+
+        // Address of the compacted structure once compaction has been recorded, of the build result before.
+        D3D12_GPU_VIRTUAL_ADDRESS GetAddress(UINT index) const;
+
+        // Accessors.
+        UINT                                    GetCount() const { return static_cast<UINT>(m_inputs.size()); }
+        const AccelerationStructurePlanner&     GetPlanner() const { return m_planner; }
+
+    private:
+        struct BottomLevelInputs
+        {
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS    inputs;
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC>             geometryDescs;
+        };
+
+        void CreateBuffer(UINT64 size, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES initialState, LPCWSTR suffix, ID3D12Resource** resource);
+
+        ID3D12Device5*                                  m_device;
+        UINT64                                          m_scratchBudget;
+        std::wstring                                    m_name;
+        AccelerationStructurePlanner                    m_planner;
+        ResourceStateTracker                            m_resourceStates;
+        std::vector<std::unique_ptr<BottomLevelInputs>> m_inputs;
+
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_resultPool;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_scratchPool;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_compactedPool;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_postbuildInfo;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_postbuildReadback;
+    };
+}
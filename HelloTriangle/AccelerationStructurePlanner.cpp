@@ -0,0 +1,140 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "AccelerationStructurePlanner.h"
+
+using namespace DX;
+
+namespace
+{
+    // Results, scratch and compacted copies all share the acceleration structure alignment.
+    inline UINT64 AlignAS(UINT64 value)
+    {
+        const UINT64 alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+AccelerationStructurePlanner::AccelerationStructurePlanner()
+{
+    Clear();
+}
+
+void AccelerationStructurePlanner::Clear()
+{
+    m_builds.clear();
+    m_batches.clear();
+    m_resultPoolSize = 0;
+    m_scratchPoolSize = 0;
+    m_compactedPoolSize = 0;
+    m_compactionPlanned = false;
+}
+
+UINT AccelerationStructurePlanner::AddBuild(UINT64 resultDataMaxSize, UINT64 scratchSize)
+{
+    ThrowIfFalse(resultDataMaxSize > 0);
+
+    Build build = {};
+    build.resultDataMaxSize = resultDataMaxSize;
+    build.scratchSize = scratchSize;
+    build.compactedSize = resultDataMaxSize;
+    m_builds.push_back(build);
+    m_batches.clear();
+    m_compactedPoolSize = 0;
+    m_compactionPlanned = false;
+    return static_cast<UINT>(m_builds.size() - 1);
+}
+
+void AccelerationStructurePlanner::PlanBuilds(UINT64 scratchBudget)
+{
+    m_batches.clear();
+    m_resultPoolSize = 0;
+    m_scratchPoolSize = 0;
+
+    Batch batch = {};
+    for (UINT i = 0; i < m_builds.size(); i++)
+    {
+        Build& build = m_builds[i];
+        UINT64 scratchSize = AlignAS(build.scratchSize);
+
+        // Close the batch when this build's scratch would not fit next to the others.
+        if (batch.buildCount > 0 && batch.scratchSize + scratchSize > scratchBudget)
+        {
+            m_batches.push_back(batch);
+            batch = {};
+            batch.firstBuild = i;
+        }
+
+        build.batch = static_cast<UINT>(m_batches.size());
+        build.scratchOffset = batch.scratchSize;
+        batch.scratchSize += scratchSize;
+        batch.buildCount++;
+
+        build.resultOffset = m_resultPoolSize;
+        m_resultPoolSize += AlignAS(build.resultDataMaxSize);
+
+        m_scratchPoolSize = std::max(m_scratchPoolSize, batch.scratchSize);
+    }
+    if (batch.buildCount > 0)
+    {
+        m_batches.push_back(batch);
+    }
+}
+
+void AccelerationStructurePlanner::PlanCompaction(const UINT64* compactedSizes)
+{
+    m_compactedPoolSize = 0;
+    for (UINT i = 0; i < m_builds.size(); i++)
+    {
+        Build& build = m_builds[i];
+        ThrowIfFalse(compactedSizes[i] > 0 && compactedSizes[i] <= build.resultDataMaxSize, L"Compacted size is larger than the prebuild estimate.\n");
+
+        build.compactedSize = compactedSizes[i];
+        build.compactedOffset = m_compactedPoolSize;
+        m_compactedPoolSize += AlignAS(build.compactedSize);
+    }
+    m_compactionPlanned = true;
+}
+
+// Scratch is released once the builds complete, before the compacting copies are recorded.
+// The peak is therefore the larger of the two phases.
+AccelerationStructurePlanner::Statistics AccelerationStructurePlanner::GetStatistics() const
+{
+    Statistics stats = {};
+    stats.resultPoolSize = m_resultPoolSize;
+    stats.scratchPoolSize = m_scratchPoolSize;
+    stats.compactedPoolSize = m_compactedPoolSize;
+
+    UINT64 buildPhase = m_resultPoolSize + m_scratchPoolSize;
+    UINT64 compactionPhase = m_compactionPlanned ? m_resultPoolSize + m_compactedPoolSize : 0;
+    stats.peakSize = std::max(buildPhase, compactionPhase);
+    stats.steadyStateSize = m_compactionPlanned ? m_compactedPoolSize : m_resultPoolSize;
+    return stats;
+}
+
+std::wstring AccelerationStructurePlanner::GetStatisticsString() const
+{
+    Statistics stats = GetStatistics();
+    auto KB = [](UINT64 bytes) { return static_cast<double>(bytes) / 1024.0; };
+
+    std::wstringstream wstr;
+    wstr << std::setprecision(1) << std::fixed;
+    wstr << L"|--------------------------------------------------------------------\n";
+    wstr << L"|Acceleration structure memory: " << m_builds.size() << L" builds in " << m_batches.size() << L" batches\n";
+    wstr << L"| Result pool:    " << KB(stats.resultPoolSize) << L" KB\n";
+    wstr << L"| Scratch pool:   " << KB(stats.scratchPoolSize) << L" KB\n";
+    wstr << L"| Compacted pool: " << KB(stats.compactedPoolSize) << L" KB\n";
+    wstr << L"| Peak:           " << KB(stats.peakSize) << L" KB\n";
+    wstr << L"| Steady state:   " << KB(stats.steadyStateSize) << L" KB\n";
+    wstr << L"|--------------------------------------------------------------------\n";
+    return wstr.str();
+}
@@ -0,0 +1,86 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// AccelerationStructurePlanner.h - Memory layout of batched acceleration structure builds
+//
+
+#pragma once
+
+namespace DX
+{
+    // Works purely from prebuild sizes and produces offsets into three pools:
+    //  - result pool:    every build's worst case result, alive until compaction is done.
+    //  - scratch pool:   builds are packed into batches whose summed scratch fits the budget.
+    //                    Batches run back to back and alias the same scratch memory.
+    //  - compacted pool: tightly packed copies of the results, the only memory kept afterwards.
+    // The sizes can come from the driver or from CpuBvh, so plans can be checked without a GPU.
+    class AccelerationStructurePlanner
+    {
+    public:
+        static const UINT64 c_defaultScratchBudget = 32 * 1024 * 1024;
+
+        struct Build
+        {
+            UINT64  resultDataMaxSize;
+            UINT64  scratchSize;
+            UINT    batch;
+            UINT64  resultOffset;
+            UINT64  scratchOffset;
+            UINT64  compactedSize;
+            UINT64  compactedOffset;
+        };
+
+        struct Batch
+        {
+            UINT    firstBuild;
+            UINT    buildCount;
+            UINT64  scratchSize;
+        };
+
+        struct Statistics
+        {
+            UINT64  resultPoolSize;
+            UINT64  scratchPoolSize;
+            UINT64  compactedPoolSize;
+            UINT64  peakSize;           // Largest amount of memory alive at any point of build + compaction.
+            UINT64  steadyStateSize;    // Memory kept once the build memory has been released.
+        };
+
+        AccelerationStructurePlanner();
+
+        void Clear();
+        UINT AddBuild(UINT64 resultDataMaxSize, UINT64 scratchSize);
+
+        // Assigns result and scratch offsets and groups the builds into batches.
+        // A build whose scratch alone exceeds the budget gets a batch of its own.
+        void PlanBuilds(UINT64 scratchBudget = c_defaultScratchBudget);
+        // Assigns offsets in the compacted pool, compactedSizes is indexed like the builds.
+        void PlanCompaction(const UINT64* compactedSizes);
+
+        // Accessors.
+        UINT                GetBuildCount() const { return static_cast<UINT>(m_builds.size()); }
+        const Build&        GetBuild(UINT index) const { return m_builds[index]; }
+        UINT                GetBatchCount() const { return static_cast<UINT>(m_batches.size()); }
+        const Batch&        GetBatch(UINT index) const { return m_batches[index]; }
+        bool                IsCompactionPlanned() const { return m_compactionPlanned; }
+        Statistics          GetStatistics() const;
+        std::wstring        GetStatisticsString() const;
+
+    private:
+        std::vector<Build>  m_builds;
+        std::vector<Batch>  m_batches;
+        UINT64              m_resultPoolSize;
+        UINT64              m_scratchPoolSize;
+        UINT64              m_compactedPoolSize;
+        bool                m_compactionPlanned;
+    };
+}
@@ -0,0 +1,278 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "AdaptiveSampler.h"
+#include "ImageFile.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const UINT c_defaultRaysPerPixel = 16;
+
+    // Roberts' R2 sequence steps by the inverse of the plastic number and its square.
+    const double c_r2StepX = 0.7548776662466927;
+    const double c_r2StepY = 0.5698402909980532;
+
+    UINT32 Hash(UINT32 value)
+    {
+        value = (value ^ 61) ^ (value >> 16);
+        value *= 9;
+        value ^= value >> 4;
+        value *= 0x27D4EB2D;
+        value ^= value >> 15;
+        return value;
+    }
+
+    double ToUnit(UINT32 value)
+    {
+        return value * (1.0 / 4294967296.0);
+    }
+
+    float Luminance(const XMFLOAT4& color)
+    {
+        return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+    }
+}
+
+AdaptiveSampler::AdaptiveSampler() :
+    m_width(0),
+    m_height(0),
+    m_statistics()
+{
+}
+
+void AdaptiveSampler::Render(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    const AdaptiveSamplingDesc& desc, CpuFramebuffer* target, JobSystem* jobs)
+{
+    TRACE_SCOPE("AdaptiveSampler::Render");
+    m_width = target->GetWidth();
+    m_height = target->GetHeight();
+    ThrowIfFalse(m_width > 0 && m_height > 0, L"AdaptiveSampler: the target has no pixels.\n");
+    ThrowIfFalse(desc.tileSize > 0 && desc.initialSamples >= 2 && desc.samplesPerRound > 0 && desc.maxSamples >= desc.initialSamples,
+        L"AdaptiveSampler: invalid sampling desc.\n");
+    m_desc = desc;
+    const UINT64 pixelCount = static_cast<UINT64>(m_width) * m_height;
+    const UINT64 rayBudget = desc.rayBudget ? desc.rayBudget : c_defaultRaysPerPixel * pixelCount;
+
+    m_pixels.assign(static_cast<size_t>(pixelCount), Pixel());
+    m_tiles.clear();
+    for (UINT top = 0; top < m_height; top += desc.tileSize)
+    {
+        for (UINT left = 0; left < m_width; left += desc.tileSize)
+        {
+            Tile tile = { left, top, min<UINT>(left + desc.tileSize, m_width), min<UINT>(top + desc.tileSize, m_height), 0, 0.0, 0.0 };
+            m_tiles.push_back(tile);
+        }
+    }
+    m_statistics = Statistics();
+    m_statistics.tileCount = static_cast<UINT>(m_tiles.size());
+
+    // Tile index and samples per pixel to add.
+    vector<pair<UINT, UINT>> batch;
+    for (UINT i = 0; i < m_tiles.size(); i++)
+    {
+        batch.emplace_back(i, desc.initialSamples);
+    }
+    vector<UINT> noisyTiles;
+    for (;;)
+    {
+        auto job = [&](UINT index, UINT)
+        {
+            TRACE_SCOPE("AdaptiveSampler::SampleTile");
+            SampleTile(tracer, vertices, indices, camera, batch[index].second, &m_tiles[batch[index].first]);
+        };
+        if (jobs)
+        {
+            jobs->ParallelFor(static_cast<UINT>(batch.size()), job);
+        }
+        else
+        {
+            for (UINT i = 0; i < batch.size(); i++)
+            {
+                job(i, 0);
+            }
+        }
+        for (auto& entry : batch)
+        {
+            const Tile& tile = m_tiles[entry.first];
+            m_statistics.rays += static_cast<UINT64>(entry.second) * (tile.right - tile.left) * (tile.bottom - tile.top);
+        }
+
+        noisyTiles.clear();
+        for (UINT i = 0; i < m_tiles.size(); i++)
+        {
+            if (m_tiles[i].error > desc.errorThreshold && m_tiles[i].samples < desc.maxSamples)
+            {
+                noisyTiles.push_back(i);
+            }
+        }
+        sort(noisyTiles.begin(), noisyTiles.end(), [&](UINT a, UINT b) { return m_tiles[a].error > m_tiles[b].error; });
+
+        // Whatever fits in the budget, noisiest first. Smaller tiles at the edges may still fit
+        // after a whole one didn't.
+        batch.clear();
+        UINT64 plannedRays = m_statistics.rays;
+        for (UINT i : noisyTiles)
+        {
+            const Tile& tile = m_tiles[i];
+            UINT sampleCount = min(desc.samplesPerRound, desc.maxSamples - tile.samples);
+            UINT64 rays = static_cast<UINT64>(sampleCount) * (tile.right - tile.left) * (tile.bottom - tile.top);
+            if (plannedRays + rays <= rayBudget)
+            {
+                batch.emplace_back(i, sampleCount);
+                plannedRays += rays;
+            }
+        }
+        if (batch.empty())
+        {
+            break;
+        }
+        m_statistics.rounds++;
+    }
+
+    m_color.Resize(m_width, m_height);
+    double worstVariance = 0.0;
+    for (const Tile& tile : m_tiles)
+    {
+        float scale = 1.0f / tile.samples;
+        for (UINT y = tile.top; y < tile.bottom; y++)
+        {
+            for (UINT x = tile.left; x < tile.right; x++)
+            {
+                const XMFLOAT3& sum = m_pixels[static_cast<size_t>(y) * m_width + x].colorSum;
+                m_color.GetPixel(x, y) = XMFLOAT4(sum.x * scale, sum.y * scale, sum.z * scale, 1.0f);
+            }
+        }
+        worstVariance = max(worstVariance, tile.variance);
+        m_statistics.maxTileError = max(m_statistics.maxTileError, tile.error);
+        m_statistics.meanTileError += tile.error / m_tiles.size();
+        m_statistics.noisyTiles += tile.error > desc.errorThreshold ? 1 : 0;
+    }
+    double error = m_statistics.maxTileError;
+    double uniformSamples = error > 0.0 ? ceil(worstVariance / (error * error)) : 0.0;
+    m_statistics.uniformRays = static_cast<UINT64>(max<double>(uniformSamples, desc.initialSamples)) * pixelCount;
+
+    for (UINT y = 0; y < m_height; y++)
+    {
+        copy(m_color.GetRow(y), m_color.GetRow(y) + m_width, target->GetRow(y));
+    }
+}
+
+// Adds sampleCount samples to every pixel of the tile and updates its error.
+void AdaptiveSampler::SampleTile(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    UINT sampleCount, Tile* tile)
+{
+    const UINT firstSample = tile->samples;
+    const UINT sampleEnd = firstSample + sampleCount;
+    double varianceSum = 0.0;
+    for (UINT y = tile->top; y < tile->bottom; y++)
+    {
+        for (UINT x = tile->left; x < tile->right; x++)
+        {
+            Pixel& pixel = m_pixels[static_cast<size_t>(y) * m_width + x];
+            UINT32 seed = Hash(x ^ Hash(y));
+            double shiftX = ToUnit(seed);
+            double shiftY = ToUnit(Hash(seed));
+            for (UINT i = firstSample; i < sampleEnd; i++)
+            {
+                double offsetX = shiftX + (i + 1) * c_r2StepX;
+                double offsetY = shiftY + (i + 1) * c_r2StepY;
+                XMFLOAT4 color;
+                CpuHit hit;
+                CpuRenderer::TraceSample(tracer, vertices, indices, camera, m_width, m_height, x, y,
+                    static_cast<float>(offsetX - floor(offsetX)), static_cast<float>(offsetY - floor(offsetY)), &color, &hit, nullptr);
+
+                pixel.colorSum.x += color.x;
+                pixel.colorSum.y += color.y;
+                pixel.colorSum.z += color.z;
+                float luminance = Luminance(color);
+                float delta = luminance - pixel.luminanceMean;
+                pixel.luminanceMean += delta / (i + 1);
+                pixel.luminanceM2 += delta * (luminance - pixel.luminanceMean);
+            }
+            varianceSum += pixel.luminanceM2 / (sampleEnd - 1);
+        }
+    }
+    tile->samples = sampleEnd;
+    tile->variance = varianceSum / ((tile->right - tile->left) * (tile->bottom - tile->top));
+    tile->error = sqrt(tile->variance / tile->samples);
+}
+
+void AdaptiveSampler::FillSampleHeatmap(CpuFramebuffer* target) const
+{
+    ThrowIfFalse(m_width > 0, L"AdaptiveSampler: nothing has been rendered.\n");
+    target->Resize(m_width, m_height);
+    for (const Tile& tile : m_tiles)
+    {
+        XMFLOAT4 color = CpuFramebuffer::HeatColor(static_cast<float>(tile.samples) / m_desc.maxSamples);
+        for (UINT y = tile.top; y < tile.bottom; y++)
+        {
+            fill(target->GetRow(y) + tile.left, target->GetRow(y) + tile.right, color);
+        }
+    }
+}
+
+void AdaptiveSampler::Export(const wstring& prefix) const
+{
+    ThrowIfFalse(m_width > 0, L"AdaptiveSampler: nothing has been rendered.\n");
+
+    vector<UINT32> rgba8(static_cast<size_t>(m_width) * m_height);
+    m_color.ConvertToRgba8(rgba8.data());
+    ImageFile::WritePpm(prefix + L"_color.ppm", m_width, m_height, rgba8.data());
+    CpuFramebuffer heatmap;
+    FillSampleHeatmap(&heatmap);
+    heatmap.ConvertToRgba8(rgba8.data());
+    ImageFile::WritePpm(prefix + L"_samples.ppm", m_width, m_height, rgba8.data());
+
+    ofstream file(prefix + L"_stats.json");
+    ThrowIfFalse(file.is_open(), L"AdaptiveSampler: couldn't open the statistics file.\n");
+    UINT64 pixelCount = static_cast<UINT64>(m_width) * m_height;
+    file << fixed << setprecision(6)
+        << "{\n  \"width\": " << m_width
+        << ",\n  \"height\": " << m_height
+        << ",\n  \"tile_size\": " << m_desc.tileSize
+        << ",\n  \"initial_samples\": " << m_desc.initialSamples
+        << ",\n  \"samples_per_round\": " << m_desc.samplesPerRound
+        << ",\n  \"max_samples\": " << m_desc.maxSamples
+        << ",\n  \"error_threshold\": " << m_desc.errorThreshold
+        << ",\n  \"rays\": " << m_statistics.rays
+        << ",\n  \"rays_per_pixel\": " << static_cast<double>(m_statistics.rays) / pixelCount
+        << ",\n  \"uniform_rays\": " << m_statistics.uniformRays
+        << ",\n  \"rays_saved\": " << (m_statistics.uniformRays ? 1.0 - static_cast<double>(m_statistics.rays) / m_statistics.uniformRays : 0.0)
+        << ",\n  \"rounds\": " << m_statistics.rounds
+        << ",\n  \"tiles\": " << m_statistics.tileCount
+        << ",\n  \"noisy_tiles\": " << m_statistics.noisyTiles
+        << ",\n  \"max_tile_error\": " << m_statistics.maxTileError
+        << ",\n  \"mean_tile_error\": " << m_statistics.meanTileError
+        << "\n}\n";
+}
+
+wstring AdaptiveSampler::GetStatisticsString() const
+{
+    wstringstream stream;
+    double pixelCount = max(static_cast<double>(m_width) * m_height, 1.0);
+    stream << fixed << setprecision(1)
+        << L"Adaptive sampling, " << m_width << L"x" << m_height << L", " << m_statistics.rays << L" rays ("
+        << m_statistics.rays / pixelCount << L" per pixel), " << m_statistics.rounds << L" rounds\n"
+        << L"  uniform at equal error: " << m_statistics.uniformRays << L" rays (" << m_statistics.uniformRays / pixelCount
+        << L" per pixel), " << (m_statistics.uniformRays ? 100.0 * (1.0 - static_cast<double>(m_statistics.rays) / m_statistics.uniformRays) : 0.0)
+        << L"% saved\n"
+        << setprecision(5) << L"  " << m_statistics.tileCount << L" tiles, " << m_statistics.noisyTiles << L" above "
+        << m_desc.errorThreshold << L", worst error " << m_statistics.maxTileError << L", mean " << m_statistics.meanTileError << L"\n";
+    return stream.str();
+}
@@ -0,0 +1,112 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// AdaptiveSampler.h - Many samples per pixel with the CPU tracer, spent where the image is noisy
+//
+
+#pragma once
+
+#include "CpuRenderer.h"
+
+namespace DX
+{
+    struct AdaptiveSamplingDesc
+    {
+        AdaptiveSamplingDesc() :
+            tileSize(16),
+            initialSamples(4),
+            samplesPerRound(4),
+            maxSamples(256),
+            rayBudget(0),
+            errorThreshold(0.002f)
+        {
+        }
+
+        UINT    tileSize;           // Pixels along each side.
+        UINT    initialSamples;     // Every pixel gets these first, at least 2 to have a variance.
+        UINT    samplesPerRound;    // Added to every pixel of a tile picked for refinement.
+        UINT    maxSamples;         // Per pixel.
+        UINT64  rayBudget;          // Per frame, the initial samples included. 0 is 16 per pixel.
+        float   errorThreshold;     // Standard error of a tile's luminance, about half an 8-bit step.
+    };
+
+    // Every pixel keeps the running mean of its samples and the variance of their luminance
+    // (Welford). All pixels of a tile have the same sample count, and the tile's error is the
+    // standard error of its pixels' means: the square root of their mean variance over the count.
+    // After initialSamples everywhere, rounds add samplesPerRound to every pixel of each tile
+    // still above errorThreshold, noisiest first, until no tile is or the ray budget runs out.
+    // MyMissShader's sky is flat per row and so is a triangle's interior, only tiles with edges
+    // keep being refined.
+    //
+    // For comparison, uniform sampling would need as many samples everywhere as the worst tile
+    // needs to get down to the final worst tile error; this is estimated from the tile variances.
+    // Sample positions are a per pixel rotation of the R2 sequence, so the result doesn't depend
+    // on how the tiles are spread over jobs.
+    class AdaptiveSampler
+    {
+    public:
+        struct Statistics
+        {
+            UINT64  rays;
+            UINT64  uniformRays;        // Uniform sampling at the same worst tile error.
+            UINT    rounds;             // Refinement rounds after the initial samples.
+            UINT    tileCount;
+            UINT    noisyTiles;         // Still above the threshold at the end.
+            double  maxTileError;
+            double  meanTileError;
+        };
+
+        AdaptiveSampler();
+
+        void Render(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            const AdaptiveSamplingDesc& desc, CpuFramebuffer* target, JobSystem* jobs = nullptr);
+
+        // Samples per pixel of the last Render() as a heatmap, red at maxSamples.
+        void FillSampleHeatmap(CpuFramebuffer* target) const;
+        // Writes prefix_color.ppm, prefix_samples.ppm and prefix_stats.json.
+        void Export(const std::wstring& prefix) const;
+        std::wstring GetStatisticsString() const;
+
+        // Accessors.
+        const Statistics&   GetStatistics() const { return m_statistics; }
+
+    private:
+        struct Pixel
+        {
+            DirectX::XMFLOAT3   colorSum;
+            float               luminanceMean;
+            float               luminanceM2;    // Sum of squared differences from the mean.
+        };
+
+        struct Tile
+        {
+            UINT    left;
+            UINT    top;
+            UINT    right;
+            UINT    bottom;
+            UINT    samples;                    // Per pixel.
+            double  variance;                   // Mean sample variance of the pixels' luminance.
+            double  error;
+        };
+
+        void SampleTile(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            UINT sampleCount, Tile* tile);
+
+        UINT                    m_width;
+        UINT                    m_height;
+        AdaptiveSamplingDesc    m_desc;
+        std::vector<Pixel>      m_pixels;
+        std::vector<Tile>       m_tiles;
+        CpuFramebuffer          m_color;
+        Statistics              m_statistics;
+    };
+}
@@ -0,0 +1,108 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CameraPath.h"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtx/spline.hpp"
+#include <fstream>
+
+using namespace DX;
+using namespace std;
+
+const double CameraPath::c_minKeyInterval = 1.0 / 120.0;
+
+CameraPath CameraPath::CreateOrbit(const glm::vec3& center, float radius, float height, double duration, UINT keyCount)
+{
+    ThrowIfFalse(keyCount >= 2 && duration > 0.0, L"CameraPath: an orbit needs a duration and at least two keys.\n");
+
+    // The last key repeats the first, so the orbit closes when the path starts over.
+    CameraPath path;
+    for (UINT i = 0; i <= keyCount; i++)
+    {
+        float angle = 2.0f * glm::pi<float>() * i / keyCount;
+        glm::vec3 eye = center + glm::vec3(radius * sin(angle), height, radius * cos(angle));
+        path.m_keys.push_back({ duration * i / keyCount, eye, center, glm::vec3(0.0f, 1.0f, 0.0f) });
+    }
+    return path;
+}
+
+void CameraPath::AddKey(double time, const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up)
+{
+    if (!m_keys.empty() && time < m_keys.back().time + c_minKeyInterval)
+    {
+        return;
+    }
+    m_keys.push_back({ time, eye, center, up });
+}
+
+void CameraPath::Evaluate(double time, glm::vec3* eye, glm::vec3* center, glm::vec3* up) const
+{
+    ThrowIfFalse(!m_keys.empty(), L"CameraPath: the path has no keys.\n");
+
+    double duration = GetDuration();
+    if (m_keys.size() == 1 || duration <= 0.0)
+    {
+        *eye = m_keys.front().eye;
+        *center = m_keys.front().center;
+        *up = m_keys.front().up;
+        return;
+    }
+
+    double t = m_keys.front().time + fmod(max(time, 0.0), duration);
+    auto next = upper_bound(m_keys.begin(), m_keys.end(), t, [](double value, const CameraKey& key) { return value < key.time; });
+    size_t i1 = min<size_t>(static_cast<size_t>(next - m_keys.begin()), m_keys.size() - 1);
+    size_t i0 = i1 - 1;
+
+    // The spline needs a key on either side of the segment, the ends repeat themselves.
+    const CameraKey& k0 = m_keys[i0 > 0 ? i0 - 1 : i0];
+    const CameraKey& k1 = m_keys[i0];
+    const CameraKey& k2 = m_keys[i1];
+    const CameraKey& k3 = m_keys[min<size_t>(i1 + 1, m_keys.size() - 1)];
+    float s = static_cast<float>((t - k1.time) / max(k2.time - k1.time, 1e-9));
+
+    *eye = glm::catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, s);
+    *center = glm::catmullRom(k0.center, k1.center, k2.center, k3.center, s);
+    *up = glm::normalize(glm::catmullRom(k0.up, k1.up, k2.up, k3.up, s));
+}
+
+void CameraPath::Save(const wstring& path) const
+{
+    ofstream file(path);
+    ThrowIfFalse(file.is_open(), L"CameraPath: couldn't open the file for writing.\n");
+
+    file << setprecision(9);
+    for (auto& key : m_keys)
+    {
+        file << key.time
+            << ' ' << key.eye.x << ' ' << key.eye.y << ' ' << key.eye.z
+            << ' ' << key.center.x << ' ' << key.center.y << ' ' << key.center.z
+            << ' ' << key.up.x << ' ' << key.up.y << ' ' << key.up.z << '\n';
+    }
+}
+
+void CameraPath::Load(const wstring& path)
+{
+    ifstream file(path);
+    ThrowIfFalse(file.is_open(), L"CameraPath: couldn't open the file.\n");
+
+    m_keys.clear();
+    CameraKey key;
+    while (file >> key.time
+        >> key.eye.x >> key.eye.y >> key.eye.z
+        >> key.center.x >> key.center.y >> key.center.z
+        >> key.up.x >> key.up.y >> key.up.z)
+    {
+        ThrowIfFalse(m_keys.empty() || key.time > m_keys.back().time, L"CameraPath: key times must increase.\n");
+        m_keys.push_back(key);
+    }
+    ThrowIfFalse(file.eof() && !m_keys.empty(), L"CameraPath: the file isn't a camera path.\n");
+}
@@ -0,0 +1,60 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CameraPath.h - Recorded or generated camera look-at keys, replayed along a spline
+//
+
+#pragma once
+
+#include "glm/glm.hpp"
+
+namespace DX
+{
+    struct CameraKey
+    {
+        double      time;       // Seconds from the start of the path.
+        glm::vec3   eye;
+        glm::vec3   center;
+        glm::vec3   up;
+    };
+
+    // Keys are the camera's look-at, as the manipulator reports it, rather than the mouse input
+    // that produced it, so a replay doesn't depend on window size or manipulator settings.
+    // Between keys the camera follows a Catmull-Rom spline, past the end it starts over.
+    // Saved as text, one key per line: time, eye, center, up.
+    class CameraPath
+    {
+    public:
+        // Keys closer than this to the previous one are dropped while recording.
+        static const double c_minKeyInterval;
+
+        // A circle around center, looking at it, for benchmarks without a recorded path.
+        static CameraPath CreateOrbit(const glm::vec3& center, float radius, float height, double duration, UINT keyCount);
+
+        void Clear() { m_keys.clear(); }
+
+        // Times must increase, AddKey() ignores keys that come too soon.
+        void AddKey(double time, const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up);
+        void Evaluate(double time, glm::vec3* eye, glm::vec3* center, glm::vec3* up) const;
+
+        void Save(const std::wstring& path) const;
+        void Load(const std::wstring& path);
+
+        // Accessors.
+        bool    IsEmpty() const { return m_keys.empty(); }
+        UINT    GetKeyCount() const { return static_cast<UINT>(m_keys.size()); }
+        double  GetDuration() const { return m_keys.empty() ? 0.0 : m_keys.back().time - m_keys.front().time; }
+
+    private:
+        std::vector<CameraKey> m_keys;
+    };
+}
@@ -0,0 +1,121 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CommandListPool.h"
+
+using namespace DX;
+using namespace std;
+
+using Microsoft::WRL::ComPtr;
+
+CommandListPool::CommandListPool() :
+    m_type(D3D12_COMMAND_LIST_TYPE_DIRECT),
+    m_frameCount(0),
+    m_threadCount(0),
+    m_frameIndex(0),
+    m_frameAcquireCount(0),
+    m_lastFrameAcquireCount(0)
+{
+}
+
+void CommandListPool::Initialize(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type, UINT frameCount, UINT threadCount)
+{
+    ThrowIfFalse(frameCount > 0 && threadCount > 0, L"CommandListPool: frame and thread counts must not be zero.\n");
+
+    Release();
+    m_device = device;
+    m_type = type;
+    m_frameCount = frameCount;
+    m_threadCount = threadCount;
+
+    m_allocators.resize(frameCount * threadCount);
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        for (UINT thread = 0; thread < threadCount; thread++)
+        {
+            auto& allocator = m_allocators[frame * threadCount + thread];
+            ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&allocator)));
+
+            wchar_t name[64] = {};
+            swprintf_s(name, L"Pooled command allocator %u/%u", frame, thread);
+            allocator->SetName(name);
+        }
+    }
+}
+
+void CommandListPool::Release()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_freeLists.clear();
+    m_usedLists.clear();
+    m_allocators.clear();
+    m_device.Reset();
+    m_frameIndex = 0;
+    m_frameAcquireCount = 0;
+    m_lastFrameAcquireCount = 0;
+}
+
+void CommandListPool::BeginFrame(UINT frameIndex)
+{
+    ThrowIfFalse(frameIndex < m_frameCount, L"CommandListPool: frame index out of range.\n");
+
+    lock_guard<mutex> lock(m_mutex);
+    m_frameIndex = frameIndex;
+    for (UINT thread = 0; thread < m_threadCount; thread++)
+    {
+        ThrowIfFailed(m_allocators[frameIndex * m_threadCount + thread]->Reset());
+    }
+
+    m_freeLists.insert(m_freeLists.end(), m_usedLists.begin(), m_usedLists.end());
+    m_usedLists.clear();
+    m_lastFrameAcquireCount = m_frameAcquireCount;
+    m_frameAcquireCount = 0;
+}
+
+ID3D12GraphicsCommandList* CommandListPool::Acquire(UINT threadIndex)
+{
+    ThrowIfFalse(threadIndex < m_threadCount, L"CommandListPool: thread index out of range.\n");
+
+    CommandList commandList;
+    ID3D12CommandAllocator* allocator;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        allocator = m_allocators[m_frameIndex * m_threadCount + threadIndex].Get();
+        if (!m_freeLists.empty())
+        {
+            commandList = m_freeLists.back();
+            m_freeLists.pop_back();
+        }
+        m_frameAcquireCount++;
+    }
+
+    // Creating or resetting a list is the expensive part, keep it outside the lock.
+    if (commandList)
+    {
+        ThrowIfFailed(commandList->Reset(allocator, nullptr));
+    }
+    else
+    {
+        ThrowIfFailed(m_device->CreateCommandList(0, m_type, allocator, nullptr, IID_PPV_ARGS(&commandList)));
+        commandList->SetName(L"Pooled command list");
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+    m_usedLists.push_back(commandList);
+    return commandList.Get();
+}
+
+UINT CommandListPool::GetCommandListCount() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return static_cast<UINT>(m_freeLists.size() + m_usedLists.size());
+}
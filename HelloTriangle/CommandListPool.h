@@ -0,0 +1,61 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CommandListPool.h - Command lists for recording on several threads at once
+//
+
+#pragma once
+
+namespace DX
+{
+    // One command allocator per frame in flight and recording thread, so threads never share an
+    // allocator and a frame's allocators are reset only once the GPU is done with them.
+    // Command lists are recycled: a list can be reset as soon as it has been submitted, so all
+    // lists handed out return to the pool at the next BeginFrame().
+    class CommandListPool
+    {
+    public:
+        CommandListPool();
+
+        void Initialize(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type, UINT frameCount, UINT threadCount);
+        void Release();
+
+        // Resets the allocators of frameIndex, the frame's previous fence must have completed.
+        void BeginFrame(UINT frameIndex);
+
+        // An open command list recording into threadIndex's allocator for the current frame.
+        // Can be called from several threads with different thread indices. A thread must close
+        // its list before acquiring the next, an allocator only backs one open list at a time.
+        ID3D12GraphicsCommandList* Acquire(UINT threadIndex);
+
+        // Accessors.
+        UINT    GetThreadCount() const { return m_threadCount; }
+        UINT    GetCommandListCount() const;
+        UINT    GetLastFrameAcquireCount() const { return m_lastFrameAcquireCount; }
+
+    private:
+        typedef Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CommandList;
+
+        Microsoft::WRL::ComPtr<ID3D12Device>                            m_device;
+        D3D12_COMMAND_LIST_TYPE                                         m_type;
+        UINT                                                            m_frameCount;
+        UINT                                                            m_threadCount;
+        UINT                                                            m_frameIndex;
+        std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>     m_allocators;   // [frame * m_threadCount + thread]
+
+        mutable std::mutex                                              m_mutex;
+        std::vector<CommandList>                                        m_freeLists;
+        std::vector<CommandList>                                        m_usedLists;
+        UINT                                                            m_frameAcquireCount;
+        UINT                                                            m_lastFrameAcquireCount;
+    };
+}
@@ -0,0 +1,290 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CpuBvh.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    inline float Component(const XMFLOAT3& v, UINT axis) { return (&v.x)[axis]; }
+
+    struct Bounds
+    {
+        XMFLOAT3 bmin;
+        XMFLOAT3 bmax;
+
+        Bounds() : bmin(FLT_MAX, FLT_MAX, FLT_MAX), bmax(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+
+        void Grow(const XMFLOAT3& p)
+        {
+            bmin = XMFLOAT3(min(bmin.x, p.x), min(bmin.y, p.y), min(bmin.z, p.z));
+            bmax = XMFLOAT3(max(bmax.x, p.x), max(bmax.y, p.y), max(bmax.z, p.z));
+        }
+
+        void Grow(const XMFLOAT3& pmin, const XMFLOAT3& pmax)
+        {
+            Grow(pmin);
+            Grow(pmax);
+        }
+
+        float HalfArea() const
+        {
+            if (bmin.x > bmax.x)
+            {
+                return 0.0f;
+            }
+            float dx = bmax.x - bmin.x, dy = bmax.y - bmin.y, dz = bmax.z - bmin.z;
+            return dx * dy + dy * dz + dz * dx;
+        }
+    };
+
+    struct Bin
+    {
+        Bounds  bounds;
+        UINT    count;
+
+        Bin() : count(0) {}
+    };
+}
+
+CpuBvh::CpuBvh() :
+    m_depth(0)
+{
+}
+
+// Worst case: one primitive per leaf gives 2N - 1 nodes.
+// Scratch holds per primitive bounds and centroids.
+CpuBvhPrebuildInfo CpuBvh::GetPrebuildInfo(UINT primitiveCount)
+{
+    UINT64 n = max(primitiveCount, 1u);
+
+    CpuBvhPrebuildInfo info;
+    info.resultDataMaxSize = (2 * n - 1) * sizeof(CpuBvhNode) + n * sizeof(UINT);
+    info.scratchDataSize = n * 3 * sizeof(XMFLOAT3) + c_binCount * sizeof(Bin);
+    return info;
+}
+
+UINT64 CpuBvh::GetCompactedSize() const
+{
+    return m_nodes.size() * sizeof(CpuBvhNode) + m_primitiveIndices.size() * sizeof(UINT);
+}
+
+void CpuBvh::Clear()
+{
+    m_nodes.clear();
+    m_primitiveIndices.clear();
+    m_depth = 0;
+}
+
+void CpuBvh::Build(const XMFLOAT3* boundsMin, const XMFLOAT3* boundsMax, UINT primitiveCount)
+{
+    TRACE_SCOPE("CpuBvh::Build");
+    Clear();
+    if (primitiveCount == 0)
+    {
+        return;
+    }
+
+    m_boundsMin.assign(boundsMin, boundsMin + primitiveCount);
+    m_boundsMax.assign(boundsMax, boundsMax + primitiveCount);
+    m_centroids.resize(primitiveCount);
+    m_primitiveIndices.resize(primitiveCount);
+    for (UINT i = 0; i < primitiveCount; i++)
+    {
+        m_centroids[i] = XMFLOAT3(
+            0.5f * (boundsMin[i].x + boundsMax[i].x),
+            0.5f * (boundsMin[i].y + boundsMax[i].y),
+            0.5f * (boundsMin[i].z + boundsMax[i].z));
+        m_primitiveIndices[i] = i;
+    }
+
+    m_nodes.reserve(2 * primitiveCount - 1);
+    CpuBvhNode root = {};
+    root.leftFirst = 0;
+    root.count = primitiveCount;
+    m_nodes.push_back(root);
+    Subdivide();
+
+    m_nodes.shrink_to_fit();
+    vector<XMFLOAT3>().swap(m_boundsMin);
+    vector<XMFLOAT3>().swap(m_boundsMax);
+    vector<XMFLOAT3>().swap(m_centroids);
+}
+
+// Depth first with an explicit stack, degenerate input can make the tree as deep as it has
+// primitives. The right child is pushed first so nodes get the order a recursive build gives them.
+void CpuBvh::Subdivide()
+{
+    struct StackEntry
+    {
+        UINT    nodeIndex;
+        UINT    depth;
+    };
+    vector<StackEntry> stack;
+    stack.push_back({ 0, 1 });
+    while (!stack.empty())
+    {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        m_depth = max(m_depth, entry.depth);
+        if (SplitNode(entry.nodeIndex))
+        {
+            UINT leftChild = m_nodes[entry.nodeIndex].leftFirst;
+            stack.push_back({ leftChild + 1, entry.depth + 1 });
+            stack.push_back({ leftChild, entry.depth + 1 });
+        }
+    }
+}
+
+bool CpuBvh::SplitNode(UINT nodeIndex)
+{
+    UINT first = m_nodes[nodeIndex].leftFirst;
+    UINT count = m_nodes[nodeIndex].count;
+
+    Bounds nodeBounds, centroidBounds;
+    for (UINT i = first; i < first + count; i++)
+    {
+        UINT p = m_primitiveIndices[i];
+        nodeBounds.Grow(m_boundsMin[p], m_boundsMax[p]);
+        centroidBounds.Grow(m_centroids[p]);
+    }
+    m_nodes[nodeIndex].boundsMin = nodeBounds.bmin;
+    m_nodes[nodeIndex].boundsMax = nodeBounds.bmax;
+
+    if (count <= c_maxLeafSize)
+    {
+        return false;
+    }
+
+    // Binned SAH: evaluate c_binCount - 1 split planes along every axis of the centroid bounds.
+    float bestCost = FLT_MAX;
+    UINT bestAxis = 0;
+    UINT bestSplit = 0;
+    for (UINT axis = 0; axis < 3; axis++)
+    {
+        float lo = Component(centroidBounds.bmin, axis);
+        float hi = Component(centroidBounds.bmax, axis);
+        if (hi <= lo)
+        {
+            continue;
+        }
+
+        Bin bins[c_binCount];
+        float scale = c_binCount / (hi - lo);
+        for (UINT i = first; i < first + count; i++)
+        {
+            UINT p = m_primitiveIndices[i];
+            UINT b = min(c_binCount - 1, static_cast<UINT>((Component(m_centroids[p], axis) - lo) * scale));
+            bins[b].count++;
+            bins[b].bounds.Grow(m_boundsMin[p], m_boundsMax[p]);
+        }
+
+        float leftArea[c_binCount - 1];
+        UINT leftCount[c_binCount - 1];
+        Bounds left;
+        UINT leftSum = 0;
+        for (UINT b = 0; b < c_binCount - 1; b++)
+        {
+            leftSum += bins[b].count;
+            left.Grow(bins[b].bounds.bmin, bins[b].bounds.bmax);
+            leftCount[b] = leftSum;
+            leftArea[b] = left.HalfArea();
+        }
+
+        Bounds right;
+        UINT rightSum = 0;
+        for (UINT b = c_binCount - 1; b > 0; b--)
+        {
+            rightSum += bins[b].count;
+            right.Grow(bins[b].bounds.bmin, bins[b].bounds.bmax);
+            float cost = leftCount[b - 1] * leftArea[b - 1] + rightSum * right.HalfArea();
+            if (leftCount[b - 1] > 0 && rightSum > 0 && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    UINT mid;
+    if (bestCost < FLT_MAX)
+    {
+        // Splitting only pays off if it is cheaper than intersecting every primitive in this node.
+        if (bestCost >= count * nodeBounds.HalfArea())
+        {
+            return false;
+        }
+
+        float lo = Component(centroidBounds.bmin, bestAxis);
+        float scale = c_binCount / (Component(centroidBounds.bmax, bestAxis) - lo);
+        auto begin = m_primitiveIndices.begin() + first;
+        auto split = partition(begin, begin + count, [&](UINT p)
+        {
+            return min(c_binCount - 1, static_cast<UINT>((Component(m_centroids[p], bestAxis) - lo) * scale)) < bestSplit;
+        });
+        mid = static_cast<UINT>(split - m_primitiveIndices.begin());
+    }
+    else
+    {
+        // All centroids coincide, fall back to splitting the list in half.
+        mid = first + count / 2;
+    }
+
+    UINT leftChild = static_cast<UINT>(m_nodes.size());
+    CpuBvhNode child = {};
+    child.leftFirst = first;
+    child.count = mid - first;
+    m_nodes.push_back(child);
+    child.leftFirst = mid;
+    child.count = first + count - mid;
+    m_nodes.push_back(child);
+
+    m_nodes[nodeIndex].leftFirst = leftChild;
+    m_nodes[nodeIndex].count = 0;
+    return true;
+}
+
+template<typename IndexType>
+void CpuBvh::BuildTrianglesT(const void* vertices, UINT vertexStride, const IndexType* indices, UINT triangleCount)
+{
+    auto position = [&](IndexType index)
+    {
+        return *reinterpret_cast<const XMFLOAT3*>(static_cast<const uint8_t*>(vertices) + static_cast<size_t>(index) * vertexStride);
+    };
+
+    vector<XMFLOAT3> boundsMin(triangleCount), boundsMax(triangleCount);
+    for (UINT i = 0; i < triangleCount; i++)
+    {
+        Bounds bounds;
+        bounds.Grow(position(indices[3 * i + 0]));
+        bounds.Grow(position(indices[3 * i + 1]));
+        bounds.Grow(position(indices[3 * i + 2]));
+        boundsMin[i] = bounds.bmin;
+        boundsMax[i] = bounds.bmax;
+    }
+    Build(boundsMin.data(), boundsMax.data(), triangleCount);
+}
+
+void CpuBvh::BuildTriangles(const void* vertices, UINT vertexStride, const UINT16* indices, UINT triangleCount)
+{
+    BuildTrianglesT(vertices, vertexStride, indices, triangleCount);
+}
+
+void CpuBvh::BuildTriangles(const void* vertices, UINT vertexStride, const UINT32* indices, UINT triangleCount)
+{
+    BuildTrianglesT(vertices, vertexStride, indices, triangleCount);
+}
@@ -0,0 +1,82 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CpuBvh.h - Binned SAH bounding volume hierarchy built on the CPU
+//
+
+#pragma once
+
+namespace DX
+{
+    // 32 bytes. Interior nodes have count == 0 and their children at leftFirst and leftFirst + 1,
+    // leaves reference count primitive indices starting at leftFirst.
+    struct CpuBvhNode
+    {
+        DirectX::XMFLOAT3   boundsMin;
+        UINT                leftFirst;
+        DirectX::XMFLOAT3   boundsMax;
+        UINT                count;
+
+        bool IsLeaf() const { return count > 0; }
+    };
+
+    // Mirrors D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO.
+    struct CpuBvhPrebuildInfo
+    {
+        UINT64  resultDataMaxSize;
+        UINT64  scratchDataSize;
+    };
+
+    // Stands in for the driver's builder: the prebuild info is a worst case known before building
+    // and GetCompactedSize() is the exact size afterwards, so AccelerationStructurePlanner can be
+    // driven without a GPU.
+    class CpuBvh
+    {
+    public:
+        static const UINT c_maxLeafSize = 4;
+        static const UINT c_binCount = 16;
+
+        CpuBvh();
+
+        static CpuBvhPrebuildInfo GetPrebuildInfo(UINT primitiveCount);
+
+        // Builds over arbitrary primitive bounds, e.g. instances of a top level structure.
+        void Build(const DirectX::XMFLOAT3* boundsMin, const DirectX::XMFLOAT3* boundsMax, UINT primitiveCount);
+        // vertexStride is in bytes, the position is expected at the start of each vertex.
+        void BuildTriangles(const void* vertices, UINT vertexStride, const UINT16* indices, UINT triangleCount);
+        void BuildTriangles(const void* vertices, UINT vertexStride, const UINT32* indices, UINT triangleCount);
+        void Clear();
+
+        // Accessors.
+        UINT64                          GetCompactedSize() const;
+        UINT                            GetNodeCount() const { return static_cast<UINT>(m_nodes.size()); }
+        UINT                            GetDepth() const { return m_depth; }
+        const std::vector<CpuBvhNode>&  GetNodes() const { return m_nodes; }
+        const std::vector<UINT>&        GetPrimitiveIndices() const { return m_primitiveIndices; }
+
+    private:
+        template<typename IndexType>
+        void BuildTrianglesT(const void* vertices, UINT vertexStride, const IndexType* indices, UINT triangleCount);
+        void Subdivide();
+        // Bounds the node and splits it in two children, false when it stays a leaf.
+        bool SplitNode(UINT nodeIndex);
+
+        std::vector<CpuBvhNode>         m_nodes;
+        std::vector<UINT>               m_primitiveIndices;
+        UINT                            m_depth;
+
+        // Scratch, only alive during Build().
+        std::vector<DirectX::XMFLOAT3>  m_boundsMin;
+        std::vector<DirectX::XMFLOAT3>  m_boundsMax;
+        std::vector<DirectX::XMFLOAT3>  m_centroids;
+    };
+}
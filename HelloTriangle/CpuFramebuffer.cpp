@@ -0,0 +1,73 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CpuFramebuffer.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    inline UINT32 ToUnorm8(float value)
+    {
+        // Written so NaN ends up as 0, like the GPU's conversion.
+        float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<UINT32>(clamped * 255.0f + 0.5f);
+    }
+}
+
+CpuFramebuffer::CpuFramebuffer() :
+    m_width(0),
+    m_height(0)
+{
+}
+
+void CpuFramebuffer::Resize(UINT width, UINT height)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels.assign(static_cast<size_t>(width) * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+}
+
+void CpuFramebuffer::Clear(const XMFLOAT4& color)
+{
+    fill(m_pixels.begin(), m_pixels.end(), color);
+}
+
+void CpuFramebuffer::ConvertToRgba8(const XMFLOAT4* source, UINT32* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const XMFLOAT4& pixel = source[i];
+        destination[i] = ToUnorm8(pixel.x) | ToUnorm8(pixel.y) << 8 | ToUnorm8(pixel.z) << 16 | ToUnorm8(pixel.w) << 24;
+    }
+}
+
+XMFLOAT4 CpuFramebuffer::HeatColor(float value)
+{
+    static const XMFLOAT3 stops[] =
+    {
+        XMFLOAT3(0.0f, 0.0f, 1.0f),
+        XMFLOAT3(0.0f, 1.0f, 1.0f),
+        XMFLOAT3(0.0f, 1.0f, 0.0f),
+        XMFLOAT3(1.0f, 1.0f, 0.0f),
+        XMFLOAT3(1.0f, 0.0f, 0.0f),
+    };
+    value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+    float position = value * (_countof(stops) - 1);
+    UINT i = min<UINT>(static_cast<UINT>(position), _countof(stops) - 2);
+    float t = position - i;
+    const XMFLOAT3& a = stops[i];
+    const XMFLOAT3& b = stops[i + 1];
+    return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, 1.0f);
+}
@@ -0,0 +1,52 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CpuFramebuffer.h - Float color target for CPU rendering and its conversion to 8 bit
+//
+
+#pragma once
+
+namespace DX
+{
+    // Linear RGBA, one XMFLOAT4 per pixel, rows top to bottom without padding.
+    class CpuFramebuffer
+    {
+    public:
+        CpuFramebuffer();
+
+        void Resize(UINT width, UINT height);
+        void Clear(const DirectX::XMFLOAT4& color);
+
+        // Clamps to [0, 1] and packs as DXGI_FORMAT_R8G8B8A8_UNORM, rounding to nearest.
+        // The static version converts any range of pixels, e.g. one band per job.
+        static void ConvertToRgba8(const DirectX::XMFLOAT4* source, UINT32* destination, size_t pixelCount);
+        void ConvertToRgba8(UINT32* destination) const { ConvertToRgba8(m_pixels.data(), destination, m_pixels.size()); }
+
+        // False color for value in [0, 1], from blue through cyan, green and yellow to red.
+        static DirectX::XMFLOAT4 HeatColor(float value);
+
+        // Accessors.
+        UINT                                    GetWidth() const { return m_width; }
+        UINT                                    GetHeight() const { return m_height; }
+        size_t                                  GetPixelCount() const { return m_pixels.size(); }
+        DirectX::XMFLOAT4*                      GetRow(UINT y) { return m_pixels.data() + static_cast<size_t>(y) * m_width; }
+        const DirectX::XMFLOAT4*                GetRow(UINT y) const { return m_pixels.data() + static_cast<size_t>(y) * m_width; }
+        DirectX::XMFLOAT4&                      GetPixel(UINT x, UINT y) { return GetRow(y)[x]; }
+        const DirectX::XMFLOAT4&                GetPixel(UINT x, UINT y) const { return GetRow(y)[x]; }
+        const std::vector<DirectX::XMFLOAT4>&   GetPixels() const { return m_pixels; }
+
+    private:
+        UINT                                    m_width;
+        UINT                                    m_height;
+        std::vector<DirectX::XMFLOAT4>          m_pixels;
+    };
+}
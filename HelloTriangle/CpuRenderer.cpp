@@ -0,0 +1,280 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CpuRenderer.h"
+#include "ImageFile.h"
+#include "TraceRecorder.h"
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    // Rows per job.
+    const UINT c_rowsPerJob = 8;
+
+    const LPCSTR c_outputNames[CpuRenderer::OutputCount] =
+    {
+        "color",
+        "node_visits",
+        "triangle_tests",
+        "instance_visits",
+        "hit_depth",
+    };
+
+    void Parallel(JobSystem* jobs, UINT height, const function<void(UINT y)>& row)
+    {
+        auto job = [&](UINT index, UINT)
+        {
+            TRACE_SCOPE("CpuRenderer::Rows");
+            for (UINT y = index * c_rowsPerJob; y < min<UINT>(height, (index + 1) * c_rowsPerJob); y++)
+            {
+                row(y);
+            }
+        };
+        UINT jobCount = (height + c_rowsPerJob - 1) / c_rowsPerJob;
+        if (jobs)
+        {
+            jobs->ParallelFor(jobCount, job);
+        }
+        else
+        {
+            for (UINT i = 0; i < jobCount; i++)
+            {
+                job(i, 0);
+            }
+        }
+    }
+}
+
+CpuRenderer::CpuRenderer() :
+    m_width(0),
+    m_height(0),
+    m_hitCount(0)
+{
+}
+
+void CpuRenderer::Render(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    Output output, CpuFramebuffer* target, JobSystem* jobs)
+{
+    TRACE_SCOPE("CpuRenderer::Render");
+    m_width = target->GetWidth();
+    m_height = target->GetHeight();
+    ThrowIfFalse(m_width > 0 && m_height > 0, L"CpuRenderer: the target has no pixels.\n");
+    m_color.Resize(m_width, m_height);
+    for (auto& statistic : m_statistics)
+    {
+        statistic.assign(static_cast<size_t>(m_width) * m_height, 0);
+    }
+
+    vector<UINT> rowHits(m_height);
+    Parallel(jobs, m_height, [&](UINT y)
+    {
+        XMFLOAT4* color = m_color.GetRow(y);
+        size_t rowStart = static_cast<size_t>(y) * m_width;
+        for (UINT x = 0; x < m_width; x++)
+        {
+            CpuHit hit;
+            CpuTraversalCounters counters = {};
+            if (TraceSample(tracer, vertices, indices, camera, m_width, m_height, x, y, 0.5f, 0.5f, &color[x], &hit, &counters))
+            {
+                m_statistics[OutputHitDepth - 1][rowStart + x] = hit.depth;
+                rowHits[y]++;
+            }
+            m_statistics[OutputNodeVisits - 1][rowStart + x] = static_cast<UINT>(counters.nodeVisits);
+            m_statistics[OutputTriangleTests - 1][rowStart + x] = static_cast<UINT>(counters.triangleTests);
+            m_statistics[OutputInstanceVisits - 1][rowStart + x] = static_cast<UINT>(counters.instanceVisits);
+        }
+    });
+
+    m_hitCount = 0;
+    for (UINT hits : rowHits)
+    {
+        m_hitCount += hits;
+    }
+
+    if (output == OutputColor)
+    {
+        for (UINT y = 0; y < m_height; y++)
+        {
+            copy(m_color.GetRow(y), m_color.GetRow(y) + m_width, target->GetRow(y));
+        }
+    }
+    else
+    {
+        FillHeatmap(output, 0, target);
+    }
+}
+
+bool CpuRenderer::TraceSample(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    UINT width, UINT height, UINT x, UINT y, float offsetX, float offsetY, XMFLOAT4* color, CpuHit* hit, CpuTraversalCounters* counters)
+{
+    // GenerateCameraRay: unproject the sample position at the near plane, Y up.
+    const XMFLOAT4X4& m = camera.projectionToWorld;
+    float screenX = (x + offsetX) / width * 2.0f - 1.0f;
+    float screenY = -((y + offsetY) / height * 2.0f - 1.0f);
+    float worldX = screenX * m._11 + screenY * m._21 + m._41;
+    float worldY = screenX * m._12 + screenY * m._22 + m._42;
+    float worldZ = screenX * m._13 + screenY * m._23 + m._43;
+    float worldW = screenX * m._14 + screenY * m._24 + m._44;
+    XMFLOAT3 direction(worldX / worldW - camera.position.x, worldY / worldW - camera.position.y, worldZ / worldW - camera.position.z);
+    float length = sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+
+    CpuRay ray;
+    ray.origin = camera.position;
+    ray.direction = XMFLOAT3(direction.x / length, direction.y / length, direction.z / length);
+    ray.tMin = 0.001f;
+    ray.tMax = 10000.0f;
+
+    if (tracer.TraceClosest(ray, hit, counters))
+    {
+        // MyClosestHitShader: interpolate the vertex colors.
+        const XMFLOAT3& c0 = vertices[indices[3 * hit->primitiveIndex + 0]].color;
+        const XMFLOAT3& c1 = vertices[indices[3 * hit->primitiveIndex + 1]].color;
+        const XMFLOAT3& c2 = vertices[indices[3 * hit->primitiveIndex + 2]].color;
+        float w = 1.0f - hit->u - hit->v;
+        *color = XMFLOAT4(w * c0.x + hit->u * c1.x + hit->v * c2.x, w * c0.y + hit->u * c1.y + hit->v * c2.y, w * c0.z + hit->u * c1.z + hit->v * c2.z, 1.0f);
+        return true;
+    }
+
+    // MyMissShader's background gets darker towards the bottom, per pixel row.
+    float ramp = static_cast<float>(y) / height;
+    *color = XMFLOAT4(0.0f, 0.2f, 0.7f - 0.3f * ramp, -1.0f);
+    return false;
+}
+
+CpuRenderer::Summary CpuRenderer::Summarize(Output output) const
+{
+    ThrowIfFalse(output != OutputColor && output < OutputCount, L"CpuRenderer: only statistics can be summarized.\n");
+
+    vector<UINT> values;
+    values.reserve(GetStatistic(output).size());
+    for (UINT value : GetStatistic(output))
+    {
+        if (output != OutputHitDepth || value > 0)
+        {
+            values.push_back(value);
+        }
+    }
+
+    Summary summary = {};
+    if (values.empty())
+    {
+        return summary;
+    }
+    for (UINT value : values)
+    {
+        summary.total += value;
+    }
+    summary.mean = static_cast<double>(summary.total) / values.size();
+    sort(values.begin(), values.end());
+    auto percentile = [&](double p) { return values[min<size_t>(static_cast<size_t>(p * values.size()), values.size() - 1)]; };
+    summary.median = percentile(0.5);
+    summary.percentile95 = percentile(0.95);
+    summary.percentile99 = percentile(0.99);
+    summary.maximum = values.back();
+    return summary;
+}
+
+void CpuRenderer::FillHeatmap(Output output, UINT scale, CpuFramebuffer* target) const
+{
+    ThrowIfFalse(target->GetWidth() == m_width && target->GetHeight() == m_height, L"CpuRenderer: the heatmap target has the wrong size.\n");
+    if (scale == 0)
+    {
+        scale = max<UINT>(Summarize(output).percentile99, 1);
+    }
+
+    const vector<UINT>& values = GetStatistic(output);
+    for (UINT y = 0; y < m_height; y++)
+    {
+        XMFLOAT4* row = target->GetRow(y);
+        const UINT* rowValues = values.data() + static_cast<size_t>(y) * m_width;
+        for (UINT x = 0; x < m_width; x++)
+        {
+            UINT value = rowValues[x];
+            row[x] = value == 0 ? XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f)
+                : value > scale ? XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f)
+                : CpuFramebuffer::HeatColor(static_cast<float>(value) / scale);
+        }
+    }
+}
+
+void CpuRenderer::Export(const wstring& prefix, const Tonemapper& tonemapper) const
+{
+    ThrowIfFalse(m_width > 0, L"CpuRenderer: nothing has been rendered.\n");
+
+    vector<UINT32> rgba8(static_cast<size_t>(m_width) * m_height);
+    CpuFramebuffer heatmap;
+    heatmap.Resize(m_width, m_height);
+    for (UINT i = 0; i < OutputCount; i++)
+    {
+        auto output = static_cast<Output>(i);
+        if (output == OutputColor)
+        {
+            tonemapper.Resolve(m_color, rgba8.data());
+        }
+        else
+        {
+            FillHeatmap(output, 0, &heatmap);
+            heatmap.ConvertToRgba8(rgba8.data());
+        }
+        string name = GetOutputName(output);
+        ImageFile::WritePpm(prefix + L"_" + wstring(name.begin(), name.end()) + L".ppm", m_width, m_height, rgba8.data());
+    }
+
+    ofstream file(prefix + L"_stats.json");
+    ThrowIfFalse(file.is_open(), L"CpuRenderer: couldn't open the statistics file.\n");
+    UINT64 pixelCount = static_cast<UINT64>(m_width) * m_height;
+    file << fixed << setprecision(4)
+        << "{\n  \"width\": " << m_width
+        << ",\n  \"height\": " << m_height
+        << ",\n  \"hit_rate\": " << static_cast<double>(m_hitCount) / pixelCount;
+    for (UINT i = OutputColor + 1; i < OutputCount; i++)
+    {
+        auto output = static_cast<Output>(i);
+        Summary summary = Summarize(output);
+        file << ",\n  \"" << GetOutputName(output) << "\": {\"total\": " << summary.total
+            << ", \"mean\": " << summary.mean
+            << ", \"median\": " << summary.median
+            << ", \"p95\": " << summary.percentile95
+            << ", \"p99\": " << summary.percentile99
+            << ", \"max\": " << summary.maximum
+            << ", \"heatmap_scale\": " << max<UINT>(summary.percentile99, 1) << '}';
+    }
+    file << "\n}\n";
+}
+
+wstring CpuRenderer::GetStatisticsString() const
+{
+    wstringstream stream;
+    UINT64 pixelCount = static_cast<UINT64>(m_width) * m_height;
+    stream << L"Traversal statistics, " << m_width << L"x" << m_height << L", "
+        << fixed << setprecision(1) << (pixelCount ? 100.0 * m_hitCount / pixelCount : 0.0) << L"% hits\n";
+    for (UINT i = OutputColor + 1; i < OutputCount; i++)
+    {
+        auto output = static_cast<Output>(i);
+        Summary summary = Summarize(output);
+        string name = GetOutputName(output);
+        stream << L"  " << left << setw(16) << wstring(name.begin(), name.end()) << right
+            << L" mean " << setw(7) << summary.mean << L"  median " << setw(5) << summary.median
+            << L"  p95 " << setw(5) << summary.percentile95 << L"  p99 " << setw(5) << summary.percentile99
+            << L"  max " << setw(5) << summary.maximum << L"\n";
+    }
+    return stream.str();
+}
+
+LPCSTR CpuRenderer::GetOutputName(Output output)
+{
+    return c_outputNames[output];
+}
@@ -0,0 +1,95 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CpuRenderer.h - Raytracing.hlsl's shaders on the CPU, with per pixel traversal statistics
+//
+
+#pragma once
+
+#include "CpuTracer.h"
+#include "CpuFramebuffer.h"
+#include "Tonemapper.h"
+#include "SceneGenerator.h"
+#include "JobSystem.h"
+
+namespace DX
+{
+    // What SceneConstantBuffer holds, without the SIMD types.
+    struct CpuCamera
+    {
+        DirectX::XMFLOAT4X4 projectionToWorld;
+        DirectX::XMFLOAT3   position;
+    };
+
+    // Renders one primary ray per pixel like MyRaygenShader, MyClosestHitShader and MyMissShader.
+    // Every Render() also records the traversal work of each pixel into side buffers; the output
+    // mode picks whether the target gets the shaded color or one of them as a false color heatmap,
+    // the way swapping payload.color would on the GPU. Heatmaps run from blue through green and
+    // yellow to red at their scale, black is zero and white is above the scale.
+    class CpuRenderer
+    {
+    public:
+        enum Output
+        {
+            OutputColor,
+            OutputNodeVisits,       // Nodes of both levels whose bounds were tested.
+            OutputTriangleTests,
+            OutputInstanceVisits,   // High where instance bounds overlap.
+            OutputHitDepth,         // CpuHit::depth, zero for misses.
+            OutputCount
+        };
+
+        struct Summary
+        {
+            UINT64  total;
+            double  mean;
+            UINT    median;
+            UINT    percentile95;
+            UINT    percentile99;
+            UINT    maximum;
+        };
+
+        CpuRenderer();
+
+        void Render(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            Output output, CpuFramebuffer* target, JobSystem* jobs = nullptr);
+
+        // Statistics of the last Render(), for any output but OutputColor. Hit depth only counts hits.
+        Summary Summarize(Output output) const;
+        // scale 0 uses the 99th percentile, so a few extreme pixels don't wash out the rest.
+        void FillHeatmap(Output output, UINT scale, CpuFramebuffer* target) const;
+        // Writes prefix_color.ppm and prefix_<statistic>.ppm for every statistic, and prefix_stats.json.
+        // Only the color goes through tonemapper, heatmaps are quantized as they are.
+        void Export(const std::wstring& prefix, const Tonemapper& tonemapper = Tonemapper()) const;
+        std::wstring GetStatisticsString() const;
+
+        static LPCSTR GetOutputName(Output output);
+
+        // One primary ray through pixel (x, y) at offset (offsetX, offsetY) in [0, 1) from its top
+        // left corner, shaded like the GPU. hit is only valid when it returns true.
+        static bool TraceSample(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            UINT width, UINT height, UINT x, UINT y, float offsetX, float offsetY, DirectX::XMFLOAT4* color, CpuHit* hit, CpuTraversalCounters* counters);
+
+        // Accessors.
+        UINT                        GetWidth() const { return m_width; }
+        UINT                        GetHeight() const { return m_height; }
+        UINT64                      GetHitCount() const { return m_hitCount; }
+        const std::vector<UINT>&    GetStatistic(Output output) const { return m_statistics[output - 1]; }
+
+    private:
+        UINT                        m_width;
+        UINT                        m_height;
+        UINT64                      m_hitCount;
+        CpuFramebuffer              m_color;            // Shaded, whatever the output.
+        std::vector<UINT>           m_statistics[OutputCount - 1];
+    };
+}
@@ -0,0 +1,337 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "CpuTracer.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    // Far children wait here with their entry distance, so they can be skipped once a closer hit
+    // is known. A tree never needs more entries than it is deep, Build() checks.
+    const UINT c_stackSize = 128;
+
+    struct StackEntry
+    {
+        UINT    node;
+        UINT    depth;
+        float   t;
+    };
+
+    // Slab test, returns the entry distance or FLT_MAX for a miss.
+    inline float IntersectBounds(const CpuBvhNode& node, const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, float tMin, float tMax)
+    {
+        float tx0 = (node.boundsMin.x - origin.x) * inverseDirection.x;
+        float tx1 = (node.boundsMax.x - origin.x) * inverseDirection.x;
+        float ty0 = (node.boundsMin.y - origin.y) * inverseDirection.y;
+        float ty1 = (node.boundsMax.y - origin.y) * inverseDirection.y;
+        float tz0 = (node.boundsMin.z - origin.z) * inverseDirection.z;
+        float tz1 = (node.boundsMax.z - origin.z) * inverseDirection.z;
+        float entry = max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), tMin));
+        float exit = min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), tMax));
+        return entry <= exit ? entry : FLT_MAX;
+    }
+
+    // Zero components give infinities, which the slab test handles except for 0 * inf on a slab
+    // boundary; a tiny bias avoids that.
+    inline XMFLOAT3 InverseDirection(const XMFLOAT3& direction)
+    {
+        auto inverse = [](float d) { return 1.0f / (fabs(d) > 1e-20f ? d : (d < 0.0f ? -1e-20f : 1e-20f)); };
+        return XMFLOAT3(inverse(direction.x), inverse(direction.y), inverse(direction.z));
+    }
+
+    // Next node to visit and its depth, UINT_MAX once the stack is empty. Nodes entered beyond tMax
+    // are dropped.
+    inline UINT Pop(const StackEntry* stack, UINT* stackSize, float tMax, UINT* depth)
+    {
+        while (*stackSize)
+        {
+            const StackEntry& entry = stack[--*stackSize];
+            if (entry.t <= tMax)
+            {
+                *depth = entry.depth;
+                return entry.node;
+            }
+        }
+        return UINT_MAX;
+    }
+
+    inline XMFLOAT3 TransformPoint(const XMFLOAT3X4& m, const XMFLOAT3& p)
+    {
+        return XMFLOAT3(
+            m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3],
+            m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3],
+            m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3]);
+    }
+
+    inline XMFLOAT3 TransformVector(const XMFLOAT3X4& m, const XMFLOAT3& v)
+    {
+        return XMFLOAT3(
+            m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2] * v.z,
+            m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2] * v.z,
+            m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z);
+    }
+}
+
+void CpuTracer::Clear()
+{
+    m_bottomLevel.Clear();
+    m_topLevel.Clear();
+    vector<CpuTriangle>().swap(m_triangles);
+    vector<UINT>().swap(m_primitiveIndices);
+    vector<XMFLOAT3X4>().swap(m_worldToObject);
+}
+
+void CpuTracer::Build(const void* vertices, UINT vertexStride, const UINT32* indices, UINT triangleCount,
+    const XMFLOAT3X4* transforms, UINT instanceCount)
+{
+    TRACE_SCOPE("CpuTracer::Build");
+    ThrowIfFalse(triangleCount > 0 && (transforms == nullptr || instanceCount > 0), L"CpuTracer: the scene is empty.\n");
+    Clear();
+
+    m_bottomLevel.BuildTriangles(vertices, vertexStride, indices, triangleCount);
+    ThrowIfFalse(m_bottomLevel.GetDepth() <= c_stackSize, L"CpuTracer: the bottom level is too deep to traverse.\n");
+    m_primitiveIndices = m_bottomLevel.GetPrimitiveIndices();
+
+    auto position = [&](UINT32 index)
+    {
+        return *reinterpret_cast<const XMFLOAT3*>(static_cast<const uint8_t*>(vertices) + static_cast<size_t>(index) * vertexStride);
+    };
+    m_triangles.resize(triangleCount);
+    for (UINT i = 0; i < triangleCount; i++)
+    {
+        UINT primitive = m_primitiveIndices[i];
+        XMFLOAT3 p0 = position(indices[3 * primitive + 0]);
+        XMFLOAT3 p1 = position(indices[3 * primitive + 1]);
+        XMFLOAT3 p2 = position(indices[3 * primitive + 2]);
+        m_triangles[i].v0 = p0;
+        m_triangles[i].edge1 = XMFLOAT3(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+        m_triangles[i].edge2 = XMFLOAT3(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+    }
+
+    // Instances are bounded by the transformed corners of the bottom level's root.
+    const CpuBvhNode& root = m_bottomLevel.GetNodes()[0];
+    XMFLOAT3X4 identity;
+    XMStoreFloat3x4(&identity, XMMatrixIdentity());
+    if (!transforms)
+    {
+        transforms = &identity;
+        instanceCount = 1;
+    }
+
+    m_worldToObject.resize(instanceCount);
+    vector<XMFLOAT3> boundsMin(instanceCount), boundsMax(instanceCount);
+    for (UINT i = 0; i < instanceCount; i++)
+    {
+        XMMATRIX objectToWorld = XMLoadFloat3x4(&transforms[i]);
+        XMStoreFloat3x4(&m_worldToObject[i], XMMatrixInverse(nullptr, objectToWorld));
+
+        boundsMin[i] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        boundsMax[i] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (UINT corner = 0; corner < 8; corner++)
+        {
+            XMFLOAT3 p(
+                corner & 1 ? root.boundsMax.x : root.boundsMin.x,
+                corner & 2 ? root.boundsMax.y : root.boundsMin.y,
+                corner & 4 ? root.boundsMax.z : root.boundsMin.z);
+            p = TransformPoint(transforms[i], p);
+            boundsMin[i] = XMFLOAT3(min(boundsMin[i].x, p.x), min(boundsMin[i].y, p.y), min(boundsMin[i].z, p.z));
+            boundsMax[i] = XMFLOAT3(max(boundsMax[i].x, p.x), max(boundsMax[i].y, p.y), max(boundsMax[i].z, p.z));
+        }
+    }
+    m_topLevel.Build(boundsMin.data(), boundsMax.data(), instanceCount);
+    ThrowIfFalse(m_topLevel.GetDepth() <= c_stackSize, L"CpuTracer: the top level is too deep to traverse.\n");
+}
+
+bool CpuTracer::TraceClosest(const CpuRay& ray, CpuHit* hit, CpuTraversalCounters* counters) const
+{
+    return Trace<false>(ray, hit, counters);
+}
+
+bool CpuTracer::TraceAny(const CpuRay& ray, CpuTraversalCounters* counters) const
+{
+    CpuHit hit;
+    return Trace<true>(ray, &hit, counters);
+}
+
+// Both levels visit the nearer child first and skip nodes beyond the closest hit so far.
+template<bool anyHit>
+bool CpuTracer::Trace(const CpuRay& ray, CpuHit* hit, CpuTraversalCounters* counters) const
+{
+    const vector<CpuBvhNode>& nodes = m_topLevel.GetNodes();
+    if (nodes.empty())
+    {
+        return false;
+    }
+    const vector<UINT>& instances = m_topLevel.GetPrimitiveIndices();
+    XMFLOAT3 inverseDirection = InverseDirection(ray.direction);
+    float tMax = ray.tMax;
+    bool found = false;
+
+    StackEntry stack[c_stackSize];
+    UINT stackSize = 0;
+    UINT64 nodeVisits = 1;
+    UINT depth = 1;
+    UINT nodeIndex = IntersectBounds(nodes[0], ray.origin, inverseDirection, ray.tMin, tMax) == FLT_MAX ? UINT_MAX : 0;
+
+    while (nodeIndex != UINT_MAX)
+    {
+        const CpuBvhNode& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            for (UINT i = node.leftFirst; i < node.leftFirst + node.count; i++)
+            {
+                UINT instance = instances[i];
+                const XMFLOAT3X4& worldToObject = m_worldToObject[instance];
+                XMFLOAT3 origin = TransformPoint(worldToObject, ray.origin);
+                XMFLOAT3 direction = TransformVector(worldToObject, ray.direction);
+                if (counters)
+                {
+                    counters->instanceVisits++;
+                }
+                if (TraceBottomLevel<anyHit>(origin, direction, ray.tMin, depth, &tMax, hit, counters))
+                {
+                    hit->instanceIndex = instance;
+                    found = true;
+                    if (anyHit)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (anyHit && found)
+            {
+                break;
+            }
+            nodeIndex = Pop(stack, &stackSize, tMax, &depth);
+            continue;
+        }
+
+        const CpuBvhNode& left = nodes[node.leftFirst];
+        const CpuBvhNode& right = nodes[node.leftFirst + 1];
+        float tLeft = IntersectBounds(left, ray.origin, inverseDirection, ray.tMin, tMax);
+        float tRight = IntersectBounds(right, ray.origin, inverseDirection, ray.tMin, tMax);
+        nodeVisits += 2;
+
+        UINT nearChild = node.leftFirst;
+        UINT farChild = node.leftFirst + 1;
+        if (tRight < tLeft)
+        {
+            swap(tLeft, tRight);
+            swap(nearChild, farChild);
+        }
+        if (tLeft == FLT_MAX)
+        {
+            nodeIndex = Pop(stack, &stackSize, tMax, &depth);
+            continue;
+        }
+        depth++;
+        if (tRight != FLT_MAX)
+        {
+            stack[stackSize++] = { farChild, depth, tRight };
+        }
+        nodeIndex = nearChild;
+    }
+
+    if (counters)
+    {
+        counters->nodeVisits += nodeVisits;
+    }
+    if (found)
+    {
+        hit->t = tMax;
+    }
+    return found;
+}
+
+template<bool anyHit>
+bool CpuTracer::TraceBottomLevel(const XMFLOAT3& origin, const XMFLOAT3& direction, float tMin, UINT instanceDepth, float* tMax,
+    CpuHit* hit, CpuTraversalCounters* counters) const
+{
+    const vector<CpuBvhNode>& nodes = m_bottomLevel.GetNodes();
+    XMFLOAT3 inverseDirection = InverseDirection(direction);
+    bool found = false;
+    UINT64 nodeVisits = 1;
+    UINT64 triangleTests = 0;
+    UINT depth = instanceDepth + 1;
+
+    StackEntry stack[c_stackSize];
+    UINT stackSize = 0;
+    UINT nodeIndex = IntersectBounds(nodes[0], origin, inverseDirection, tMin, *tMax) == FLT_MAX ? UINT_MAX : 0;
+
+    while (nodeIndex != UINT_MAX)
+    {
+        const CpuBvhNode& node = nodes[nodeIndex];
+        if (node.IsLeaf())
+        {
+            for (UINT i = node.leftFirst; i < node.leftFirst + node.count; i++)
+            {
+                float t, u, v;
+                triangleTests++;
+                if (IntersectTriangle(m_triangles[i], origin, direction, tMin, *tMax, &t, &u, &v))
+                {
+                    *tMax = t;
+                    hit->u = u;
+                    hit->v = v;
+                    hit->primitiveIndex = m_primitiveIndices[i];
+                    hit->depth = depth;
+                    found = true;
+                    if (anyHit)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (anyHit && found)
+            {
+                break;
+            }
+            nodeIndex = Pop(stack, &stackSize, *tMax, &depth);
+            continue;
+        }
+
+        const CpuBvhNode& left = nodes[node.leftFirst];
+        const CpuBvhNode& right = nodes[node.leftFirst + 1];
+        float tLeft = IntersectBounds(left, origin, inverseDirection, tMin, *tMax);
+        float tRight = IntersectBounds(right, origin, inverseDirection, tMin, *tMax);
+        nodeVisits += 2;
+
+        UINT nearChild = node.leftFirst;
+        UINT farChild = node.leftFirst + 1;
+        if (tRight < tLeft)
+        {
+            swap(tLeft, tRight);
+            swap(nearChild, farChild);
+        }
+        if (tLeft == FLT_MAX)
+        {
+            nodeIndex = Pop(stack, &stackSize, *tMax, &depth);
+            continue;
+        }
+        depth++;
+        if (tRight != FLT_MAX)
+        {
+            stack[stackSize++] = { farChild, depth, tRight };
+        }
+        nodeIndex = nearChild;
+    }
+
+    if (counters)
+    {
+        counters->nodeVisits += nodeVisits;
+        counters->triangleTests += triangleTests;
+    }
+    return found;
+}
@@ -0,0 +1,133 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// CpuTracer.h - Two level ray traversal over CpuBvh, a CPU reference for the DXR scene
+//
+
+#pragma once
+
+#include "CpuBvh.h"
+
+namespace DX
+{
+    struct CpuRay
+    {
+        DirectX::XMFLOAT3   origin;
+        float               tMin;
+        DirectX::XMFLOAT3   direction;
+        float               tMax;
+    };
+
+    // Mirrors what the closest hit shader gets: the hit distance, the barycentrics of vertices
+    // 1 and 2, PrimitiveIndex() and InstanceIndex(). depth counts the nodes from the top level's
+    // root down to the leaf holding the triangle, through both levels.
+    struct CpuHit
+    {
+        float   t;
+        float   u;
+        float   v;
+        UINT    primitiveIndex;
+        UINT    instanceIndex;
+        UINT    depth;
+    };
+
+    // Work done by one or more traversals, summed by the caller.
+    struct CpuTraversalCounters
+    {
+        UINT64  nodeVisits;         // Interior and leaf nodes of both levels whose bounds were tested.
+        UINT64  triangleTests;
+        UINT64  instanceVisits;     // Rays transformed into an instance.
+    };
+
+    // A triangle as the intersection test wants it, stored in leaf order.
+    struct CpuTriangle
+    {
+        DirectX::XMFLOAT3   v0;
+        DirectX::XMFLOAT3   edge1;
+        DirectX::XMFLOAT3   edge2;
+    };
+
+    // One bottom level over the mesh and a top level over its instances, like the sample's
+    // acceleration structures. Triangles are copied in leaf order so a leaf reads one contiguous
+    // range. Rays are not culled by facing, directions need not be normalized and t is measured
+    // in world space, instances only use affine transforms. Tracing is const and thread safe.
+    class CpuTracer
+    {
+    public:
+        // transforms are object to world in D3D12_RAYTRACING_INSTANCE_DESC layout, null for a single identity instance.
+        void Build(const void* vertices, UINT vertexStride, const UINT32* indices, UINT triangleCount,
+            const DirectX::XMFLOAT3X4* transforms, UINT instanceCount);
+        void Clear();
+
+        // Returns whether anything was hit, hit is only written then. counters may be null.
+        bool TraceClosest(const CpuRay& ray, CpuHit* hit, CpuTraversalCounters* counters = nullptr) const;
+        // Stops at the first hit, for shadow and occlusion rays.
+        bool TraceAny(const CpuRay& ray, CpuTraversalCounters* counters = nullptr) const;
+
+        // Moeller-Trumbore. Returns true for t in (tMin, tMax).
+        static bool IntersectTriangle(const CpuTriangle& triangle, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction,
+            float tMin, float tMax, float* t, float* u, float* v)
+        {
+            using DirectX::XMFLOAT3;
+            const XMFLOAT3& e1 = triangle.edge1;
+            const XMFLOAT3& e2 = triangle.edge2;
+            XMFLOAT3 p(direction.y * e2.z - direction.z * e2.y, direction.z * e2.x - direction.x * e2.z, direction.x * e2.y - direction.y * e2.x);
+            float determinant = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+            if (determinant > -1e-12f && determinant < 1e-12f)
+            {
+                return false;
+            }
+            float inverse = 1.0f / determinant;
+            XMFLOAT3 s(origin.x - triangle.v0.x, origin.y - triangle.v0.y, origin.z - triangle.v0.z);
+            float hitU = (s.x * p.x + s.y * p.y + s.z * p.z) * inverse;
+            if (hitU < 0.0f || hitU > 1.0f)
+            {
+                return false;
+            }
+            XMFLOAT3 q(s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x);
+            float hitV = (direction.x * q.x + direction.y * q.y + direction.z * q.z) * inverse;
+            if (hitV < 0.0f || hitU + hitV > 1.0f)
+            {
+                return false;
+            }
+            float hitT = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * inverse;
+            if (hitT <= tMin || hitT >= tMax)
+            {
+                return false;
+            }
+            *t = hitT;
+            *u = hitU;
+            *v = hitV;
+            return true;
+        }
+
+        // Accessors.
+        const CpuBvh&                       GetBottomLevel() const { return m_bottomLevel; }
+        const CpuBvh&                       GetTopLevel() const { return m_topLevel; }
+        const std::vector<CpuTriangle>&     GetTriangles() const { return m_triangles; }
+        UINT                                GetTriangleCount() const { return static_cast<UINT>(m_triangles.size()); }
+        UINT                                GetInstanceCount() const { return static_cast<UINT>(m_worldToObject.size()); }
+
+    private:
+        template<bool anyHit>
+        bool Trace(const CpuRay& ray, CpuHit* hit, CpuTraversalCounters* counters) const;
+        template<bool anyHit>
+        bool TraceBottomLevel(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float tMin, UINT instanceDepth,
+            float* tMax, CpuHit* hit, CpuTraversalCounters* counters) const;
+
+        CpuBvh                              m_bottomLevel;
+        CpuBvh                              m_topLevel;
+        std::vector<CpuTriangle>            m_triangles;
+        std::vector<UINT>                   m_primitiveIndices;     // Leaf order to the mesh's triangle index.
+        std::vector<DirectX::XMFLOAT3X4>    m_worldToObject;
+    };
+}
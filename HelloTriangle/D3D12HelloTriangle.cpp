@@ -13,10 +13,13 @@
 #include <algorithm>
 #include "D3D12HelloTriangle.h"
 #include "DirectXRaytracingHelper.h"
+#include "RecordingDevice.h"
+#include "CpuBvh.h"
 #include "CompiledShaders\Raytracing.hlsl.h"
 #include "glm/gtc/type_ptr.hpp"
 #include "manipulator.h"
 #include "Windowsx.h"
+#include <fstream>
 
 
 
@@ -31,7 +34,41 @@ const wchar_t* D3D12HelloTriangle::c_missShaderName = L"MyMissShader";
 
 D3D12HelloTriangle::D3D12HelloTriangle(UINT width, UINT height, std::wstring name) :
 	DXSample(width, height, name),
-	m_raytracingOutputResourceUAVDescriptorHeapIndex(UINT_MAX)
+	m_persistentDescriptorCount(c_defaultPersistentDescriptorCount),
+	m_recordingThreadCount(1),
+	m_maxFrameLatency(0),
+	m_simulatedGpuFrameTime(0.0),
+	m_lastFrameStart(0),
+	m_replayCamera(false),
+	m_benchmarkFrameCount(0),
+	m_benchmarkReportPath(L"benchmark.json"),
+	m_benchmarkStart(0),
+	m_renderedFrameCount(0),
+	m_generateScene(false),
+	m_cpuBottomLevelBuildMilliseconds(0.0),
+	m_cpuTopLevelBuildMilliseconds(0.0),
+	m_tonemapOperator(Tonemapper::OperatorNone),
+	m_exposure(0.0f),
+	m_adaptiveRaysPerPixel(0.0f),
+	m_frameFormat(FrameWriter::FormatPng),
+	m_noFrameDrops(false),
+	m_capturedFrameCount(0),
+	m_bottomLevelAccelerationStructure(0),
+	m_maxAccumulatedFrames(c_defaultMaxAccumulatedFrames),
+	m_accumulatedFrameCount(0),
+	m_accumulationReset(true),
+	m_accumulationProjectionToWorld(),
+	m_accumulationCameraPosition(),
+	m_renderWidth(width),
+	m_renderHeight(height),
+	m_renderedPixelCount(0),
+	m_rayPatternFrame(0),
+	m_raysPerFrame(0.0),
+	m_tracedRayCount(0.0),
+	m_tiledRenderCamera(),
+	m_tiledRenderFrame(0),
+	m_tileToCapture(UINT_MAX),
+	m_viewCount(0)
 {
 	m_rayGenCB.viewport = { -1.0f, -1.0f, 1.0f, 1.0f };
 	UpdateForSizeChange(width, height);
@@ -39,9 +76,78 @@ D3D12HelloTriangle::D3D12HelloTriangle(UINT width, UINT height, std::wstring nam
 
 void D3D12HelloTriangle::OnInit()
 {
+	if (!m_tracePath.empty())
+	{
+		TraceRecorder::SetThreadName("Main");
+		TraceRecorder::Enable(true);
+	}
+
 	nv_helpers_dx12::CameraManip.setWindowSize(GetWidth(), GetHeight());
 	nv_helpers_dx12::CameraManip.setLookat(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
+	// A generated scene is framed by the camera, and by the benchmark orbit.
+	glm::vec3 sceneCenter(0.f, 0.f, 0.f);
+	float sceneRadius = 5.f;
+	if (m_generateScene)
+	{
+		m_scene.Generate(m_sceneDesc);
+		XMFLOAT3 boundsMin = m_scene.GetBoundsMin();
+		XMFLOAT3 boundsMax = m_scene.GetBoundsMax();
+		sceneCenter = 0.5f * (glm::vec3(boundsMin.x, boundsMin.y, boundsMin.z) + glm::vec3(boundsMax.x, boundsMax.y, boundsMax.z));
+		sceneRadius = 0.5f * glm::length(glm::vec3(boundsMax.x, boundsMax.y, boundsMax.z) - glm::vec3(boundsMin.x, boundsMin.y, boundsMin.z));
+		nv_helpers_dx12::CameraManip.setLookat(sceneCenter + glm::vec3(0.f, 0.5f, 2.f) * sceneRadius, sceneCenter, glm::vec3(0, 1, 0));
+
+		if (m_headless)
+		{
+			BuildCpuAccelerationStructures();
+		}
+	}
+	ThrowIfFalse(m_traversalStatisticsPrefix.empty() || m_generateScene, L"-traversalStats needs a generated scene, pass -scene too.");
+	ThrowIfFalse(m_adaptiveSamplingPrefix.empty() || m_generateScene, L"-adaptiveSampling needs a generated scene, pass -scene too.");
+	ThrowIfFalse(m_rayPatternStatsPrefix.empty() || m_generateScene, L"-rayPatternStats needs a generated scene, pass -scene too.");
+	if (!m_rayPatternStatsPrefix.empty())
+	{
+		m_rayPatternAnalysis.Reset(m_rayPatternDesc, m_width, m_height, c_rayPatternAnalysisFrameCount);
+	}
+	if (!m_tiledRenderPath.empty())
+	{
+		ThrowIfFalse(!m_headless || m_generateScene, L"A headless -tiledRender traces on the CPU and needs a generated scene, pass -scene too.");
+		ThrowIfFalse(m_dynamicResolutionDesc.targetMilliseconds == 0.0, L"-tiledRender renders whole tiles, it can't be combined with -targetFrameTime.");
+		m_tiledRenderDesc.tileWidth = m_width;
+		m_tiledRenderDesc.tileHeight = m_height;
+		m_tiledRenderer.Begin(m_tiledRenderDesc, m_tiledRenderPath);
+	}
+	ThrowIfFalse(m_multiViewStatsPrefix.empty() || m_generateScene, L"-multiViewStats needs a generated scene, pass -scene too.");
+	ThrowIfFalse(m_multiViewStatsPrefix.empty() || m_viewCount, L"-multiViewStats needs -views.");
+	if (m_viewCount)
+	{
+		ThrowIfFalse(m_rayPatternDesc.pattern == RayPatternFull, L"-views traces every pixel of its views, it can't be combined with a sparse -rayPattern.");
+		ThrowIfFalse(m_dynamicResolutionDesc.targetMilliseconds == 0.0, L"-views sets the render size, it can't be combined with -targetFrameTime.");
+		ThrowIfFalse(m_tiledRenderPath.empty(), L"-views can't be combined with -tiledRender.");
+	}
+	ThrowIfFalse(!m_noFrameDrops || !m_writeFramesPrefix.empty(), L"-noFrameDrops needs -writeFrames.");
+	if (!m_writeFramesPrefix.empty())
+	{
+		m_frameWriter = std::make_unique<FrameWriter>(m_writeFramesPrefix, m_frameFormat, 0, 0, m_noFrameDrops);
+	}
+
+	// Replays advance a fixed step per frame, so every run sees the same camera on the same frame.
+	if (!m_cameraPathFile.empty())
+	{
+		m_cameraPath.Load(m_cameraPathFile);
+		m_replayCamera = true;
+	}
+	else if (m_benchmarkFrameCount)
+	{
+		m_cameraPath = CameraPath::CreateOrbit(sceneCenter, 2.f * sceneRadius, 0.4f * sceneRadius, 10.0, 64);
+		m_replayCamera = true;
+	}
+	if (m_replayCamera)
+	{
+		m_timer.SetTargetElapsedSeconds(1.0 / 60.0);
+		m_timer.SetVirtualTime(true);
+	}
+
 	m_deviceResources = std::make_unique<DeviceResources>(
 		DXGI_FORMAT_R8G8B8A8_UNORM,
 		DXGI_FORMAT_UNKNOWN,
@@ -49,21 +155,45 @@ void D3D12HelloTriangle::OnInit()
 		D3D_FEATURE_LEVEL_11_0,
 		// Sample shows handling of use cases with tearing support, which is OS dependent and has been supported since TH2.
 		// Since the sample requires build 1809 (RS5) or higher, we don't need to handle non-tearing cases.
-		DeviceResources::c_RequireTearingSupport,
+		DeviceResources::c_RequireTearingSupport | (m_headless ? DeviceResources::c_RecordingDevice : 0),
 		m_adapterIDoverride
 		);
 	m_deviceResources->RegisterDeviceNotify(this);
 	m_deviceResources->SetWindow(Win32Application::GetHwnd(), m_width, m_height);
 	m_deviceResources->InitializeDXGIAdapter();
 
-	ThrowIfFalse(IsDirectXRaytracingSupported(m_deviceResources->GetAdapter()),
+	ThrowIfFalse(m_deviceResources->IsRecordingDevice() || IsDirectXRaytracingSupported(m_deviceResources->GetAdapter()),
 		L"ERROR: DirectX Raytracing is not supported by your OS, GPU and/or driver.\n\n");
 
+	// The calling thread records too, so one thread less is started.
+	if (m_recordingThreadCount > 1)
+	{
+		m_jobSystem = std::make_unique<JobSystem>(m_recordingThreadCount - 1);
+	}
+	m_deviceResources->SetRecordingThreadCount(m_recordingThreadCount);
+	if (m_maxFrameLatency)
+	{
+		m_deviceResources->SetMaxFrameLatency(m_maxFrameLatency);
+	}
+	m_deviceResources->SetSimulatedGpuFrameTime(m_simulatedGpuFrameTime);
+	m_dynamicResolution.Reset(m_dynamicResolutionDesc, m_width, m_height);
+	m_renderWidth = m_dynamicResolution.GetRenderWidth();
+	m_renderHeight = m_dynamicResolution.GetRenderHeight();
+	m_multiView.Reset(m_viewCount, m_width, m_height);
+
 	m_deviceResources->CreateDeviceResources();
 	m_deviceResources->CreateWindowSizeDependentResources();
 
 	CreateDeviceDependentResources();
 	CreateWindowSizeDependentResources();
+
+	if (m_deviceResources->IsRecordingDevice())
+	{
+		// Report the initialization on its own, frames are counted from here.
+		RecordingStatistics* statistics = m_deviceResources->GetRecordingStatistics();
+		statistics->EndFrame();
+		OutputDebugStringW(statistics->GetStatisticsString().c_str());
+	}
 }
 
 // Create resources that depend on the device.
@@ -80,9 +210,24 @@ void D3D12HelloTriangle::CreateDeviceDependentResources()
 	// Create a raytracing pipeline state object which defines the binding of shaders, state and resources to be used during raytracing.
 	CreateRaytracingPipelineStateObject();
 
+	// Create the compute pipeline that upscales frames traced below the output resolution.
+	if (m_dynamicResolution.IsEnabled())
+	{
+		m_upscaler.Create(m_deviceResources->GetD3DDevice());
+	}
+
+	// Create the compute pipeline that fills in the pixels a sparse ray pattern skips.
+	if (m_rayPatternDesc.pattern != RayPatternFull)
+	{
+		m_reconstructor.Create(m_deviceResources->GetD3DDevice());
+	}
+
 	// Create a heap for descriptors.
 	CreateDescriptorHeap();
 
+	// Create the paged allocators that geometry, instance descs and acceleration structures are sub-allocated from.
+	CreateBufferAllocators();
+
 	// Build geometry to be used in the sample.
 	BuildGeometry();
 
@@ -97,6 +242,9 @@ void D3D12HelloTriangle::CreateDeviceDependentResources()
 
 	// Create an output 2D texture to store the raytracing result to.
 	CreateRaytracingOutputResource();
+
+	// Time the raytracing pass on the GPU, where timestamp queries are supported.
+	m_traceTimer.Create(m_deviceResources->GetD3DDevice(), m_deviceResources->GetCommandQueue(), m_deviceResources->GetFrameCount());
 }
 
 void D3D12HelloTriangle::SerializeAndCreateRaytracingRootSignature(D3D12_ROOT_SIGNATURE_DESC& desc, ComPtr<ID3D12RootSignature>* rootSig)
@@ -114,8 +262,9 @@ void D3D12HelloTriangle::CreateRootSignatures()
 	// Global Root Signature
 	// This is a root signature that is shared across all raytracing shaders invoked during a DispatchRays() call.
 	{
+		// UAV0 output, UAV1 accumulation
 		CD3DX12_DESCRIPTOR_RANGE UAVDescriptor;
-		UAVDescriptor.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0); // rangeType, numDescriptors, baseShaderRegister, registerSpace = 0
+		UAVDescriptor.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0); // rangeType, numDescriptors, baseShaderRegister, registerSpace = 0
 		CD3DX12_ROOT_PARAMETER rootParameters[GlobalRootSignatureParams::Count];
 		rootParameters[GlobalRootSignatureParams::OutputViewSlot].InitAsDescriptorTable(1, &UAVDescriptor); // numDescriptorRanges, pDescriptorRanges
 		//SRV0
@@ -128,6 +277,8 @@ void D3D12HelloTriangle::CreateRootSignatures()
 
 		// hlsl: ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b1);
 		rootParameters[GlobalRootSignatureParams::SceneConstantSlot].InitAsConstantBufferView(1, 0); //shaderRegister, registerSpace = 0
+		// hlsl: ConstantBuffer<MultiViewConstantBuffer> g_viewCB : register(b2);
+		rootParameters[GlobalRootSignatureParams::ViewConstantSlot].InitAsConstantBufferView(2, 0);
 		CD3DX12_ROOT_SIGNATURE_DESC globalRootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
 		SerializeAndCreateRaytracingRootSignature(globalRootSignatureDesc, &m_raytracingGlobalRootSignature);
 	}
@@ -259,39 +410,96 @@ void D3D12HelloTriangle::CreateRaytracingOutputResource()
 	ThrowIfFailed(device->CreateCommittedResource(
 		&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &uavDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_raytracingOutput)));
 	NAME_D3D12_OBJECT(m_raytracingOutput);
+	m_resourceStates.Register(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// Full float precision, so thousands of samples can be averaged without banding.
+	auto accumulationDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	ThrowIfFailed(device->CreateCommittedResource(
+		&defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &accumulationDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_accumulationBuffer)));
+	NAME_D3D12_OBJECT(m_accumulationBuffer);
+	m_resourceStates.Register(m_accumulationBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	ResetAccumulation();
 
-	D3D12_CPU_DESCRIPTOR_HANDLE uavDescriptorHandle;
-	m_raytracingOutputResourceUAVDescriptorHeapIndex = AllocateDescriptor(&uavDescriptorHandle, m_raytracingOutputResourceUAVDescriptorHeapIndex);
+	// The output is recreated on resize, its descriptor slots are kept and simply rewritten.
+	if (!m_raytracingOutputResourceUAVDescriptor.IsValid())
+	{
+		m_raytracingOutputResourceUAVDescriptor = m_descriptorHeap.AllocatePersistent(2);
+	}
 	D3D12_UNORDERED_ACCESS_VIEW_DESC UAVDesc = {};
 	UAVDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	device->CreateUnorderedAccessView(m_raytracingOutput.Get(), nullptr, &UAVDesc, uavDescriptorHandle);
-	m_raytracingOutputResourceUAVGpuDescriptor = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_raytracingOutputResourceUAVDescriptorHeapIndex, m_descriptorSize);
+	device->CreateUnorderedAccessView(m_raytracingOutput.Get(), nullptr, &UAVDesc, m_raytracingOutputResourceUAVDescriptor.GetCpuHandle(0));
+	device->CreateUnorderedAccessView(m_accumulationBuffer.Get(), nullptr, &UAVDesc, m_raytracingOutputResourceUAVDescriptor.GetCpuHandle(1));
+
+	if (m_dynamicResolution.IsEnabled())
+	{
+		m_upscaler.CreateOutput(device, &m_descriptorHeap, m_raytracingOutput.Get());
+		m_resourceStates.Register(m_upscaler.GetOutput(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
+
+	if (m_frameWriter)
+	{
+		m_outputReadback.Create(device, uavDesc, m_deviceResources->GetFrameCount());
+	}
+	if (m_tiledRenderer.IsActive() && !m_headless)
+	{
+		m_tileReadback.Create(device, uavDesc, m_deviceResources->GetFrameCount());
+	}
 }
 
 void D3D12HelloTriangle::CreateDescriptorHeap()
 {
 	auto device = m_deviceResources->GetD3DDevice();
 
-	D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
-	// Allocate a heap for 3 descriptors:
-	// 1 - raytracing output texture SRV
-	descriptorHeapDesc.NumDescriptors = 1;
-	descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	descriptorHeapDesc.NodeMask = 0;
-	device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_descriptorHeap));
-	NAME_D3D12_OBJECT(m_descriptorHeap);
+	// Persistent region for static resources:
+	//  2 - raytracing output and accumulation texture UAVs, allocated as one contiguous table
+	//  2 - index and vertex buffer SRVs, allocated as one contiguous table
+	//  2 - with dynamic resolution, the upscaler's source SRV and output UAV
+	// followed by a transient ring with one slice per frame in flight.
+	m_descriptorHeap.Create(device, m_persistentDescriptorCount, c_transientDescriptorsPerFrame, m_deviceResources->GetFrameCount(), L"m_descriptorHeap");
+}
 
-	m_descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+void D3D12HelloTriangle::CreateBufferAllocators()
+{
+	auto device = m_deviceResources->GetD3DDevice();
+
+	// Upload heap pages stay mapped for their lifetime and hold geometry and instance descs.
+	m_uploadBufferAllocator.Create(device, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_FLAG_NONE, LinearBufferAllocator::c_defaultPageSize, L"UploadBufferPages");
+
+	// Acceleration structures can only be placed in resources that are created in the default heap (or custom heap equivalent).
+	// Default heap is OK since the application doesn't need CPU read/write access to them.
+	// The resources that will contain acceleration structures must be created in the state D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+	// and must have resource flag D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS. A resource cannot change out of that state,
+	// so results and scratch memory come from separate pages.
+	m_accelerationStructureAllocator.Create(device, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, LinearBufferAllocator::c_defaultPageSize, L"AccelerationStructurePages");
+	m_scratchBufferAllocator.Create(device, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, LinearBufferAllocator::c_defaultPageSize, L"ScratchPages");
 }
 
 // Build geometry used in the sample.
 void D3D12HelloTriangle::BuildGeometry()
 {
-	auto device = m_deviceResources->GetD3DDevice();
+	if (m_generateScene)
+	{
+		static_assert(sizeof(SceneVertex) == sizeof(Vertex), "SceneVertex must match the shader's Vertex.");
+		auto& sceneVertices = m_scene.GetVertices();
+		auto& sceneIndices = m_scene.GetIndices();
+		UINT64 verticesSize = sceneVertices.size() * sizeof(Vertex);
+		UINT64 indicesSize = sceneIndices.size() * sizeof(Index);
+
+		m_vertexBuffer.allocation = AllocateUploadBuffer(&m_uploadBufferAllocator, sceneVertices.data(), verticesSize, BufferAlignment::ShaderResource(sizeof(Vertex)));
+		m_indexBuffer.allocation = AllocateUploadBuffer(&m_uploadBufferAllocator, sceneIndices.data(), indicesSize, BufferAlignment::ShaderResource(0));
+
+		m_indexVertexDescriptors = m_descriptorHeap.AllocatePersistent(2);
+		createBufferSRV(&m_indexBuffer, m_indexVertexDescriptors, 0, static_cast<UINT>(indicesSize / 4), 0);
+		createBufferSRV(&m_vertexBuffer, m_indexVertexDescriptors, 1, static_cast<UINT>(sceneVertices.size()), sizeof(Vertex));
+		return;
+	}
+
 	Index indices[] =
 	{
-		0, 1, 2, 0
+		0, 1, 2
 	};
 
 	float depthValue = 0.0;
@@ -306,46 +514,30 @@ void D3D12HelloTriangle::BuildGeometry()
 		{{ offset, -offset, depthValue },		XMFLOAT3(0.0f, 0.0f, 1.0f)},
 	};
 
-	AllocateUploadBuffer(device, vertices, sizeof(vertices), &m_vertexBuffer.resource);
-	AllocateUploadBuffer(device, indices, sizeof(indices), &m_indexBuffer.resource);
+	m_vertexBuffer.allocation = AllocateUploadBuffer(&m_uploadBufferAllocator, vertices, sizeof(vertices), BufferAlignment::ShaderResource(sizeof(*vertices)));
+	m_indexBuffer.allocation = AllocateUploadBuffer(&m_uploadBufferAllocator, indices, sizeof(indices), BufferAlignment::ShaderResource(0));
 
 	// Vertex buffer is passed to the shader along with index buffer as a descriptor table.
-	// Vertex buffer descriptor must allow index buffer descriptor in the descriptor heap.
-	UINT descriptorIndexIB = createBufferSRV(&m_indexBuffer, sizeof(indices) / 4, 0);
-	UINT descriptorIndexVB = createBufferSRV(&m_vertexBuffer, ARRAYSIZE(vertices), sizeof(*vertices));
-	ThrowIfFalse(descriptorIndexVB == descriptorIndexIB + 1, L"Vertex Buffer descriptor index must follow that of Index Buffer descriptor index!");
+	// Allocating both as one range guarantees the vertex buffer descriptor follows the index buffer descriptor.
+	m_indexVertexDescriptors = m_descriptorHeap.AllocatePersistent(2);
+	createBufferSRV(&m_indexBuffer, m_indexVertexDescriptors, 0, sizeof(indices) / 4, 0);
+	createBufferSRV(&m_vertexBuffer, m_indexVertexDescriptors, 1, ARRAYSIZE(vertices), sizeof(*vertices));
 }
 
 void D3D12HelloTriangle::CreateConstantBuffers() {
 	auto device = m_deviceResources->GetD3DDevice();
-	auto frameCount = m_deviceResources->GetBackBufferCount();
-
-	// Create the constant buffer memory and map the CPU and GPU address
-	const D3D12_HEAP_PROPERTIES uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto frameCount = m_deviceResources->GetFrameCount();
 
-	// Allocate one constant buffer per frame, since it gets updated every frame.
-	size_t cbSize = frameCount * sizeof(AlignedSceneConstantBuffer);
-	const D3D12_RESOURCE_DESC constantBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(cbSize);
-
-	ThrowIfFailed(device->CreateCommittedResource(
-		&uploadHeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&constantBufferDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr, IID_PPV_ARGS(&_perFrameConstants)));
-
-	// Map the constant buffer and cache its heap pointers
-	// We don't unmap this until the app closes. Keeping buffer mapped for the lifetime of resource is okay.
-	//CD3DX12_RANGE readRange(0, 0); // We do not intend to read from this resource on the GPU.
-	ThrowIfFailed(_perFrameConstants->Map(0, nullptr, reinterpret_cast<void **>(&_mappedConstantData)));
+	// One slice per frame, since constants get rewritten every frame.
+	// Each slice holds as many 256 byte aligned constant blocks as the frame needs.
+	m_frameConstants.Create(device, frameCount, FrameConstantAllocator::c_defaultCapacityPerFrame, L"FrameConstants");
 }
 
 // Build acceleration structures needed for raytracing.
 void D3D12HelloTriangle::BuildAccelerationStructures()
 {
-	auto device = m_deviceResources->GetD3DDevice();
+	TRACE_SCOPE("BuildAccelerationStructures");
 	auto commandList = m_deviceResources->GetCommandList();
-	auto commandQueue = m_deviceResources->GetCommandQueue();
 	auto commandAllocator = m_deviceResources->GetCommandAllocator();
 
 	// Reset the command list for the acceleration structure construction.
@@ -353,13 +545,13 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 
 	D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
 	geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-	geometryDesc.Triangles.IndexBuffer = m_indexBuffer.resource->GetGPUVirtualAddress();
-	geometryDesc.Triangles.IndexCount = static_cast<UINT>(m_indexBuffer.resource->GetDesc().Width) / sizeof(Index);
-	geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+	geometryDesc.Triangles.IndexBuffer = m_indexBuffer.allocation.gpuAddress;
+	geometryDesc.Triangles.IndexCount = static_cast<UINT>(m_indexBuffer.allocation.size) / sizeof(Index);
+	geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
 	geometryDesc.Triangles.Transform3x4 = 0;
 	geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-	geometryDesc.Triangles.VertexCount = static_cast<UINT>(m_vertexBuffer.resource->GetDesc().Width) / sizeof(Vertex);
-	geometryDesc.Triangles.VertexBuffer.StartAddress = m_vertexBuffer.resource->GetGPUVirtualAddress();
+	geometryDesc.Triangles.VertexCount = static_cast<UINT>(m_vertexBuffer.allocation.size) / sizeof(Vertex);
+	geometryDesc.Triangles.VertexBuffer.StartAddress = m_vertexBuffer.allocation.gpuAddress;
 	geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
 
 	// Mark the geometry as opaque. 
@@ -369,8 +561,39 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 	geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
 
 
-	// Get required size for a top level acceleration structure
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+
+	// Bottom level acceleration structures are built in batches that share one scratch pool
+	// and are then compacted, see AccelerationStructureManager.
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS bottomLevelInputs = {};
+	bottomLevelInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	bottomLevelInputs.pGeometryDescs = &geometryDesc;
+	bottomLevelInputs.Flags = buildFlags;
+	bottomLevelInputs.NumDescs = _triangleGemotryCount;
+	bottomLevelInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+
+	m_bottomLevelAccelerationStructures.Create(m_dxrDevice.Get(), AccelerationStructurePlanner::c_defaultScratchBudget, L"BottomLevelAccelerationStructures");
+	m_bottomLevelAccelerationStructure = m_bottomLevelAccelerationStructures.AddBottomLevel(bottomLevelInputs);
+	m_bottomLevelAccelerationStructures.RecordBuilds(m_dxrCommandList.Get());
+
+	// The compacted sizes are only known once the builds have executed.
+	m_deviceResources->ExecuteCommandList();
+	m_deviceResources->WaitForGpu();
+	commandList->Reset(commandAllocator, nullptr);
+	m_bottomLevelAccelerationStructures.RecordCompaction(m_dxrCommandList.Get());
+
+	// A generated scene brings its own instances, otherwise the triangle is placed three times.
+	if (!m_generateScene)
+	{
+		_instances = {
+			{m_bottomLevelAccelerationStructures.GetAddress(m_bottomLevelAccelerationStructure), XMMatrixIdentity()},
+			{m_bottomLevelAccelerationStructures.GetAddress(m_bottomLevelAccelerationStructure), XMMatrixTranslation(-.05f, 0, -1)},
+			{m_bottomLevelAccelerationStructures.GetAddress(m_bottomLevelAccelerationStructure), XMMatrixTranslation(.05f, 0, -1)},
+		};
+	}
+	_instanceCount = m_generateScene ? m_scene.GetInstanceCount() : static_cast<UINT>(_instances.size());
+
+	// Get required size for a top level acceleration structure
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS topLevelInputs = {};
 	topLevelInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	topLevelInputs.Flags = buildFlags;
@@ -381,20 +604,8 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 	m_dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(&topLevelInputs, &topLevelPrebuildInfo);
 	ThrowIfFalse(topLevelPrebuildInfo.ResultDataMaxSizeInBytes > 0);
 
-	// Get required sizes for a bottom level acceleration structure.
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS bottomLevelInputs = {};
-	bottomLevelInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-	bottomLevelInputs.pGeometryDescs = &geometryDesc;
-	bottomLevelInputs.Flags = buildFlags;
-	bottomLevelInputs.NumDescs = _triangleGemotryCount;
-	bottomLevelInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-
-	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO bottomLevelPrebuildInfo = {};
-	m_dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(&bottomLevelInputs, &bottomLevelPrebuildInfo);
-	ThrowIfFalse(bottomLevelPrebuildInfo.ResultDataMaxSizeInBytes > 0);
-
-	ComPtr<ID3D12Resource> scratchResource;
-	AllocateUAVBuffer(device, std::max(topLevelPrebuildInfo.ScratchDataSizeInBytes, bottomLevelPrebuildInfo.ScratchDataSizeInBytes), &scratchResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"ScratchResource");
+	// Scratch is only needed while building, the pages are rewound once the build has finished.
+	BufferAllocation scratch = m_scratchBufferAllocator.Allocate(topLevelPrebuildInfo.ScratchDataSizeInBytes, BufferAlignment::AccelerationStructure);
 
 	// Allocate resources for acceleration structures.
 	// Acceleration structures can only be placed in resources that are created in the default heap (or custom heap equivalent). 
@@ -403,37 +614,14 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 	// and must have resource flag D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS. The ALLOW_UNORDERED_ACCESS requirement simply acknowledges both: 
 	//  - the system will be doing this type of access in its implementation of acceleration structure builds behind the scenes.
 	//  - from the app point of view, synchronization of writes/reads to acceleration structures is accomplished using UAV barriers.
-	{
-		D3D12_RESOURCE_STATES initialResourceState = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
-
-		AllocateUAVBuffer(device, bottomLevelPrebuildInfo.ResultDataMaxSizeInBytes, &m_bottomLevelAccelerationStructure, initialResourceState, L"BottomLevelAccelerationStructure");
-		AllocateUAVBuffer(device, topLevelPrebuildInfo.ResultDataMaxSizeInBytes, &m_topLevelAccelerationStructure, initialResourceState, L"TopLevelAccelerationStructure");
-	}
-
-	// Bottom Level Acceleration Structure desc
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC bottomLevelBuildDesc = {};
-	{
-		bottomLevelBuildDesc.Inputs = bottomLevelInputs;
-		bottomLevelBuildDesc.ScratchAccelerationStructureData = scratchResource->GetGPUVirtualAddress();
-		bottomLevelBuildDesc.DestAccelerationStructureData = m_bottomLevelAccelerationStructure->GetGPUVirtualAddress();
-	}
-
-	m_dxrCommandList->BuildRaytracingAccelerationStructure(&bottomLevelBuildDesc, 0, nullptr);
-	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_bottomLevelAccelerationStructure.Get()));
-
+	// The top level structure is sub-allocated from m_accelerationStructureAllocator's pages which satisfy these requirements.
+	m_topLevelAccelerationStructure = m_accelerationStructureAllocator.Allocate(topLevelPrebuildInfo.ResultDataMaxSizeInBytes, BufferAlignment::AccelerationStructure);
 
 	/*
 	Top Level Acceleration structure.
 	*/
-	// Just one instance for now
-	_instances = {
-		{m_bottomLevelAccelerationStructure, XMMatrixIdentity()},
-		{m_bottomLevelAccelerationStructure, XMMatrixTranslation(-.05f, 0, -1)},
-		{m_bottomLevelAccelerationStructure, XMMatrixTranslation(.05f, 0, -1)},
-	};
-
 	// Create an instance desc for the bottom-level acceleration structure.
-	ComPtr<ID3D12Resource> instanceDescs; // descriptors buffer
+	BufferAllocation instanceDescs; // descriptors buffer
 
 	{
 		//vector<AccelerationStructureInstance> instances;
@@ -451,12 +639,13 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 
 		// changed by Stan: support multiple instance
 
-		UINT instanceCount = static_cast<UINT>(_instances.size());
+		UINT instanceCount = _instanceCount;
 
-		UINT64 instanceDescsSizeInBytes = ROUND_UP(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceCount, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		UINT64 instanceDescsSizeInBytes = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceCount;
 
-		D3D12_RAYTRACING_INSTANCE_DESC *instanceDescArray = (D3D12_RAYTRACING_INSTANCE_DESC *)malloc(instanceDescsSizeInBytes);
-		//ZeroMemory(instanceDescArray, instanceDescsSizeInBytes);
+		// Write the descs straight into the mapped upload page.
+		instanceDescs = m_uploadBufferAllocator.Allocate(instanceDescsSizeInBytes, BufferAlignment::InstanceDescs);
+		D3D12_RAYTRACING_INSTANCE_DESC *instanceDescArray = reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC *>(instanceDescs.cpuAddress);
 
 		// create the description for each instance
 		for (UINT i = 0; i <instanceCount; ++i)
@@ -468,24 +657,28 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 			desc.InstanceContributionToHitGroupIndex = static_cast<UINT>(0);
 			// Instance flags, including backface culling, winding, etc.
 			desc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-			desc.AccelerationStructure = _instances[i].first->GetGPUVirtualAddress();
+			desc.AccelerationStructure = m_bottomLevelAccelerationStructures.GetAddress(m_bottomLevelAccelerationStructure);
 			// Visibility mask, always visible here.
 			desc.InstanceMask = 0xFF;
-			XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4 *>(desc.Transform), _instances[i].second);
+			if (m_generateScene)
+			{
+				memcpy(desc.Transform, &m_scene.GetInstanceTransforms()[i], sizeof(desc.Transform));
+			}
+			else
+			{
+				XMStoreFloat3x4(reinterpret_cast<XMFLOAT3X4 *>(desc.Transform), _instances[i].second);
+			}
 		}
-
-		//AllocateUploadBuffer(device, &instanceDesc, 256, &instanceDescs, L"InstanceDescs");
-		AllocateUploadBuffer(device, instanceDescArray, instanceDescsSizeInBytes, &instanceDescs, L"InstanceDescs");
 	}
 
 
 	// Top Level Acceleration Structure desc
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC topLevelBuildDesc = {};
 	{
-		topLevelInputs.InstanceDescs = instanceDescs->GetGPUVirtualAddress();
+		topLevelInputs.InstanceDescs = instanceDescs.gpuAddress;
 		topLevelBuildDesc.Inputs = topLevelInputs;
-		topLevelBuildDesc.DestAccelerationStructureData = m_topLevelAccelerationStructure->GetGPUVirtualAddress();
-		topLevelBuildDesc.ScratchAccelerationStructureData = scratchResource->GetGPUVirtualAddress();
+		topLevelBuildDesc.DestAccelerationStructureData = m_topLevelAccelerationStructure.gpuAddress;
+		topLevelBuildDesc.ScratchAccelerationStructureData = scratch.gpuAddress;
 	}
 
 	auto BuildTopLevelAccelerationStructure = [&](auto* raytracingCommandList)
@@ -499,14 +692,165 @@ void D3D12HelloTriangle::BuildAccelerationStructures()
 	// Kick off acceleration structure construction.
 	m_deviceResources->ExecuteCommandList();
 
-	// Wait for GPU to finish as the locally created temporary GPU resources will get released once we go out of scope.
+	// Wait for GPU to finish before the scratch pages are rewound and the uncompacted results are released.
 	m_deviceResources->WaitForGpu();
+	m_scratchBufferAllocator.Reset();
+	m_bottomLevelAccelerationStructures.ReleaseBuildMemory();
+	OutputDebugStringW(m_bottomLevelAccelerationStructures.GetPlanner().GetStatisticsString().c_str());
+}
+
+// On the recording device nothing is built for real, so the generated scene is built with CpuBvh
+// instead: the mesh as the bottom level and the instance bounds as the top level.
+void D3D12HelloTriangle::BuildCpuAccelerationStructures()
+{
+	TRACE_SCOPE("BuildCpuAccelerationStructures");
+	CpuBvh bvh;
+
+	UINT64 start = StepTimer::GetCurrentTicks();
+	bvh.BuildTriangles(m_scene.GetVertices().data(), sizeof(SceneVertex), m_scene.GetIndices().data(), m_scene.GetTriangleCount());
+	m_cpuBottomLevelBuildMilliseconds = StepTimer::TicksToMilliseconds(StepTimer::GetCurrentTicks() - start);
+	UINT bottomLevelNodeCount = bvh.GetNodeCount();
+	UINT bottomLevelDepth = bvh.GetDepth();
+
+	vector<XMFLOAT3> boundsMin, boundsMax;
+	m_scene.GetInstanceBounds(&boundsMin, &boundsMax);
+	start = StepTimer::GetCurrentTicks();
+	bvh.Build(boundsMin.data(), boundsMax.data(), m_scene.GetInstanceCount());
+	m_cpuTopLevelBuildMilliseconds = StepTimer::TicksToMilliseconds(StepTimer::GetCurrentTicks() - start);
+
+	wstringstream stream;
+	stream << L"Scene: " << SceneGenerator::GetMeshName(m_sceneDesc.mesh) << L", " << m_scene.GetTriangleCount() << L" triangles x "
+		<< m_scene.GetInstanceCount() << L" instances (" << SceneGenerator::GetLayoutName(m_sceneDesc.layout) << L") = "
+		<< m_scene.GetTotalTriangleCount() << L" triangles\n"
+		<< fixed << setprecision(2)
+		<< L"  CpuBvh bottom level: " << m_cpuBottomLevelBuildMilliseconds << L" ms, " << bottomLevelNodeCount << L" nodes, depth " << bottomLevelDepth << L"\n"
+		<< L"  CpuBvh top level:    " << m_cpuTopLevelBuildMilliseconds << L" ms, " << bvh.GetNodeCount() << L" nodes, depth " << bvh.GetDepth() << L"\n";
+	OutputDebugStringW(stream.str().c_str());
+}
+
+// Builds the generated scene for the CPU tracer, instances and all.
+void D3D12HelloTriangle::BuildCpuTracer(CpuTracer* tracer) const
+{
+	tracer->Build(m_scene.GetVertices().data(), sizeof(SceneVertex), m_scene.GetIndices().data(), m_scene.GetTriangleCount(),
+		m_scene.GetInstanceTransforms().data(), m_scene.GetInstanceCount());
+}
+
+// This frame's camera, as the raygen shader gets it.
+CpuCamera D3D12HelloTriangle::GetCpuCamera() const
+{
+	auto& sceneCB = _sceneCB[m_deviceResources->GetCurrentFrameIndex()];
+	CpuCamera camera;
+	XMStoreFloat4x4(&camera.projectionToWorld, sceneCB.projectionToWorld);
+	XMStoreFloat3(&camera.position, sceneCB.cameraPosition);
+	return camera;
+}
+
+// -tonemap and -exposure for CPU images written as 8-bit, which stay linear unless either is given.
+Tonemapper D3D12HelloTriangle::GetTonemapper() const
+{
+	bool tonemapped = m_tonemapOperator != Tonemapper::OperatorNone || m_exposure != 0.0f;
+	return Tonemapper(m_tonemapOperator, m_exposure, tonemapped);
+}
+
+// Renders what the camera sees with CpuTracer, recording the traversal work of every pixel.
+void D3D12HelloTriangle::WriteTraversalStatistics()
+{
+	TRACE_SCOPE("WriteTraversalStatistics");
+	CpuTracer tracer;
+	BuildCpuTracer(&tracer);
+
+	CpuFramebuffer target;
+	target.Resize(m_width, m_height);
+	CpuRenderer renderer;
+	renderer.Render(tracer, m_scene.GetVertices().data(), m_scene.GetIndices().data(), GetCpuCamera(), CpuRenderer::OutputColor, &target, m_jobSystem.get());
+	renderer.Export(m_traversalStatisticsPrefix, GetTonemapper());
+	OutputDebugStringW(renderer.GetStatisticsString().c_str());
+}
+
+// Renders what the camera sees with CpuTracer and many samples per pixel, most of them where the
+// image is still noisy.
+void D3D12HelloTriangle::WriteAdaptiveSampling()
+{
+	TRACE_SCOPE("WriteAdaptiveSampling");
+	CpuTracer tracer;
+	BuildCpuTracer(&tracer);
+
+	CpuFramebuffer target;
+	target.Resize(m_width, m_height);
+	AdaptiveSamplingDesc desc = m_adaptiveSamplingDesc;
+	desc.rayBudget = static_cast<UINT64>(m_adaptiveRaysPerPixel * m_width * m_height);
+	AdaptiveSampler sampler;
+	sampler.Render(tracer, m_scene.GetVertices().data(), m_scene.GetIndices().data(), GetCpuCamera(), desc, &target, m_jobSystem.get());
+	sampler.Export(m_adaptiveSamplingPrefix);
+	OutputDebugStringW(sampler.GetStatisticsString().c_str());
+}
+
+// Traces this frame with the CPU for every ray pattern. Writes the results and stops once
+// c_rayPatternAnalysisFrameCount frames are in.
+void D3D12HelloTriangle::AnalyzeRayPatterns()
+{
+	TRACE_SCOPE("AnalyzeRayPatterns");
+	if (!m_rayPatternTracer)
+	{
+		m_rayPatternTracer = std::make_unique<CpuTracer>();
+		BuildCpuTracer(m_rayPatternTracer.get());
+	}
+
+	auto& sceneCB = _sceneCB[m_deviceResources->GetCurrentFrameIndex()];
+	m_rayPatternAnalysis.AddFrame(*m_rayPatternTracer, m_scene.GetVertices().data(), m_scene.GetIndices().data(), GetCpuCamera(),
+		sceneCB.rayPattern.frameIndex, sceneCB.rayPattern.history, m_jobSystem.get());
+	if (m_rayPatternAnalysis.IsComplete())
+	{
+		m_rayPatternAnalysis.Export(m_rayPatternStatsPrefix);
+		OutputDebugStringW(m_rayPatternAnalysis.GetStatisticsString().c_str());
+		m_rayPatternStatsPrefix.clear();
+		m_rayPatternTracer.reset();
+	}
+}
+
+// Traces every tile of a headless -tiledRender with the CPU, on the generated scene.
+void D3D12HelloTriangle::RenderTilesOnCpu()
+{
+	TRACE_SCOPE("RenderTilesOnCpu");
+	CpuTracer tracer;
+	BuildCpuTracer(&tracer);
+	m_tiledRenderer.RenderCpu(tracer, m_scene.GetVertices().data(), m_scene.GetIndices().data(), GetCpuCamera(), GetTonemapper(), m_jobSystem.get());
+	OutputDebugStringW(m_tiledRenderer.GetStatisticsString().c_str());
+}
+
+// Traces the views with CpuTracer once batched and once a frame per view, on the generated scene.
+void D3D12HelloTriangle::WriteMultiViewStatistics()
+{
+	TRACE_SCOPE("WriteMultiViewStatistics");
+	MultiView::Statistics statistics = m_multiView.Analyze(m_scene, m_multiViewStatsPrefix, m_jobSystem.get());
+	OutputDebugStringW(MultiView::GetStatisticsString(statistics, m_multiView.GetViewCount()).c_str());
+}
+
+// A tile's last frame, read back. Its pixels are at the top left of the output.
+void D3D12HelloTriangle::WriteRenderedTile(UINT tileIndex, const void* data, UINT rowPitch)
+{
+	TRACE_SCOPE("WriteRenderedTile");
+	m_tiledRenderer.WriteTile(tileIndex, static_cast<const UINT32*>(data), rowPitch);
+	if (m_tiledRenderer.IsComplete())
+	{
+		OutputDebugStringW(m_tiledRenderer.GetStatisticsString().c_str());
+		PostQuitMessage(0);
+	}
+}
+
+// Hand a read back frame to the writer, which copies it and returns. A frame the writer has no
+// room for is dropped and counted in its statistics.
+void D3D12HelloTriangle::SubmitCapturedFrame(UINT64 frameNumber, const void* data, UINT rowPitch)
+{
+	TRACE_SCOPE("SubmitCapturedFrame");
+	m_frameWriter->Submit(frameNumber, m_outputReadback.GetWidth(), m_outputReadback.GetHeight(), static_cast<const UINT32*>(data), rowPitch);
 }
 
 // Build shader tables.
 // This encapsulates all shader records - shaders and the arguments for their local root signatures.
 void D3D12HelloTriangle::BuildShaderTables()
 {
+	TRACE_SCOPE("BuildShaderTables");
 	auto device = m_deviceResources->GetD3DDevice();
 
 	void* rayGenShaderIdentifier;
@@ -565,18 +909,72 @@ void D3D12HelloTriangle::BuildShaderTables()
 // Update frame-based values.
 void D3D12HelloTriangle::OnUpdate()
 {
+	TRACE_SCOPE("OnUpdate");
 	m_timer.Tick();
+
+	// Frame times come from the wall clock, the timer may be running on virtual time.
+	UINT64 updateStart = StepTimer::GetCurrentTicks();
+	if (m_lastFrameStart)
+	{
+		m_frameTimings.Record(FrameTimings::PhaseFrame, updateStart - m_lastFrameStart);
+	}
+	else
+	{
+		m_benchmarkStart = updateStart;
+	}
+	m_lastFrameStart = updateStart;
 	CalculateFrameStats();
 
 	// upate camera
 	{
+		glm::vec3 eye, center, up;
+		if (m_replayCamera)
+		{
+			m_cameraPath.Evaluate(m_timer.GetTotalSeconds(), &eye, &center, &up);
+			nv_helpers_dx12::CameraManip.setLookat(eye, center, up);
+		}
+		else if (!m_recordCameraFile.empty())
+		{
+			nv_helpers_dx12::CameraManip.getLookat(eye, center, up);
+			m_cameraPath.AddKey(m_timer.GetTotalSeconds(), eye, center, up);
+		}
 		updateCameraMatrices();
+		UpdateDynamicResolution();
+		UpdateMultiView();
+		UpdateTiledRender();
+		UpdateAccumulation();
+	}
+	if (!m_rayPatternStatsPrefix.empty())
+	{
+		AnalyzeRayPatterns();
+	}
+	if (m_tiledRenderer.IsActive() && m_headless)
+	{
+		RenderTilesOnCpu();
+	}
+	if (!m_traversalStatisticsPrefix.empty())
+	{
+		WriteTraversalStatistics();
+		m_traversalStatisticsPrefix.clear();
+	}
+	if (!m_adaptiveSamplingPrefix.empty())
+	{
+		WriteAdaptiveSampling();
+		m_adaptiveSamplingPrefix.clear();
+	}
+	if (!m_multiViewStatsPrefix.empty())
+	{
+		WriteMultiViewStatistics();
+		m_multiViewStatsPrefix.clear();
 	}
+	m_frameTimings.Record(FrameTimings::PhaseUpdate, StepTimer::GetCurrentTicks() - updateStart);
 }
 
-void D3D12HelloTriangle::DoRaytracing()
+void D3D12HelloTriangle::DoRaytracing(ID3D12GraphicsCommandList* commandList)
 {
-	auto commandList = m_deviceResources->GetCommandList();
+	TRACE_SCOPE("DoRaytracing");
+	ComPtr<ID3D12GraphicsCommandList4> dxrCommandList;
+	ThrowIfFailed(commandList->QueryInterface(IID_PPV_ARGS(&dxrCommandList)), L"Couldn't get DirectX Raytracing interface for the command list.\n");
 	auto frameIndex = m_deviceResources->GetCurrentFrameIndex();
 
 	auto DispatchRays = [&](auto* commandList, auto* stateObject, auto* dispatchDesc)
@@ -590,40 +988,58 @@ void D3D12HelloTriangle::DoRaytracing()
 		dispatchDesc->MissShaderTable.StrideInBytes = dispatchDesc->MissShaderTable.SizeInBytes;
 		dispatchDesc->RayGenerationShaderRecord.StartAddress = m_rayGenShaderTable->GetGPUVirtualAddress();
 		dispatchDesc->RayGenerationShaderRecord.SizeInBytes = m_rayGenShaderTable->GetDesc().Width;
-		dispatchDesc->Width = m_width;
-		dispatchDesc->Height = m_height;
-		dispatchDesc->Depth = 1;
+		RayPattern::GetDispatchSize(_sceneCB[frameIndex].rayPattern, &dispatchDesc->Width, &dispatchDesc->Height);
+		dispatchDesc->Depth = max(_sceneCB[frameIndex].viewCount, 1u);
 		commandList->SetPipelineState1(stateObject);
 		commandList->DispatchRays(dispatchDesc);
 	};
 
 	auto setCommonPiplineState = [&](ID3D12GraphicsCommandList *descriptorSetCL) {
-		descriptorSetCL->SetDescriptorHeaps(1, m_descriptorHeap.GetAddressOf());
+		ID3D12DescriptorHeap *descriptorHeaps[] = { m_descriptorHeap.GetHeap() };
+		descriptorSetCL->SetDescriptorHeaps(ARRAYSIZE(descriptorHeaps), descriptorHeaps);
 		//set index and successive vertex buffer descriptor tables
-		descriptorSetCL->SetComputeRootDescriptorTable(GlobalRootSignatureParams::VertexBuffersSlot, m_indexBuffer.gpuDescriptorHandle);
-		descriptorSetCL->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputViewSlot, m_raytracingOutputResourceUAVGpuDescriptor);
+		descriptorSetCL->SetComputeRootDescriptorTable(GlobalRootSignatureParams::VertexBuffersSlot, m_indexVertexDescriptors.GetGpuHandle());
+		descriptorSetCL->SetComputeRootDescriptorTable(GlobalRootSignatureParams::OutputViewSlot, m_raytracingOutputResourceUAVDescriptor.GetGpuHandle());
 	};
 
 
 	commandList->SetComputeRootSignature(m_raytracingGlobalRootSignature.Get());
 
 	// Copy the updated Scene constant buffer to GPU
-	SceneConstantBuffer &currentSceneCB = _sceneCB[frameIndex];
-	memcpy(&_mappedConstantData[frameIndex].constants, &currentSceneCB, sizeof(currentSceneCB));
-	auto cbGpuAddress = _perFrameConstants->GetGPUVirtualAddress() + frameIndex * sizeof(*_mappedConstantData);
+	auto cbGpuAddress = m_frameConstants.Push(_sceneCB[frameIndex]);
 	commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParams::SceneConstantSlot, cbGpuAddress);
 
+	// The views' cameras. Without views nothing reads g_viewCB, the scene constants stand in.
+	auto viewCbGpuAddress = cbGpuAddress;
+	if (m_multiView.IsEnabled())
+	{
+		MultiViewConstantBuffer views = {};
+		m_multiView.GetConstants(&views);
+		viewCbGpuAddress = m_frameConstants.Push(views);
+	}
+	commandList->SetComputeRootConstantBufferView(GlobalRootSignatureParams::ViewConstantSlot, viewCbGpuAddress);
+
 	// Bind the heaps, acceleration structure and dispatch rays.    
 	D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
 	setCommonPiplineState(commandList);
-	commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParams::AccelerationStructureSlot, m_topLevelAccelerationStructure->GetGPUVirtualAddress());
-	DispatchRays(m_dxrCommandList.Get(), m_dxrStateObject.Get(), &dispatchDesc);
+	commandList->SetComputeRootShaderResourceView(GlobalRootSignatureParams::AccelerationStructureSlot, m_topLevelAccelerationStructure.gpuAddress);
+	m_traceTimer.Start(commandList);
+	DispatchRays(dxrCommandList.Get(), m_dxrStateObject.Get(), &dispatchDesc);
+	// A sparse pattern's reconstruction pass stops the timer.
+	if (m_rayPatternDesc.pattern == RayPatternFull)
+	{
+		m_traceTimer.Stop(commandList);
+	}
 }
 
 // Update the application state with the new resolution.
 void D3D12HelloTriangle::UpdateForSizeChange(UINT width, UINT height)
 {
 	DXSample::UpdateForSizeChange(width, height);
+	m_dynamicResolution.SetOutputSize(width, height);
+	m_renderWidth = m_dynamicResolution.GetRenderWidth();
+	m_renderHeight = m_dynamicResolution.GetRenderHeight();
+	m_multiView.SetOutputSize(width, height);
 	float border = 0.1f;
 	if (m_width <= m_height)
 	{
@@ -644,24 +1060,100 @@ void D3D12HelloTriangle::UpdateForSizeChange(UINT width, UINT height)
 	}
 }
 
-// Copy the raytracing output to the backbuffer.
-void D3D12HelloTriangle::CopyRaytracingOutputToBackbuffer()
+// Copy the raytracing output, or its upscaled version, to the backbuffer.
+void D3D12HelloTriangle::CopyRaytracingOutputToBackbuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* output)
 {
-	auto commandList = m_deviceResources->GetCommandList();
 	auto renderTarget = m_deviceResources->GetRenderTarget();
 
-	D3D12_RESOURCE_BARRIER preCopyBarriers[2];
-	preCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST);
-	preCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-	commandList->ResourceBarrier(ARRAYSIZE(preCopyBarriers), preCopyBarriers);
+	commandList->CopyResource(renderTarget, output);
+}
 
-	commandList->CopyResource(renderTarget, m_raytracingOutput.Get());
+// Declare this frame's passes and the resources they touch.
+// The graph works out the barriers in between from the declared states.
+// Every pass runs on the direct queue and every resource is imported. The scene is static, so the
+// top level acceleration structure is built once at load and there is no per-frame build to
+// overlap on the compute queue. The graph's compute queue planning and transient aliasing are
+// only exercised by the Tests project.
+void D3D12HelloTriangle::BuildRenderGraph()
+{
+	auto renderTarget = m_deviceResources->GetRenderTarget();
 
-	D3D12_RESOURCE_BARRIER postCopyBarriers[2];
-	postCopyBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(renderTarget, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT);
-	postCopyBarriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(m_raytracingOutput.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	m_renderGraph.Reset();
+	// The output stays a copy source, or the upscaler's shader resource, until the next frame needs it as a UAV.
+	// Views and tiles below the output size are shown as they are.
+	bool upscale = m_dynamicResolution.IsEnabled() && (m_renderWidth != m_width || m_renderHeight != m_height);
+	auto raytracingOutput = m_renderGraph.ImportResource(L"RaytracingOutput", m_raytracingOutput.Get(),
+		m_resourceStates.GetState(m_raytracingOutput.Get()), upscale ? D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_COPY_SOURCE);
+	auto backBuffer = m_renderGraph.ImportResource(L"BackBuffer", renderTarget, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+	auto accumulationBuffer = m_renderGraph.ImportResource(L"AccumulationBuffer", m_accumulationBuffer.Get(),
+		m_resourceStates.GetState(m_accumulationBuffer.Get()), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	auto raytracingPass = m_renderGraph.AddPass(L"DispatchRays", D3D12_COMMAND_LIST_TYPE_DIRECT,
+		[this](ID3D12GraphicsCommandList* commandList) { DoRaytracing(commandList); });
+	m_renderGraph.Write(raytracingPass, raytracingOutput, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	m_renderGraph.Write(raytracingPass, accumulationBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	if (m_rayPatternDesc.pattern != RayPatternFull)
+	{
+		RayPatternConstants constants = _sceneCB[m_deviceResources->GetCurrentFrameIndex()].rayPattern;
+		auto reconstructPass = m_renderGraph.AddPass(L"Reconstruct", D3D12_COMMAND_LIST_TYPE_DIRECT,
+			[this, constants](ID3D12GraphicsCommandList* commandList)
+		{
+			ID3D12DescriptorHeap* descriptorHeaps[] = { m_descriptorHeap.GetHeap() };
+			commandList->SetDescriptorHeaps(ARRAYSIZE(descriptorHeaps), descriptorHeaps);
+			m_reconstructor.Dispatch(commandList, m_raytracingOutputResourceUAVDescriptor.GetGpuHandle(), constants);
+			m_traceTimer.Stop(commandList);
+		});
+		m_renderGraph.Write(reconstructPass, raytracingOutput, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
+
+	// What is presented and captured.
+	auto output = raytracingOutput;
+	ID3D12Resource* outputResource = m_raytracingOutput.Get();
+	if (upscale)
+	{
+		output = m_renderGraph.ImportResource(L"UpscaledOutput", m_upscaler.GetOutput(),
+			m_resourceStates.GetState(m_upscaler.GetOutput()), D3D12_RESOURCE_STATE_COPY_SOURCE);
+		outputResource = m_upscaler.GetOutput();
+
+		auto upscalePass = m_renderGraph.AddPass(L"Upscale", D3D12_COMMAND_LIST_TYPE_DIRECT,
+			[this](ID3D12GraphicsCommandList* commandList)
+		{
+			ID3D12DescriptorHeap* descriptorHeaps[] = { m_descriptorHeap.GetHeap() };
+			commandList->SetDescriptorHeaps(ARRAYSIZE(descriptorHeaps), descriptorHeaps);
+			m_upscaler.Dispatch(commandList, m_renderWidth, m_renderHeight);
+		});
+		m_renderGraph.Read(upscalePass, raytracingOutput, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		m_renderGraph.Write(upscalePass, output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
 
-	commandList->ResourceBarrier(ARRAYSIZE(postCopyBarriers), postCopyBarriers);
+	auto copyPass = m_renderGraph.AddPass(L"CopyToBackbuffer", D3D12_COMMAND_LIST_TYPE_DIRECT,
+		[this, outputResource](ID3D12GraphicsCommandList* commandList) { CopyRaytracingOutputToBackbuffer(commandList, outputResource); });
+	m_renderGraph.Read(copyPass, output, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	m_renderGraph.Write(copyPass, backBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	if (m_frameWriter)
+	{
+		// Only reads from the graph's point of view, the readback buffer it fills isn't in the graph.
+		UINT64 frameNumber = m_capturedFrameCount++;
+		auto capturePass = m_renderGraph.AddPass(L"CaptureOutput", D3D12_COMMAND_LIST_TYPE_DIRECT,
+			[this, outputResource, frameNumber](ID3D12GraphicsCommandList* commandList) { m_outputReadback.Copy(commandList, outputResource, frameNumber); }, true);
+		m_renderGraph.Read(capturePass, output, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	}
+
+	if (m_tileToCapture != UINT_MAX)
+	{
+		// Like CaptureOutput, its only output is a readback buffer outside the graph.
+		UINT tileIndex = m_tileToCapture;
+		auto captureTilePass = m_renderGraph.AddPass(L"CaptureTile", D3D12_COMMAND_LIST_TYPE_DIRECT,
+			[this, outputResource, tileIndex](ID3D12GraphicsCommandList* commandList) { m_tileReadback.Copy(commandList, outputResource, tileIndex); }, true);
+		m_renderGraph.Read(captureTilePass, output, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	}
+
+	m_renderGraph.Compile();
+	// Every pass declared above produces something, a culled one would silently do nothing.
+	ThrowIfFalse(m_renderGraph.GetPlan().culledPasses.empty(), L"The render graph culled a pass of the frame.");
+	m_renderGraph.CreateTransientResources(m_deviceResources->GetD3DDevice(), m_resourceStates);
 }
 
 // Create resources that are dependent on the size of the main window.
@@ -679,7 +1171,17 @@ void D3D12HelloTriangle::ReleaseWindowSizeDependentResources()
 	m_rayGenShaderTable.Reset();
 	m_missShaderTable.Reset();
 	m_hitGroupShaderTable.Reset();
+	m_resourceStates.Unregister(m_raytracingOutput.Get());
 	m_raytracingOutput.Reset();
+	m_resourceStates.Unregister(m_accumulationBuffer.Get());
+	m_accumulationBuffer.Reset();
+	if (m_upscaler.GetOutput())
+	{
+		m_resourceStates.Unregister(m_upscaler.GetOutput());
+		m_upscaler.ReleaseOutput();
+	}
+	m_outputReadback.Release();
+	m_tileReadback.Release();
 }
 
 // Release all resources that depend on the device.
@@ -687,21 +1189,31 @@ void D3D12HelloTriangle::ReleaseDeviceDependentResources()
 {
 	m_raytracingGlobalRootSignature.Reset();
 	m_raytracingLocalRootSignature.Reset();
+	m_upscaler.Release();
+	m_reconstructor.Release();
 
 	m_dxrDevice.Reset();
 	m_dxrCommandList.Reset();
 	m_dxrStateObject.Reset();
 
-	m_descriptorHeap.Reset();
-	m_descriptorsAllocated = 0;
-	m_raytracingOutputResourceUAVDescriptorHeapIndex = UINT_MAX;
-	m_indexBuffer.resource.Reset();
-	m_vertexBuffer.resource.Reset();
-	_perFrameConstants.Reset();
-
-	m_accelerationStructure.Reset();
-	m_bottomLevelAccelerationStructure.Reset();
-	m_topLevelAccelerationStructure.Reset();
+	m_renderGraph.ReleaseTransientResources(m_resourceStates);
+	m_renderGraph.Reset();
+	m_resourceStates.Clear();
+	m_descriptorHeap.Release();
+	m_raytracingOutputResourceUAVDescriptor = DescriptorRange();
+	m_indexVertexDescriptors = DescriptorRange();
+	m_indexBuffer.allocation = BufferAllocation();
+	m_vertexBuffer.allocation = BufferAllocation();
+	m_frameConstants.Release();
+	m_traceTimer.Release();
+
+	m_bottomLevelAccelerationStructures.Release();
+	m_topLevelAccelerationStructure = BufferAllocation();
+	_instances.clear();
+
+	m_uploadBufferAllocator.Release();
+	m_accelerationStructureAllocator.Release();
+	m_scratchBufferAllocator.Release();
 }
 
 void D3D12HelloTriangle::RecreateD3D()
@@ -726,17 +1238,121 @@ void D3D12HelloTriangle::OnRender()
 		return;
 	}
 
-	m_deviceResources->Prepare();
-	DoRaytracing();
-	CopyRaytracingOutputToBackbuffer();
+	// Declaring and compiling the graph needs none of the frame's command allocators, descriptors
+	// or constants, so it is done while the GPU may still be using them.
+	UINT64 buildStart = StepTimer::GetCurrentTicks();
+	BuildRenderGraph();
+	UINT64 buildTicks = StepTimer::GetCurrentTicks() - buildStart;
+
+	// The back buffer is never rendered to. It starts the frame in the present state, where the
+	// tracker knows it to be, and the render graph takes it to the copy destination state and back.
+	if (m_deviceResources->IsFrameReady())
+	{
+		m_deviceResources->Prepare(D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+	}
+	else
+	{
+		// The GPU is a full frame latency behind and there is no CPU work left to do meanwhile.
+		TRACE_SCOPE("WaitForFrame");
+		m_deviceResources->Prepare(D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+	}
+	m_resourceStates.BeginFrame();
+	m_resourceStates.Register(m_deviceResources->GetRenderTarget(), D3D12_RESOURCE_STATE_PRESENT);
+	// Prepare() has waited for this frame's fence, so its transient descriptors and constants can be reused.
+	m_descriptorHeap.BeginFrame(m_deviceResources->GetCurrentFrameIndex());
+	m_frameConstants.BeginFrame(m_deviceResources->GetCurrentFrameIndex());
+	UINT64 traceTicks;
+	if (m_traceTimer.BeginFrame(m_deviceResources->GetCurrentFrameIndex(), &traceTicks))
+	{
+		m_frameTimings.Record(FrameTimings::PhaseTrace, traceTicks);
+		m_dynamicResolution.Update(1000.0 * StepTimer::TicksToSeconds(traceTicks));
+	}
+	else if (!m_traceTimer.IsAvailable() && m_simulatedGpuFrameTime > 0.0)
+	{
+		m_dynamicResolution.Update(m_simulatedGpuFrameTime * m_raysPerFrame / (static_cast<double>(m_width) * m_height));
+	}
+	m_outputReadback.BeginFrame(m_deviceResources->GetCurrentFrameIndex(),
+		[this](UINT64 frameNumber, const void* data, UINT rowPitch) { SubmitCapturedFrame(frameNumber, data, rowPitch); });
+	m_tileReadback.BeginFrame(m_deviceResources->GetCurrentFrameIndex(),
+		[this](UINT64 tileIndex, const void* data, UINT rowPitch) { WriteRenderedTile(static_cast<UINT>(tileIndex), data, rowPitch); });
+
+	UINT64 recordStart = StepTimer::GetCurrentTicks();
+	if (m_jobSystem)
+	{
+		// The pass lists are submitted right after the main command list, in the same batch.
+		std::vector<ID3D12CommandList*> commandLists;
+		m_renderGraph.ExecuteParallel(m_resourceStates, *m_jobSystem, m_deviceResources->GetCommandListPool(), commandLists);
+		m_deviceResources->QueueCommandLists(static_cast<UINT>(commandLists.size()), commandLists.data());
+	}
+	else
+	{
+		m_renderGraph.Execute(m_resourceStates, m_deviceResources->GetCommandList());
+	}
 
-	m_deviceResources->Present(D3D12_RESOURCE_STATE_PRESENT);
+	UINT64 presentStart = StepTimer::GetCurrentTicks();
+	m_frameTimings.Record(FrameTimings::PhaseRecord, buildTicks + presentStart - recordStart);
+	if (m_renderedFrameCount < m_benchmarkFrameCount)
+	{
+		m_renderedPixelCount += static_cast<UINT64>(m_renderWidth) * m_renderHeight * max(m_multiView.GetViewCount(), 1u);
+		m_tracedRayCount += m_raysPerFrame;
+		if (++m_renderedFrameCount == m_benchmarkFrameCount)
+		{
+			// The run ends when the GPU has finished its last frame, not when the CPU submitted it.
+			// Frames rendered until then aren't counted.
+			m_deviceResources->OnGpuCompletion([this]()
+			{
+				WriteBenchmarkReport(StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - m_benchmarkStart));
+				if (!m_headless)
+				{
+					PostQuitMessage(0);
+				}
+			});
+		}
+	}
+	{
+		TRACE_SCOPE("Present");
+		m_deviceResources->Present(D3D12_RESOURCE_STATE_PRESENT);
+	}
+	m_frameTimings.Record(FrameTimings::PhasePresent, StepTimer::GetCurrentTicks() - presentStart);
 }
 
 void D3D12HelloTriangle::OnDestroy()
 {
+	if (m_deviceResources->IsRecordingDevice())
+	{
+		OutputDebugStringW(m_deviceResources->GetRecordingStatistics()->GetStatisticsString().c_str());
+		WriteRecordingReport();
+	}
+	OutputDebugStringW(m_deviceResources->GetFramePacer().GetLatencyHistogramString().c_str());
+	OutputDebugStringW(m_frameTimings.GetSummaryString().c_str());
+	if (!m_frameTimingsPath.empty())
+	{
+		m_frameTimings.Export(m_frameTimingsPath);
+	}
+	if (!m_tracePath.empty())
+	{
+		TraceRecorder::Export(m_tracePath);
+	}
+	if (!m_recordCameraFile.empty() && !m_replayCamera)
+	{
+		m_cameraPath.Save(m_recordCameraFile);
+	}
+
 	// Let GPU finish before releasing D3D resources.
 	m_deviceResources->WaitForGpu();
+	if (m_frameWriter)
+	{
+		// Nothing renders anymore, so the last frames wait for room instead of being dropped.
+		m_outputReadback.ReadAll([this](UINT64 frameNumber, const void* data, UINT rowPitch)
+		{
+			m_frameWriter->Flush();
+			SubmitCapturedFrame(frameNumber, data, rowPitch);
+		});
+		m_frameWriter->Flush();
+		OutputDebugStringW(m_frameWriter->GetStatisticsString().c_str());
+	}
+	// Tiles still in flight are written, the file stays short if the window was closed early.
+	m_tileReadback.ReadAll([this](UINT64 tileIndex, const void* data, UINT rowPitch) { WriteRenderedTile(static_cast<UINT>(tileIndex), data, rowPitch); });
 	OnDeviceLost();
 }
 
@@ -764,9 +1380,9 @@ void D3D12HelloTriangle::onMouseMoveOriginal(UINT8 wParam, UINT32 lParam) {
 
 	inputs.lmb = wParam & MK_LBUTTON;
 
-	if (!inputs.lmb)
+	if (!inputs.lmb || m_replayCamera)
 	{
-		return; // no mouse button pressed
+		return; // no mouse button pressed, or the camera follows a path
 	}
 
 	inputs.ctrl = GetAsyncKeyState(VK_CONTROL);
@@ -799,17 +1415,146 @@ void D3D12HelloTriangle::CalculateFrameStats()
 		frameCnt = 0;
 		elapsedTime = totalTime;
 
-		float MRaysPerSecond = (m_width * m_height * fps) / static_cast<float>(1e6);
+		float MRaysPerSecond = static_cast<float>(m_raysPerFrame * fps / 1e6);
 
 		wstringstream windowText;
 
 		windowText << setprecision(2) << fixed
-			<< L"    fps: " << fps << L"     ~Million Primary Rays/s: " << MRaysPerSecond
+			<< L"    fps: " << fps << L"    p99: " << m_frameTimings.GetHistogram(FrameTimings::PhaseFrame).GetPercentileMilliseconds(99.0) << L" ms"
+			<< L"     ~Million Primary Rays/s: " << MRaysPerSecond;
+		if (m_dynamicResolution.IsEnabled())
+		{
+			windowText << L"    render: " << m_renderWidth << L"x" << m_renderHeight;
+		}
+		if (m_rayPatternDesc.pattern != RayPatternFull)
+		{
+			windowText << L"    pattern: " << RayPattern::GetPatternName(m_rayPatternDesc.pattern);
+		}
+		if (m_multiView.IsEnabled())
+		{
+			windowText << L"    views: " << m_multiView.GetViewCount() << L" of " << m_renderWidth << L"x" << m_renderHeight;
+		}
+		if (m_tiledRenderer.IsActive())
+		{
+			windowText << L"    tiles: " << m_tiledRenderer.GetWrittenTileCount() << L"/" << m_tiledRenderer.GetTileCount();
+		}
+		windowText
+			<< L"    barriers/frame: " << m_resourceStates.GetLastFrameBarrierCount()
 			<< L"    GPU[" << m_deviceResources->GetAdapterID() << L"]: " << m_deviceResources->GetAdapterDescription();
 		SetCustomWindowText(windowText.str().c_str());
 	}
 }
 
+// Nothing timing dependent goes in, so two runs of the same command line give the same report
+// and a diff shows what a change did to the calls, the barriers and the passes of a frame.
+void D3D12HelloTriangle::WriteRecordingReport()
+{
+	std::wstringstream report;
+	report << m_deviceResources->GetRecordingStatistics()->GetReportString()
+		<< L"last_frame.barriers " << m_resourceStates.GetLastFrameBarrierCount() << L"\n"
+		<< L"dropped_barriers " << m_resourceStates.GetDroppedBarrierCount() << L"\n";
+	if (m_renderGraph.IsCompiled())
+	{
+		const auto& plan = m_renderGraph.GetPlan();
+		report << L"render_graph.passes " << plan.passes.size() << L"\n"
+			<< L"render_graph.culled " << plan.culledPasses.size() << L"\n";
+		for (auto pass : plan.culledPasses)
+		{
+			report << L"render_graph.culled_pass " << m_renderGraph.GetPassName(pass) << L"\n";
+		}
+		report << m_renderGraph.GetPlanString();
+	}
+
+	if (m_recordingReportPath.empty())
+	{
+		fputws(report.str().c_str(), stdout);
+		fflush(stdout);
+		return;
+	}
+	std::wofstream file(m_recordingReportPath);
+	ThrowIfFalse(file.is_open(), L"Couldn't open the recording report file.");
+	file << report.str();
+}
+
+// Machine-readable results of a -benchmark run. Primary rays traced per second of wall time and,
+// where timestamp queries work, per second of GPU time spent in DispatchRays() and the
+// reconstruction after it.
+void D3D12HelloTriangle::WriteBenchmarkReport(double seconds)
+{
+	ofstream file(m_benchmarkReportPath);
+	ThrowIfFalse(file.is_open(), L"Couldn't open the benchmark report file.");
+
+	auto& trace = m_frameTimings.GetHistogram(FrameTimings::PhaseTrace);
+	// The render size changes with dynamic resolution and the ray pattern traces a part of it.
+	// Written once m_renderedFrameCount reaches m_benchmarkFrameCount, never 0.
+	double pixelsPerFrame = static_cast<double>(m_renderedPixelCount) / m_renderedFrameCount;
+	double raysPerFrame = m_tracedRayCount / m_renderedFrameCount;
+	double wallMRaysPerSecond = seconds > 0.0 ? raysPerFrame * m_benchmarkFrameCount / seconds / 1e6 : 0.0;
+	double traceMilliseconds = trace.GetMeanMilliseconds();
+	double gpuMRaysPerSecond = traceMilliseconds > 0.0 ? raysPerFrame / (traceMilliseconds / 1000.0) / 1e6 : 0.0;
+	// Adapter names are plain ASCII in practice.
+	string device = "recording";
+	if (!m_deviceResources->IsRecordingDevice())
+	{
+		device.clear();
+		for (LPCWSTR c = m_deviceResources->GetAdapterDescription(); *c; c++)
+		{
+			device += (*c < 0x80 && *c != L'"' && *c != L'\\') ? static_cast<char>(*c) : '?';
+		}
+	}
+
+	file << fixed << setprecision(4)
+		<< "{\n  \"frames\": " << m_benchmarkFrameCount
+		<< ",\n  \"width\": " << m_width
+		<< ",\n  \"height\": " << m_height
+		<< ",\n  \"device\": \"" << device << '"'
+		<< ",\n  \"camera_path_keys\": " << m_cameraPath.GetKeyCount()
+		<< ",\n  \"seconds\": " << seconds
+		<< ",\n  \"ms_per_frame\": " << (m_benchmarkFrameCount ? 1000.0 * seconds / m_benchmarkFrameCount : 0.0)
+		<< ",\n  \"mrays_per_second\": " << wallMRaysPerSecond
+		<< ",\n  \"gpu_mrays_per_second\": " << gpuMRaysPerSecond;
+	if (m_dynamicResolution.IsEnabled())
+	{
+		file << ",\n  \"dynamic_resolution\": {\"target_ms\": " << m_dynamicResolution.GetTargetMilliseconds()
+			<< ", \"mean_scale\": " << sqrt(pixelsPerFrame / (static_cast<double>(m_width) * m_height))
+			<< ", \"final_width\": " << m_renderWidth << ", \"final_height\": " << m_renderHeight << '}';
+	}
+	if (m_rayPatternDesc.pattern != RayPatternFull)
+	{
+		// Effective rays are the pixels delivered, as if each had been traced.
+		wstring patternName = RayPattern::GetPatternName(m_rayPatternDesc.pattern);
+		string pattern;
+		transform(patternName.begin(), patternName.end(), back_inserter(pattern), [](wchar_t c) { return static_cast<char>(c); });
+		file << ",\n  \"ray_pattern\": {\"name\": \"" << pattern << '"'
+			<< ", \"rays_per_pixel\": " << raysPerFrame / pixelsPerFrame
+			<< ", \"effective_mrays_per_second\": " << wallMRaysPerSecond * pixelsPerFrame / raysPerFrame
+			<< ", \"gpu_effective_mrays_per_second\": " << gpuMRaysPerSecond * pixelsPerFrame / raysPerFrame << '}';
+	}
+	if (m_multiView.IsEnabled())
+	{
+		file << ",\n  \"multi_view\": {\"views\": " << m_multiView.GetViewCount() << ", \"columns\": " << m_multiView.GetColumns()
+			<< ", \"view_width\": " << m_multiView.GetViewWidth() << ", \"view_height\": " << m_multiView.GetViewHeight() << '}';
+	}
+	if (m_generateScene)
+	{
+		// The names are ASCII.
+		wstring meshName = SceneGenerator::GetMeshName(m_sceneDesc.mesh);
+		wstring layoutName = SceneGenerator::GetLayoutName(m_sceneDesc.layout);
+		string mesh, layout;
+		transform(meshName.begin(), meshName.end(), back_inserter(mesh), [](wchar_t c) { return static_cast<char>(c); });
+		transform(layoutName.begin(), layoutName.end(), back_inserter(layout), [](wchar_t c) { return static_cast<char>(c); });
+		file << ",\n  \"scene\": {\"mesh\": \"" << mesh << "\", \"triangles\": " << m_scene.GetTriangleCount()
+			<< ", \"layout\": \"" << layout << "\", \"instances\": " << m_scene.GetInstanceCount()
+			<< ", \"total_triangles\": " << m_scene.GetTotalTriangleCount()
+			<< ", \"overlap\": " << m_sceneDesc.overlap << ", \"aspect_ratio\": " << m_sceneDesc.aspectRatio
+			<< ", \"cpu_bottom_level_build_ms\": " << m_cpuBottomLevelBuildMilliseconds
+			<< ", \"cpu_top_level_build_ms\": " << m_cpuTopLevelBuildMilliseconds << '}';
+	}
+	file << ",\n  \"timings\": ";
+	m_frameTimings.WriteJson(file);
+	file << "}\n";
+}
+
 // Handle OnSizeChanged message event.
 void D3D12HelloTriangle::OnSizeChanged(UINT width, UINT height, bool minimized)
 {
@@ -818,23 +1563,367 @@ void D3D12HelloTriangle::OnSizeChanged(UINT width, UINT height, bool minimized)
 		return;
 	}
 
+	// The GPU is idle, frames still waiting to be read back are handed over at the old size.
+	m_outputReadback.ReadAll([this](UINT64 frameNumber, const void* data, UINT rowPitch) { SubmitCapturedFrame(frameNumber, data, rowPitch); });
+	m_tileReadback.ReadAll([this](UINT64 tileIndex, const void* data, UINT rowPitch) { WriteRenderedTile(static_cast<UINT>(tileIndex), data, rowPitch); });
 	UpdateForSizeChange(width, height);
 
 	ReleaseWindowSizeDependentResources();
 	CreateWindowSizeDependentResources();
 }
 
-// Allocate a descriptor and return its index. 
-// If the passed descriptorIndexToUse is valid, it will be used instead of allocating a new one.
-UINT D3D12HelloTriangle::AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse)
+// Handle the sample specific command line args.
+_Use_decl_annotations_
+void D3D12HelloTriangle::ParseCommandLineArgs(WCHAR* argv[], int argc)
 {
-	auto descriptorHeapCpuBase = m_descriptorHeap->GetCPUDescriptorHandleForHeapStart();
-	if (descriptorIndexToUse >= m_descriptorHeap->GetDesc().NumDescriptors)
+	DXSample::ParseCommandLineArgs(argv, argc);
+
+	for (int i = 1; i < argc; ++i)
+	{
+		// -descriptorHeapSize [count]
+		if (_wcsnicmp(argv[i], L"-descriptorHeapSize", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/descriptorHeapSize", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_persistentDescriptorCount = _wtoi(argv[i + 1]);
+			ThrowIfFalse(m_persistentDescriptorCount > 0, L"Descriptor heap size must be positive.");
+			i++;
+		}
+		// -recordingThreads [count]
+		else if (_wcsnicmp(argv[i], L"-recordingThreads", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/recordingThreads", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_recordingThreadCount = _wtoi(argv[i + 1]);
+			ThrowIfFalse(m_recordingThreadCount > 0, L"Recording thread count must be positive.");
+			i++;
+		}
+		// -recordingReport [path]
+		else if (_wcsnicmp(argv[i], L"-recordingReport", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/recordingReport", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_recordingReportPath = argv[i + 1];
+			i++;
+		}
+		// -frameLatency [count]
+		else if (_wcsnicmp(argv[i], L"-frameLatency", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/frameLatency", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_maxFrameLatency = _wtoi(argv[i + 1]);
+			ThrowIfFalse(m_maxFrameLatency > 0 && m_maxFrameLatency <= FramePacer::c_maxFrameLatency, L"Frame latency must be between 1 and 16.");
+			i++;
+		}
+		// -simulatedGpuFrameTime [milliseconds], headless only
+		else if (_wcsnicmp(argv[i], L"-simulatedGpuFrameTime", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/simulatedGpuFrameTime", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_simulatedGpuFrameTime = _wtof(argv[i + 1]);
+			ThrowIfFalse(m_simulatedGpuFrameTime >= 0.0, L"Simulated GPU frame time must not be negative.");
+			i++;
+		}
+		// -cameraPath [path]
+		else if (_wcsnicmp(argv[i], L"-cameraPath", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/cameraPath", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_cameraPathFile = argv[i + 1];
+			i++;
+		}
+		// -recordCamera [path]
+		else if (_wcsnicmp(argv[i], L"-recordCamera", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/recordCamera", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_recordCameraFile = argv[i + 1];
+			i++;
+		}
+		// -benchmark [frameCount]
+		else if (_wcsnicmp(argv[i], L"-benchmark", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/benchmark", wcslen(argv[i])) == 0)
+		{
+			m_benchmarkFrameCount = c_defaultBenchmarkFrameCount;
+			if (i + 1 < argc && iswdigit(argv[i + 1][0]))
+			{
+				m_benchmarkFrameCount = _wtoi(argv[i + 1]);
+				ThrowIfFalse(m_benchmarkFrameCount > 0, L"Benchmark frame count must be positive.");
+				i++;
+			}
+		}
+		// -benchmarkReport [path]
+		else if (_wcsnicmp(argv[i], L"-benchmarkReport", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/benchmarkReport", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_benchmarkReportPath = argv[i + 1];
+			i++;
+		}
+		// -scene [terrain|sphere|soup]
+		else if (_wcsnicmp(argv[i], L"-scene", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/scene", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+			ThrowIfFalse(SceneGenerator::ParseMesh(argv[i + 1], &m_sceneDesc.mesh), L"Unknown scene mesh, expected terrain, sphere or soup.");
+
+			m_generateScene = true;
+			i++;
+		}
+		// -sceneTriangles [count], per mesh
+		else if (_wcsnicmp(argv[i], L"-sceneTriangles", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneTriangles", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_sceneDesc.triangleCount = _wtoi(argv[i + 1]);
+			i++;
+		}
+		// -sceneLayout [grid|clustered|overlapping]
+		else if (_wcsnicmp(argv[i], L"-sceneLayout", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneLayout", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+			ThrowIfFalse(SceneGenerator::ParseLayout(argv[i + 1], &m_sceneDesc.layout), L"Unknown scene layout, expected grid, clustered or overlapping.");
+
+			i++;
+		}
+		// -sceneInstances [count]
+		else if (_wcsnicmp(argv[i], L"-sceneInstances", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneInstances", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_sceneDesc.instanceCount = _wtoi(argv[i + 1]);
+			i++;
+		}
+		// -sceneOverlap [0..1)
+		else if (_wcsnicmp(argv[i], L"-sceneOverlap", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneOverlap", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_sceneDesc.overlap = static_cast<float>(_wtof(argv[i + 1]));
+			i++;
+		}
+		// -sceneAspect [ratio]
+		else if (_wcsnicmp(argv[i], L"-sceneAspect", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneAspect", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_sceneDesc.aspectRatio = static_cast<float>(_wtof(argv[i + 1]));
+			i++;
+		}
+		// -sceneSeed [seed]
+		else if (_wcsnicmp(argv[i], L"-sceneSeed", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/sceneSeed", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_sceneDesc.seed = _wtoi(argv[i + 1]);
+			i++;
+		}
+		// -trace [path], Chrome trace JSON of the instrumented scopes
+		else if (_wcsnicmp(argv[i], L"-trace", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/trace", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_tracePath = argv[i + 1];
+			i++;
+		}
+		// -frameTimings [path], .json for JSON, CSV otherwise
+		else if (_wcsnicmp(argv[i], L"-frameTimings", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/frameTimings", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_frameTimingsPath = argv[i + 1];
+			i++;
+		}
+		// -traversalStats [prefix], CPU traversal heatmaps of the first frame
+		else if (_wcsnicmp(argv[i], L"-traversalStats", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/traversalStats", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_traversalStatisticsPrefix = argv[i + 1];
+			i++;
+		}
+		// -writeFrames [prefix], every frame's raytracing output as prefix_<frame>.<format>
+		else if (_wcsnicmp(argv[i], L"-writeFrames", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/writeFrames", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_writeFramesPrefix = argv[i + 1];
+			i++;
+		}
+		// -frameFormat [png|pfm|exr]
+		else if (_wcsnicmp(argv[i], L"-frameFormat", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/frameFormat", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			ThrowIfFalse(FrameWriter::ParseFormat(argv[i + 1], &m_frameFormat), L"Unknown frame format, use png, pfm or exr.");
+			i++;
+		}
+		// -noFrameDrops, -writeFrames waits for the frame writer rather than drop frames
+		else if (_wcsnicmp(argv[i], L"-noFrameDrops", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/noFrameDrops", wcslen(argv[i])) == 0)
+		{
+			m_noFrameDrops = true;
+		}
+		// -tonemap [none|reinhard|aces], for the -traversalStats color image
+		else if (_wcsnicmp(argv[i], L"-tonemap", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/tonemap", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			ThrowIfFalse(Tonemapper::ParseOperator(argv[i + 1], &m_tonemapOperator), L"Unknown tonemap operator, use none, reinhard or aces.");
+			i++;
+		}
+		// -exposure [stops]
+		else if (_wcsnicmp(argv[i], L"-exposure", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/exposure", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_exposure = static_cast<float>(_wtof(argv[i + 1]));
+			i++;
+		}
+		// -maxAccumulatedFrames [count], 0 disables accumulation
+		else if (_wcsnicmp(argv[i], L"-maxAccumulatedFrames", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/maxAccumulatedFrames", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_maxAccumulatedFrames = _wtoi(argv[i + 1]);
+			i++;
+		}
+		// -targetFrameTime [milliseconds], GPU time of DispatchRays() to hold with dynamic resolution
+		else if (_wcsnicmp(argv[i], L"-targetFrameTime", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/targetFrameTime", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_dynamicResolutionDesc.targetMilliseconds = _wtof(argv[i + 1]);
+			ThrowIfFalse(m_dynamicResolutionDesc.targetMilliseconds > 0.0, L"Target frame time must be positive.");
+			i++;
+		}
+		// -minRenderScale [scale], per axis, in (0, 1]
+		else if (_wcsnicmp(argv[i], L"-minRenderScale", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/minRenderScale", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_dynamicResolutionDesc.minScale = static_cast<float>(_wtof(argv[i + 1]));
+			i++;
+		}
+		// -adaptiveSampling [prefix], CPU traced first frame with samples where it is noisy
+		else if (_wcsnicmp(argv[i], L"-adaptiveSampling", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/adaptiveSampling", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_adaptiveSamplingPrefix = argv[i + 1];
+			i++;
+		}
+		// -rayBudget [rays per pixel], for -adaptiveSampling
+		else if (_wcsnicmp(argv[i], L"-rayBudget", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/rayBudget", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_adaptiveRaysPerPixel = static_cast<float>(_wtof(argv[i + 1]));
+			i++;
+		}
+		// -rayPattern [full|checkerboard|foveated], before -rayPatternStats, which it is a prefix of
+		else if (_wcsnicmp(argv[i], L"-rayPattern", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/rayPattern", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			ThrowIfFalse(RayPattern::ParsePattern(argv[i + 1], &m_rayPatternDesc.pattern), L"Unknown ray pattern, use full, checkerboard or foveated.");
+			i++;
+		}
+		// -rayPatternStats [prefix], CPU traced frames of every ray pattern against the full one
+		else if (_wcsnicmp(argv[i], L"-rayPatternStats", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/rayPatternStats", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_rayPatternStatsPrefix = argv[i + 1];
+			i++;
+		}
+		// -foveation [inner radius] [outer radius], as fractions of the height
+		else if (_wcsnicmp(argv[i], L"-foveation", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/foveation", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 2 < argc, L"Incorrect argument format passed in.");
+
+			m_rayPatternDesc.innerRadius = static_cast<float>(_wtof(argv[i + 1]));
+			m_rayPatternDesc.outerRadius = static_cast<float>(_wtof(argv[i + 2]));
+			ThrowIfFalse(m_rayPatternDesc.innerRadius <= m_rayPatternDesc.outerRadius, L"The inner foveation radius can't be larger than the outer one.");
+			i += 2;
+		}
+		// -tiledRender [width] [height] [path], a .ppm or .pfm
+		else if (_wcsnicmp(argv[i], L"-tiledRender", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/tiledRender", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 3 < argc, L"Incorrect argument format passed in.");
+
+			m_tiledRenderDesc.width = _wtoi(argv[i + 1]);
+			m_tiledRenderDesc.height = _wtoi(argv[i + 2]);
+			ThrowIfFalse(m_tiledRenderDesc.width > 0 && m_tiledRenderDesc.height > 0, L"The tiled render size must be positive.");
+			m_tiledRenderPath = argv[i + 3];
+			i += 3;
+		}
+		// -tileSamples [count], accumulated frames per tile of a tiled render
+		else if (_wcsnicmp(argv[i], L"-tileSamples", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/tileSamples", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_tiledRenderDesc.samplesPerPixel = _wtoi(argv[i + 1]);
+			ThrowIfFalse(m_tiledRenderDesc.samplesPerPixel > 0, L"The samples per tile must be positive.");
+			i++;
+		}
+		// -views [count], cameras turned about the look at point traced in one dispatch
+		else if (_wcsnicmp(argv[i], L"-views", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/views", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_viewCount = _wtoi(argv[i + 1]);
+			ThrowIfFalse(m_viewCount > 0 && m_viewCount <= MaxViewCount, L"The view count must be between 1 and 64.");
+			i++;
+		}
+		// -multiViewStats [prefix], CPU traced views batched against a frame per view
+		else if (_wcsnicmp(argv[i], L"-multiViewStats", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/multiViewStats", wcslen(argv[i])) == 0)
+		{
+			ThrowIfFalse(i + 1 < argc, L"Incorrect argument format passed in.");
+
+			m_multiViewStatsPrefix = argv[i + 1];
+			i++;
+		}
+	}
+
+	// A headless benchmark runs exactly as many frames as it measures.
+	if (m_benchmarkFrameCount)
 	{
-		descriptorIndexToUse = m_descriptorsAllocated++;
+		m_headlessFrameCount = m_benchmarkFrameCount;
 	}
-	*cpuDescriptor = CD3DX12_CPU_DESCRIPTOR_HANDLE(descriptorHeapCpuBase, descriptorIndexToUse, m_descriptorSize);
-	return descriptorIndexToUse;
 }
 
 // #DXR
@@ -859,7 +1948,10 @@ void D3D12HelloTriangle::updateCameraMatrices() {
 		XMVectorSet(up.x, up.y, up.z, 0.0f));
 
 
-	XMMATRIX proj = XMMatrixPerspectiveFovRH(fovAngleY, m_aspectRatio, 0.1f, 1000.0f);
+	// A tiled render's tiles are cut from the projection of the whole image.
+	const TiledRenderDesc& tiledRender = m_tiledRenderer.GetDesc();
+	float aspectRatio = m_tiledRenderer.IsActive() ? static_cast<float>(tiledRender.width) / tiledRender.height : m_aspectRatio;
+	XMMATRIX proj = XMMatrixPerspectiveFovRH(fovAngleY, aspectRatio, 0.1f, 1000.0f);
 	XMMATRIX viewProj = view * proj;
 
 	// Raytracing has to do the contrary of rasterization: rays are defined in camera space, and are transformed into world space.
@@ -867,6 +1959,153 @@ void D3D12HelloTriangle::updateCameraMatrices() {
 	_sceneCB[frameIndex].projectionToWorld = XMMatrixInverse(nullptr, viewProj);
 }
 
+// Picks up the render size the controller chose from the frames measured so far.
+void D3D12HelloTriangle::UpdateDynamicResolution()
+{
+	// A tiled render's tiles set the render size, see UpdateTiledRender(), and so do the views.
+	if (m_tiledRenderer.IsActive() || m_multiView.IsEnabled())
+	{
+		return;
+	}
+
+	UINT renderWidth = m_dynamicResolution.GetRenderWidth();
+	UINT renderHeight = m_dynamicResolution.GetRenderHeight();
+	if (renderWidth == m_renderWidth && renderHeight == m_renderHeight)
+	{
+		return;
+	}
+
+	m_renderWidth = renderWidth;
+	m_renderHeight = renderHeight;
+	// The accumulated pixels no longer line up with the traced ones.
+	ResetAccumulation();
+}
+
+// -views: the render size is a cell of the view grid, and the views' cameras follow the main one.
+// The main camera's matrices are left as they are, they still tell UpdateAccumulation() when it moved.
+void D3D12HelloTriangle::UpdateMultiView()
+{
+	auto& sceneCB = _sceneCB[m_deviceResources->GetCurrentFrameIndex()];
+	sceneCB.viewCount = m_multiView.GetViewCount();
+	sceneCB.viewColumns = m_multiView.GetColumns();
+	if (!m_multiView.IsEnabled())
+	{
+		return;
+	}
+
+	if (m_renderWidth != m_multiView.GetViewWidth() || m_renderHeight != m_multiView.GetViewHeight())
+	{
+		m_renderWidth = m_multiView.GetViewWidth();
+		m_renderHeight = m_multiView.GetViewHeight();
+		ResetAccumulation();
+	}
+
+	glm::vec3 eye, center, up;
+	nv_helpers_dx12::CameraManip.getLookat(eye, center, up);
+	// The field of view of updateCameraMatrices().
+	m_multiView.Update(XMFLOAT3(eye.x, eye.y, eye.z), XMFLOAT3(center.x, center.y, center.z), XMFLOAT3(up.x, up.y, up.z), 90.0f * XM_PI / 180.0f);
+}
+
+// A -tiledRender frame traces a tile, through the projection of the whole image cropped to it,
+// into the top left of the output. Each tile restarts the accumulation, so its samples follow the
+// same jitter sequence as every other tile's, and its last frame is read back. Past the last tile
+// it is rendered again until the readback comes in. Otherwise the rendered rows are the image.
+void D3D12HelloTriangle::UpdateTiledRender()
+{
+	auto& sceneCB = _sceneCB[m_deviceResources->GetCurrentFrameIndex()];
+	m_tileToCapture = UINT_MAX;
+	if (!m_tiledRenderer.IsActive() || m_headless)
+	{
+		sceneCB.tileTop = 0;
+		sceneCB.imageHeight = m_renderHeight;
+		return;
+	}
+
+	if (m_tiledRenderFrame == 0)
+	{
+		XMStoreFloat4x4(&m_tiledRenderCamera.projectionToWorld, sceneCB.projectionToWorld);
+		XMStoreFloat3(&m_tiledRenderCamera.position, sceneCB.cameraPosition);
+	}
+	const TiledRenderDesc& desc = m_tiledRenderer.GetDesc();
+	UINT tileCount = m_tiledRenderer.GetTileCount();
+	UINT tileIndex = min(m_tiledRenderFrame / desc.samplesPerPixel, tileCount - 1);
+	if (m_tiledRenderFrame < tileCount * desc.samplesPerPixel)
+	{
+		UINT sample = m_tiledRenderFrame % desc.samplesPerPixel;
+		if (sample == 0)
+		{
+			ResetAccumulation();
+		}
+		if (sample == desc.samplesPerPixel - 1)
+		{
+			m_tileToCapture = tileIndex;
+		}
+		m_tiledRenderFrame++;
+	}
+
+	TileRect tile = m_tiledRenderer.GetTile(tileIndex);
+	ThrowIfFalse(tile.width <= m_width && tile.height <= m_height, L"The window is smaller than the tiles of the tiled render.");
+	m_renderWidth = tile.width;
+	m_renderHeight = tile.height;
+	sceneCB.projectionToWorld = TiledRenderer::GetTileProjectionToWorld(XMLoadFloat4x4(&m_tiledRenderCamera.projectionToWorld), desc.width, desc.height, tile);
+	sceneCB.cameraPosition = XMLoadFloat3(&m_tiledRenderCamera.position);
+	sceneCB.tileTop = tile.y;
+	sceneCB.imageHeight = desc.height;
+}
+
+// Compares this frame's camera with the last one: a still camera adds one more sample per pixel
+// at the next point of the Halton (2, 3) sequence, anything else restarts from the pixel centers.
+// The ray pattern's history follows the same comparison.
+void D3D12HelloTriangle::UpdateAccumulation()
+{
+	auto& sceneCB = _sceneCB[m_deviceResources->GetCurrentFrameIndex()];
+	XMFLOAT4X4 projectionToWorld;
+	XMFLOAT3 cameraPosition;
+	XMStoreFloat4x4(&projectionToWorld, sceneCB.projectionToWorld);
+	XMStoreFloat3(&cameraPosition, sceneCB.cameraPosition);
+	bool cameraMoved = memcmp(&projectionToWorld, &m_accumulationProjectionToWorld, sizeof(projectionToWorld)) != 0
+		|| memcmp(&cameraPosition, &m_accumulationCameraPosition, sizeof(cameraPosition)) != 0;
+	m_accumulationProjectionToWorld = projectionToWorld;
+	m_accumulationCameraPosition = cameraPosition;
+
+	UINT history = m_accumulationReset ? RayPatternHistoryNone : cameraMoved ? RayPatternHistoryClamped : RayPatternHistoryExact;
+	sceneCB.rayPattern = RayPattern::GetConstants(m_rayPatternDesc, m_renderWidth, m_renderHeight, m_rayPatternFrame++, history);
+	if (m_accumulationReset)
+	{
+		// Resets come with every change of the render size, and so of the rays per frame.
+		m_raysPerFrame = RayPattern::GetRaysPerFrame(sceneCB.rayPattern) * max(sceneCB.viewCount, 1u);
+		if (m_deviceResources->IsRecordingDevice())
+		{
+			m_deviceResources->SetSimulatedGpuFrameTime(m_simulatedGpuFrameTime * m_raysPerFrame / (static_cast<double>(m_width) * m_height));
+		}
+	}
+
+	if (cameraMoved || m_accumulationReset || m_maxAccumulatedFrames == 0 || m_rayPatternDesc.pattern != RayPatternFull)
+	{
+		m_accumulatedFrameCount = 0;
+	}
+	else if (m_accumulatedFrameCount < m_maxAccumulatedFrames)
+	{
+		m_accumulatedFrameCount++;
+	}
+	m_accumulationReset = false;
+
+	auto Halton = [](UINT index, UINT base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / base;
+		for (; index > 0; index /= base, fraction /= base)
+		{
+			result += fraction * (index % base);
+		}
+		return result;
+	};
+	sceneCB.accumulatedFrameCount = m_accumulatedFrameCount;
+	sceneCB.subpixelJitter = m_accumulatedFrameCount
+		? XMFLOAT2(Halton(m_accumulatedFrameCount, 2) - 0.5f, Halton(m_accumulatedFrameCount, 3) - 0.5f)
+		: XMFLOAT2(0.0f, 0.0f);
+}
+
 void D3D12HelloTriangle::initializeScene() {
 
 	// setup Camera
@@ -876,8 +2115,8 @@ void D3D12HelloTriangle::initializeScene() {
 
 }
 
-// Create SRV for a buffer
-UINT D3D12HelloTriangle::createBufferSRV(D3DBuffer *buffer, UINT numElements, UINT elementSize) {
+// Create SRV for a buffer in slot descriptorOffset of the given descriptor range
+void D3D12HelloTriangle::createBufferSRV(D3DBuffer *buffer, const DescriptorRange &descriptors, UINT descriptorOffset, UINT numElements, UINT elementSize) {
 	auto device = m_deviceResources->GetD3DDevice();
 
 	//SRV
@@ -885,6 +2124,8 @@ UINT D3D12HelloTriangle::createBufferSRV(D3DBuffer *buffer, UINT numElements, UI
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	srvDesc.Buffer.NumElements = numElements;
+	// The buffer lives at an offset inside a shared page, which the view addresses in elements.
+	srvDesc.Buffer.FirstElement = buffer->allocation.offset / (elementSize == 0 ? sizeof(UINT32) : elementSize);
 	if (elementSize == 0)
 	{
 		srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
@@ -898,11 +2139,9 @@ UINT D3D12HelloTriangle::createBufferSRV(D3DBuffer *buffer, UINT numElements, UI
 		srvDesc.Buffer.StructureByteStride = elementSize;
 	}
 
-	UINT descriptorIndex = AllocateDescriptor(&buffer->cpuDescriptorHandle);
-	device->CreateShaderResourceView(buffer->resource.Get(), &srvDesc, buffer->cpuDescriptorHandle);
-	buffer->gpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), descriptorIndex, m_descriptorSize);
-
-	return descriptorIndex;
+	buffer->cpuDescriptorHandle = descriptors.GetCpuHandle(descriptorOffset);
+	buffer->gpuDescriptorHandle = descriptors.GetGpuHandle(descriptorOffset);
+	device->CreateShaderResourceView(buffer->allocation.resource, &srvDesc, buffer->cpuDescriptorHandle);
 }
 
 
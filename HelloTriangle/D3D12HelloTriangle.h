@@ -14,6 +14,27 @@
 #include "DXSample.h"
 #include "StepTimer.h"
 #include "RaytracingHlslCompat.h"
+#include "DescriptorHeapAllocator.h"
+#include "FrameConstantAllocator.h"
+#include "AccelerationStructureManager.h"
+#include "ResourceStateTracker.h"
+#include "RenderGraph.h"
+#include "FrameTimings.h"
+#include "GpuTimer.h"
+#include "TraceRecorder.h"
+#include "CameraPath.h"
+#include "SceneGenerator.h"
+#include "CpuRenderer.h"
+#include "AdaptiveSampler.h"
+#include "FrameWriter.h"
+#include "TextureReadback.h"
+#include "DynamicResolution.h"
+#include "Upscaler.h"
+#include "RayPattern.h"
+#include "RayPatternAnalysis.h"
+#include "Reconstructor.h"
+#include "TiledRenderer.h"
+#include "MultiView.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -23,6 +44,7 @@ namespace GlobalRootSignatureParams {
 		AccelerationStructureSlot,
 		SceneConstantSlot,
 		VertexBuffersSlot,
+		ViewConstantSlot,
 		Count,
 	};
 }
@@ -54,19 +76,22 @@ public:
 	virtual void onMouseMoveOriginal(UINT8 wParam, UINT32 lParam) override;
 	virtual void onLeftButtonDownOriginal(UINT32 lParam) override;
 
+	virtual void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc) override;
+
 private:
 
 	static const UINT FrameCount = 3;
 
-	// We'll allocate space for serveral of these  and the will need to padded for alignment.
-	static_assert(sizeof(SceneConstantBuffer) < D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, "Checking the size here");
+	// Descriptor heap layout, the persistent region can be resized with -descriptorHeapSize.
+	static const UINT c_defaultPersistentDescriptorCount = 1024;
+	static const UINT c_transientDescriptorsPerFrame = 256;
 
-	union AlignedSceneConstantBuffer {
-		SceneConstantBuffer constants;
-		uint8_t alignmentPadding[D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT];
-	};
-	AlignedSceneConstantBuffer *_mappedConstantData;
-	ComPtr<ID3D12Resource> _perFrameConstants;
+	static const UINT c_defaultBenchmarkFrameCount = 500;
+	static const UINT c_defaultMaxAccumulatedFrames = 1024;
+	static const UINT c_rayPatternAnalysisFrameCount = 60;
+
+	// Per-frame constants of any type are bump allocated from a persistently mapped ring, one slice per frame.
+	DX::FrameConstantAllocator m_frameConstants;
 
 	// DirectX Raytracing (DXR) attributes
 	ComPtr<ID3D12Device5> m_dxrDevice;
@@ -78,21 +103,96 @@ private:
 	ComPtr<ID3D12RootSignature> m_raytracingLocalRootSignature;
 
 	// Descriptors
-	ComPtr<ID3D12DescriptorHeap> m_descriptorHeap;
-	UINT m_descriptorsAllocated;
-	UINT m_descriptorSize;
+	DX::DescriptorHeapAllocator m_descriptorHeap;
+	UINT m_persistentDescriptorCount;
+
+	// Resource states and the barriers between them
+	DX::ResourceStateTracker m_resourceStates;
+	DX::RenderGraph m_renderGraph;
+
+	// Passes are recorded in parallel with -recordingThreads greater than 1.
+	UINT m_recordingThreadCount;
+	std::unique_ptr<DX::JobSystem> m_jobSystem;
+
+	// Frame pacing, 0 keeps one frame in flight per back buffer.
+	UINT m_maxFrameLatency;
+	double m_simulatedGpuFrameTime;
+
+	// Headless runs write their call and barrier counts and the render graph plan to
+	// -recordingReport [path] on exit, or to stdout without one.
+	std::wstring m_recordingReportPath;
+
+	// Per-phase frame time histograms, written to -frameTimings [path] on exit.
+	DX::FrameTimings m_frameTimings;
+	DX::GpuTimer m_traceTimer;
+	std::wstring m_frameTimingsPath;
+	std::wstring m_tracePath;
+	UINT64 m_lastFrameStart;
+
+	// Camera paths: -recordCamera [path] saves the interactive camera, -cameraPath [path] replays one.
+	// -benchmark [frameCount] replays the path, or an orbit, on a virtual 60 Hz clock and writes
+	// a report to -benchmarkReport [path] after frameCount frames.
+	DX::CameraPath m_cameraPath;
+	std::wstring m_cameraPathFile;
+	std::wstring m_recordCameraFile;
+	bool m_replayCamera;
+	UINT m_benchmarkFrameCount;
+	std::wstring m_benchmarkReportPath;
+	UINT64 m_benchmarkStart;
+	UINT m_renderedFrameCount;
+
+	// Procedural scene, -scene [terrain|sphere|soup] replaces the triangles. Generated once, it
+	// survives device loss. On the recording device the CpuBvh builds over it are timed.
+	bool m_generateScene;
+	DX::SceneDesc m_sceneDesc;
+	DX::SceneGenerator m_scene;
+	double m_cpuBottomLevelBuildMilliseconds;
+	double m_cpuTopLevelBuildMilliseconds;
+
+	// -traversalStats [prefix] renders the generated scene's first frame with the CPU tracer and
+	// writes per pixel traversal heatmaps and their statistics, see CpuRenderer::Export().
+	// -tonemap [none|reinhard|aces] and -exposure [stops] treat its color as scene linear and
+	// sRGB encode it; by default it is quantized as is, like the GPU output.
+	std::wstring m_traversalStatisticsPrefix;
+	DX::Tonemapper::Operator m_tonemapOperator;
+	float m_exposure;
+
+	// -adaptiveSampling [prefix] renders the generated scene's first frame again with the CPU
+	// tracer, spending more samples on noisy tiles, and writes the image, a samples per pixel
+	// heatmap and the rays saved against uniform sampling, see AdaptiveSampler::Export().
+	// -rayBudget [rays per pixel] caps the frame's rays, initial samples included.
+	std::wstring m_adaptiveSamplingPrefix;
+	DX::AdaptiveSamplingDesc m_adaptiveSamplingDesc;
+	float m_adaptiveRaysPerPixel;
+
+	// -writeFrames [prefix] reads the raytracing output back every frame and writes it to disk
+	// on the frame writer's threads, as PNG or -frameFormat [png|pfm|exr]. The readback is
+	// picked up when its frame index comes around again, so nothing waits on the GPU or the disk.
+	// -noFrameDrops waits for the disk instead of dropping frames, for golden image runs.
+	std::wstring m_writeFramesPrefix;
+	DX::FrameWriter::Format m_frameFormat;
+	bool m_noFrameDrops;
+	std::unique_ptr<DX::FrameWriter> m_frameWriter;
+	DX::TextureReadback m_outputReadback;
+	UINT64 m_capturedFrameCount;
 
 	// Raytracing scene
 	RayGenConstantBuffer m_rayGenCB;
 
+	// Buffer memory, sub-allocated from large pages instead of one committed resource per buffer.
+	DX::LinearBufferAllocator m_uploadBufferAllocator;
+	DX::LinearBufferAllocator m_accelerationStructureAllocator;
+	DX::LinearBufferAllocator m_scratchBufferAllocator;
+
 	// Geometry
 	struct D3DBuffer {
-		ComPtr<ID3D12Resource> resource;
+		DX::BufferAllocation allocation;
 		D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle;
 		D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptorHandle;
 	};
 	D3DBuffer m_indexBuffer;
 	D3DBuffer m_vertexBuffer;
+	DX::DescriptorRange m_indexVertexDescriptors;
 
 	// added by stan
 	// Acceleration structure
@@ -110,17 +210,76 @@ private:
 	//		: bottomLevelAS(blAS), transform(t), instanceId(iId), hitGroupIndex(hgId) {};
 	//};
 
-	ComPtr<ID3D12Resource> m_accelerationStructure;
-	ComPtr<ID3D12Resource> m_bottomLevelAccelerationStructure;
+	DX::AccelerationStructureManager m_bottomLevelAccelerationStructures;
+	UINT m_bottomLevelAccelerationStructure;
 	UINT _triangleGemotryCount = 1; // bottom level NumDescs
 	UINT _instanceCount = 3; // top level NumDescs
-	std::vector<std::pair<ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> _instances;
-	ComPtr<ID3D12Resource> m_topLevelAccelerationStructure;
+	std::vector<std::pair<D3D12_GPU_VIRTUAL_ADDRESS, DirectX::XMMATRIX>> _instances;
+	DX::BufferAllocation m_topLevelAccelerationStructure;
 
 	// Raytracing output
 	ComPtr<ID3D12Resource> m_raytracingOutput;
-	D3D12_GPU_DESCRIPTOR_HANDLE m_raytracingOutputResourceUAVGpuDescriptor;
-	UINT m_raytracingOutputResourceUAVDescriptorHeapIndex;
+	DX::DescriptorRange m_raytracingOutputResourceUAVDescriptor;	// Output and accumulation UAVs.
+
+	// While the camera is still, every frame traces a jittered sample per pixel and blends it into
+	// a float running average, up to -maxAccumulatedFrames [count] (0 disables it). Past the cap
+	// the average keeps moving with weight 1 / (count + 1). Any camera change or resize restarts it.
+	ComPtr<ID3D12Resource> m_accumulationBuffer;
+	UINT m_maxAccumulatedFrames;
+	UINT m_accumulatedFrameCount;
+	bool m_accumulationReset;
+	DirectX::XMFLOAT4X4 m_accumulationProjectionToWorld;
+	DirectX::XMFLOAT3 m_accumulationCameraPosition;
+
+	// -targetFrameTime [milliseconds] turns on dynamic resolution: a controller fed with the GPU
+	// time of DispatchRays() picks the render size, down to -minRenderScale [scale] of the window
+	// per axis. Rays are traced into the top left of the output and the upscaler fills the back
+	// buffer from there; at full size the output is copied as usual. Headless, the simulated GPU
+	// frame time stands in for the measurement and scales with the render area.
+	DX::DynamicResolutionDesc m_dynamicResolutionDesc;
+	DX::DynamicResolution m_dynamicResolution;
+	DX::Upscaler m_upscaler;
+	UINT m_renderWidth;
+	UINT m_renderHeight;
+	UINT64 m_renderedPixelCount;
+
+	// -rayPattern [full|checkerboard|foveated] picks the pixels DispatchRays() traces each frame,
+	// the reconstructor fills in the others, see RayPattern. -foveation [inner] [outer] sets the
+	// foveated radii, as fractions of the height. Accumulation is off with a sparse pattern, a
+	// still camera converges as the pattern comes around every pixel instead. The trace timer
+	// includes the reconstruction. -rayPatternStats [prefix] follows the generated scene's camera
+	// for c_rayPatternAnalysisFrameCount frames with the CPU tracer and writes every pattern's
+	// effective rays per second and reconstruction error, see RayPatternAnalysis::Export().
+	DX::RayPatternDesc m_rayPatternDesc;
+	DX::Reconstructor m_reconstructor;
+	UINT m_rayPatternFrame;
+	double m_raysPerFrame;
+	double m_tracedRayCount;
+	std::wstring m_rayPatternStatsPrefix;
+	std::unique_ptr<DX::CpuTracer> m_rayPatternTracer;
+	DX::RayPatternAnalysis m_rayPatternAnalysis;
+
+	// -tiledRender [width] [height] [path] renders an image of any size in window sized tiles,
+	// one per frame or -tileSamples [count] accumulated frames, and streams each to a .ppm or .pfm
+	// as its readback comes in, see TiledRenderer. The camera is frozen at the first tile. Quits
+	// once the file is written. Headless, where the recording device reads back nothing, the
+	// generated scene's tiles are traced with the CPU on the first frame instead.
+	std::wstring m_tiledRenderPath;
+	DX::TiledRenderDesc m_tiledRenderDesc;
+	DX::TiledRenderer m_tiledRenderer;
+	DX::TextureReadback m_tileReadback;
+	DX::CpuCamera m_tiledRenderCamera;
+	UINT m_tiledRenderFrame;
+	UINT m_tileToCapture;
+
+	// -views [count] traces count cameras in one DispatchRays() as deep as there are views: the
+	// camera turned about its up axis through the look at point in even steps, each into a cell of
+	// a grid over the output, see MultiView. The render size is the cell's. -multiViewStats [prefix]
+	// traces the generated scene's views with the CPU batched and a frame per view, and writes the
+	// times, see MultiView::Analyze().
+	DX::MultiView m_multiView;
+	UINT m_viewCount;
+	std::wstring m_multiViewStatsPrefix;
 
 	// Shader tables
 	static const wchar_t* c_hitGroupName;
@@ -135,7 +294,7 @@ private:
 	StepTimer m_timer;
 
 	void RecreateD3D();
-	void DoRaytracing();
+	void DoRaytracing(ID3D12GraphicsCommandList* commandList);
 	void CreateDeviceDependentResources();
 	void CreateWindowSizeDependentResources();
 	void ReleaseDeviceDependentResources();
@@ -146,21 +305,40 @@ private:
 	void CreateLocalRootSignatureSubobjects(CD3DX12_STATE_OBJECT_DESC* raytracingPipeline);
 	void CreateRaytracingPipelineStateObject();
 	void CreateDescriptorHeap();
+	void CreateBufferAllocators();
 	void CreateRaytracingOutputResource();
 	void BuildGeometry();
 	void CreateConstantBuffers();
 	void BuildAccelerationStructures();
+	void BuildCpuAccelerationStructures();
+	void BuildCpuTracer(DX::CpuTracer* tracer) const;
+	DX::CpuCamera GetCpuCamera() const;
+	DX::Tonemapper GetTonemapper() const;
+	void WriteTraversalStatistics();
+	void WriteAdaptiveSampling();
+	void AnalyzeRayPatterns();
+	void RenderTilesOnCpu();
+	void WriteMultiViewStatistics();
+	void WriteRenderedTile(UINT tileIndex, const void* data, UINT rowPitch);
+	void SubmitCapturedFrame(UINT64 frameNumber, const void* data, UINT rowPitch);
 	void BuildShaderTables();
 	void UpdateForSizeChange(UINT clientWidth, UINT clientHeight);
-	void CopyRaytracingOutputToBackbuffer();
+	void CopyRaytracingOutputToBackbuffer(ID3D12GraphicsCommandList* commandList, ID3D12Resource* output);
+	void BuildRenderGraph();
 	void CalculateFrameStats();
-	UINT AllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* cpuDescriptor, UINT descriptorIndexToUse = UINT_MAX);
+	void WriteBenchmarkReport(double seconds);
+	void WriteRecordingReport();
 
 	// #DXR Extra: Perspective Camera
 	void updateCameraMatrices();
-	SceneConstantBuffer _sceneCB[FrameCount];
+	void UpdateAccumulation();
+	void UpdateDynamicResolution();
+	void UpdateMultiView();
+	void UpdateTiledRender();
+	void ResetAccumulation() { m_accumulationReset = true; }
+	SceneConstantBuffer _sceneCB[DX::FramePacer::c_maxFrameLatency];
 
 	void initializeScene();
 
-	UINT createBufferSRV(D3DBuffer *buffer, UINT numElements, UINT elementSize);
+	void createBufferSRV(D3DBuffer *buffer, const DX::DescriptorRange &descriptors, UINT descriptorOffset, UINT numElements, UINT elementSize);
 };
@@ -22,6 +22,8 @@ DXSample::DXSample(UINT width, UINT height, std::wstring name) :
 	m_title(name),
 	m_aspectRatio(0.0f),
 	m_enableUI(true),
+	m_headless(false),
+	m_headlessFrameCount(100),
 	m_adapterIDoverride(UINT_MAX)
 {
 	WCHAR assetsPath[512];
@@ -108,6 +110,17 @@ void DXSample::ParseCommandLineArgs(WCHAR* argv[], int argc)
 			m_adapterIDoverride = _wtoi(argv[i + 1]);
 			i++;
 		}
+		// -headless [frameCount]
+		else if (_wcsnicmp(argv[i], L"-headless", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/headless", wcslen(argv[i])) == 0)
+		{
+			m_headless = true;
+			if (i + 1 < argc && iswdigit(argv[i + 1][0]))
+			{
+				m_headlessFrameCount = _wtoi(argv[i + 1]);
+				i++;
+			}
+		}
 	}
 
 }
@@ -48,6 +48,8 @@ public:
 	RECT GetWindowsBounds() const { return m_windowBounds; }
 	virtual IDXGISwapChain* GetSwapchain() { return nullptr; }
 	DX::DeviceResources* GetDeviceResources() const { return m_deviceResources.get(); }
+	bool IsHeadless() const { return m_headless; }
+	UINT GetHeadlessFrameCount() const { return m_headlessFrameCount; }
 
 	void UpdateForSizeChange(UINT clientWidth, UINT clientHeight);
 	void SetWindowBounds(int left, int top, int right, int bottom);
@@ -71,6 +73,10 @@ protected:
 	// Override to be able to start without Dx11on12 UI for PIX. PIX doesn't support 11 on 12. 
 	bool m_enableUI;
 
+	// Run a fixed number of frames without a window on the recording device.
+	bool m_headless;
+	UINT m_headlessFrameCount;
+
 	// D3D device resources
 	UINT m_adapterIDoverride;
 	std::unique_ptr<DX::DeviceResources> m_deviceResources;
@@ -0,0 +1,180 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "DescriptorHeapAllocator.h"
+
+using namespace DX;
+
+DescriptorHeapAllocator::DescriptorHeapAllocator() :
+    m_cpuBase{},
+    m_gpuBase{},
+    m_descriptorSize(0),
+    m_persistentCount(0),
+    m_persistentAllocated(0),
+    m_transientCountPerFrame(0),
+    m_frameCount(0),
+    m_frameIndex(0),
+    m_transientAllocated(0)
+{
+}
+
+void DescriptorHeapAllocator::Create(ID3D12Device* device, UINT persistentCount, UINT transientCountPerFrame, UINT frameCount, LPCWSTR name)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
+    descriptorHeapDesc.NumDescriptors = persistentCount + transientCountPerFrame * frameCount;
+    descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    descriptorHeapDesc.NodeMask = 0;
+    ThrowIfFailed(device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_heap)));
+    if (name)
+    {
+        m_heap->SetName(name);
+    }
+
+    Initialize(
+        m_heap->GetCPUDescriptorHandleForHeapStart(),
+        m_heap->GetGPUDescriptorHandleForHeapStart(),
+        device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV),
+        persistentCount, transientCountPerFrame, frameCount);
+}
+
+void DescriptorHeapAllocator::Initialize(D3D12_CPU_DESCRIPTOR_HANDLE cpuBase, D3D12_GPU_DESCRIPTOR_HANDLE gpuBase, UINT descriptorSize,
+    UINT persistentCount, UINT transientCountPerFrame, UINT frameCount)
+{
+    ThrowIfFalse(frameCount > 0 && descriptorSize > 0);
+
+    m_cpuBase = cpuBase;
+    m_gpuBase = gpuBase;
+    m_descriptorSize = descriptorSize;
+
+    m_persistentCount = persistentCount;
+    m_persistentAllocated = 0;
+    m_freeRanges.clear();
+    if (persistentCount > 0)
+    {
+        m_freeRanges.push_back({ 0, persistentCount });
+    }
+
+    m_transientCountPerFrame = transientCountPerFrame;
+    m_frameCount = frameCount;
+    m_frameIndex = 0;
+    m_transientAllocated = 0;
+}
+
+void DescriptorHeapAllocator::Release()
+{
+    m_heap.Reset();
+    m_cpuBase = {};
+    m_gpuBase = {};
+    m_persistentCount = 0;
+    m_persistentAllocated = 0;
+    m_freeRanges.clear();
+    m_transientCountPerFrame = 0;
+    m_frameIndex = 0;
+    m_transientAllocated = 0;
+}
+
+DescriptorRange DescriptorHeapAllocator::GetRange(UINT index, UINT count) const
+{
+    DescriptorRange range;
+    range.index = index;
+    range.count = count;
+    range.descriptorSize = m_descriptorSize;
+    range.cpuHandle.ptr = m_cpuBase.ptr + static_cast<SIZE_T>(index) * m_descriptorSize;
+    range.gpuHandle.ptr = m_gpuBase.ptr + static_cast<UINT64>(index) * m_descriptorSize;
+    return range;
+}
+
+// First fit over the free-list. Static allocations are few and long lived,
+// so a linear scan stays cheap while keeping fragmentation low.
+DescriptorRange DescriptorHeapAllocator::AllocatePersistent(UINT count)
+{
+    ThrowIfFalse(count > 0);
+
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+    {
+        if (it->count >= count)
+        {
+            UINT index = it->start;
+            it->start += count;
+            it->count -= count;
+            if (it->count == 0)
+            {
+                m_freeRanges.erase(it);
+            }
+            m_persistentAllocated += count;
+            return GetRange(index, count);
+        }
+    }
+
+    ThrowIfFalse(false, L"ERROR: Persistent descriptor heap region exhausted, increase its size with -descriptorHeapSize.\n");
+    return DescriptorRange();
+}
+
+void DescriptorHeapAllocator::FreePersistent(const DescriptorRange& range)
+{
+    if (!range.IsValid())
+    {
+        return;
+    }
+    ThrowIfFalse(range.index + range.count <= m_persistentCount, L"Descriptor range was not allocated from the persistent region.\n");
+
+    // Insert sorted, then merge with the neighbours on either side.
+    auto next = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), range.index,
+        [](const FreeRange& r, UINT start) { return r.start < start; });
+    auto it = m_freeRanges.insert(next, { range.index, range.count });
+
+    auto following = it + 1;
+    if (following != m_freeRanges.end() && it->start + it->count == following->start)
+    {
+        it->count += following->count;
+        m_freeRanges.erase(following);
+    }
+    if (it != m_freeRanges.begin())
+    {
+        auto previous = it - 1;
+        if (previous->start + previous->count == it->start)
+        {
+            previous->count += it->count;
+            m_freeRanges.erase(it);
+        }
+    }
+
+    m_persistentAllocated -= range.count;
+}
+
+UINT DescriptorHeapAllocator::GetLargestFreePersistentRange() const
+{
+    UINT largest = 0;
+    for (const auto& r : m_freeRanges)
+    {
+        largest = std::max(largest, r.count);
+    }
+    return largest;
+}
+
+void DescriptorHeapAllocator::BeginFrame(UINT frameIndex)
+{
+    ThrowIfFalse(frameIndex < m_frameCount);
+    m_frameIndex = frameIndex;
+    m_transientAllocated = 0;
+}
+
+DescriptorRange DescriptorHeapAllocator::AllocateTransient(UINT count)
+{
+    ThrowIfFalse(count > 0);
+    ThrowIfFalse(m_transientAllocated + count <= m_transientCountPerFrame, L"ERROR: Transient descriptor ring exhausted for this frame.\n");
+
+    UINT index = m_persistentCount + m_frameIndex * m_transientCountPerFrame + m_transientAllocated;
+    m_transientAllocated += count;
+    return GetRange(index, count);
+}
@@ -0,0 +1,110 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// DescriptorHeapAllocator.h - Sub-allocation of a shader visible CBV/SRV/UAV descriptor heap
+//
+
+#pragma once
+
+namespace DX
+{
+    // A contiguous run of descriptors handed out by DescriptorHeapAllocator.
+    struct DescriptorRange
+    {
+        UINT                        index;
+        UINT                        count;
+        UINT                        descriptorSize;
+        D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;
+        D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+
+        DescriptorRange() : index(UINT_MAX), count(0), descriptorSize(0), cpuHandle{}, gpuHandle{} {}
+
+        bool IsValid() const { return count != 0; }
+
+        D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(UINT offset = 0) const
+        {
+            return D3D12_CPU_DESCRIPTOR_HANDLE{ cpuHandle.ptr + static_cast<SIZE_T>(offset) * descriptorSize };
+        }
+        D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(UINT offset = 0) const
+        {
+            return D3D12_GPU_DESCRIPTOR_HANDLE{ gpuHandle.ptr + static_cast<UINT64>(offset) * descriptorSize };
+        }
+    };
+
+    // Splits one descriptor heap into a persistent region followed by a transient ring:
+    //
+    //   [ persistent (free-list) | frame 0 transient | frame 1 transient | ... ]
+    //
+    // Persistent ranges are used for static resources and live until freed. Freed ranges are
+    // coalesced, and any allocation can span several descriptors so descriptor tables such as
+    // the index/vertex buffer pair always get adjacent slots.
+    // Transient descriptors are bump allocated from the current frame's slice and recycled in
+    // bulk by BeginFrame once the GPU is done with that frame.
+    //
+    // Only the heap base handles and increment size are needed, so the allocator can be laid
+    // over a mock heap through Initialize().
+    class DescriptorHeapAllocator
+    {
+    public:
+        DescriptorHeapAllocator();
+
+        // Creates a shader visible heap sized for the given layout.
+        void Create(ID3D12Device* device, UINT persistentCount, UINT transientCountPerFrame, UINT frameCount, LPCWSTR name = nullptr);
+        // Lays the allocator over an existing heap described by its base handles.
+        void Initialize(D3D12_CPU_DESCRIPTOR_HANDLE cpuBase, D3D12_GPU_DESCRIPTOR_HANDLE gpuBase, UINT descriptorSize,
+            UINT persistentCount, UINT transientCountPerFrame, UINT frameCount);
+        void Release();
+
+        DescriptorRange AllocatePersistent(UINT count = 1);
+        void FreePersistent(const DescriptorRange& range);
+
+        // Recycles the transient slice of frameIndex. The caller must ensure the GPU is done with it.
+        void BeginFrame(UINT frameIndex);
+        DescriptorRange AllocateTransient(UINT count = 1);
+
+        // Returns a range view over already allocated descriptors.
+        DescriptorRange GetRange(UINT index, UINT count = 1) const;
+
+        // Accessors.
+        ID3D12DescriptorHeap*       GetHeap() const { return m_heap.Get(); }
+        UINT                        GetDescriptorSize() const { return m_descriptorSize; }
+        UINT                        GetNumDescriptors() const { return m_persistentCount + m_transientCountPerFrame * m_frameCount; }
+        UINT                        GetPersistentCapacity() const { return m_persistentCount; }
+        UINT                        GetPersistentAllocatedCount() const { return m_persistentAllocated; }
+        UINT                        GetLargestFreePersistentRange() const;
+        UINT                        GetTransientCapacity() const { return m_transientCountPerFrame; }
+        UINT                        GetTransientAllocatedCount() const { return m_transientAllocated; }
+
+    private:
+        struct FreeRange
+        {
+            UINT start;
+            UINT count;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>    m_heap;
+        D3D12_CPU_DESCRIPTOR_HANDLE                     m_cpuBase;
+        D3D12_GPU_DESCRIPTOR_HANDLE                     m_gpuBase;
+        UINT                                            m_descriptorSize;
+
+        // Persistent region, free ranges are kept sorted by start and coalesced.
+        UINT                                            m_persistentCount;
+        UINT                                            m_persistentAllocated;
+        std::vector<FreeRange>                          m_freeRanges;
+
+        // Transient ring, one slice per frame.
+        UINT                                            m_transientCountPerFrame;
+        UINT                                            m_frameCount;
+        UINT                                            m_frameIndex;
+        UINT                                            m_transientAllocated;
+    };
+}
@@ -12,6 +12,7 @@
 #include "stdafx.h"
 #include "DeviceResources.h"
 #include "Win32Application.h"
+#include "RecordingDevice.h"
 
 using namespace DX;
 using namespace std;
@@ -20,6 +21,13 @@ using Microsoft::WRL::ComPtr;
 
 namespace
 {
+    inline UINT64 GetTicks()
+    {
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        return ticks.QuadPart;
+    }
+
     inline DXGI_FORMAT NoSRGB(DXGI_FORMAT fmt)
     {
         switch (fmt)
@@ -35,13 +43,15 @@ namespace
 // Constructor for DeviceResources.
 DeviceResources::DeviceResources(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, UINT backBufferCount, D3D_FEATURE_LEVEL minFeatureLevel, UINT flags, UINT adapterIDoverride) :
     m_backBufferIndex(0),
-    m_fenceValues{},
+    m_frameIndex(0),
+    m_nextFenceValue(1),
     m_rtvDescriptorSize(0),
     m_screenViewport{},
     m_scissorRect{},
     m_backBufferFormat(backBufferFormat),
     m_depthBufferFormat(depthBufferFormat),
     m_backBufferCount(backBufferCount),
+    m_frameCount(backBufferCount),
     m_d3dMinFeatureLevel(minFeatureLevel),
     m_window(nullptr),
     m_d3dFeatureLevel(D3D_FEATURE_LEVEL_11_0),
@@ -50,7 +60,8 @@ DeviceResources::DeviceResources(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depth
     m_deviceNotify(nullptr),
     m_isWindowVisible(true),
     m_adapterIDoverride(adapterIDoverride),
-    m_adapterID(UINT_MAX)
+    m_adapterID(UINT_MAX),
+    m_recordingThreadCount(1)
 {
     if (backBufferCount > MAX_BACK_BUFFER_COUNT)
     {
@@ -65,18 +76,41 @@ DeviceResources::DeviceResources(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depth
     {
         m_options |= c_AllowTearing;
     }
+    if (m_options & c_RecordingDevice)
+    {
+        m_recordingStatistics = make_shared<RecordingStatistics>();
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_ticksPerSecond = frequency.QuadPart;
 }
 
 // Destructor for DeviceResources.
 DeviceResources::~DeviceResources()
 {
     // Ensure that the GPU is no longer referencing resources that are about to be destroyed.
-    WaitForGpu();
+    // A completion callback that throws can't be reported from a destructor.
+    try
+    {
+        WaitForGpu();
+    }
+    catch (...)
+    {
+    }
 }
 
 // Configures DXGI Factory and retrieve an adapter.
 void DeviceResources::InitializeDXGIAdapter()
 {
+    if (m_options & c_RecordingDevice)
+    {
+        // No factory, adapter or swap chain, so no tearing either.
+        m_options &= ~(c_AllowTearing | c_RequireTearingSupport);
+        m_adapterDescription = L"Recording device";
+        return;
+    }
+
     bool debugDXGI = false;
 
 #if defined(_DEBUG)
@@ -141,7 +175,14 @@ void DeviceResources::InitializeDXGIAdapter()
 void DeviceResources::CreateDeviceResources()
 {
     // Create the DX12 API device object.
-    ThrowIfFailed(D3D12CreateDevice(m_adapter.Get(), m_d3dMinFeatureLevel, IID_PPV_ARGS(&m_d3dDevice)));
+    if (m_options & c_RecordingDevice)
+    {
+        ThrowIfFailed(CreateRecordingDevice(m_recordingStatistics, IID_PPV_ARGS(&m_d3dDevice)));
+    }
+    else
+    {
+        ThrowIfFailed(D3D12CreateDevice(m_adapter.Get(), m_d3dMinFeatureLevel, IID_PPV_ARGS(&m_d3dDevice)));
+    }
 
 #ifndef NDEBUG
     // Configure debug device (if active).
@@ -213,8 +254,8 @@ void DeviceResources::CreateDeviceResources()
         ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(&dsvDescriptorHeapDesc, IID_PPV_ARGS(&m_dsvDescriptorHeap)));
     }
 
-    // Create a command allocator for each back buffer that will be rendered to.
-    for (UINT n = 0; n < m_backBufferCount; n++)
+    // Create a command allocator for each frame that can be in flight.
+    for (UINT n = 0; n < m_frameCount; n++)
     {
         ThrowIfFailed(m_d3dDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocators[n])));
     }
@@ -223,9 +264,14 @@ void DeviceResources::CreateDeviceResources()
     ThrowIfFailed(m_d3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
     ThrowIfFailed(m_commandList->Close());
 
-    // Create a fence for tracking GPU execution progress.
-    ThrowIfFailed(m_d3dDevice->CreateFence(m_fenceValues[m_backBufferIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-    m_fenceValues[m_backBufferIndex]++;
+    m_commandListPool.Initialize(m_d3dDevice.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT, m_frameCount, m_recordingThreadCount);
+
+    // Create a fence for tracking GPU execution progress. It starts at the last value signaled,
+    // so after a device loss whatever was submitted to the old device counts as complete.
+    ThrowIfFailed(m_d3dDevice->CreateFence(m_nextFenceValue - 1, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+    m_framePacer.Update(m_nextFenceValue - 1, GetTicks());
+    m_framePacer.Initialize(m_frameCount, m_ticksPerSecond);
+    m_frameIndex = 0;
 
     m_fenceEvent.Attach(CreateEvent(nullptr, FALSE, FALSE, nullptr));
     if (!m_fenceEvent.IsValid())
@@ -237,7 +283,7 @@ void DeviceResources::CreateDeviceResources()
 // These resources need to be recreated every time the window size is changed.
 void DeviceResources::CreateWindowSizeDependentResources()
 {
-    if (!m_window)
+    if (!m_window && !(m_options & c_RecordingDevice))
     {
         ThrowIfFailed(E_HANDLE, L"Call SetWindow with a valid Win32 window handle.\n");
     }
@@ -245,11 +291,10 @@ void DeviceResources::CreateWindowSizeDependentResources()
     // Wait until all previous GPU work is complete.
     WaitForGpu();
 
-    // Release resources that are tied to the swap chain and update fence values.
+    // Release resources that are tied to the swap chain.
     for (UINT n = 0; n < m_backBufferCount; n++)
     {
         m_renderTargets[n].Reset();
-        m_fenceValues[n] = m_fenceValues[m_backBufferIndex];
     }
 
     // Determine the render target size in pixels.
@@ -288,7 +333,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
             ThrowIfFailed(hr);
         }
     }
-    else
+    else if (!(m_options & c_RecordingDevice))
     {
         // Create a descriptor for the swap chain.
         DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
@@ -339,7 +384,17 @@ void DeviceResources::CreateWindowSizeDependentResources()
     // and create render target views for each of them.
     for (UINT n = 0; n < m_backBufferCount; n++)
     {
-        ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+        if (m_swapChain)
+        {
+            ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+        }
+        else
+        {
+            // Without a swap chain the back buffers are plain render target textures.
+            CD3DX12_HEAP_PROPERTIES backBufferHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+            D3D12_RESOURCE_DESC backBufferDesc = CD3DX12_RESOURCE_DESC::Tex2D(backBufferFormat, backBufferWidth, backBufferHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+            ThrowIfFailed(m_d3dDevice->CreateCommittedResource(&backBufferHeapProperties, D3D12_HEAP_FLAG_NONE, &backBufferDesc, D3D12_RESOURCE_STATE_PRESENT, nullptr, IID_PPV_ARGS(&m_renderTargets[n])));
+        }
 
         wchar_t name[25] = {};
         swprintf_s(name, L"Render target %u", n);
@@ -354,7 +409,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
     }
 
     // Reset the index to the current back buffer.
-    m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    m_backBufferIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex() : 0;
 
     if (m_depthBufferFormat != DXGI_FORMAT_UNKNOWN)
     {
@@ -451,15 +506,20 @@ void DeviceResources::HandleDeviceLost()
         m_deviceNotify->OnDeviceLost();
     }
 
-    for (UINT n = 0; n < m_backBufferCount; n++)
+    for (UINT n = 0; n < m_frameCount; n++)
     {
         m_commandAllocators[n].Reset();
+    }
+    for (UINT n = 0; n < m_backBufferCount; n++)
+    {
         m_renderTargets[n].Reset();
     }
 
     m_depthStencil.Reset();
     m_commandQueue.Reset();
     m_commandList.Reset();
+    m_commandListPool.Release();
+    m_queuedCommandLists.clear();
     m_fence.Reset();
     m_rtvDescriptorHeap.Reset();
     m_dsvDescriptorHeap.Reset();
@@ -488,16 +548,18 @@ void DeviceResources::HandleDeviceLost()
 }
 
 // Prepare the command list and render target for rendering.
-void DeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState)
+void DeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState)
 {
-    // Reset command list and allocator.
-    ThrowIfFailed(m_commandAllocators[m_backBufferIndex]->Reset());
-    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].Get(), nullptr));
+    // Wait until the frame's resources are no longer in use, then reset command list and allocator.
+    WaitForFrame();
+    ThrowIfFailed(m_commandAllocators[m_frameIndex]->Reset());
+    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_frameIndex].Get(), nullptr));
+    m_commandListPool.BeginFrame(m_frameIndex);
 
-    if (beforeState != D3D12_RESOURCE_STATE_RENDER_TARGET)
+    if (beforeState != afterState)
     {
         // Transition the render target into the correct state to allow for drawing into it.
-        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_backBufferIndex].Get(), beforeState, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_backBufferIndex].Get(), beforeState, afterState);
         m_commandList->ResourceBarrier(1, &barrier);
     }
 }
@@ -508,14 +570,29 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
     if (beforeState != D3D12_RESOURCE_STATE_PRESENT)
     {
         // Transition the render target to the state that allows it to be presented to the display.
+        // The main command list runs first, after queued lists the transition needs a list of its own.
         D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_backBufferIndex].Get(), beforeState, D3D12_RESOURCE_STATE_PRESENT);
-        m_commandList->ResourceBarrier(1, &barrier);
+        if (m_queuedCommandLists.empty())
+        {
+            m_commandList->ResourceBarrier(1, &barrier);
+        }
+        else
+        {
+            ID3D12GraphicsCommandList* commandList = m_commandListPool.Acquire(0);
+            commandList->ResourceBarrier(1, &barrier);
+            ThrowIfFailed(commandList->Close());
+            m_queuedCommandLists.push_back(commandList);
+        }
     }
 
     ExecuteCommandList();
 
-    HRESULT hr;
-    if (m_options & c_AllowTearing)
+    HRESULT hr = S_OK;
+    if (!m_swapChain)
+    {
+        // The recording device has nothing to present to.
+    }
+    else if (m_options & c_AllowTearing)
     {
         // Recommended to always use tearing if supported when using a sync interval of 0.
         // Note this will fail if in true 'fullscreen' mode.
@@ -544,6 +621,11 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
         ThrowIfFailed(hr);
 
         MoveToNextFrame();
+
+        if (m_recordingStatistics)
+        {
+            m_recordingStatistics->EndFrame();
+        }
     }
 }
 
@@ -551,50 +633,123 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
 void DeviceResources::ExecuteCommandList()
 {
     ThrowIfFailed(m_commandList->Close());
-    ID3D12CommandList *commandLists[] = { m_commandList.Get() }; 
-    m_commandQueue->ExecuteCommandLists(ARRAYSIZE(commandLists), commandLists);
+    m_queuedCommandLists.insert(m_queuedCommandLists.begin(), m_commandList.Get());
+    m_commandQueue->ExecuteCommandLists(static_cast<UINT>(m_queuedCommandLists.size()), m_queuedCommandLists.data());
+    m_queuedCommandLists.clear();
+}
+
+void DeviceResources::QueueCommandLists(UINT count, ID3D12CommandList* const* commandLists)
+{
+    m_queuedCommandLists.insert(m_queuedCommandLists.end(), commandLists, commandLists + count);
 }
 
-// Wait for pending GPU work to complete.
-void DeviceResources::WaitForGpu() noexcept
+// Wait for pending GPU work to complete. Completion callbacks run here and may throw.
+void DeviceResources::WaitForGpu()
 {
     if (m_commandQueue && m_fence && m_fenceEvent.IsValid())
     {
         // Schedule a Signal command in the GPU queue.
-        UINT64 fenceValue = m_fenceValues[m_backBufferIndex];
+        UINT64 fenceValue = m_nextFenceValue;
         if (SUCCEEDED(m_commandQueue->Signal(m_fence.Get(), fenceValue)))
         {
-            // Wait until the Signal has been processed.
-            if (SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent.Get())))
+            m_nextFenceValue++;
+            if (m_options & c_RecordingDevice)
             {
-                WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
-
-                // Increment the fence value for the current frame.
-                m_fenceValues[m_backBufferIndex]++;
+                m_simulatedFence.Signal(fenceValue, GetTicks());
             }
+
+            // Wait until the Signal has been processed.
+            WaitForFence(fenceValue);
         }
     }
 }
 
+void DeviceResources::SetMaxFrameLatency(UINT frameLatency)
+{
+    ThrowIfFalse(frameLatency > 0 && frameLatency <= FramePacer::c_maxFrameLatency, L"DeviceResources: max frame latency out of range.\n");
+    m_frameCount = frameLatency;
+}
+
+bool DeviceResources::IsFrameReady()
+{
+    m_framePacer.Update(GetCompletedFenceValue(), GetTicks());
+    return m_framePacer.CanBeginFrame();
+}
+
+void DeviceResources::OnGpuCompletion(const FramePacer::Callback& callback)
+{
+    // The next value signaled follows everything submitted until then.
+    m_framePacer.OnCompletion(m_nextFenceValue, callback);
+}
+
+void DeviceResources::SetSimulatedGpuFrameTime(double milliseconds)
+{
+    m_simulatedFence.SetDuration(static_cast<UINT64>(max(milliseconds, 0.0) * m_ticksPerSecond / 1000.0));
+}
+
 // Prepare to render the next frame.
 void DeviceResources::MoveToNextFrame()
 {
-    // Schedule a Signal command in the queue.
-    const UINT64 currentFenceValue = m_fenceValues[m_backBufferIndex];
-    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), currentFenceValue));
+    // Schedule a Signal command in the queue, the frame is complete once it has been processed.
+    const UINT64 fenceValue = m_nextFenceValue++;
+    ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fenceValue));
 
-    // Update the back buffer index.
-    m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    UINT64 ticks = GetTicks();
+    if (m_options & c_RecordingDevice)
+    {
+        m_simulatedFence.Signal(fenceValue, ticks);
+    }
+    m_framePacer.FrameSubmitted(fenceValue, ticks);
+    m_framePacer.Update(GetCompletedFenceValue(), ticks);
+
+    // Update the back buffer and frame indices. Waiting for the next frame's resources is left to
+    // Prepare(), so the CPU can get on with the next frame until it needs them.
+    m_backBufferIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex() : (m_backBufferIndex + 1) % m_backBufferCount;
+    m_frameIndex = (m_frameIndex + 1) % m_frameCount;
+}
+
+// If the current frame's resources are still in use by the GPU, wait until they are free.
+void DeviceResources::WaitForFrame()
+{
+    m_framePacer.Update(GetCompletedFenceValue(), GetTicks());
 
-    // If the next frame is not ready to be rendered yet, wait until it is ready.
-    if (m_fence->GetCompletedValue() < m_fenceValues[m_backBufferIndex])
+    UINT64 fenceValue = m_framePacer.GetFenceValueToWaitFor();
+    if (fenceValue != 0)
+    {
+        WaitForFence(fenceValue);
+    }
+}
+
+// Blocks until fenceValue has been reached, the frame pacer sees it as soon as it is.
+void DeviceResources::WaitForFence(UINT64 fenceValue)
+{
+    if (m_fence->GetCompletedValue() < fenceValue &&
+        SUCCEEDED(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent.Get())))
     {
-        ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValues[m_backBufferIndex], m_fenceEvent.Get()));
         WaitForSingleObjectEx(m_fenceEvent.Get(), INFINITE, FALSE);
     }
 
-    // Set the fence value for the next frame.
-    m_fenceValues[m_backBufferIndex] = currentFenceValue + 1;
+    if (m_options & c_RecordingDevice)
+    {
+        // Spin rather than sleep, the simulated frame time shouldn't depend on the timer resolution.
+        UINT64 completionTicks = m_simulatedFence.GetCompletionTicks(fenceValue);
+        while (GetTicks() < completionTicks)
+        {
+            SwitchToThread();
+        }
+    }
+
+    m_framePacer.Update(GetCompletedFenceValue(), GetTicks());
+}
+
+UINT64 DeviceResources::GetCompletedFenceValue()
+{
+    UINT64 completedValue = m_fence->GetCompletedValue();
+    if (m_options & c_RecordingDevice)
+    {
+        completedValue = min<UINT64>(completedValue, m_simulatedFence.GetCompletedValue(GetTicks()));
+    }
+    return completedValue;
 }
 
 // This method acquires the first available hardware adapter that supports Direct3D 12.
@@ -15,8 +15,13 @@
 
 #pragma once
 
+#include "CommandListPool.h"
+#include "FramePacer.h"
+
 namespace DX
 {
+    class RecordingStatistics;
+
     // Provides an interface for an application that owns DeviceResources to be notified of the device being lost or created.
     interface IDeviceNotify
     {
@@ -31,6 +36,7 @@ namespace DX
     public:
         static const unsigned int c_AllowTearing = 0x1;
         static const unsigned int c_RequireTearingSupport = 0x2;
+        static const unsigned int c_RecordingDevice = 0x4;     // Records API calls instead of using an adapter, see RecordingDevice.h.
 
         DeviceResources(DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM,
             DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT,
@@ -42,6 +48,14 @@ namespace DX
 
         void InitializeDXGIAdapter();
         void SetAdapterOverride(UINT adapterID) { m_adapterIDoverride = adapterID; }
+        // Threads that record into the command list pool, takes effect in CreateDeviceResources().
+        void SetRecordingThreadCount(UINT threadCount) { m_recordingThreadCount = max(threadCount, 1u); }
+        // Frames the CPU may run ahead of the GPU, counting the one being recorded. Each has its own
+        // command allocators, so this is also the number of frame indices. Defaults to the back buffer
+        // count and takes effect in CreateDeviceResources().
+        void SetMaxFrameLatency(UINT frameLatency);
+        // Makes the recording device's fence complete as if each frame kept a GPU busy this long.
+        void SetSimulatedGpuFrameTime(double milliseconds);
         void CreateDeviceResources();
         void CreateWindowSizeDependentResources();
         void SetWindow(HWND window, int width, int height);
@@ -65,15 +79,24 @@ namespace DX
             }
         }
 
-        void Prepare(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_PRESENT);
+        // Leaves the back buffer alone when afterState is beforeState, for callers that track its state themselves.
+        void Prepare(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_RENDER_TARGET);
         void Present(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_RENDER_TARGET);
         void ExecuteCommandList();
-        void WaitForGpu() noexcept;
+        // Submits commandLists with the next ExecuteCommandList(), in one batch after the main command list.
+        void QueueCommandLists(UINT count, ID3D12CommandList* const* commandLists);
+        void WaitForGpu();
+        // Polls the fence without blocking, true when Prepare() won't have to wait for the GPU.
+        bool IsFrameReady();
+        // Runs callback once the GPU has finished all work submitted so far, including the frame
+        // being recorded. Callbacks run on this thread, from Prepare(), WaitForGpu() and polling.
+        void OnGpuCompletion(const FramePacer::Callback& callback);
 
         // Device Accessors.
         RECT GetOutputSize() const { return m_outputSize; }
         bool IsWindowVisible() const { return m_isWindowVisible; }
         bool IsTearingSupported() const { return m_options & c_AllowTearing; }
+        bool IsRecordingDevice() const { return (m_options & c_RecordingDevice) != 0; }
 
         // Direct3D Accessors.
         IDXGIAdapter1*              GetAdapter() const { return m_adapter.Get(); }
@@ -84,18 +107,22 @@ namespace DX
         ID3D12Resource*             GetRenderTarget() const { return m_renderTargets[m_backBufferIndex].Get(); }
         ID3D12Resource*             GetDepthStencil() const { return m_depthStencil.Get(); }
         ID3D12CommandQueue*         GetCommandQueue() const { return m_commandQueue.Get(); }
-        ID3D12CommandAllocator*     GetCommandAllocator() const { return m_commandAllocators[m_backBufferIndex].Get(); }
+        ID3D12CommandAllocator*     GetCommandAllocator() const { return m_commandAllocators[m_frameIndex].Get(); }
         ID3D12GraphicsCommandList*  GetCommandList() const { return m_commandList.Get(); }
+        CommandListPool&            GetCommandListPool() { return m_commandListPool; }
         DXGI_FORMAT                 GetBackBufferFormat() const { return m_backBufferFormat; }
         DXGI_FORMAT                 GetDepthBufferFormat() const { return m_depthBufferFormat; }
         D3D12_VIEWPORT              GetScreenViewport() const { return m_screenViewport; }
         D3D12_RECT                  GetScissorRect() const { return m_scissorRect; }
-        UINT                        GetCurrentFrameIndex() const { return m_backBufferIndex; }
-        UINT                        GetPreviousFrameIndex() const { return m_backBufferIndex == 0 ? m_backBufferCount - 1 : m_backBufferIndex - 1; }
+        UINT                        GetCurrentFrameIndex() const { return m_frameIndex; }
+        UINT                        GetPreviousFrameIndex() const { return m_frameIndex == 0 ? m_frameCount - 1 : m_frameIndex - 1; }
+        UINT                        GetFrameCount() const { return m_frameCount; }
         UINT                        GetBackBufferCount() const { return m_backBufferCount; }
+        const FramePacer&           GetFramePacer() const { return m_framePacer; }
         unsigned int                GetDeviceOptions() const { return m_options; }
         LPCWSTR                     GetAdapterDescription() const { return m_adapterDescription.c_str(); }
         UINT                        GetAdapterID() const { return m_adapterID; }
+        RecordingStatistics*        GetRecordingStatistics() const { return m_recordingStatistics.get(); }
 
         CD3DX12_CPU_DESCRIPTOR_HANDLE GetRenderTargetView() const
         {
@@ -108,12 +135,16 @@ namespace DX
 
     private:
         void MoveToNextFrame();
+        void WaitForFrame();
+        void WaitForFence(UINT64 fenceValue);
+        UINT64 GetCompletedFenceValue();
         void InitializeAdapter(IDXGIAdapter1** ppAdapter);
 
         const static size_t MAX_BACK_BUFFER_COUNT = 3;
 
         UINT                                                m_adapterIDoverride;
         UINT                                                m_backBufferIndex;
+        UINT                                                m_frameIndex;
 		Microsoft::WRL::ComPtr<IDXGIAdapter1>                               m_adapter;
         UINT                                                m_adapterID;
         std::wstring                                        m_adapterDescription;
@@ -122,7 +153,12 @@ namespace DX
         Microsoft::WRL::ComPtr<ID3D12Device>                m_d3dDevice;
         Microsoft::WRL::ComPtr<ID3D12CommandQueue>          m_commandQueue;
         Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>   m_commandList;
-        Microsoft::WRL::ComPtr<ID3D12CommandAllocator>      m_commandAllocators[MAX_BACK_BUFFER_COUNT];
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator>      m_commandAllocators[FramePacer::c_maxFrameLatency];
+
+        // Command lists recorded on other threads, submitted after m_commandList.
+        CommandListPool                                     m_commandListPool;
+        UINT                                                m_recordingThreadCount;
+        std::vector<ID3D12CommandList*>                     m_queuedCommandLists;
 
         // Swap chain objects.
         Microsoft::WRL::ComPtr<IDXGIFactory4>               m_dxgiFactory;
@@ -130,10 +166,13 @@ namespace DX
         Microsoft::WRL::ComPtr<ID3D12Resource>              m_renderTargets[MAX_BACK_BUFFER_COUNT];
         Microsoft::WRL::ComPtr<ID3D12Resource>              m_depthStencil;
 
-        // Presentation fence objects.
+        // Presentation fence objects. Fence values keep increasing across device loss.
         Microsoft::WRL::ComPtr<ID3D12Fence>                 m_fence;
-        UINT64                                              m_fenceValues[MAX_BACK_BUFFER_COUNT];
+        UINT64                                              m_nextFenceValue;
         Microsoft::WRL::Wrappers::Event                     m_fenceEvent;
+        FramePacer                                          m_framePacer;
+        SimulatedFenceTimeline                              m_simulatedFence;   // Recording device only.
+        UINT64                                              m_ticksPerSecond;
 
         // Direct3D rendering objects.
         Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>        m_rtvDescriptorHeap;
@@ -146,6 +185,7 @@ namespace DX
         DXGI_FORMAT                                         m_backBufferFormat;
         DXGI_FORMAT                                         m_depthBufferFormat;
         UINT                                                m_backBufferCount;
+        UINT                                                m_frameCount;
         D3D_FEATURE_LEVEL                                   m_d3dMinFeatureLevel;
 
         // Cached device properties.
@@ -159,5 +199,8 @@ namespace DX
 
         // The IDeviceNotify can be held directly as it owns the DeviceResources.
         IDeviceNotify*                                      m_deviceNotify;
+
+        // Outlives the recording device, so counts carry over a device lost.
+        std::shared_ptr<RecordingStatistics>                m_recordingStatistics;
     };
 }
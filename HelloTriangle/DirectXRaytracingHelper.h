@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include "LinearBufferAllocator.h"
+
 //added by stan
 
 // Helper to compute aligned buffer sizes
@@ -179,6 +181,14 @@ inline void AllocateUploadBuffer(ID3D12Device* pDevice, void *pData, UINT64 data
     (*ppResource)->Unmap(0, nullptr);
 }
 
+// Sub-allocate an upload buffer from a persistently mapped page instead of creating a committed resource per buffer.
+inline DX::BufferAllocation AllocateUploadBuffer(DX::LinearBufferAllocator* pAllocator, const void *pData, UINT64 datasize, UINT64 alignment)
+{
+    DX::BufferAllocation allocation = pAllocator->Allocate(datasize, alignment);
+    memcpy(allocation.cpuAddress, pData, datasize);
+    return allocation;
+}
+
 // Pretty-print a state object tree.
 inline void PrintStateObjectDesc(const D3D12_STATE_OBJECT_DESC* desc)
 {
@@ -0,0 +1,105 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "DynamicResolution.h"
+
+using namespace DX;
+using namespace std;
+
+DynamicResolution::DynamicResolution() :
+    m_outputWidth(0),
+    m_outputHeight(0),
+    m_renderWidth(0),
+    m_renderHeight(0),
+    m_scale(1.0f),
+    m_integral(0.0),
+    m_previousError(0.0),
+    m_hasPreviousError(false)
+{
+}
+
+void DynamicResolution::Reset(const DynamicResolutionDesc& desc, UINT outputWidth, UINT outputHeight)
+{
+    ThrowIfFalse(desc.targetMilliseconds >= 0.0, L"DynamicResolution: the target must not be negative.\n");
+    ThrowIfFalse(desc.minScale > 0.0f && desc.minScale <= desc.maxScale && desc.maxScale <= 1.0f,
+        L"DynamicResolution: scales must be in (0, 1], the minimum no larger than the maximum.\n");
+    m_desc = desc;
+    m_scale = desc.maxScale;
+    // The integral alone holds the output at maxScale.
+    m_integral = desc.integralGain > 0.0f ? 2.0 * log2(desc.maxScale) / desc.integralGain : 0.0;
+    m_previousError = 0.0;
+    m_hasPreviousError = false;
+    SetOutputSize(outputWidth, outputHeight);
+}
+
+void DynamicResolution::SetOutputSize(UINT outputWidth, UINT outputHeight)
+{
+    m_outputWidth = outputWidth;
+    m_outputHeight = outputHeight;
+    UpdateRenderSize();
+}
+
+bool DynamicResolution::Update(double milliseconds)
+{
+    if (!IsEnabled() || !(milliseconds > 0.0))
+    {
+        return false;
+    }
+
+    double error = log2(m_desc.targetMilliseconds / milliseconds);
+    double derivative = m_hasPreviousError ? error - m_previousError : 0.0;
+    m_previousError = error;
+    m_hasPreviousError = true;
+
+    double integral = m_integral + error;
+    double output = m_desc.proportionalGain * error + m_desc.integralGain * integral + m_desc.derivativeGain * derivative;
+    double lowest = 2.0 * log2(m_desc.minScale);
+    double highest = 2.0 * log2(m_desc.maxScale);
+    if (output < lowest || output > highest)
+    {
+        output = min(max(output, lowest), highest);
+        if (m_desc.integralGain > 0.0f)
+        {
+            integral = (output - m_desc.proportionalGain * error - m_desc.derivativeGain * derivative) / m_desc.integralGain;
+        }
+    }
+    m_integral = integral;
+    m_scale = static_cast<float>(exp2(0.5 * output));
+
+    // Measurement noise alone moves the size back and forth by a step, every change restarts
+    // the accumulation, so only moves of more than one step are taken.
+    UINT renderWidth = m_renderWidth;
+    UINT renderHeight = m_renderHeight;
+    UpdateRenderSize();
+    UINT step = max(m_desc.sizeAlignment, 1u);
+    auto Distance = [](UINT a, UINT b) { return a > b ? a - b : b - a; };
+    if (Distance(m_renderWidth, renderWidth) <= step && Distance(m_renderHeight, renderHeight) <= step)
+    {
+        m_renderWidth = renderWidth;
+        m_renderHeight = renderHeight;
+        return false;
+    }
+    return true;
+}
+
+void DynamicResolution::UpdateRenderSize()
+{
+    UINT alignment = max(m_desc.sizeAlignment, 1u);
+    auto RenderSize = [&](UINT outputSize)
+    {
+        UINT size = static_cast<UINT>(outputSize * m_scale + 0.5f);
+        size = (size + alignment / 2) / alignment * alignment;
+        return max(min(size, outputSize), min(alignment, outputSize));
+    };
+    m_renderWidth = IsEnabled() ? RenderSize(m_outputWidth) : m_outputWidth;
+    m_renderHeight = IsEnabled() ? RenderSize(m_outputHeight) : m_outputHeight;
+}
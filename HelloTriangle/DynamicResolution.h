@@ -0,0 +1,83 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// DynamicResolution.h - Pick a render resolution per frame from a GPU time target
+//
+
+#pragma once
+
+namespace DX
+{
+    struct DynamicResolutionDesc
+    {
+        DynamicResolutionDesc() :
+            targetMilliseconds(0.0),
+            minScale(0.5f),
+            maxScale(1.0f),
+            proportionalGain(0.1f),
+            integralGain(0.08f),
+            derivativeGain(0.02f),
+            sizeAlignment(8)
+        {
+        }
+
+        double  targetMilliseconds;     // 0 disables scaling, frames render at the output size.
+        float   minScale;               // Of the output size, per axis.
+        float   maxScale;
+        float   proportionalGain;
+        float   integralGain;
+        float   derivativeGain;
+        UINT    sizeAlignment;          // Render sizes are multiples of it, unless that is the output size,
+                                        // and change by more than one multiple at a time.
+    };
+
+    // A PID controller on the render area. The time of the resolution dependent work is taken to
+    // be proportional to the pixel count, so the controller works in log2 units: the error is
+    // log2(target / measured), the output log2 of the area as a fraction of the output area.
+    // With all gains 1 and no delay it would jump to the right size in one frame, the defaults
+    // are much lower because timestamps arrive frames late and single frames are noisy.
+    // The output is clamped to [minScale², maxScale²] and the integral is held where it produces
+    // the clamped value, so it doesn't wind up while the target is out of reach.
+    class DynamicResolution
+    {
+    public:
+        DynamicResolution();
+
+        // Starts at maxScale.
+        void Reset(const DynamicResolutionDesc& desc, UINT outputWidth, UINT outputHeight);
+        // Keeps the controller state, only the sizes change.
+        void SetOutputSize(UINT outputWidth, UINT outputHeight);
+        // One measured frame. Returns true when the render size changed.
+        bool Update(double milliseconds);
+
+        // Accessors.
+        bool    IsEnabled() const { return m_desc.targetMilliseconds > 0.0; }
+        UINT    GetRenderWidth() const { return m_renderWidth; }
+        UINT    GetRenderHeight() const { return m_renderHeight; }
+        float   GetScale() const { return m_scale; }
+        double  GetTargetMilliseconds() const { return m_desc.targetMilliseconds; }
+        const DynamicResolutionDesc& GetDesc() const { return m_desc; }
+
+    private:
+        void UpdateRenderSize();
+
+        DynamicResolutionDesc   m_desc;
+        UINT                    m_outputWidth;
+        UINT                    m_outputHeight;
+        UINT                    m_renderWidth;
+        UINT                    m_renderHeight;
+        float                   m_scale;            // Per axis, before alignment.
+        double                  m_integral;
+        double                  m_previousError;
+        bool                    m_hasPreviousError;
+    };
+}
@@ -0,0 +1,106 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "FrameConstantAllocator.h"
+
+using namespace DX;
+
+FrameConstantAllocator::FrameConstantAllocator() :
+    m_mappedData(nullptr),
+    m_gpuBase(0),
+    m_frameCount(0),
+    m_capacityPerFrame(0),
+    m_frameIndex(0),
+    m_offset(0),
+    m_peakBytes(0)
+{
+}
+
+FrameConstantAllocator::~FrameConstantAllocator()
+{
+    Release();
+}
+
+void FrameConstantAllocator::Create(ID3D12Device* device, UINT frameCount, UINT64 capacityPerFrame, LPCWSTR name)
+{
+    Release();
+
+    // Keep every slice start on a constant buffer boundary.
+    m_capacityPerFrame = (capacityPerFrame + BufferAlignment::ConstantBuffer - 1) & ~(BufferAlignment::ConstantBuffer - 1);
+    m_frameCount = frameCount;
+
+    auto uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_capacityPerFrame * frameCount);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &uploadHeapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_resource)));
+    if (name)
+    {
+        m_resource->SetName(name);
+    }
+
+    // We don't unmap this until the app closes. Keeping buffer mapped for the lifetime of resource is okay.
+    CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+    ThrowIfFailed(m_resource->Map(0, &readRange, reinterpret_cast<void**>(&m_mappedData)));
+    m_gpuBase = m_resource->GetGPUVirtualAddress();
+
+    m_frameIndex = 0;
+    m_offset = 0;
+    m_peakBytes = 0;
+}
+
+void FrameConstantAllocator::Release()
+{
+    if (m_resource && m_mappedData)
+    {
+        m_resource->Unmap(0, nullptr);
+    }
+    m_resource.Reset();
+    m_mappedData = nullptr;
+    m_gpuBase = 0;
+    m_offset = 0;
+}
+
+void FrameConstantAllocator::BeginFrame(UINT frameIndex)
+{
+    ThrowIfFalse(frameIndex < m_frameCount);
+    m_peakBytes = std::max(m_peakBytes, m_offset.load());
+    m_frameIndex = frameIndex;
+    m_offset = 0;
+}
+
+BufferAllocation FrameConstantAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+    ThrowIfFalse(m_mappedData != nullptr, L"FrameConstantAllocator used before Create().\n");
+
+    UINT64 offset = m_offset.load(std::memory_order_relaxed);
+    UINT64 alignedOffset;
+    do
+    {
+        alignedOffset = (offset + alignment - 1) / alignment * alignment;
+        ThrowIfFalse(alignedOffset + size <= m_capacityPerFrame, L"ERROR: Per-frame constant buffer space exhausted.\n");
+    } while (!m_offset.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed));
+
+    UINT64 bufferOffset = m_frameIndex * m_capacityPerFrame + alignedOffset;
+
+    BufferAllocation allocation;
+    allocation.resource = m_resource.Get();
+    allocation.offset = bufferOffset;
+    allocation.size = size;
+    allocation.gpuAddress = m_gpuBase + bufferOffset;
+    allocation.cpuAddress = m_mappedData + bufferOffset;
+    return allocation;
+}
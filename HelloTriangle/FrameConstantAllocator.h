@@ -0,0 +1,65 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// FrameConstantAllocator.h - Per-frame bump allocation of constant buffer data
+//
+
+#pragma once
+
+#include "LinearBufferAllocator.h"
+
+namespace DX
+{
+    // One persistently mapped upload buffer split into a slice per frame in flight.
+    // Constants for any number of draws or dispatches are bump allocated from the current
+    // frame's slice and bound by GPU address, e.g. with SetComputeRootConstantBufferView.
+    // A slice is only rewound by BeginFrame, after the caller has waited on that frame's fence.
+    class FrameConstantAllocator
+    {
+    public:
+        static const UINT64 c_defaultCapacityPerFrame = 64 * 1024;
+
+        FrameConstantAllocator();
+        ~FrameConstantAllocator();
+
+        void Create(ID3D12Device* device, UINT frameCount, UINT64 capacityPerFrame = c_defaultCapacityPerFrame, LPCWSTR name = nullptr);
+        void Release();
+
+        void BeginFrame(UINT frameIndex);
+
+        // Thread safe.
+        BufferAllocation Allocate(UINT64 size, UINT64 alignment = BufferAlignment::ConstantBuffer);
+
+        template <class T>
+        D3D12_GPU_VIRTUAL_ADDRESS Push(const T& constants)
+        {
+            BufferAllocation allocation = Allocate(sizeof(T));
+            memcpy(allocation.cpuAddress, &constants, sizeof(T));
+            return allocation.gpuAddress;
+        }
+
+        // Accessors.
+        UINT64  GetCapacityPerFrame() const { return m_capacityPerFrame; }
+        UINT64  GetAllocatedBytes() const { return m_offset.load(); }
+        UINT64  GetPeakAllocatedBytes() const { return m_peakBytes; }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Resource>  m_resource;
+        uint8_t*                                m_mappedData;
+        D3D12_GPU_VIRTUAL_ADDRESS               m_gpuBase;
+        UINT                                    m_frameCount;
+        UINT64                                  m_capacityPerFrame;
+        UINT                                    m_frameIndex;
+        std::atomic<UINT64>                     m_offset;
+        UINT64                                  m_peakBytes;
+    };
+}
@@ -0,0 +1,184 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "FramePacer.h"
+
+using namespace DX;
+using namespace std;
+
+FramePacer::FramePacer() :
+    m_maxFrameLatency(1),
+    m_ticksPerSecond(1),
+    m_completedValue(0),
+    m_completedFrameCount(0),
+    m_totalLatencyTicks(0),
+    m_maxLatencyTicks(0),
+    m_latencyBuckets{}
+{
+}
+
+void FramePacer::Initialize(UINT maxFrameLatency, UINT64 ticksPerSecond)
+{
+    ThrowIfFalse(maxFrameLatency > 0 && maxFrameLatency <= c_maxFrameLatency, L"FramePacer: max frame latency out of range.\n");
+    ThrowIfFalse(ticksPerSecond > 0, L"FramePacer: tick frequency must not be zero.\n");
+
+    m_maxFrameLatency = maxFrameLatency;
+    m_ticksPerSecond = ticksPerSecond;
+    m_completedValue = 0;
+    m_frames.clear();
+    m_callbacks.clear();
+    m_completedFrameCount = 0;
+    m_totalLatencyTicks = 0;
+    m_maxLatencyTicks = 0;
+    fill(begin(m_latencyBuckets), end(m_latencyBuckets), 0);
+}
+
+void FramePacer::FrameSubmitted(UINT64 fenceValue, UINT64 ticks)
+{
+    ThrowIfFalse(fenceValue > m_completedValue && (m_frames.empty() || fenceValue > m_frames.back().fenceValue),
+        L"FramePacer: fence values must increase.\n");
+
+    m_frames.push_back({ fenceValue, ticks });
+}
+
+void FramePacer::Update(UINT64 completedValue, UINT64 ticks)
+{
+    if (completedValue <= m_completedValue)
+    {
+        return;
+    }
+    m_completedValue = completedValue;
+
+    while (!m_frames.empty() && m_frames.front().fenceValue <= completedValue)
+    {
+        UINT64 latency = ticks > m_frames.front().submitTicks ? ticks - m_frames.front().submitTicks : 0;
+        m_frames.pop_front();
+
+        UINT bucket = min<UINT64>(static_cast<UINT64>(TicksToMilliseconds(latency)), c_latencyBucketCount - 1);
+        m_latencyBuckets[bucket]++;
+        m_totalLatencyTicks += latency;
+        m_maxLatencyTicks = max(m_maxLatencyTicks, latency);
+        m_completedFrameCount++;
+    }
+
+    // Take the callbacks out first, they may register new ones.
+    auto reached = m_callbacks.upper_bound(completedValue);
+    vector<Callback> callbacks;
+    for (auto it = m_callbacks.begin(); it != reached; ++it)
+    {
+        callbacks.push_back(move(it->second));
+    }
+    m_callbacks.erase(m_callbacks.begin(), reached);
+
+    for (auto& callback : callbacks)
+    {
+        callback();
+    }
+}
+
+void FramePacer::OnCompletion(UINT64 fenceValue, const Callback& callback)
+{
+    if (fenceValue <= m_completedValue)
+    {
+        callback();
+    }
+    else
+    {
+        m_callbacks.insert(make_pair(fenceValue, callback));
+    }
+}
+
+UINT64 FramePacer::GetFenceValueToWaitFor() const
+{
+    // The frame about to be recorded counts as in flight too.
+    if (m_frames.size() < m_maxFrameLatency)
+    {
+        return 0;
+    }
+    return m_frames[m_frames.size() - m_maxFrameLatency].fenceValue;
+}
+
+double FramePacer::GetAverageLatencyMilliseconds() const
+{
+    return m_completedFrameCount ? TicksToMilliseconds(m_totalLatencyTicks) / m_completedFrameCount : 0.0;
+}
+
+double FramePacer::GetMaxLatencyMilliseconds() const
+{
+    return TicksToMilliseconds(m_maxLatencyTicks);
+}
+
+wstring FramePacer::GetLatencyHistogramString() const
+{
+    wstringstream stream;
+    stream << fixed << setprecision(2)
+        << L"Frame latency: " << m_completedFrameCount << L" frames, max " << m_maxFrameLatency << L" in flight, "
+        << GetAverageLatencyMilliseconds() << L" ms average, " << GetMaxLatencyMilliseconds() << L" ms max\n";
+
+    for (UINT bucket = 0; bucket < c_latencyBucketCount; bucket++)
+    {
+        if (m_latencyBuckets[bucket] == 0)
+        {
+            continue;
+        }
+        if (bucket == c_latencyBucketCount - 1)
+        {
+            stream << L"  >= " << setw(3) << bucket << L" ms";
+        }
+        else
+        {
+            stream << L"  " << setw(3) << bucket << L"-" << setw(3) << bucket + 1 << L" ms";
+        }
+        stream << L": " << m_latencyBuckets[bucket] << L"\n";
+    }
+    return stream.str();
+}
+
+SimulatedFenceTimeline::SimulatedFenceTimeline() :
+    m_durationTicks(0),
+    m_completedValue(0),
+    m_busyUntilTicks(0)
+{
+}
+
+void SimulatedFenceTimeline::Signal(UINT64 fenceValue, UINT64 ticks)
+{
+    // Work starts once the work before it is done.
+    m_busyUntilTicks = max(m_busyUntilTicks, ticks) + m_durationTicks;
+    m_work.push_back({ fenceValue, m_busyUntilTicks });
+}
+
+UINT64 SimulatedFenceTimeline::GetCompletedValue(UINT64 ticks)
+{
+    while (!m_work.empty() && m_work.front().completionTicks <= ticks)
+    {
+        m_completedValue = max(m_completedValue, m_work.front().fenceValue);
+        m_work.pop_front();
+    }
+    return m_completedValue;
+}
+
+UINT64 SimulatedFenceTimeline::GetCompletionTicks(UINT64 fenceValue) const
+{
+    if (fenceValue <= m_completedValue)
+    {
+        return 0;
+    }
+    for (auto& work : m_work)
+    {
+        if (work.fenceValue >= fenceValue)
+        {
+            return work.completionTicks;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// FramePacer.h - Bookkeeping for frames in flight on a fence timeline
+//
+
+#pragma once
+
+#include <deque>
+
+namespace DX
+{
+    // Tracks the fence value each submitted frame signals and decides when the CPU may start
+    // recording another frame: at most GetMaxFrameLatency() frames are in flight, counting the
+    // one being recorded. The pacer never touches a fence itself, the owner polls the fence and
+    // passes the completed value and a timestamp to Update(). This keeps it non-blocking, the
+    // owner chooses when to wait, and lets it run against a simulated timeline as well.
+    // Latency is measured from submission until Update() first sees the frame complete.
+    class FramePacer
+    {
+    public:
+        typedef std::function<void()> Callback;
+
+        static const UINT c_maxFrameLatency = 16;
+        static const UINT c_latencyBucketCount = 33;    // 1 ms buckets, the last one counts everything longer.
+
+        FramePacer();
+
+        // Forgets all frames and callbacks, nothing may be in flight.
+        void Initialize(UINT maxFrameLatency, UINT64 ticksPerSecond);
+
+        // The frame's work has been submitted and will signal fenceValue, values must increase.
+        void FrameSubmitted(UINT64 fenceValue, UINT64 ticks);
+
+        // Retires frames up to completedValue, recording their latency, and runs their callbacks.
+        void Update(UINT64 completedValue, UINT64 ticks);
+
+        // Runs callback from the Update() that sees fenceValue complete, or right away if it has.
+        void OnCompletion(UINT64 fenceValue, const Callback& callback);
+
+        // The fence value to wait for before another frame can start recording, 0 if one can now.
+        UINT64 GetFenceValueToWaitFor() const;
+        bool CanBeginFrame() const { return GetFenceValueToWaitFor() == 0; }
+
+        // Accessors.
+        UINT            GetMaxFrameLatency() const { return m_maxFrameLatency; }
+        UINT            GetFramesInFlight() const { return static_cast<UINT>(m_frames.size()); }
+        UINT64          GetCompletedValue() const { return m_completedValue; }
+        UINT64          GetCompletedFrameCount() const { return m_completedFrameCount; }
+        UINT64          GetLatencyBucket(UINT bucket) const { return m_latencyBuckets[bucket]; }
+        double          GetAverageLatencyMilliseconds() const;
+        double          GetMaxLatencyMilliseconds() const;
+        std::wstring    GetLatencyHistogramString() const;
+
+    private:
+        double TicksToMilliseconds(UINT64 ticks) const { return 1000.0 * ticks / m_ticksPerSecond; }
+
+        struct Frame
+        {
+            UINT64 fenceValue;
+            UINT64 submitTicks;
+        };
+
+        UINT                                m_maxFrameLatency;
+        UINT64                              m_ticksPerSecond;
+        UINT64                              m_completedValue;
+        std::deque<Frame>                   m_frames;           // In flight, oldest first.
+        std::multimap<UINT64, Callback>     m_callbacks;        // Keyed by fence value.
+
+        UINT64                              m_completedFrameCount;
+        UINT64                              m_totalLatencyTicks;
+        UINT64                              m_maxLatencyTicks;
+        UINT64                              m_latencyBuckets[c_latencyBucketCount];
+    };
+
+    // A fence timeline without a GPU: every signal stands for a piece of work taking a fixed
+    // time, run one after the other from the moment it is signaled. Used to pace the recording
+    // device like a GPU of a given speed, and to drive a FramePacer in isolation.
+    class SimulatedFenceTimeline
+    {
+    public:
+        SimulatedFenceTimeline();
+
+        // How long each signaled piece of work takes, 0 completes it on submission.
+        void SetDuration(UINT64 ticks) { m_durationTicks = ticks; }
+
+        void Signal(UINT64 fenceValue, UINT64 ticks);
+        UINT64 GetCompletedValue(UINT64 ticks);
+
+        // When fenceValue completes, 0 if it has or was never signaled.
+        UINT64 GetCompletionTicks(UINT64 fenceValue) const;
+
+        // Accessors.
+        UINT64 GetDuration() const { return m_durationTicks; }
+
+    private:
+        struct Work
+        {
+            UINT64 fenceValue;
+            UINT64 completionTicks;
+        };
+
+        UINT64              m_durationTicks;
+        UINT64              m_completedValue;
+        UINT64              m_busyUntilTicks;
+        std::deque<Work>    m_work;
+    };
+}
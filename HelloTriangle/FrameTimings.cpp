@@ -0,0 +1,229 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "FrameTimings.h"
+#include "StepTimer.h"
+#include <fstream>
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    const double c_percentiles[] = { 50.0, 95.0, 99.0 };
+}
+
+TimingHistogram::TimingHistogram() :
+    m_count(0),
+    m_totalTicks(0),
+    m_maxTicks(0)
+{
+    for (auto& bucket : m_buckets)
+    {
+        bucket = 0;
+    }
+}
+
+void TimingHistogram::Record(UINT64 ticks)
+{
+    m_buckets[GetBucket(ticks)].fetch_add(1, memory_order_relaxed);
+    m_totalTicks.fetch_add(ticks, memory_order_relaxed);
+    m_count.fetch_add(1, memory_order_relaxed);
+
+    UINT64 maxTicks = m_maxTicks.load(memory_order_relaxed);
+    while (ticks > maxTicks && !m_maxTicks.compare_exchange_weak(maxTicks, ticks, memory_order_relaxed))
+    {
+    }
+}
+
+void TimingHistogram::Reset()
+{
+    for (auto& bucket : m_buckets)
+    {
+        bucket = 0;
+    }
+    m_count = 0;
+    m_totalTicks = 0;
+    m_maxTicks = 0;
+}
+
+double TimingHistogram::GetPercentileMilliseconds(double percentile) const
+{
+    // Sum the buckets rather than trusting m_count, they may be a sample apart mid-record.
+    UINT64 count = 0;
+    for (auto& bucket : m_buckets)
+    {
+        count += bucket.load(memory_order_relaxed);
+    }
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    UINT64 rank = max<UINT64>(static_cast<UINT64>(ceil(percentile / 100.0 * count)), 1);
+    UINT64 seen = 0;
+    for (UINT bucket = 0; bucket < c_bucketCount; bucket++)
+    {
+        seen += m_buckets[bucket].load(memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // The bucket's upper bound, but never beyond the longest sample seen.
+            UINT64 ticks = min<UINT64>(GetBucketUpperBound(bucket), m_maxTicks.load(memory_order_relaxed));
+            return StepTimer::TicksToMilliseconds(ticks);
+        }
+    }
+    return GetMaxMilliseconds();
+}
+
+UINT TimingHistogram::GetBucket(UINT64 ticks)
+{
+    if (ticks < c_linearBucketCount)
+    {
+        return static_cast<UINT>(ticks);
+    }
+
+    // Sub-buckets split [2^e, 2^(e+1)) evenly, keyed by the bits below the leading one.
+    UINT exponent = 0;
+    while (ticks >> (exponent + 1))
+    {
+        exponent++;
+    }
+    const UINT linearExponent = 6;     // log2(c_linearBucketCount)
+    const UINT subBucketExponent = 5;  // log2(c_subBucketCount)
+    UINT octave = exponent - linearExponent;
+    if (octave >= c_octaveCount)
+    {
+        return c_bucketCount - 1;
+    }
+    UINT subBucket = static_cast<UINT>(ticks >> (exponent - subBucketExponent)) - c_subBucketCount;
+    return c_linearBucketCount + octave * c_subBucketCount + subBucket;
+}
+
+UINT64 TimingHistogram::GetBucketUpperBound(UINT bucket)
+{
+    if (bucket < c_linearBucketCount)
+    {
+        return bucket + 1;
+    }
+
+    UINT octave = (bucket - c_linearBucketCount) / c_subBucketCount;
+    UINT subBucket = (bucket - c_linearBucketCount) % c_subBucketCount;
+    return static_cast<UINT64>(c_subBucketCount + subBucket + 1) << (octave + 1);
+}
+
+double TimingHistogram::GetMeanMilliseconds() const
+{
+    UINT64 count = m_count.load(memory_order_relaxed);
+    return count ? StepTimer::TicksToMilliseconds(m_totalTicks.load(memory_order_relaxed)) / count : 0.0;
+}
+
+double TimingHistogram::GetMaxMilliseconds() const
+{
+    return StepTimer::TicksToMilliseconds(m_maxTicks.load(memory_order_relaxed));
+}
+
+const char* FrameTimings::GetPhaseName(Phase phase)
+{
+    static const char* names[PhaseCount] = { "frame", "update", "record", "trace", "present" };
+    return names[phase];
+}
+
+void FrameTimings::Reset()
+{
+    for (auto& phase : m_phases)
+    {
+        phase.Reset();
+    }
+}
+
+void FrameTimings::WriteCsv(ostream& stream) const
+{
+    stream << "phase,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n" << fixed << setprecision(4);
+    for (UINT phase = 0; phase < PhaseCount; phase++)
+    {
+        auto& histogram = m_phases[phase];
+        stream << GetPhaseName(static_cast<Phase>(phase)) << ',' << histogram.GetCount() << ',' << histogram.GetMeanMilliseconds();
+        for (double percentile : c_percentiles)
+        {
+            stream << ',' << histogram.GetPercentileMilliseconds(percentile);
+        }
+        stream << ',' << histogram.GetMaxMilliseconds() << '\n';
+    }
+}
+
+void FrameTimings::WriteJson(ostream& stream) const
+{
+    stream << "{\n  \"phases\": {" << fixed << setprecision(4);
+    for (UINT phase = 0; phase < PhaseCount; phase++)
+    {
+        auto& histogram = m_phases[phase];
+        stream << (phase ? "," : "") << "\n    \"" << GetPhaseName(static_cast<Phase>(phase)) << "\": {"
+            << "\"count\": " << histogram.GetCount()
+            << ", \"mean_ms\": " << histogram.GetMeanMilliseconds()
+            << ", \"p50_ms\": " << histogram.GetPercentileMilliseconds(50.0)
+            << ", \"p95_ms\": " << histogram.GetPercentileMilliseconds(95.0)
+            << ", \"p99_ms\": " << histogram.GetPercentileMilliseconds(99.0)
+            << ", \"max_ms\": " << histogram.GetMaxMilliseconds()
+            << ", \"buckets\": [";
+
+        // Only the buckets that were hit, as [upper bound in ms, count].
+        bool first = true;
+        for (UINT bucket = 0; bucket < TimingHistogram::c_bucketCount; bucket++)
+        {
+            UINT64 count = histogram.GetBucketCount(bucket);
+            if (count)
+            {
+                stream << (first ? "" : ", ") << '[' << StepTimer::TicksToMilliseconds(TimingHistogram::GetBucketUpperBound(bucket)) << ", " << count << ']';
+                first = false;
+            }
+        }
+        stream << "]}";
+    }
+    stream << "\n  }\n}\n";
+}
+
+void FrameTimings::Export(const wstring& path) const
+{
+    ofstream file(path);
+    ThrowIfFalse(file.is_open(), L"FrameTimings: couldn't open the export file.\n");
+
+    bool json = path.size() >= 5 && _wcsicmp(path.c_str() + path.size() - 5, L".json") == 0;
+    if (json)
+    {
+        WriteJson(file);
+    }
+    else
+    {
+        WriteCsv(file);
+    }
+}
+
+wstring FrameTimings::GetSummaryString() const
+{
+    wstringstream stream;
+    stream << fixed << setprecision(2) << L"Frame timings (ms):\n";
+    for (UINT phase = 0; phase < PhaseCount; phase++)
+    {
+        auto& histogram = m_phases[phase];
+        if (histogram.GetCount() == 0)
+        {
+            continue;
+        }
+        stream << L"  " << setw(8) << left << GetPhaseName(static_cast<Phase>(phase)) << right
+            << L" p50 " << setw(7) << histogram.GetPercentileMilliseconds(50.0)
+            << L"  p95 " << setw(7) << histogram.GetPercentileMilliseconds(95.0)
+            << L"  p99 " << setw(7) << histogram.GetPercentileMilliseconds(99.0)
+            << L"  max " << setw(7) << histogram.GetMaxMilliseconds()
+            << L"  (" << histogram.GetCount() << L" samples)\n";
+    }
+    return stream.str();
+}
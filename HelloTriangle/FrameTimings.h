@@ -0,0 +1,94 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// FrameTimings.h - Frame time histograms with percentiles, exported as CSV or JSON
+//
+
+#pragma once
+
+namespace DX
+{
+    // Durations in StepTimer ticks (100 ns), bucketed log-linearly: one bucket per tick below
+    // c_linearBucketCount, then c_subBucketCount buckets per doubling, so percentiles are within
+    // about 3% up to over a minute. Record() is lock-free and safe from any thread, reads taken
+    // while others record see each sample either fully or not at all, per counter.
+    class TimingHistogram
+    {
+    public:
+        static const UINT c_linearBucketCount = 64;
+        static const UINT c_subBucketCount = 32;
+        static const UINT c_octaveCount = 24;
+        static const UINT c_bucketCount = c_linearBucketCount + c_octaveCount * c_subBucketCount;
+
+        TimingHistogram();
+
+        void Record(UINT64 ticks);
+
+        // Not safe while other threads record.
+        void Reset();
+
+        // The smallest duration at least percentile (0-100) percent of the samples don't exceed,
+        // to the resolution of the buckets.
+        double GetPercentileMilliseconds(double percentile) const;
+
+        // Exclusive upper bound of bucket, in ticks. The last bucket also holds everything longer.
+        static UINT64 GetBucketUpperBound(UINT bucket);
+
+        // Accessors.
+        UINT64  GetCount() const { return m_count; }
+        UINT64  GetBucketCount(UINT bucket) const { return m_buckets[bucket]; }
+        double  GetMeanMilliseconds() const;
+        double  GetMaxMilliseconds() const;
+
+    private:
+        static UINT GetBucket(UINT64 ticks);
+
+        std::atomic<UINT64>     m_buckets[c_bucketCount];
+        std::atomic<UINT64>     m_count;
+        std::atomic<UINT64>     m_totalTicks;
+        std::atomic<UINT64>     m_maxTicks;
+    };
+
+    // A histogram for the whole frame and for each phase of it. Phases can be recorded from any
+    // thread, the GPU trace time comes from timestamp queries a few frames late.
+    class FrameTimings
+    {
+    public:
+        enum Phase
+        {
+            PhaseFrame = 0,     // Tick to tick, what the user sees.
+            PhaseUpdate,        // OnUpdate().
+            PhaseRecord,        // Recording the render graph.
+            PhaseTrace,         // DispatchRays() on the GPU.
+            PhasePresent,       // Submission and Present().
+            PhaseCount
+        };
+
+        static const char* GetPhaseName(Phase phase);
+
+        void Record(Phase phase, UINT64 ticks) { m_phases[phase].Record(ticks); }
+        void Reset();
+
+        void WriteCsv(std::ostream& stream) const;
+        void WriteJson(std::ostream& stream) const;
+
+        // Writes JSON when path ends in .json, CSV otherwise.
+        void Export(const std::wstring& path) const;
+
+        // Accessors.
+        const TimingHistogram&  GetHistogram(Phase phase) const { return m_phases[phase]; }
+        std::wstring            GetSummaryString() const;
+
+    private:
+        TimingHistogram m_phases[PhaseCount];
+    };
+}
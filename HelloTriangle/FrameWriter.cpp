@@ -0,0 +1,292 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "FrameWriter.h"
+#include "ImageFile.h"
+#include "StepTimer.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const UINT c_queuedFramesPerWorker = 2;
+
+    const LPCWSTR c_formatNames[FrameWriter::FormatCount] = { L"png", L"pfm", L"exr" };
+}
+
+FrameWriter::FrameWriter(const wstring& prefix, Format format, UINT workerCount, UINT maxQueuedFrames, bool waitForRoom) :
+    m_prefix(prefix),
+    m_format(format),
+    m_maxQueuedFrames(maxQueuedFrames),
+    m_waitForRoom(waitForRoom),
+    m_busyWorkers(0),
+    m_quit(false),
+    m_statistics()
+{
+    ThrowIfFalse(format < FormatCount, L"FrameWriter: unknown format.\n");
+    if (workerCount == 0)
+    {
+        workerCount = max(thread::hardware_concurrency() / 2, 1u);
+    }
+    if (m_maxQueuedFrames == 0)
+    {
+        m_maxQueuedFrames = c_queuedFramesPerWorker * workerCount;
+    }
+
+    m_workers.reserve(workerCount);
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        m_workers.emplace_back(&FrameWriter::WorkerMain, this);
+    }
+}
+
+FrameWriter::~FrameWriter()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_frameQueued.notify_all();
+
+    // Queued frames are still written.
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+bool FrameWriter::Submit(UINT64 frameNumber, UINT width, UINT height, const UINT32* rgba8, UINT rowPitch)
+{
+    auto frame = AcquireFrame(frameNumber, width, height, false);
+    if (!frame)
+    {
+        return false;
+    }
+    const size_t rowSize = static_cast<size_t>(width) * sizeof(UINT32);
+    for (UINT y = 0; y < height; y++)
+    {
+        memcpy(frame->pixels.data() + y * rowSize, reinterpret_cast<const uint8_t*>(rgba8) + static_cast<size_t>(y) * rowPitch, rowSize);
+    }
+    return Queue(move(frame));
+}
+
+bool FrameWriter::Submit(UINT64 frameNumber, UINT width, UINT height, const XMFLOAT4* rgba32, const Tonemapper& tonemapper)
+{
+    auto frame = AcquireFrame(frameNumber, width, height, true);
+    if (!frame)
+    {
+        return false;
+    }
+    frame->tonemapper = tonemapper;
+    memcpy(frame->pixels.data(), rgba32, frame->pixels.size());
+    return Queue(move(frame));
+}
+
+void FrameWriter::Flush()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_queue.empty() && m_busyWorkers == 0; });
+    if (m_exception)
+    {
+        exception_ptr exception = m_exception;
+        m_exception = nullptr;
+        rethrow_exception(exception);
+    }
+}
+
+FrameWriter::Statistics FrameWriter::GetStatistics() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+wstring FrameWriter::GetStatisticsString() const
+{
+    const double MB = 1024.0 * 1024.0;
+    Statistics statistics = GetStatistics();
+    wstringstream stream;
+    stream << fixed << setprecision(1)
+        << L"Frame writer: " << statistics.framesWritten << L" ." << GetExtension(m_format) << L" frames written, "
+        << statistics.framesDropped << L" dropped, " << GetWorkerCount() << L" workers\n"
+        << L"  encode " << (statistics.encodeSeconds > 0.0 ? statistics.pixelBytes / MB / statistics.encodeSeconds : 0.0)
+        << L" MB/s of pixels per worker, " << statistics.pixelBytes / MB << L" MB in, " << statistics.fileBytes / MB << L" MB out\n"
+        << L"  write " << (statistics.writeSeconds > 0.0 ? statistics.fileBytes / MB / statistics.writeSeconds : 0.0) << L" MB/s per worker\n";
+    return stream.str();
+}
+
+bool FrameWriter::ParseFormat(const wstring& name, Format* format)
+{
+    for (UINT i = 0; i < FormatCount; i++)
+    {
+        if (_wcsicmp(name.c_str(), c_formatNames[i]) == 0)
+        {
+            *format = static_cast<Format>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+LPCWSTR FrameWriter::GetExtension(Format format)
+{
+    return c_formatNames[format];
+}
+
+unique_ptr<FrameWriter::Frame> FrameWriter::AcquireFrame(UINT64 frameNumber, UINT width, UINT height, bool isFloat)
+{
+    unique_ptr<Frame> frame;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        if (m_waitForRoom)
+        {
+            m_frameTaken.wait(lock, [this] { return m_queue.size() < m_maxQueuedFrames; });
+        }
+        else if (m_queue.size() >= m_maxQueuedFrames)
+        {
+            m_statistics.framesDropped++;
+            return nullptr;
+        }
+        if (!m_freeFrames.empty())
+        {
+            frame = move(m_freeFrames.back());
+            m_freeFrames.pop_back();
+        }
+    }
+    if (!frame)
+    {
+        frame = make_unique<Frame>();
+    }
+    frame->number = frameNumber;
+    frame->width = width;
+    frame->height = height;
+    frame->isFloat = isFloat;
+    frame->pixels.resize(static_cast<size_t>(width) * height * (isFloat ? sizeof(XMFLOAT4) : sizeof(UINT32)));
+    return frame;
+}
+
+bool FrameWriter::Queue(unique_ptr<Frame> frame)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_queue.push_back(move(frame));
+    }
+    m_frameQueued.notify_one();
+    return true;
+}
+
+void FrameWriter::WorkerMain()
+{
+    TraceRecorder::SetThreadName("Frame writer");
+
+    // Per worker, reused from frame to frame.
+    vector<uint8_t> converted;
+    vector<uint8_t> encoded;
+    for (;;)
+    {
+        unique_ptr<Frame> frame;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_frameQueued.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                return;
+            }
+            frame = move(m_queue.front());
+            m_queue.pop_front();
+            m_busyWorkers++;
+        }
+        m_frameTaken.notify_one();
+
+        try
+        {
+            Write(*frame, &converted, &encoded);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (!m_exception)
+            {
+                m_exception = current_exception();
+            }
+        }
+
+        bool idle;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_freeFrames.push_back(move(frame));
+            idle = --m_busyWorkers == 0 && m_queue.empty();
+        }
+        if (idle)
+        {
+            m_idle.notify_all();
+        }
+    }
+}
+
+void FrameWriter::Write(const Frame& frame, vector<uint8_t>* converted, vector<uint8_t>* encoded)
+{
+    TRACE_SCOPE("FrameWriter::Write");
+    const size_t pixelCount = static_cast<size_t>(frame.width) * frame.height;
+
+    UINT64 encodeStart = StepTimer::GetCurrentTicks();
+    if (m_format == FormatPng)
+    {
+        const UINT32* rgba8 = reinterpret_cast<const UINT32*>(frame.pixels.data());
+        if (frame.isFloat)
+        {
+            converted->resize(pixelCount * sizeof(UINT32));
+            rgba8 = reinterpret_cast<UINT32*>(converted->data());
+            frame.tonemapper.Resolve(reinterpret_cast<const XMFLOAT4*>(frame.pixels.data()), reinterpret_cast<UINT32*>(converted->data()), pixelCount);
+        }
+        ImageFile::EncodePng(frame.width, frame.height, rgba8, encoded);
+    }
+    else
+    {
+        const XMFLOAT4* rgba32 = reinterpret_cast<const XMFLOAT4*>(frame.pixels.data());
+        if (!frame.isFloat)
+        {
+            converted->resize(pixelCount * sizeof(XMFLOAT4));
+            XMFLOAT4* destination = reinterpret_cast<XMFLOAT4*>(converted->data());
+            const UINT32* source = reinterpret_cast<const UINT32*>(frame.pixels.data());
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                UINT32 pixel = source[i];
+                destination[i] = XMFLOAT4((pixel & 0xFF) / 255.0f, ((pixel >> 8) & 0xFF) / 255.0f, ((pixel >> 16) & 0xFF) / 255.0f, (pixel >> 24) / 255.0f);
+            }
+            rgba32 = destination;
+        }
+        if (m_format == FormatPfm)
+        {
+            ImageFile::EncodePfm(frame.width, frame.height, rgba32, encoded);
+        }
+        else
+        {
+            ImageFile::EncodeExr(frame.width, frame.height, rgba32, encoded);
+        }
+    }
+
+    UINT64 writeStart = StepTimer::GetCurrentTicks();
+    wstringstream path;
+    path << m_prefix << L"_" << setw(5) << setfill(L'0') << frame.number << L"." << GetExtension(m_format);
+    ImageFile::WriteFile(path.str(), *encoded);
+    UINT64 writeEnd = StepTimer::GetCurrentTicks();
+
+    lock_guard<mutex> lock(m_mutex);
+    m_statistics.framesWritten++;
+    m_statistics.pixelBytes += frame.pixels.size();
+    m_statistics.fileBytes += encoded->size();
+    m_statistics.encodeSeconds += StepTimer::TicksToSeconds(writeStart - encodeStart);
+    m_statistics.writeSeconds += StepTimer::TicksToSeconds(writeEnd - writeStart);
+}
@@ -0,0 +1,109 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// FrameWriter.h - Encodes and writes rendered frames to disk on worker threads
+//
+
+#pragma once
+
+#include "Tonemapper.h"
+#include <thread>
+#include <condition_variable>
+#include <deque>
+
+namespace DX
+{
+    // Submit() copies the pixels into a recycled buffer, queues it and returns; the workers convert
+    // to the file format's pixel type, encode and write, one frame each at a time. A frame that
+    // would exceed the queue depth is dropped and counted rather than waited for, so the caller
+    // never blocks on encoding or the disk. With waitForRoom, Submit() waits instead and every
+    // frame is written, for runs whose output is compared frame by frame.
+    // Frames are named prefix_<frame number>.<extension>.
+    class FrameWriter
+    {
+    public:
+        enum Format
+        {
+            FormatPng,      // 8-bit, tonemapped on the workers when the frame is float.
+            FormatPfm,      // 32-bit float.
+            FormatExr,      // 32-bit float.
+            FormatCount
+        };
+
+        struct Statistics
+        {
+            UINT64  framesWritten;
+            UINT64  framesDropped;
+            UINT64  pixelBytes;         // Submitted, before any conversion.
+            UINT64  fileBytes;
+            double  encodeSeconds;      // Summed over the workers, conversion included.
+            double  writeSeconds;
+        };
+
+        // workerCount 0 uses half the hardware threads. maxQueuedFrames 0 allows two per worker.
+        FrameWriter(const std::wstring& prefix, Format format, UINT workerCount = 0, UINT maxQueuedFrames = 0, bool waitForRoom = false);
+        ~FrameWriter();
+
+        // rgba8 is DXGI_FORMAT_R8G8B8A8_UNORM with rowPitch bytes between rows, e.g. a mapped
+        // readback footprint. Return false if the frame was dropped, never with waitForRoom.
+        // tonemapper only applies when float pixels are written as PNG; the float formats keep
+        // the linear values.
+        bool Submit(UINT64 frameNumber, UINT width, UINT height, const UINT32* rgba8, UINT rowPitch);
+        bool Submit(UINT64 frameNumber, UINT width, UINT height, const DirectX::XMFLOAT4* rgba32, const Tonemapper& tonemapper = Tonemapper());
+
+        // Waits until every queued frame is on disk. The first error a worker hit is rethrown here.
+        void Flush();
+
+        Statistics GetStatistics() const;
+        std::wstring GetStatisticsString() const;
+
+        static bool ParseFormat(const std::wstring& name, Format* format);
+        static LPCWSTR GetExtension(Format format);
+
+        // Accessors.
+        Format  GetFormat() const { return m_format; }
+        UINT    GetWorkerCount() const { return static_cast<UINT>(m_workers.size()); }
+
+    private:
+        struct Frame
+        {
+            UINT64                          number;
+            UINT                            width;
+            UINT                            height;
+            bool                            isFloat;
+            Tonemapper                      tonemapper;
+            std::vector<uint8_t>            pixels;
+        };
+
+        std::unique_ptr<Frame> AcquireFrame(UINT64 frameNumber, UINT width, UINT height, bool isFloat);
+        bool Queue(std::unique_ptr<Frame> frame);
+        void WorkerMain();
+        void Write(const Frame& frame, std::vector<uint8_t>* converted, std::vector<uint8_t>* encoded);
+
+        std::wstring                            m_prefix;
+        Format                                  m_format;
+        UINT                                    m_maxQueuedFrames;
+        bool                                    m_waitForRoom;
+
+        std::vector<std::thread>                m_workers;
+        mutable std::mutex                      m_mutex;
+        std::condition_variable                 m_frameQueued;
+        std::condition_variable                 m_frameTaken;
+        std::condition_variable                 m_idle;
+        std::deque<std::unique_ptr<Frame>>      m_queue;
+        std::vector<std::unique_ptr<Frame>>     m_freeFrames;   // Written, kept for their buffers.
+        UINT                                    m_busyWorkers;
+        bool                                    m_quit;
+        std::exception_ptr                      m_exception;
+        Statistics                              m_statistics;
+    };
+}
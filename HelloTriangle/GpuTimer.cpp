@@ -0,0 +1,99 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "GpuTimer.h"
+#include "StepTimer.h"
+
+using namespace DX;
+using namespace std;
+
+GpuTimer::GpuTimer() :
+    m_frequency(0),
+    m_frameIndex(0)
+{
+}
+
+void GpuTimer::Create(ID3D12Device* device, ID3D12CommandQueue* commandQueue, UINT frameCount)
+{
+    Release();
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = 2 * frameCount;
+    if (FAILED(commandQueue->GetTimestampFrequency(&m_frequency)) || m_frequency == 0 ||
+        FAILED(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap))))
+    {
+        m_queryHeap.Reset();
+        return;
+    }
+    m_queryHeap->SetName(L"GpuTimer queries");
+
+    auto readbackHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(queryHeapDesc.Count * sizeof(UINT64));
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readbackBuffer)));
+    m_readbackBuffer->SetName(L"GpuTimer readback");
+
+    m_recorded.assign(frameCount, false);
+}
+
+void GpuTimer::Release()
+{
+    m_queryHeap.Reset();
+    m_readbackBuffer.Reset();
+    m_recorded.clear();
+    m_frameIndex = 0;
+}
+
+bool GpuTimer::BeginFrame(UINT frameIndex, UINT64* ticks)
+{
+    if (!IsAvailable())
+    {
+        return false;
+    }
+
+    m_frameIndex = frameIndex;
+    if (!m_recorded[frameIndex])
+    {
+        return false;
+    }
+    m_recorded[frameIndex] = false;
+
+    D3D12_RANGE readRange = { 2 * frameIndex * sizeof(UINT64), 2 * (frameIndex + 1) * sizeof(UINT64) };
+    D3D12_RANGE writtenRange = {};
+    void* data;
+    ThrowIfFailed(m_readbackBuffer->Map(0, &readRange, &data));
+    const UINT64* timestamps = reinterpret_cast<const UINT64*>(static_cast<BYTE*>(data) + readRange.Begin);
+    UINT64 delta = timestamps[1] > timestamps[0] ? timestamps[1] - timestamps[0] : 0;
+    m_readbackBuffer->Unmap(0, &writtenRange);
+
+    *ticks = static_cast<UINT64>(static_cast<double>(delta) * StepTimer::TicksPerSecond / m_frequency);
+    return true;
+}
+
+void GpuTimer::Start(ID3D12GraphicsCommandList* commandList)
+{
+    if (IsAvailable())
+    {
+        commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * m_frameIndex);
+    }
+}
+
+void GpuTimer::Stop(ID3D12GraphicsCommandList* commandList)
+{
+    if (IsAvailable())
+    {
+        commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * m_frameIndex + 1);
+        commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * m_frameIndex, 2, m_readbackBuffer.Get(), 2 * m_frameIndex * sizeof(UINT64));
+        m_recorded[m_frameIndex] = true;
+    }
+}
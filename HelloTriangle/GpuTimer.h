@@ -0,0 +1,49 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// GpuTimer.h - Time one range of GPU work per frame with timestamp queries
+//
+
+#pragma once
+
+namespace DX
+{
+    // Each frame index gets a pair of timestamps, resolved straight into a readback buffer. The
+    // result is read when the frame index comes around again, once its fence has completed.
+    // Devices without timestamp queries, such as the recording device, leave the timer unavailable
+    // and all calls do nothing.
+    class GpuTimer
+    {
+    public:
+        GpuTimer();
+
+        void Create(ID3D12Device* device, ID3D12CommandQueue* commandQueue, UINT frameCount);
+        void Release();
+
+        // Call once the frame's fence has completed. Returns the duration, in StepTimer ticks, the
+        // frame recorded the last time it had this index, false if it recorded none.
+        bool BeginFrame(UINT frameIndex, UINT64* ticks);
+
+        void Start(ID3D12GraphicsCommandList* commandList);
+        void Stop(ID3D12GraphicsCommandList* commandList);
+
+        // Accessors.
+        bool IsAvailable() const { return m_queryHeap != nullptr; }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12QueryHeap>     m_queryHeap;
+        Microsoft::WRL::ComPtr<ID3D12Resource>      m_readbackBuffer;
+        UINT64                                      m_frequency;
+        UINT                                        m_frameIndex;
+        std::vector<bool>                           m_recorded;     // Per frame index, a range is waiting to be read.
+    };
+}
@@ -0,0 +1,376 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "ImageCompare.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+const float ImageCompare::c_defaultPixelsPerDegree = 67.0f;
+
+namespace
+{
+    typedef vector<float> Plane;
+
+    const float c_pi = 3.14159265f;
+
+    // FLIP's exponents and the split of the color error range, see the paper's section 4.
+    const float c_colorExponent = 0.7f;
+    const float c_colorSplit = 0.4f;
+    const float c_colorSplitValue = 0.95f;
+    const float c_featureExponent = 0.5f;
+    const float c_featureWidth = 0.082f;        // Degrees.
+
+    // D65, for XYZ and everything derived from it.
+    const XMFLOAT3 c_whitePoint(0.950428545f, 1.0f, 1.088900371f);
+
+    // Contrast sensitivity of each opponent channel as a sum of two Gaussians, a * sqrt(pi / b) *
+    // exp(-pi^2 x^2 / b) with x in degrees.
+    struct CsfTerm
+    {
+        float a;
+        float b;
+    };
+    const CsfTerm c_csf[3][2] =
+    {
+        { { 1.0f, 0.0047f }, { 0.0f, 1e-5f } },     // Achromatic
+        { { 1.0f, 0.0053f }, { 0.0f, 1e-5f } },     // Red-green
+        { { 34.1f, 0.04f }, { 13.5f, 0.025f } },    // Blue-yellow
+    };
+
+    float SrgbToLinear(float value)
+    {
+        value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return value <= 0.04045f ? value / 12.92f : pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    XMFLOAT3 LinearRgbToXyz(const XMFLOAT3& c)
+    {
+        return XMFLOAT3(
+            0.4124564f * c.x + 0.3575761f * c.y + 0.1804375f * c.z,
+            0.2126729f * c.x + 0.7151522f * c.y + 0.0721750f * c.z,
+            0.0193339f * c.x + 0.1191920f * c.y + 0.9503041f * c.z);
+    }
+
+    XMFLOAT3 XyzToLinearRgb(const XMFLOAT3& c)
+    {
+        return XMFLOAT3(
+            3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+            -0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+            0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z);
+    }
+
+    // Hunt adjusted CIELAB: a and b scale with lightness, so dark colors differ less.
+    XMFLOAT3 LinearRgbToHuntLab(const XMFLOAT3& rgb)
+    {
+        const float delta = 6.0f / 29.0f;
+        auto f = [&](float t) { return t > delta * delta * delta ? cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f; };
+        XMFLOAT3 xyz = LinearRgbToXyz(rgb);
+        float fx = f(xyz.x / c_whitePoint.x);
+        float fy = f(xyz.y / c_whitePoint.y);
+        float fz = f(xyz.z / c_whitePoint.z);
+        float l = 116.0f * fy - 16.0f;
+        return XMFLOAT3(l, 0.01f * l * 500.0f * (fx - fy), 0.01f * l * 200.0f * (fy - fz));
+    }
+
+    float HyAB(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        float da = a.y - b.y;
+        float db = a.z - b.z;
+        return abs(a.x - b.x) + sqrt(da * da + db * db);
+    }
+
+    // Clamped to the edges, the kernels are odd sized and centered.
+    void Convolve(const Plane& source, UINT width, UINT height, const vector<float>& kernelX, const vector<float>& kernelY, Plane* scratch, Plane* destination)
+    {
+        const int radiusX = static_cast<int>(kernelX.size() / 2);
+        const int radiusY = static_cast<int>(kernelY.size() / 2);
+        scratch->resize(source.size());
+        destination->resize(source.size());
+        for (UINT y = 0; y < height; y++)
+        {
+            const float* row = source.data() + static_cast<size_t>(y) * width;
+            for (UINT x = 0; x < width; x++)
+            {
+                float sum = 0.0f;
+                for (int i = -radiusX; i <= radiusX; i++)
+                {
+                    int sx = min<int>(max<int>(static_cast<int>(x) + i, 0), width - 1);
+                    sum += kernelX[i + radiusX] * row[sx];
+                }
+                (*scratch)[static_cast<size_t>(y) * width + x] = sum;
+            }
+        }
+        for (UINT y = 0; y < height; y++)
+        {
+            for (UINT x = 0; x < width; x++)
+            {
+                float sum = 0.0f;
+                for (int i = -radiusY; i <= radiusY; i++)
+                {
+                    int sy = min<int>(max<int>(static_cast<int>(y) + i, 0), height - 1);
+                    sum += kernelY[i + radiusY] * (*scratch)[static_cast<size_t>(sy) * width + x];
+                }
+                (*destination)[static_cast<size_t>(y) * width + x] = sum;
+            }
+        }
+    }
+
+    class FlipFilters
+    {
+    public:
+        explicit FlipFilters(float pixelsPerDegree)
+        {
+            // Wide enough for the widest Gaussian of all the channels.
+            float widest = 0.0f;
+            for (auto& channel : c_csf)
+            {
+                for (auto& term : channel)
+                {
+                    widest = max<float>(widest, term.b);
+                }
+            }
+            int csfRadius = static_cast<int>(ceil(3.0f * sqrt(widest / (2.0f * c_pi * c_pi)) * pixelsPerDegree));
+
+            // Each term is separable. Its weight in x folds in the normalization of the whole 2D
+            // kernel, the sum of all the channel's terms.
+            for (UINT c = 0; c < 3; c++)
+            {
+                float total = 0.0f;
+                for (UINT t = 0; t < 2; t++)
+                {
+                    const CsfTerm& term = c_csf[c][t];
+                    vector<float>& gaussian = m_csf[c][t];
+                    gaussian.resize(2 * csfRadius + 1);
+                    float sum = 0.0f;
+                    for (int i = -csfRadius; i <= csfRadius; i++)
+                    {
+                        float x = i / pixelsPerDegree;
+                        gaussian[i + csfRadius] = exp(-c_pi * c_pi * x * x / term.b);
+                        sum += gaussian[i + csfRadius];
+                    }
+                    m_csfWeights[c][t] = term.a * sqrt(c_pi / term.b);
+                    total += m_csfWeights[c][t] * sum * sum;
+                }
+                for (UINT t = 0; t < 2; t++)
+                {
+                    m_csfWeights[c][t] /= total;
+                }
+            }
+
+            // Edges are the first derivative of a Gaussian and points the second, each with its
+            // positive and negative weights normalized to 1 and -1.
+            float sigma = 0.5f * c_featureWidth * pixelsPerDegree;
+            int featureRadius = static_cast<int>(ceil(3.0f * sigma));
+            m_gaussian.resize(2 * featureRadius + 1);
+            m_edge.resize(2 * featureRadius + 1);
+            m_point.resize(2 * featureRadius + 1);
+            float gaussianSum = 0.0f, edgePositive = 0.0f, pointPositive = 0.0f, pointNegative = 0.0f;
+            for (int i = -featureRadius; i <= featureRadius; i++)
+            {
+                float g = exp(-(i * i) / (2.0f * sigma * sigma));
+                m_gaussian[i + featureRadius] = g;
+                m_edge[i + featureRadius] = -i * g;
+                m_point[i + featureRadius] = (i * i / (sigma * sigma) - 1.0f) * g;
+                gaussianSum += g;
+                edgePositive += max<float>(-i * g, 0.0f);
+                pointPositive += max<float>(m_point[i + featureRadius], 0.0f);
+                pointNegative -= min<float>(m_point[i + featureRadius], 0.0f);
+            }
+            for (int i = 0; i <= 2 * featureRadius; i++)
+            {
+                m_gaussian[i] /= gaussianSum;
+                m_edge[i] /= edgePositive;
+                m_point[i] /= m_point[i] > 0.0f ? pointPositive : pointNegative;
+            }
+        }
+
+        // The filtered image in linear RGB, clamped to what a display shows.
+        void FilterColor(const Plane opponent[3], UINT width, UINT height, vector<XMFLOAT3>* rgb) const
+        {
+            Plane filtered[3], scratch, term;
+            for (UINT c = 0; c < 3; c++)
+            {
+                filtered[c].assign(opponent[c].size(), 0.0f);
+                for (UINT t = 0; t < 2; t++)
+                {
+                    if (c_csf[c][t].a == 0.0f)
+                    {
+                        continue;
+                    }
+                    Convolve(opponent[c], width, height, m_csf[c][t], m_csf[c][t], &scratch, &term);
+                    for (size_t i = 0; i < term.size(); i++)
+                    {
+                        filtered[c][i] += m_csfWeights[c][t] * term[i];
+                    }
+                }
+            }
+
+            rgb->resize(opponent[0].size());
+            for (size_t i = 0; i < rgb->size(); i++)
+            {
+                // YCxCz back to XYZ.
+                float y = (filtered[0][i] + 16.0f) / 116.0f;
+                XMFLOAT3 xyz((filtered[1][i] / 500.0f + y) * c_whitePoint.x, y * c_whitePoint.y, (y - filtered[2][i] / 200.0f) * c_whitePoint.z);
+                XMFLOAT3 linear = XyzToLinearRgb(xyz);
+                (*rgb)[i] = XMFLOAT3(min<float>(max<float>(linear.x, 0.0f), 1.0f), min<float>(max<float>(linear.y, 0.0f), 1.0f), min<float>(max<float>(linear.z, 0.0f), 1.0f));
+            }
+        }
+
+        void DetectFeatures(const Plane& luminance, UINT width, UINT height, Plane* edges, Plane* points) const
+        {
+            Plane scratch, x, y;
+            Convolve(luminance, width, height, m_edge, m_gaussian, &scratch, &x);
+            Convolve(luminance, width, height, m_gaussian, m_edge, &scratch, &y);
+            edges->resize(luminance.size());
+            for (size_t i = 0; i < luminance.size(); i++)
+            {
+                (*edges)[i] = sqrt(x[i] * x[i] + y[i] * y[i]);
+            }
+            Convolve(luminance, width, height, m_point, m_gaussian, &scratch, &x);
+            Convolve(luminance, width, height, m_gaussian, m_point, &scratch, &y);
+            points->resize(luminance.size());
+            for (size_t i = 0; i < luminance.size(); i++)
+            {
+                (*points)[i] = sqrt(x[i] * x[i] + y[i] * y[i]);
+            }
+        }
+
+    private:
+        vector<float>   m_csf[3][2];
+        float           m_csfWeights[3][2];
+        vector<float>   m_gaussian;
+        vector<float>   m_edge;
+        vector<float>   m_point;
+    };
+
+    // YCxCz, opponent channels linear in XYZ, and the luminance the features are found in.
+    void ToOpponent(const CpuFramebuffer& image, Plane opponent[3], Plane* luminance)
+    {
+        const size_t pixelCount = image.GetPixelCount();
+        for (UINT c = 0; c < 3; c++)
+        {
+            opponent[c].resize(pixelCount);
+        }
+        luminance->resize(pixelCount);
+        const XMFLOAT4* pixels = image.GetPixels().data();
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            XMFLOAT3 xyz = LinearRgbToXyz(XMFLOAT3(SrgbToLinear(pixels[i].x), SrgbToLinear(pixels[i].y), SrgbToLinear(pixels[i].z)));
+            float y = xyz.y / c_whitePoint.y;
+            opponent[0][i] = 116.0f * y - 16.0f;
+            opponent[1][i] = 500.0f * (xyz.x / c_whitePoint.x - y);
+            opponent[2][i] = 200.0f * (y - xyz.z / c_whitePoint.z);
+            (*luminance)[i] = y;
+        }
+    }
+}
+
+ImageCompare::ImageCompare(float pixelsPerDegree) :
+    m_pixelsPerDegree(pixelsPerDegree),
+    m_width(0),
+    m_height(0)
+{
+    ThrowIfFalse(pixelsPerDegree > 0.0f, L"ImageCompare: pixels per degree must be positive.\n");
+}
+
+ImageCompare::Result ImageCompare::Compare(const CpuFramebuffer& reference, const CpuFramebuffer& test)
+{
+    ThrowIfFalse(reference.GetWidth() == test.GetWidth() && reference.GetHeight() == test.GetHeight(), L"ImageCompare: the images differ in size.\n");
+    m_width = reference.GetWidth();
+    m_height = reference.GetHeight();
+    const size_t pixelCount = reference.GetPixelCount();
+    ThrowIfFalse(pixelCount > 0, L"ImageCompare: the images are empty.\n");
+
+    Result result = {};
+    m_difference.resize(pixelCount);
+    double squaredErrorSum = 0.0;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const XMFLOAT4& a = reference.GetPixels()[i];
+        const XMFLOAT4& b = test.GetPixels()[i];
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        squaredErrorSum += static_cast<double>(dx) * dx + static_cast<double>(dy) * dy + static_cast<double>(dz) * dz;
+        float difference = max<float>(abs(dx), max<float>(abs(dy), abs(dz)));
+        m_difference[i] = difference;
+        if (difference > 0.0f)
+        {
+            result.differentPixels++;
+        }
+        if (difference > result.maxError)
+        {
+            result.maxError = difference;
+            result.maxErrorX = static_cast<UINT>(i % m_width);
+            result.maxErrorY = static_cast<UINT>(i / m_width);
+        }
+    }
+    result.rmse = sqrt(squaredErrorSum / (3.0 * pixelCount));
+
+    FlipFilters filters(m_pixelsPerDegree);
+    Plane opponent[3], referenceLuminance, testLuminance;
+    vector<XMFLOAT3> referenceFiltered, testFiltered;
+    ToOpponent(reference, opponent, &referenceLuminance);
+    filters.FilterColor(opponent, m_width, m_height, &referenceFiltered);
+    ToOpponent(test, opponent, &testLuminance);
+    filters.FilterColor(opponent, m_width, m_height, &testFiltered);
+
+    Plane referenceEdges, referencePoints, testEdges, testPoints;
+    filters.DetectFeatures(referenceLuminance, m_width, m_height, &referenceEdges, &referencePoints);
+    filters.DetectFeatures(testLuminance, m_width, m_height, &testEdges, &testPoints);
+
+    // The largest color difference there is, between green and blue.
+    const float maxColorError = pow(HyAB(LinearRgbToHuntLab(XMFLOAT3(0.0f, 1.0f, 0.0f)), LinearRgbToHuntLab(XMFLOAT3(0.0f, 0.0f, 1.0f))), c_colorExponent);
+    const float splitError = c_colorSplit * maxColorError;
+
+    m_flip.resize(pixelCount);
+    double flipSum = 0.0;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        float colorError = pow(HyAB(LinearRgbToHuntLab(referenceFiltered[i]), LinearRgbToHuntLab(testFiltered[i])), c_colorExponent);
+        // Small differences get most of the range.
+        colorError = colorError < splitError
+            ? c_colorSplitValue / splitError * colorError
+            : c_colorSplitValue + (colorError - splitError) / (maxColorError - splitError) * (1.0f - c_colorSplitValue);
+
+        float featureDifference = max<float>(abs(referenceEdges[i] - testEdges[i]), abs(referencePoints[i] - testPoints[i]));
+        float featureError = pow(min<float>(featureDifference / sqrt(2.0f), 1.0f), c_featureExponent);
+
+        float flip = pow(min<float>(colorError, 1.0f), 1.0f - featureError);
+        m_flip[i] = flip;
+        flipSum += flip;
+        result.maxFlip = max<double>(result.maxFlip, flip);
+    }
+    result.meanFlip = flipSum / pixelCount;
+    return result;
+}
+
+void ImageCompare::FillFlipImage(CpuFramebuffer* target) const
+{
+    target->Resize(m_width, m_height);
+    for (size_t i = 0; i < m_flip.size(); i++)
+    {
+        target->GetPixel(static_cast<UINT>(i % m_width), static_cast<UINT>(i / m_width)) = CpuFramebuffer::HeatColor(m_flip[i]);
+    }
+}
+
+void ImageCompare::FillDifferenceImage(float scale, CpuFramebuffer* target) const
+{
+    ThrowIfFalse(scale > 0.0f, L"ImageCompare: the difference scale must be positive.\n");
+    target->Resize(m_width, m_height);
+    for (size_t i = 0; i < m_difference.size(); i++)
+    {
+        float difference = m_difference[i];
+        target->GetPixel(static_cast<UINT>(i % m_width), static_cast<UINT>(i / m_width)) =
+            difference == 0.0f ? XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f) : CpuFramebuffer::HeatColor(difference / scale);
+    }
+}
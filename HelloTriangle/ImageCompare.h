@@ -0,0 +1,64 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// ImageCompare.h - Error metrics between a reference image and a test image
+//
+
+#pragma once
+
+#include "CpuFramebuffer.h"
+
+namespace DX
+{
+    // Images hold display values the way the sample writes its UNORM output, sRGB encoded in
+    // [0, 1]. RMSE and the maximum error are over the R, G and B channels as stored. The
+    // perceptual error follows LDR FLIP (Andersson et al. 2020): both images are filtered with
+    // contrast sensitivity functions in an opponent space and compared as Hunt adjusted HyAB
+    // color differences, which edges and points that appear or vanish then amplify. Per pixel it
+    // is in [0, 1], roughly how noticeable the difference is when flipping between the images.
+    class ImageCompare
+    {
+    public:
+        // A 0.7 m viewing distance from a 4K monitor 0.7 m wide, FLIP's default.
+        static const float c_defaultPixelsPerDegree;
+
+        struct Result
+        {
+            double  rmse;
+            double  maxError;           // Largest difference of any channel.
+            UINT    maxErrorX;
+            UINT    maxErrorY;
+            double  meanFlip;
+            double  maxFlip;
+            UINT64  differentPixels;    // Any channel differs at all.
+        };
+
+        explicit ImageCompare(float pixelsPerDegree = c_defaultPixelsPerDegree);
+
+        Result Compare(const CpuFramebuffer& reference, const CpuFramebuffer& test);
+
+        // Per pixel errors of the last Compare() as false color. The FLIP image maps [0, 1]; the
+        // difference image shows the largest channel difference, red at scale and above.
+        void FillFlipImage(CpuFramebuffer* target) const;
+        void FillDifferenceImage(float scale, CpuFramebuffer* target) const;
+
+        // Accessors.
+        const std::vector<float>&   GetFlipErrors() const { return m_flip; }
+
+    private:
+        float                       m_pixelsPerDegree;
+        UINT                        m_width;
+        UINT                        m_height;
+        std::vector<float>          m_flip;
+        std::vector<float>          m_difference;
+    };
+}
@@ -0,0 +1,449 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "ImageFile.h"
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    // Deflate's window and longest match.
+    const UINT c_windowSize = 32768;
+    const UINT c_maxMatch = 258;
+    const UINT c_minMatch = 3;
+    const UINT c_hashBits = 15;
+
+    const UINT16 c_lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const UINT8 c_lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const UINT16 c_distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const UINT8 c_distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    UINT ReverseBits(UINT value, UINT count)
+    {
+        UINT reversed = 0;
+        for (UINT i = 0; i < count; i++)
+        {
+            reversed = (reversed << 1) | ((value >> i) & 1);
+        }
+        return reversed;
+    }
+
+    // The fixed Huffman codes of RFC 1951 3.2.6, bit reversed since deflate streams are written
+    // least significant bit first, and which length symbol covers each match length.
+    struct FixedCodes
+    {
+        UINT16  literalCode[288];
+        UINT8   literalBits[288];
+        UINT8   distanceCode[30];
+        UINT8   lengthSymbol[c_maxMatch + 1];
+
+        FixedCodes()
+        {
+            for (UINT symbol = 0; symbol < 288; symbol++)
+            {
+                UINT code, bits;
+                if (symbol < 144)      { code = 0x30 + symbol;          bits = 8; }
+                else if (symbol < 256) { code = 0x190 + symbol - 144;   bits = 9; }
+                else if (symbol < 280) { code = symbol - 256;           bits = 7; }
+                else                   { code = 0xC0 + symbol - 280;    bits = 8; }
+                literalCode[symbol] = static_cast<UINT16>(ReverseBits(code, bits));
+                literalBits[symbol] = static_cast<UINT8>(bits);
+            }
+            for (UINT symbol = 0; symbol < 30; symbol++)
+            {
+                distanceCode[symbol] = static_cast<UINT8>(ReverseBits(symbol, 5));
+            }
+            for (UINT symbol = 0; symbol < 29; symbol++)
+            {
+                UINT end = symbol + 1 < 29 ? c_lengthBase[symbol + 1] : c_maxMatch + 1;
+                for (UINT length = c_lengthBase[symbol]; length < end; length++)
+                {
+                    lengthSymbol[length] = static_cast<UINT8>(symbol);
+                }
+            }
+        }
+    };
+
+    UINT DistanceSymbol(UINT distance)
+    {
+        UINT d = distance - 1;
+        if (d < 4)
+        {
+            return d;
+        }
+        UINT highBit = 0;
+        while ((d >> (highBit + 1)) != 0)
+        {
+            highBit++;
+        }
+        return 2 * highBit + ((d >> (highBit - 1)) & 1);
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(vector<uint8_t>* output) : m_output(output), m_bits(0), m_count(0) {}
+
+        void Write(UINT value, UINT count)
+        {
+            m_bits |= static_cast<UINT64>(value) << m_count;
+            m_count += count;
+            while (m_count >= 8)
+            {
+                m_output->push_back(static_cast<uint8_t>(m_bits));
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void Flush()
+        {
+            if (m_count > 0)
+            {
+                m_output->push_back(static_cast<uint8_t>(m_bits));
+            }
+            m_bits = 0;
+            m_count = 0;
+        }
+
+    private:
+        vector<uint8_t>*    m_output;
+        UINT64              m_bits;
+        UINT                m_count;
+    };
+
+    // One fixed Huffman block. Every position probes the last one with the same three byte hash.
+    void Deflate(const vector<uint8_t>& data, vector<uint8_t>* output)
+    {
+        static const FixedCodes codes;
+        vector<INT32> lastPosition(1 << c_hashBits, -1);
+
+        BitWriter writer(output);
+        writer.Write(1, 1);     // BFINAL
+        writer.Write(1, 2);     // BTYPE fixed Huffman
+
+        const UINT size = static_cast<UINT>(data.size());
+        const uint8_t* bytes = data.data();
+        UINT i = 0;
+        while (i < size)
+        {
+            UINT matchLength = 0;
+            UINT matchDistance = 0;
+            if (i + c_minMatch <= size)
+            {
+                UINT hash = ((bytes[i] << 16 | bytes[i + 1] << 8 | bytes[i + 2]) * 2654435761u) >> (32 - c_hashBits);
+                INT32 candidate = lastPosition[hash];
+                lastPosition[hash] = static_cast<INT32>(i);
+                if (candidate >= 0 && i - candidate <= c_windowSize)
+                {
+                    UINT limit = min<UINT>(c_maxMatch, size - i);
+                    UINT length = 0;
+                    while (length < limit && bytes[candidate + length] == bytes[i + length])
+                    {
+                        length++;
+                    }
+                    if (length >= c_minMatch)
+                    {
+                        matchLength = length;
+                        matchDistance = i - candidate;
+                    }
+                }
+            }
+
+            if (matchLength)
+            {
+                UINT lengthSymbol = codes.lengthSymbol[matchLength];
+                writer.Write(codes.literalCode[257 + lengthSymbol], codes.literalBits[257 + lengthSymbol]);
+                writer.Write(matchLength - c_lengthBase[lengthSymbol], c_lengthExtra[lengthSymbol]);
+                UINT distanceSymbol = DistanceSymbol(matchDistance);
+                writer.Write(codes.distanceCode[distanceSymbol], 5);
+                writer.Write(matchDistance - c_distanceBase[distanceSymbol], c_distanceExtra[distanceSymbol]);
+                i += matchLength;
+            }
+            else
+            {
+                writer.Write(codes.literalCode[bytes[i]], codes.literalBits[bytes[i]]);
+                i++;
+            }
+        }
+        writer.Write(codes.literalCode[256], codes.literalBits[256]);
+        writer.Flush();
+    }
+
+    UINT32 Adler32(const vector<uint8_t>& data)
+    {
+        UINT32 a = 1, b = 0;
+        size_t i = 0;
+        while (i < data.size())
+        {
+            // 5552 bytes is the most that can be summed before b could overflow.
+            size_t end = min<size_t>(data.size(), i + 5552);
+            for (; i < end; i++)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    UINT32 Crc32(const uint8_t* data, size_t size, UINT32 crc = 0)
+    {
+        struct Table
+        {
+            UINT32 entries[256];
+            Table()
+            {
+                for (UINT32 n = 0; n < 256; n++)
+                {
+                    UINT32 c = n;
+                    for (UINT k = 0; k < 8; k++)
+                    {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[n] = c;
+                }
+            }
+        };
+        static const Table table;
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void AppendBigEndian32(vector<uint8_t>* output, UINT32 value)
+    {
+        uint8_t bytes[] = { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+        output->insert(output->end(), bytes, bytes + sizeof(bytes));
+    }
+
+    // The formats are little endian, as is every platform this builds for.
+    template <typename T>
+    void AppendLittleEndian(vector<uint8_t>* output, T value)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        output->insert(output->end(), bytes, bytes + sizeof(T));
+    }
+
+    void AppendString(vector<uint8_t>* output, const char* text)
+    {
+        output->insert(output->end(), text, text + strlen(text) + 1);
+    }
+
+    void AppendPngChunk(vector<uint8_t>* output, const char* type, const vector<uint8_t>& data)
+    {
+        AppendBigEndian32(output, static_cast<UINT32>(data.size()));
+        size_t typeStart = output->size();
+        output->insert(output->end(), type, type + 4);
+        output->insert(output->end(), data.begin(), data.end());
+        AppendBigEndian32(output, Crc32(output->data() + typeStart, output->size() - typeStart));
+    }
+
+    // An OpenEXR header attribute: name, type, size and value.
+    void AppendExrAttribute(vector<uint8_t>* output, const char* name, const char* type, const vector<uint8_t>& value)
+    {
+        AppendString(output, name);
+        AppendString(output, type);
+        AppendLittleEndian<INT32>(output, static_cast<INT32>(value.size()));
+        output->insert(output->end(), value.begin(), value.end());
+    }
+}
+
+void ImageFile::WritePpm(const wstring& path, UINT width, UINT height, const UINT32* rgba8)
+{
+    ofstream file(path, ios::binary);
+    ThrowIfFalse(file.is_open(), L"ImageFile: couldn't open the file for writing.\n");
+
+    file << "P6\n" << width << ' ' << height << "\n255\n";
+    vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    for (UINT y = 0; y < height; y++)
+    {
+        const UINT32* pixels = rgba8 + static_cast<size_t>(y) * width;
+        for (UINT x = 0; x < width; x++)
+        {
+            row[3 * x + 0] = static_cast<uint8_t>(pixels[x]);
+            row[3 * x + 1] = static_cast<uint8_t>(pixels[x] >> 8);
+            row[3 * x + 2] = static_cast<uint8_t>(pixels[x] >> 16);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    ThrowIfFalse(file.good(), L"ImageFile: writing the file failed.\n");
+}
+
+void ImageFile::EncodePng(UINT width, UINT height, const UINT32* rgba8, vector<uint8_t>* encoded)
+{
+    // Each row is its filter type followed by the differences to the pixel on the left.
+    const size_t rowSize = 1 + static_cast<size_t>(width) * 3;
+    vector<uint8_t> filtered(rowSize * height);
+    for (UINT y = 0; y < height; y++)
+    {
+        const UINT32* pixels = rgba8 + static_cast<size_t>(y) * width;
+        uint8_t* row = filtered.data() + y * rowSize;
+        row[0] = 1;     // Sub
+        UINT32 left = 0;
+        for (UINT x = 0; x < width; x++)
+        {
+            UINT32 pixel = pixels[x];
+            row[1 + 3 * x + 0] = static_cast<uint8_t>(pixel - left);
+            row[1 + 3 * x + 1] = static_cast<uint8_t>((pixel >> 8) - (left >> 8));
+            row[1 + 3 * x + 2] = static_cast<uint8_t>((pixel >> 16) - (left >> 16));
+            left = pixel;
+        }
+    }
+
+    // zlib: deflate with a 32K window, no preset dictionary, then the Adler-32 of the data.
+    vector<uint8_t> compressed = { 0x78, 0x01 };
+    Deflate(filtered, &compressed);
+    AppendBigEndian32(&compressed, Adler32(filtered));
+
+    vector<uint8_t> header;
+    AppendBigEndian32(&header, width);
+    AppendBigEndian32(&header, height);
+    uint8_t format[] = { 8, 2, 0, 0, 0 };   // 8 bits per channel RGB, deflate, adaptive filters, not interlaced.
+    header.insert(header.end(), format, format + sizeof(format));
+
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    encoded->assign(signature, signature + sizeof(signature));
+    AppendPngChunk(encoded, "IHDR", header);
+    AppendPngChunk(encoded, "IDAT", compressed);
+    AppendPngChunk(encoded, "IEND", vector<uint8_t>());
+}
+
+void ImageFile::EncodePfm(UINT width, UINT height, const XMFLOAT4* rgba32, vector<uint8_t>* encoded)
+{
+    // A negative scale marks the data little endian.
+    string header = "PF\n" + to_string(width) + " " + to_string(height) + "\n-1.0\n";
+    encoded->assign(header.begin(), header.end());
+    encoded->reserve(header.size() + static_cast<size_t>(width) * height * 3 * sizeof(float));
+    for (UINT y = height; y-- > 0;)
+    {
+        const XMFLOAT4* pixels = rgba32 + static_cast<size_t>(y) * width;
+        for (UINT x = 0; x < width; x++)
+        {
+            AppendLittleEndian(encoded, pixels[x].x);
+            AppendLittleEndian(encoded, pixels[x].y);
+            AppendLittleEndian(encoded, pixels[x].z);
+        }
+    }
+}
+
+void ImageFile::EncodeExr(UINT width, UINT height, const XMFLOAT4* rgba32, vector<uint8_t>* encoded)
+{
+    encoded->clear();
+    AppendLittleEndian<UINT32>(encoded, 20000630);      // Magic number.
+    AppendLittleEndian<UINT32>(encoded, 2);             // Version 2, single part scanline.
+
+    // Channels are listed, and stored, in alphabetical order.
+    vector<uint8_t> channels;
+    for (const char* name : { "B", "G", "R" })
+    {
+        AppendString(&channels, name);
+        AppendLittleEndian<INT32>(&channels, 2);        // FLOAT
+        AppendLittleEndian<INT32>(&channels, 0);        // pLinear and reserved.
+        AppendLittleEndian<INT32>(&channels, 1);        // xSampling
+        AppendLittleEndian<INT32>(&channels, 1);        // ySampling
+    }
+    channels.push_back(0);
+
+    vector<uint8_t> window;
+    for (INT32 value : { 0, 0, static_cast<INT32>(width) - 1, static_cast<INT32>(height) - 1 })
+    {
+        AppendLittleEndian(&window, value);
+    }
+    vector<uint8_t> one, center;
+    AppendLittleEndian(&one, 1.0f);
+    AppendLittleEndian(&center, 0.0f);
+    AppendLittleEndian(&center, 0.0f);
+
+    AppendExrAttribute(encoded, "channels", "chlist", channels);
+    AppendExrAttribute(encoded, "compression", "compression", vector<uint8_t>(1, 0));   // NO_COMPRESSION
+    AppendExrAttribute(encoded, "dataWindow", "box2i", window);
+    AppendExrAttribute(encoded, "displayWindow", "box2i", window);
+    AppendExrAttribute(encoded, "lineOrder", "lineOrder", vector<uint8_t>(1, 0));       // INCREASING_Y
+    AppendExrAttribute(encoded, "pixelAspectRatio", "float", one);
+    AppendExrAttribute(encoded, "screenWindowCenter", "v2f", center);
+    AppendExrAttribute(encoded, "screenWindowWidth", "float", one);
+    encoded->push_back(0);
+
+    // Uncompressed files hold one scanline per block: its y, its size and then each channel.
+    const UINT32 blockDataSize = width * 3 * sizeof(float);
+    const UINT64 firstBlock = encoded->size() + static_cast<UINT64>(height) * sizeof(UINT64);
+    for (UINT y = 0; y < height; y++)
+    {
+        AppendLittleEndian<UINT64>(encoded, firstBlock + static_cast<UINT64>(y) * (2 * sizeof(INT32) + blockDataSize));
+    }
+    encoded->reserve(encoded->size() + static_cast<size_t>(height) * (2 * sizeof(INT32) + blockDataSize));
+    for (UINT y = 0; y < height; y++)
+    {
+        AppendLittleEndian<INT32>(encoded, static_cast<INT32>(y));
+        AppendLittleEndian<UINT32>(encoded, blockDataSize);
+        const XMFLOAT4* pixels = rgba32 + static_cast<size_t>(y) * width;
+        for (UINT x = 0; x < width; x++) { AppendLittleEndian(encoded, pixels[x].z); }
+        for (UINT x = 0; x < width; x++) { AppendLittleEndian(encoded, pixels[x].y); }
+        for (UINT x = 0; x < width; x++) { AppendLittleEndian(encoded, pixels[x].x); }
+    }
+}
+
+void ImageFile::WriteFile(const wstring& path, const vector<uint8_t>& data)
+{
+    ofstream file(path, ios::binary);
+    ThrowIfFalse(file.is_open(), L"ImageFile: couldn't open the file for writing.\n");
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    ThrowIfFalse(file.good(), L"ImageFile: writing the file failed.\n");
+}
+
+void ImageFile::ReadPfm(const wstring& path, UINT* width, UINT* height, vector<XMFLOAT4>* rgba32)
+{
+    ifstream file(path, ios::binary);
+    ThrowIfFalse(file.is_open(), L"ImageFile: couldn't open the file for reading.\n");
+
+    string type;
+    double scale = 0.0;
+    file >> type >> *width >> *height >> scale;
+    ThrowIfFalse(file.good() && (type == "PF" || type == "Pf") && *width > 0 && *height > 0 && scale != 0.0, L"ImageFile: not a PFM file.\n");
+    // Exactly one whitespace character separates the header from the data.
+    file.get();
+
+    const UINT channels = type == "PF" ? 3 : 1;
+    const bool swapBytes = scale > 0.0;     // Positive scales are big endian.
+    vector<float> row(static_cast<size_t>(*width) * channels);
+    rgba32->resize(static_cast<size_t>(*width) * *height);
+    for (UINT y = *height; y-- > 0;)
+    {
+        file.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float));
+        ThrowIfFalse(file.good(), L"ImageFile: the PFM file is truncated.\n");
+        if (swapBytes)
+        {
+            for (float& value : row)
+            {
+                uint8_t* bytes = reinterpret_cast<uint8_t*>(&value);
+                swap(bytes[0], bytes[3]);
+                swap(bytes[1], bytes[2]);
+            }
+        }
+        XMFLOAT4* pixels = rgba32->data() + static_cast<size_t>(y) * *width;
+        for (UINT x = 0; x < *width; x++)
+        {
+            const float* value = &row[x * channels];
+            pixels[x] = channels == 3 ? XMFLOAT4(value[0], value[1], value[2], 1.0f) : XMFLOAT4(value[0], value[0], value[0], 1.0f);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// ImageFile.h - Writes CPU images to disk
+//
+
+#pragma once
+
+namespace DX
+{
+    // rgba8 is DXGI_FORMAT_R8G8B8A8_UNORM and rgba32 XMFLOAT4, both with rows top to bottom and
+    // no padding. Every format drops alpha: the shaders leave it undefined for misses. The
+    // Encode functions only touch memory, so callers can time encoding apart from the disk.
+    class ImageFile
+    {
+    public:
+        // Binary PPM (P6).
+        static void WritePpm(const std::wstring& path, UINT width, UINT height, const UINT32* rgba8);
+
+        // 8-bit RGB PNG. Rows use the Sub filter and are deflated with fixed Huffman codes and a
+        // greedy single probe match search, far from the smallest files but quick to produce.
+        static void EncodePng(UINT width, UINT height, const UINT32* rgba8, std::vector<uint8_t>* encoded);
+        // Little endian RGB PFM, which stores rows bottom to top.
+        static void EncodePfm(UINT width, UINT height, const DirectX::XMFLOAT4* rgba32, std::vector<uint8_t>* encoded);
+        // Uncompressed scanline OpenEXR with 32-bit float R, G and B channels.
+        static void EncodeExr(UINT width, UINT height, const DirectX::XMFLOAT4* rgba32, std::vector<uint8_t>* encoded);
+
+        static void WriteFile(const std::wstring& path, const std::vector<uint8_t>& data);
+
+        // RGB or grayscale PFM of either byte order, rows returned top to bottom with alpha 1.
+        static void ReadPfm(const std::wstring& path, UINT* width, UINT* height, std::vector<DirectX::XMFLOAT4>* rgba32);
+    };
+}
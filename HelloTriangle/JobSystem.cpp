@@ -0,0 +1,143 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "JobSystem.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace std;
+
+JobSystem::JobSystem(UINT workerCount) :
+    m_quit(false),
+    m_job(nullptr),
+    m_count(0),
+    m_nextIndex(0),
+    m_activeThreads(0),
+    m_generation(0)
+{
+    if (workerCount == 0)
+    {
+        workerCount = max(thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    m_workers.reserve(workerCount);
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        m_workers.emplace_back(&JobSystem::WorkerMain, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_workAvailable.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::ParallelFor(UINT count, const Job& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Not worth waking anyone for a single job.
+    if (count == 1 || m_workers.empty())
+    {
+        for (UINT i = 0; i < count; i++)
+        {
+            job(i, 0);
+        }
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_nextIndex = 0;
+        m_activeThreads = 1;
+        m_exception = nullptr;
+        m_generation++;
+    }
+    m_workAvailable.notify_all();
+
+    RunJobs(0);
+
+    unique_lock<mutex> lock(m_mutex);
+    m_activeThreads--;
+    m_workDone.wait(lock, [this] { return m_activeThreads == 0; });
+    m_job = nullptr;
+
+    if (m_exception)
+    {
+        rethrow_exception(m_exception);
+    }
+}
+
+void JobSystem::WorkerMain(UINT threadIndex)
+{
+    TraceRecorder::SetThreadName("Job worker");
+
+    UINT64 generation = 0;
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&] { return m_quit || (m_job && m_generation != generation); });
+            if (m_quit)
+            {
+                return;
+            }
+            generation = m_generation;
+            m_activeThreads++;
+        }
+
+        RunJobs(threadIndex);
+
+        bool last;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            last = --m_activeThreads == 0;
+        }
+        if (last)
+        {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+void JobSystem::RunJobs(UINT threadIndex)
+{
+    for (UINT index = m_nextIndex++; index < m_count; index = m_nextIndex++)
+    {
+        try
+        {
+            (*m_job)(index, threadIndex);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (!m_exception)
+            {
+                m_exception = current_exception();
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// JobSystem.h - A fixed pool of worker threads running parallel loops
+//
+
+#pragma once
+
+#include <thread>
+#include <condition_variable>
+
+namespace DX
+{
+    // Worker threads are started once and sleep between loops. ParallelFor() hands out indices
+    // to the workers and the calling thread until all are taken, then waits for the last one.
+    // Each job is told which thread runs it: 0 is the calling thread, 1..GetWorkerCount() the
+    // workers. Jobs can index per-thread resources with it, e.g. command allocators, since a
+    // thread runs one job at a time.
+    class JobSystem
+    {
+    public:
+        typedef std::function<void(UINT index, UINT threadIndex)> Job;
+
+        // workerCount 0 starts one worker less than there are hardware threads.
+        explicit JobSystem(UINT workerCount = 0);
+        ~JobSystem();
+
+        // Runs job for every index in [0, count) and returns once all have finished. The first
+        // exception thrown by a job is rethrown here. Not reentrant, jobs must not call it.
+        void ParallelFor(UINT count, const Job& job);
+
+        // Accessors.
+        UINT GetWorkerCount() const { return static_cast<UINT>(m_workers.size()); }
+        UINT GetThreadCount() const { return GetWorkerCount() + 1; }
+
+    private:
+        void WorkerMain(UINT threadIndex);
+        void RunJobs(UINT threadIndex);
+
+        std::vector<std::thread>    m_workers;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_workAvailable;
+        std::condition_variable     m_workDone;
+        bool                        m_quit;
+
+        // The loop in progress, m_generation changes with every ParallelFor().
+        const Job*                  m_job;
+        UINT                        m_count;
+        std::atomic<UINT>           m_nextIndex;
+        UINT                        m_activeThreads;
+        UINT64                      m_generation;
+        std::exception_ptr          m_exception;
+    };
+}
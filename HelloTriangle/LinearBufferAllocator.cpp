@@ -0,0 +1,234 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "LinearBufferAllocator.h"
+
+using namespace DX;
+
+namespace
+{
+    inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+LinearBufferAllocator::LinearBufferAllocator() :
+    m_device(nullptr),
+    m_heapType(D3D12_HEAP_TYPE_UPLOAD),
+    m_initialState(D3D12_RESOURCE_STATE_GENERIC_READ),
+    m_resourceFlags(D3D12_RESOURCE_FLAG_NONE),
+    m_pageSize(c_defaultPageSize),
+    m_nextPage(0),
+    m_currentPage(nullptr),
+    m_allocatedBytes(0),
+    m_reservedBytes(0),
+    m_created(false)
+{
+}
+
+LinearBufferAllocator::~LinearBufferAllocator()
+{
+    Release();
+}
+
+void LinearBufferAllocator::Create(ID3D12Device* device, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES initialState,
+    D3D12_RESOURCE_FLAGS resourceFlags, UINT64 pageSize, LPCWSTR name)
+{
+    Release();
+
+    m_device = device;
+    m_heapType = heapType;
+    m_initialState = initialState;
+    m_resourceFlags = resourceFlags;
+    // Buffers are placed on 64KB boundaries, so rounding pages up wastes nothing.
+    m_pageSize = AlignUp(pageSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    m_name = name ? name : L"LinearBufferAllocator";
+    m_created = true;
+}
+
+void LinearBufferAllocator::CreatePageResource(Page* page)
+{
+    ThrowIfFalse(m_device != nullptr, L"LinearBufferAllocator: pages need a device, pass one to Create().\n");
+    auto heapProperties = CD3DX12_HEAP_PROPERTIES(m_heapType);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(page->size, m_resourceFlags);
+    ThrowIfFailed(m_device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        m_initialState,
+        nullptr,
+        IID_PPV_ARGS(&page->resource)));
+
+    wchar_t name[64] = {};
+    swprintf_s(name, L"%s page %u", m_name.c_str(), GetPageCount());
+    page->resource->SetName(name);
+
+    page->gpuBase = page->resource->GetGPUVirtualAddress();
+    page->cpuBase = nullptr;
+    if (m_heapType == D3D12_HEAP_TYPE_UPLOAD)
+    {
+        // We don't unmap this until the page is released. Keeping upload buffers mapped is okay.
+        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+        ThrowIfFailed(page->resource->Map(0, &readRange, reinterpret_cast<void**>(&page->cpuBase)));
+    }
+}
+
+// Must be called with m_pageMutex held.
+LinearBufferAllocator::Page* LinearBufferAllocator::CreatePage(UINT64 size, std::vector<std::unique_ptr<Page>>* pages)
+{
+    std::unique_ptr<Page> page(new Page());
+    page->size = size;
+    page->offset = 0;
+    CreatePageResource(page.get());
+
+    m_reservedBytes += size;
+    pages->push_back(std::move(page));
+    return pages->back().get();
+}
+
+// Returns the page to continue allocating from once exhaustedPage is full.
+// Several threads can run out of room at the same time, only the first one moves the allocator on.
+LinearBufferAllocator::Page* LinearBufferAllocator::AcquirePage(Page* exhaustedPage, UINT64 minSize)
+{
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+
+    Page* current = m_currentPage.load();
+    if (current != exhaustedPage)
+    {
+        return current;
+    }
+
+    // Reuse pages rewound by Reset() before growing.
+    while (m_nextPage < m_pages.size())
+    {
+        Page* page = m_pages[m_nextPage++].get();
+        if (page->size >= minSize)
+        {
+            m_currentPage.store(page);
+            return page;
+        }
+    }
+
+    Page* page = CreatePage(m_pageSize, &m_pages);
+    m_nextPage = m_pages.size();
+    m_currentPage.store(page);
+    return page;
+}
+
+// Dedicated pages are kept apart from the regular ones: made current, a full one would end the
+// regular page it replaced early and leave its own tail to whatever comes next.
+LinearBufferAllocator::Page* LinearBufferAllocator::AcquireDedicatedPage(UINT64 size)
+{
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+
+    // The smallest page rewound by Reset() that fits.
+    Page* best = nullptr;
+    for (auto& page : m_dedicatedPages)
+    {
+        if (page->offset.load() == 0 && page->size >= size && (!best || page->size < best->size))
+        {
+            best = page.get();
+        }
+    }
+    if (!best)
+    {
+        best = CreatePage(AlignUp(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT), &m_dedicatedPages);
+    }
+    best->offset = size;
+    return best;
+}
+
+BufferAllocation LinearBufferAllocator::SubAllocate(Page* page, UINT64 offset, UINT64 size)
+{
+    BufferAllocation allocation;
+    allocation.resource = page->resource.Get();
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.gpuAddress = page->gpuBase + offset;
+    allocation.cpuAddress = page->cpuBase ? page->cpuBase + offset : nullptr;
+    return allocation;
+}
+
+BufferAllocation LinearBufferAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+    ThrowIfFalse(m_created, L"LinearBufferAllocator used before Create().\n");
+    ThrowIfFalse(size > 0 && alignment > 0 && alignment <= D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+    // Page bases are 64KB aligned, so aligning the offset aligns the GPU address to any power of
+    // two. Structured buffer alignments such as 48 only hold for the offset, which is what a
+    // buffer SRV's first element is counted from.
+    if (size > m_pageSize)
+    {
+        Page* dedicated = AcquireDedicatedPage(size);
+        m_allocatedBytes += size;
+        return SubAllocate(dedicated, 0, size);
+    }
+
+    Page* page = m_currentPage.load(std::memory_order_acquire);
+    for (;;)
+    {
+        if (page)
+        {
+            UINT64 offset = page->offset.load(std::memory_order_relaxed);
+            UINT64 alignedOffset = AlignUp(offset, alignment);
+            while (alignedOffset + size <= page->size)
+            {
+                if (page->offset.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_acq_rel))
+                {
+                    m_allocatedBytes += size;
+                    return SubAllocate(page, alignedOffset, size);
+                }
+                alignedOffset = AlignUp(offset, alignment);
+            }
+        }
+        // A page taken from the start is aligned for anything, the size alone has to fit.
+        page = AcquirePage(page, size);
+    }
+}
+
+void LinearBufferAllocator::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    for (auto& page : m_pages)
+    {
+        page->offset = 0;
+    }
+    for (auto& page : m_dedicatedPages)
+    {
+        page->offset = 0;
+    }
+    m_nextPage = 0;
+    m_currentPage.store(nullptr);
+    m_allocatedBytes = 0;
+}
+
+void LinearBufferAllocator::Release()
+{
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    for (auto* pages : { &m_pages, &m_dedicatedPages })
+    {
+        for (auto& page : *pages)
+        {
+            if (page->cpuBase && page->resource)
+            {
+                page->resource->Unmap(0, nullptr);
+            }
+        }
+    }
+    m_pages.clear();
+    m_dedicatedPages.clear();
+    m_nextPage = 0;
+    m_currentPage.store(nullptr);
+    m_allocatedBytes = 0;
+    m_reservedBytes = 0;
+}
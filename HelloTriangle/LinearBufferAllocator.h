@@ -0,0 +1,130 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// LinearBufferAllocator.h - Paged linear sub-allocation of buffer memory
+//
+
+#pragma once
+
+namespace DX
+{
+    // A sub-range of a page owned by LinearBufferAllocator.
+    struct BufferAllocation
+    {
+        ID3D12Resource*             resource;
+        UINT64                      offset;
+        UINT64                      size;
+        D3D12_GPU_VIRTUAL_ADDRESS   gpuAddress;
+        uint8_t*                    cpuAddress;     // Only set for upload heap allocations.
+
+        BufferAllocation() : resource(nullptr), offset(0), size(0), gpuAddress(0), cpuAddress(nullptr) {}
+
+        bool IsValid() const { return resource != nullptr; }
+    };
+
+    // Placement alignments for the kinds of data the sample stores in sub-allocated buffers.
+    namespace BufferAlignment
+    {
+        const UINT64 ConstantBuffer = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+        const UINT64 AccelerationStructure = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+        const UINT64 InstanceDescs = D3D12_RAYTRACING_INSTANCE_DESCS_BYTE_ALIGNMENT;
+        const UINT64 RawBuffer = D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT;
+
+        // Buffer SRVs address their first element by index, so a structured buffer has to start
+        // on a multiple of its stride. Raw buffers (elementSize == 0) need 16 byte alignment.
+        inline UINT64 ShaderResource(UINT elementSize)
+        {
+            if (elementSize == 0)
+            {
+                return RawBuffer;
+            }
+            UINT64 a = elementSize, b = RawBuffer;
+            while (b != 0)
+            {
+                UINT64 t = a % b;
+                a = b;
+                b = t;
+            }
+            return elementSize / a * RawBuffer;
+        }
+    }
+
+    // Hands out BufferAllocations from a list of large committed buffers (pages).
+    // Allocation is a lock-free bump of the current page's offset, so any number of threads can
+    // allocate concurrently; only switching to a new page takes a lock. Upload heap pages stay
+    // persistently mapped.
+    // Allocations are never freed individually: Reset() rewinds every page once the GPU is done
+    // with their contents and Release() returns the memory.
+    class LinearBufferAllocator
+    {
+    public:
+        static const UINT64 c_defaultPageSize = 4 * 1024 * 1024;
+
+        LinearBufferAllocator();
+        virtual ~LinearBufferAllocator();
+
+        // device may be null when a derived class creates the pages, see CreatePageResource().
+        void Create(ID3D12Device* device, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES initialState,
+            D3D12_RESOURCE_FLAGS resourceFlags = D3D12_RESOURCE_FLAG_NONE, UINT64 pageSize = c_defaultPageSize, LPCWSTR name = nullptr);
+
+        // Thread safe. Allocations larger than the page size get a dedicated page, which only ever
+        // holds that one allocation and is reused for another large one after Reset().
+        BufferAllocation Allocate(UINT64 size, UINT64 alignment);
+
+        // Not thread safe, must not overlap with Allocate().
+        void Reset();
+        void Release();
+
+        // Accessors.
+        UINT64  GetPageSize() const { return m_pageSize; }
+        UINT64  GetAllocatedBytes() const { return m_allocatedBytes.load(); }
+        UINT64  GetReservedBytes() const { return m_reservedBytes.load(); }
+        UINT    GetPageCount() const { return static_cast<UINT>(m_pages.size() + m_dedicatedPages.size()); }
+
+    protected:
+        struct Page
+        {
+            Microsoft::WRL::ComPtr<ID3D12Resource>  resource;
+            D3D12_GPU_VIRTUAL_ADDRESS               gpuBase;
+            uint8_t*                                cpuBase;
+            UINT64                                  size;
+            std::atomic<UINT64>                     offset;
+        };
+
+        // Creates the buffer backing a page and fills in its base addresses, with m_device.
+        // Overridable so the allocation logic can run against a fake heap, without a device.
+        // Called with the page mutex held.
+        virtual void CreatePageResource(Page* page);
+
+        ID3D12Device*                               m_device;
+        D3D12_HEAP_TYPE                             m_heapType;
+        D3D12_RESOURCE_STATES                       m_initialState;
+        D3D12_RESOURCE_FLAGS                        m_resourceFlags;
+        std::wstring                                m_name;
+
+    private:
+        static BufferAllocation SubAllocate(Page* page, UINT64 offset, UINT64 size);
+        Page* CreatePage(UINT64 size, std::vector<std::unique_ptr<Page>>* pages);
+        Page* AcquirePage(Page* exhaustedPage, UINT64 minSize);
+        Page* AcquireDedicatedPage(UINT64 size);
+
+        UINT64                                      m_pageSize;
+        std::vector<std::unique_ptr<Page>>          m_pages;
+        std::vector<std::unique_ptr<Page>>          m_dedicatedPages;   // Never current, see AcquireDedicatedPage().
+        size_t                                      m_nextPage;
+        std::atomic<Page*>                          m_currentPage;
+        std::mutex                                  m_pageMutex;
+        std::atomic<UINT64>                         m_allocatedBytes;
+        std::atomic<UINT64>                         m_reservedBytes;
+        bool                                        m_created;
+    };
+}
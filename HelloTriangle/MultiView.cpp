@@ -0,0 +1,210 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "MultiView.h"
+#include "ImageFile.h"
+#include "StepTimer.h"
+#include "TraceRecorder.h"
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+MultiView::MultiView() :
+    m_viewCount(0),
+    m_outputWidth(0),
+    m_outputHeight(0),
+    m_columns(1),
+    m_viewWidth(0),
+    m_viewHeight(0)
+{
+}
+
+void MultiView::Reset(UINT viewCount, UINT outputWidth, UINT outputHeight)
+{
+    ThrowIfFalse(viewCount <= MaxViewCount, L"MultiView: too many views.\n");
+    m_viewCount = viewCount;
+    // The smallest square grid that holds them, less the rows it doesn't need.
+    m_columns = 1;
+    while (m_columns * m_columns < viewCount)
+    {
+        m_columns++;
+    }
+    m_cameras.clear();
+    SetOutputSize(outputWidth, outputHeight);
+}
+
+void MultiView::SetOutputSize(UINT outputWidth, UINT outputHeight)
+{
+    m_outputWidth = outputWidth;
+    m_outputHeight = outputHeight;
+    if (!IsEnabled())
+    {
+        m_viewWidth = outputWidth;
+        m_viewHeight = outputHeight;
+        return;
+    }
+    UINT rows = (m_viewCount + m_columns - 1) / m_columns;
+    m_viewWidth = max(outputWidth / m_columns, 1u);
+    m_viewHeight = max(outputHeight / rows, 1u);
+}
+
+void MultiView::Update(const XMFLOAT3& eye, const XMFLOAT3& center, const XMFLOAT3& up, float fovY)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    XMVECTOR target = XMLoadFloat3(&center);
+    XMVECTOR axis = XMVector3Normalize(XMLoadFloat3(&up));
+    XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&eye), target);
+    float aspectRatio = static_cast<float>(m_viewWidth) / m_viewHeight;
+    XMMATRIX proj = XMMatrixPerspectiveFovRH(fovY, aspectRatio, 0.1f, 1000.0f);
+
+    m_cameras.resize(m_viewCount);
+    for (UINT i = 0; i < m_viewCount; i++)
+    {
+        XMVECTOR position = XMVectorAdd(target, XMVector3Transform(offset, XMMatrixRotationAxis(axis, XM_2PI * i / m_viewCount)));
+        XMMATRIX view = XMMatrixLookAtRH(position, target, axis);
+        XMStoreFloat4x4(&m_cameras[i].projectionToWorld, XMMatrixInverse(nullptr, view * proj));
+        XMStoreFloat3(&m_cameras[i].position, position);
+    }
+}
+
+void MultiView::GetConstants(MultiViewConstantBuffer* constants) const
+{
+    for (UINT i = 0; i < static_cast<UINT>(m_cameras.size()); i++)
+    {
+        constants->views[i].projectionToWorld = XMLoadFloat4x4(&m_cameras[i].projectionToWorld);
+        constants->views[i].cameraPosition = XMVectorSetW(XMLoadFloat3(&m_cameras[i].position), 0.0f);
+    }
+}
+
+void MultiView::RenderCpu(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, CpuFramebuffer* target,
+    JobSystem* jobs) const
+{
+    TRACE_SCOPE("MultiView::RenderCpu");
+    RenderViews(tracer, vertices, indices, 0, m_viewCount, target, jobs);
+}
+
+MultiView::Statistics MultiView::Analyze(const SceneGenerator& scene, const wstring& prefix, JobSystem* jobs) const
+{
+    TRACE_SCOPE("MultiView::Analyze");
+    ThrowIfFalse(IsEnabled() && m_cameras.size() == m_viewCount, L"MultiView: no views to analyze.\n");
+    Statistics statistics = {};
+    const SceneVertex* vertices = scene.GetVertices().data();
+    const UINT32* indices = scene.GetIndices().data();
+
+    // Every view shares one build and one pass over all their rows.
+    UINT64 start = StepTimer::GetCurrentTicks();
+    CpuTracer tracer;
+    tracer.Build(vertices, sizeof(SceneVertex), indices, scene.GetTriangleCount(),
+        scene.GetInstanceTransforms().data(), scene.GetInstanceCount());
+    statistics.buildSeconds = StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - start);
+
+    CpuFramebuffer batched;
+    batched.Resize(m_outputWidth, m_outputHeight);
+    start = StepTimer::GetCurrentTicks();
+    RenderViews(tracer, vertices, indices, 0, m_viewCount, &batched, jobs);
+    statistics.batchedSeconds = StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - start) + statistics.buildSeconds;
+
+    // A frame per view: the acceleration structure is rebuilt each time, as the app does per
+    // frame, and each view waits on the last one's pass.
+    CpuFramebuffer separate;
+    separate.Resize(m_outputWidth, m_outputHeight);
+    start = StepTimer::GetCurrentTicks();
+    for (UINT view = 0; view < m_viewCount; view++)
+    {
+        CpuTracer viewTracer;
+        viewTracer.Build(vertices, sizeof(SceneVertex), indices, scene.GetTriangleCount(),
+            scene.GetInstanceTransforms().data(), scene.GetInstanceCount());
+        RenderViews(viewTracer, vertices, indices, view, 1, &separate, jobs);
+    }
+    statistics.separateSeconds = StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - start);
+
+    statistics.identical = true;
+    for (UINT y = 0; y < m_outputHeight && statistics.identical; y++)
+    {
+        statistics.identical = memcmp(batched.GetRow(y), separate.GetRow(y), m_outputWidth * sizeof(XMFLOAT4)) == 0;
+    }
+
+    vector<UINT32> rgba8(static_cast<size_t>(m_outputWidth) * m_outputHeight);
+    batched.ConvertToRgba8(rgba8.data());
+    ImageFile::WritePpm(prefix + L"_views.ppm", m_outputWidth, m_outputHeight, rgba8.data());
+
+    ofstream file(prefix + L"_stats.json");
+    ThrowIfFalse(file.is_open(), L"MultiView: couldn't open the statistics file.\n");
+    double rays = static_cast<double>(m_viewWidth) * m_viewHeight * m_viewCount;
+    file << fixed << setprecision(6)
+        << "{\n  \"views\": " << m_viewCount
+        << ",\n  \"columns\": " << m_columns
+        << ",\n  \"view_width\": " << m_viewWidth
+        << ",\n  \"view_height\": " << m_viewHeight
+        << ",\n  \"rays\": " << static_cast<UINT64>(rays)
+        << ",\n  \"threads\": " << (jobs ? jobs->GetThreadCount() : 1u)
+        << ",\n  \"build_ms\": " << 1000.0 * statistics.buildSeconds
+        << ",\n  \"batched_ms\": " << 1000.0 * statistics.batchedSeconds
+        << ",\n  \"separate_ms\": " << 1000.0 * statistics.separateSeconds
+        << ",\n  \"batched_mrays_per_second\": " << (statistics.batchedSeconds > 0.0 ? rays / statistics.batchedSeconds / 1e6 : 0.0)
+        << ",\n  \"separate_mrays_per_second\": " << (statistics.separateSeconds > 0.0 ? rays / statistics.separateSeconds / 1e6 : 0.0)
+        << ",\n  \"speedup\": " << (statistics.batchedSeconds > 0.0 ? statistics.separateSeconds / statistics.batchedSeconds : 0.0)
+        << ",\n  \"identical\": " << (statistics.identical ? "true" : "false")
+        << "\n}\n";
+    return statistics;
+}
+
+wstring MultiView::GetStatisticsString(const Statistics& statistics, UINT viewCount)
+{
+    wstringstream stream;
+    stream << fixed << setprecision(2)
+        << L"Multi-view: " << viewCount << L" views\n"
+        << L"  batched " << 1000.0 * statistics.batchedSeconds << L" ms (" << 1000.0 * statistics.buildSeconds << L" ms building), "
+        << L"a frame per view " << 1000.0 * statistics.separateSeconds << L" ms, "
+        << (statistics.batchedSeconds > 0.0 ? statistics.separateSeconds / statistics.batchedSeconds : 0.0) << L"x\n"
+        << L"  images " << (statistics.identical ? L"identical" : L"differ") << L"\n";
+    return stream.str();
+}
+
+void MultiView::RenderViews(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, UINT firstView, UINT viewCount,
+    CpuFramebuffer* target, JobSystem* jobs) const
+{
+    ThrowIfFalse(target->GetWidth() >= m_columns * m_viewWidth, L"MultiView: the target is smaller than the view grid.\n");
+    // One job per row of a view, so the threads stay busy across the views' boundaries.
+    auto job = [&](UINT row, UINT)
+    {
+        TRACE_SCOPE("MultiView::Row");
+        UINT view = firstView + row / m_viewHeight;
+        UINT y = row % m_viewHeight;
+        UINT left = view % m_columns * m_viewWidth;
+        XMFLOAT4* pixels = target->GetRow(view / m_columns * m_viewHeight + y) + left;
+        for (UINT x = 0; x < m_viewWidth; x++)
+        {
+            CpuHit hit;
+            CpuRenderer::TraceSample(tracer, vertices, indices, m_cameras[view], m_viewWidth, m_viewHeight, x, y, 0.5f, 0.5f,
+                &pixels[x], &hit, nullptr);
+        }
+    };
+    UINT rowCount = viewCount * m_viewHeight;
+    if (jobs)
+    {
+        jobs->ParallelFor(rowCount, job);
+    }
+    else
+    {
+        for (UINT row = 0; row < rowCount; row++)
+        {
+            job(row, 0);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// MultiView.h - Many cameras traced by one dispatch, laid out in a grid of the output
+//
+
+#pragma once
+
+#include "RaytracingHlslCompat.h"
+#include "CpuRenderer.h"
+
+namespace DX
+{
+    // A turntable of viewCount cameras: view i is the camera orbited about the up axis through
+    // its look at point by i / viewCount of a turn, view 0 is the camera itself. The views share
+    // the output as a grid of equally sized cells, as close to square as their count allows, and
+    // are traced by one DispatchRays() with a depth of viewCount; Raytracing.hlsl picks the
+    // camera with the z of the dispatch index and writes to the view's cell.
+    class MultiView
+    {
+    public:
+        struct Statistics
+        {
+            double  buildSeconds;           // One CpuTracer build.
+            double  batchedSeconds;         // The build and every view in one pass.
+            double  separateSeconds;        // A build and a pass per view.
+            bool    identical;              // The batched and separate images match.
+        };
+
+        MultiView();
+
+        // viewCount 0 turns it off, the sizes are then the output's.
+        void Reset(UINT viewCount, UINT outputWidth, UINT outputHeight);
+        void SetOutputSize(UINT outputWidth, UINT outputHeight);
+        // The cameras from the main camera's look at, with the fovY the app projects with.
+        void Update(const DirectX::XMFLOAT3& eye, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& up, float fovY);
+        void GetConstants(MultiViewConstantBuffer* constants) const;
+
+        // Traces every view into its cell of target, one primary ray per pixel shaded like
+        // CpuRenderer, with one ParallelFor over the rows of all views.
+        void RenderCpu(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, CpuFramebuffer* target,
+            JobSystem* jobs = nullptr) const;
+        // Builds the tracer once, then renders the views batched and a frame per view, as the app
+        // would without the view grid. Writes prefix_views.ppm and prefix_stats.json. The timings
+        // depend on the thread count, which goes in the statistics with them.
+        Statistics Analyze(const SceneGenerator& scene, const std::wstring& prefix, JobSystem* jobs = nullptr) const;
+
+        static std::wstring GetStatisticsString(const Statistics& statistics, UINT viewCount);
+
+        // Accessors.
+        bool                            IsEnabled() const { return m_viewCount > 0; }
+        UINT                            GetViewCount() const { return m_viewCount; }
+        UINT                            GetColumns() const { return m_columns; }
+        UINT                            GetViewWidth() const { return m_viewWidth; }
+        UINT                            GetViewHeight() const { return m_viewHeight; }
+        const std::vector<CpuCamera>&   GetCameras() const { return m_cameras; }
+
+    private:
+        // Renders views [firstView, firstView + viewCount) into their cells.
+        void RenderViews(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, UINT firstView, UINT viewCount,
+            CpuFramebuffer* target, JobSystem* jobs) const;
+
+        UINT                    m_viewCount;
+        UINT                    m_outputWidth;
+        UINT                    m_outputHeight;
+        UINT                    m_columns;
+        UINT                    m_viewWidth;
+        UINT                    m_viewHeight;
+        std::vector<CpuCamera>  m_cameras;
+    };
+}
@@ -0,0 +1,201 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace DX;
+using namespace std;
+
+#if defined(__linux__)
+namespace
+{
+    struct CounterConfig
+    {
+        UINT32  type;
+        UINT64  config;
+    };
+
+    // In Counter order.
+    const CounterConfig c_configs[PerfCounters::CounterCount] =
+    {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+
+    // Matches PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING.
+    struct ReadFormat
+    {
+        UINT64  value;
+        UINT64  timeEnabled;
+        UINT64  timeRunning;
+    };
+
+    bool ReadCounter(int file, ReadFormat* result)
+    {
+        return read(file, result, sizeof(*result)) == static_cast<ssize_t>(sizeof(*result));
+    }
+}
+
+PerfCounters::PerfCounters() :
+    m_running(false)
+{
+    for (UINT i = 0; i < CounterCount; i++)
+    {
+        perf_event_attr attributes = {};
+        attributes.size = sizeof(attributes);
+        attributes.type = c_configs[i].type;
+        attributes.config = c_configs[i].config;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // User mode only, which perf_event_paranoid up to 2 allows without privileges.
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+
+        // This thread on any CPU. Left running, Start() and Stop() take differences.
+        m_files[i] = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        m_available[i] = m_files[i] >= 0;
+    }
+    Reset();
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int file : m_files)
+    {
+        if (file >= 0)
+        {
+            close(file);
+        }
+    }
+}
+
+void PerfCounters::Start()
+{
+    m_running = true;
+    for (UINT i = 0; i < CounterCount; i++)
+    {
+        ReadFormat sample;
+        if (m_available[i] && ReadCounter(m_files[i], &sample))
+        {
+            m_startValues[i] = sample.value;
+            m_startEnabled[i] = sample.timeEnabled;
+            m_startRunning[i] = sample.timeRunning;
+        }
+    }
+}
+
+void PerfCounters::Stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+    m_running = false;
+    for (UINT i = 0; i < CounterCount; i++)
+    {
+        ReadFormat sample;
+        if (!m_available[i] || !ReadCounter(m_files[i], &sample))
+        {
+            continue;
+        }
+        UINT64 value = sample.value - m_startValues[i];
+        UINT64 enabled = sample.timeEnabled - m_startEnabled[i];
+        UINT64 running = sample.timeRunning - m_startRunning[i];
+        if (running > 0 && running < enabled)
+        {
+            value = static_cast<UINT64>(static_cast<double>(value) * enabled / running);
+        }
+        m_values[i] += value;
+    }
+}
+#else
+PerfCounters::PerfCounters() :
+    m_running(false),
+    m_startCycles(0)
+{
+    for (UINT i = 0; i < CounterCount; i++)
+    {
+        m_available[i] = false;
+    }
+    ULONG64 cycles;
+    m_available[CounterCycles] = QueryThreadCycleTime(GetCurrentThread(), &cycles) != FALSE;
+    Reset();
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::Start()
+{
+    m_running = true;
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    m_startCycles = cycles;
+}
+
+void PerfCounters::Stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+    m_running = false;
+    ULONG64 cycles = 0;
+    if (m_available[CounterCycles] && QueryThreadCycleTime(GetCurrentThread(), &cycles))
+    {
+        m_values[CounterCycles] += cycles - m_startCycles;
+    }
+}
+#endif
+
+void PerfCounters::Reset()
+{
+    m_running = false;
+    for (UINT64& value : m_values)
+    {
+        value = 0;
+    }
+}
+
+bool PerfCounters::IsAnyAvailable() const
+{
+    for (bool available : m_available)
+    {
+        if (available)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+LPCSTR PerfCounters::GetName(Counter counter)
+{
+    static const LPCSTR names[CounterCount] =
+    {
+        "cycles",
+        "instructions",
+        "l1d_misses",
+        "llc_misses",
+        "branch_misses",
+    };
+    return names[counter];
+}
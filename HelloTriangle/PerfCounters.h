@@ -0,0 +1,68 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// PerfCounters.h - Hardware performance counters around a region of CPU work
+//
+
+#pragma once
+
+namespace DX
+{
+    // Counts user mode events of the thread that created it, between Start() and Stop(); repeated
+    // regions add up until Reset(). On Linux the counters come from perf_event_open, on Windows
+    // only cycles are known, from QueryThreadCycleTime. Counters the OS, the hardware or the
+    // permissions don't allow are left unavailable instead of failing, e.g. in most VMs.
+    class PerfCounters
+    {
+    public:
+        enum Counter
+        {
+            CounterCycles,
+            CounterInstructions,
+            CounterL1DataMisses,
+            CounterLastLevelCacheMisses,
+            CounterBranchMisses,
+            CounterCount
+        };
+
+        PerfCounters();
+        ~PerfCounters();
+
+        void Start();
+        void Stop();
+        void Reset();
+
+        static LPCSTR GetName(Counter counter);
+
+        // Accessors.
+        bool    IsAvailable(Counter counter) const { return m_available[counter]; }
+        bool    IsAnyAvailable() const;
+        // Scaled up when the kernel had to multiplex the counters.
+        UINT64  GetValue(Counter counter) const { return m_values[counter]; }
+
+    private:
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool    m_available[CounterCount];
+        UINT64  m_values[CounterCount];
+        bool    m_running;
+#if defined(__linux__)
+        int     m_files[CounterCount];
+        UINT64  m_startValues[CounterCount];
+        UINT64  m_startEnabled[CounterCount];
+        UINT64  m_startRunning[CounterCount];
+#else
+        UINT64  m_startCycles;
+#endif
+    };
+}
@@ -0,0 +1,240 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "RayPattern.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const LPCWSTR c_patternNames[RayPattern::c_patternCount] = { L"full", L"checkerboard", L"foveated" };
+
+    const UINT c_tileSize = 4;
+
+    // Running weighted sum and range of the traced neighbours of a pixel.
+    struct Neighbourhood
+    {
+        Neighbourhood() :
+            sum(0.0f, 0.0f, 0.0f, 0.0f),
+            weightSum(0.0f),
+            low(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX),
+            high(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX)
+        {
+        }
+
+        void Add(const XMFLOAT4& color, float weight)
+        {
+            sum.x += weight * color.x;
+            sum.y += weight * color.y;
+            sum.z += weight * color.z;
+            sum.w += weight * color.w;
+            weightSum += weight;
+            low = XMFLOAT4(min(low.x, color.x), min(low.y, color.y), min(low.z, color.z), min(low.w, color.w));
+            high = XMFLOAT4(max(high.x, color.x), max(high.y, color.y), max(high.z, color.z), max(high.w, color.w));
+        }
+
+        XMFLOAT4    sum;
+        float       weightSum;
+        XMFLOAT4    low;
+        XMFLOAT4    high;
+    };
+
+    bool IsTracedPixel(const RayPatternConstants& constants, int x, int y)
+    {
+        return x >= 0 && y >= 0 && static_cast<UINT>(x) < constants.renderWidth && static_cast<UINT>(y) < constants.renderHeight
+            && RayPatternTraces(constants, x, y);
+    }
+
+    // Bilinear weights of the four points of the rate x rate lattice around the pixel, for those
+    // that are traced.
+    void AddLatticeNeighbours(const RayPatternConstants& constants, const CpuFramebuffer& target, int x, int y, int rate, Neighbourhood* neighbourhood)
+    {
+        UINT offset = RayPatternLatticeOffset(constants.frameIndex);
+        int left = x - (x - static_cast<int>(offset & 3) % rate + rate) % rate;
+        int top = y - (y - static_cast<int>(offset >> 2) % rate + rate) % rate;
+        float fractionX = static_cast<float>(x - left) / rate;
+        float fractionY = static_cast<float>(y - top) / rate;
+        for (int j = 0; j < 2; j++)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                int sampleX = left + i * rate;
+                int sampleY = top + j * rate;
+                if (IsTracedPixel(constants, sampleX, sampleY))
+                {
+                    float weight = (i ? fractionX : 1.0f - fractionX) * (j ? fractionY : 1.0f - fractionY);
+                    neighbourhood->Add(target.GetPixel(sampleX, sampleY), weight);
+                }
+            }
+        }
+    }
+}
+
+RayPatternConstants RayPattern::GetConstants(const RayPatternDesc& desc, UINT renderWidth, UINT renderHeight, UINT frameIndex, UINT history)
+{
+    RayPatternConstants constants = {};
+    constants.pattern = desc.pattern;
+    constants.frameIndex = frameIndex;
+    constants.renderWidth = renderWidth;
+    constants.renderHeight = renderHeight;
+    constants.focus = XMFLOAT2(desc.focusX * renderWidth, desc.focusY * renderHeight);
+    constants.innerRadius = desc.innerRadius * renderHeight;
+    constants.outerRadius = desc.outerRadius * renderHeight;
+    constants.history = history;
+    return constants;
+}
+
+void RayPattern::GetDispatchSize(const RayPatternConstants& constants, UINT* width, UINT* height)
+{
+    switch (constants.pattern)
+    {
+    case RayPatternCheckerboard:
+        *width = (constants.renderWidth + 1) / 2;
+        *height = constants.renderHeight;
+        break;
+    case RayPatternFoveated:
+        *width = (constants.renderWidth + c_tileSize - 1) / c_tileSize;
+        *height = (constants.renderHeight + c_tileSize - 1) / c_tileSize;
+        break;
+    default:
+        *width = constants.renderWidth;
+        *height = constants.renderHeight;
+        break;
+    }
+}
+
+double RayPattern::GetRaysPerFrame(const RayPatternConstants& constants)
+{
+    double pixelCount = static_cast<double>(constants.renderWidth) * constants.renderHeight;
+    if (constants.pattern == RayPatternCheckerboard)
+    {
+        return 0.5 * pixelCount;
+    }
+    if (constants.pattern != RayPatternFoveated)
+    {
+        return pixelCount;
+    }
+
+    // Every offset comes up equally often, so a tile averages its area over rate².
+    double rays = 0.0;
+    for (UINT tileY = 0; tileY * c_tileSize < constants.renderHeight; tileY++)
+    {
+        UINT tileHeight = min(c_tileSize, constants.renderHeight - tileY * c_tileSize);
+        for (UINT tileX = 0; tileX * c_tileSize < constants.renderWidth; tileX++)
+        {
+            UINT tileWidth = min(c_tileSize, constants.renderWidth - tileX * c_tileSize);
+            UINT rate = FoveatedTileRate(constants, tileX, tileY);
+            rays += static_cast<double>(tileWidth * tileHeight) / (rate * rate);
+        }
+    }
+    return rays;
+}
+
+void RayPattern::Reconstruct(const RayPatternConstants& constants, CpuFramebuffer* target, JobSystem* jobs)
+{
+    TRACE_SCOPE("RayPattern::Reconstruct");
+    ThrowIfFalse(target->GetWidth() >= constants.renderWidth && target->GetHeight() >= constants.renderHeight,
+        L"RayPattern: the target is smaller than the render size.\n");
+    if (constants.pattern == RayPatternFull || constants.history == RayPatternHistoryExact)
+    {
+        return;
+    }
+
+    // Rows only write pixels that aren't traced and only read those that are, besides their own.
+    auto job = [&](UINT y, UINT)
+    {
+        TRACE_SCOPE("RayPattern::ReconstructRow");
+        for (UINT x = 0; x < constants.renderWidth; x++)
+        {
+            if (RayPatternTraces(constants, x, y))
+            {
+                continue;
+            }
+
+            Neighbourhood neighbourhood;
+            int sampleX = static_cast<int>(x);
+            int sampleY = static_cast<int>(y);
+            if (constants.pattern == RayPatternCheckerboard)
+            {
+                const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+                for (auto& offset : offsets)
+                {
+                    if (IsTracedPixel(constants, sampleX + offset[0], sampleY + offset[1]))
+                    {
+                        neighbourhood.Add(target->GetPixel(sampleX + offset[0], sampleY + offset[1]), 1.0f);
+                    }
+                }
+            }
+            else
+            {
+                AddLatticeNeighbours(constants, *target, sampleX, sampleY, RayPatternRate(constants, x, y), &neighbourhood);
+                if (neighbourhood.weightSum == 0.0f)
+                {
+                    AddLatticeNeighbours(constants, *target, sampleX, sampleY, c_tileSize, &neighbourhood);
+                }
+            }
+            if (neighbourhood.weightSum == 0.0f)
+            {
+                continue;
+            }
+
+            XMFLOAT4& pixel = target->GetPixel(x, y);
+            if (constants.history == RayPatternHistoryClamped)
+            {
+                pixel = XMFLOAT4(
+                    min(max(pixel.x, neighbourhood.low.x), neighbourhood.high.x),
+                    min(max(pixel.y, neighbourhood.low.y), neighbourhood.high.y),
+                    min(max(pixel.z, neighbourhood.low.z), neighbourhood.high.z),
+                    min(max(pixel.w, neighbourhood.low.w), neighbourhood.high.w));
+            }
+            else
+            {
+                float scale = 1.0f / neighbourhood.weightSum;
+                pixel = XMFLOAT4(neighbourhood.sum.x * scale, neighbourhood.sum.y * scale, neighbourhood.sum.z * scale, neighbourhood.sum.w * scale);
+            }
+        }
+    };
+    if (jobs)
+    {
+        jobs->ParallelFor(constants.renderHeight, job);
+    }
+    else
+    {
+        for (UINT y = 0; y < constants.renderHeight; y++)
+        {
+            job(y, 0);
+        }
+    }
+}
+
+bool RayPattern::ParsePattern(const wstring& name, UINT* pattern)
+{
+    for (UINT i = 0; i < ARRAYSIZE(c_patternNames); i++)
+    {
+        if (_wcsicmp(name.c_str(), c_patternNames[i]) == 0)
+        {
+            *pattern = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+LPCWSTR RayPattern::GetPatternName(UINT pattern)
+{
+    return pattern < ARRAYSIZE(c_patternNames) ? c_patternNames[pattern] : L"unknown";
+}
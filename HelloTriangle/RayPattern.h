@@ -0,0 +1,72 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+//
+// RayPattern.h - Which pixels get a primary ray each frame, and the others' reconstruction
+//
+
+#pragma once
+
+#include "RaytracingHlslCompat.h"
+#include "CpuFramebuffer.h"
+#include "JobSystem.h"
+
+namespace DX
+{
+    struct RayPatternDesc
+    {
+        RayPatternDesc() :
+            pattern(RayPatternFull),
+            focusX(0.5f),
+            focusY(0.5f),
+            innerRadius(0.15f),
+            outerRadius(0.35f)
+        {
+        }
+
+        UINT    pattern;            // RayPatternFull, RayPatternCheckerboard or RayPatternFoveated.
+        float   focusX;             // Foveated, as fractions of the render size.
+        float   focusY;
+        float   innerRadius;        // Foveated, as fractions of the render height.
+        float   outerRadius;
+    };
+
+    // The patterns are defined in RaytracingHlslCompat.h, where the shaders and the CPU share them.
+    // The checkerboard traces the pixels with an even x + y + frameIndex. The foveated pattern
+    // picks a rate per 4x4 tile and traces one pixel per rate x rate block, on a lattice that
+    // moves every frame. Over 2 frames, or 16 for the sparsest tiles, every pixel gets a ray.
+    //
+    // A pixel that isn't traced is interpolated from its traced neighbours: the four around it
+    // on the checkerboard, the four lattice points around it when foveated, falling back to the
+    // 1 in 4x4 lattice, which is always traced, next to sparser tiles. Then its last value is
+    // used as the history allows: as is while the camera is still, so a still image converges
+    // to the full one, or clamped to the neighbours' range after it moved, which keeps detail
+    // where the scene didn't change and rejects it where it did.
+    class RayPattern
+    {
+    public:
+        static const UINT c_patternCount = 3;
+
+        static RayPatternConstants GetConstants(const RayPatternDesc& desc, UINT renderWidth, UINT renderHeight, UINT frameIndex, UINT history);
+        // The DispatchRays() grid: a thread per pixel, per pixel pair in a row or per 4x4 tile.
+        static void GetDispatchSize(const RayPatternConstants& constants, UINT* width, UINT* height);
+        // Averaged over the frames it takes to cover every pixel.
+        static double GetRaysPerFrame(const RayPatternConstants& constants);
+
+        // What Reconstruct.hlsl does, in place on a target holding this frame's traced pixels
+        // and the last frame elsewhere.
+        static void Reconstruct(const RayPatternConstants& constants, CpuFramebuffer* target, JobSystem* jobs = nullptr);
+
+        static bool ParsePattern(const std::wstring& name, UINT* pattern);
+        static LPCWSTR GetPatternName(UINT pattern);
+    };
+}
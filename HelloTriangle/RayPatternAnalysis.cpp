@@ -0,0 +1,194 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "RayPatternAnalysis.h"
+#include "ImageCompare.h"
+#include "ImageFile.h"
+#include "StepTimer.h"
+#include "TraceRecorder.h"
+#include <fstream>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+RayPatternAnalysis::RayPatternAnalysis() :
+    m_width(0),
+    m_height(0),
+    m_frameCount(0),
+    m_frame(0),
+    m_statistics()
+{
+}
+
+void RayPatternAnalysis::Reset(const RayPatternDesc& desc, UINT width, UINT height, UINT frameCount)
+{
+    ThrowIfFalse(width > 0 && height > 0 && frameCount > 0, L"RayPatternAnalysis: nothing to analyze.\n");
+    m_width = width;
+    m_height = height;
+    m_frameCount = frameCount;
+    m_frame = 0;
+    m_desc = desc;
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        m_images[pattern].Resize(width, height);
+        m_statistics[pattern] = Statistics();
+    }
+}
+
+void RayPatternAnalysis::AddFrame(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    UINT frameIndex, UINT history, JobSystem* jobs)
+{
+    TRACE_SCOPE("RayPatternAnalysis::AddFrame");
+    ThrowIfFalse(m_frame < m_frameCount, L"RayPatternAnalysis: all frames have been added.\n");
+    // The images start out empty, whatever the sample's history.
+    if (m_frame == 0)
+    {
+        history = RayPatternHistoryNone;
+    }
+
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        RayPatternDesc desc = m_desc;
+        desc.pattern = pattern;
+        RayPatternConstants constants = RayPattern::GetConstants(desc, m_width, m_height, frameIndex, history);
+        CpuFramebuffer& image = m_images[pattern];
+        Statistics& statistics = m_statistics[pattern];
+
+        // One row per job, each counts its own rays.
+        vector<UINT> rowRays(m_height);
+        auto job = [&](UINT y, UINT)
+        {
+            TRACE_SCOPE("RayPatternAnalysis::TraceRow");
+            XMFLOAT4* row = image.GetRow(y);
+            for (UINT x = 0; x < m_width; x++)
+            {
+                if (RayPatternTraces(constants, x, y))
+                {
+                    CpuHit hit;
+                    CpuRenderer::TraceSample(tracer, vertices, indices, camera, m_width, m_height, x, y, 0.5f, 0.5f, &row[x], &hit, nullptr);
+                    rowRays[y]++;
+                }
+            }
+        };
+        UINT64 traceStart = StepTimer::GetCurrentTicks();
+        if (jobs)
+        {
+            jobs->ParallelFor(m_height, job);
+        }
+        else
+        {
+            for (UINT y = 0; y < m_height; y++)
+            {
+                job(y, 0);
+            }
+        }
+        UINT64 reconstructStart = StepTimer::GetCurrentTicks();
+        RayPattern::Reconstruct(constants, &image, jobs);
+        UINT64 reconstructEnd = StepTimer::GetCurrentTicks();
+
+        for (UINT rays : rowRays)
+        {
+            statistics.rays += rays;
+        }
+        statistics.traceSeconds += StepTimer::TicksToSeconds(reconstructStart - traceStart);
+        statistics.reconstructSeconds += StepTimer::TicksToSeconds(reconstructEnd - reconstructStart);
+    }
+
+    // The full pattern is the reference.
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        Statistics& statistics = m_statistics[pattern];
+        if (pattern == RayPatternFull)
+        {
+            continue;
+        }
+        ImageCompare compare;
+        ImageCompare::Result result = compare.Compare(m_images[RayPatternFull], m_images[pattern]);
+        statistics.meanRmse += result.rmse / m_frameCount;
+        statistics.maxRmse = max(statistics.maxRmse, result.rmse);
+        statistics.meanFlip += result.meanFlip / m_frameCount;
+    }
+    m_frame++;
+}
+
+void RayPatternAnalysis::Export(const wstring& prefix) const
+{
+    ThrowIfFalse(m_frame > 0, L"RayPatternAnalysis: nothing has been rendered.\n");
+
+    vector<UINT32> rgba8(static_cast<size_t>(m_width) * m_height);
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        m_images[pattern].ConvertToRgba8(rgba8.data());
+        ImageFile::WritePpm(prefix + L"_" + RayPattern::GetPatternName(pattern) + L".ppm", m_width, m_height, rgba8.data());
+    }
+
+    ofstream file(prefix + L"_stats.json");
+    ThrowIfFalse(file.is_open(), L"RayPatternAnalysis: couldn't open the statistics file.\n");
+    double pixels = static_cast<double>(m_width) * m_height * m_frame;
+    const Statistics& full = m_statistics[RayPatternFull];
+    double fullSeconds = full.traceSeconds + full.reconstructSeconds;
+    file << fixed << setprecision(6)
+        << "{\n  \"width\": " << m_width
+        << ",\n  \"height\": " << m_height
+        << ",\n  \"frames\": " << m_frame
+        << ",\n  \"focus\": [" << m_desc.focusX << ", " << m_desc.focusY << ']'
+        << ",\n  \"inner_radius\": " << m_desc.innerRadius
+        << ",\n  \"outer_radius\": " << m_desc.outerRadius
+        << ",\n  \"patterns\": {";
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        const Statistics& statistics = m_statistics[pattern];
+        double seconds = statistics.traceSeconds + statistics.reconstructSeconds;
+        // Pixels delivered per second, as if each had its own ray.
+        double effectiveRaysPerSecond = seconds > 0.0 ? pixels / seconds : 0.0;
+        string name;
+        for (LPCWSTR c = RayPattern::GetPatternName(pattern); *c; c++)
+        {
+            name += static_cast<char>(*c);
+        }
+        file << (pattern ? "," : "") << "\n    \"" << name << "\": {"
+            << "\"rays\": " << statistics.rays
+            << ", \"rays_per_pixel\": " << statistics.rays / pixels
+            << ", \"trace_ms\": " << 1000.0 * statistics.traceSeconds / m_frame
+            << ", \"reconstruct_ms\": " << 1000.0 * statistics.reconstructSeconds / m_frame
+            << ", \"effective_mrays_per_second\": " << effectiveRaysPerSecond / 1e6
+            << ", \"gain\": " << (seconds > 0.0 ? fullSeconds / seconds : 0.0)
+            << ", \"ray_gain\": " << (statistics.rays ? static_cast<double>(full.rays) / statistics.rays : 0.0)
+            << ", \"mean_rmse\": " << statistics.meanRmse
+            << ", \"max_rmse\": " << statistics.maxRmse
+            << ", \"mean_flip\": " << statistics.meanFlip << '}';
+    }
+    file << "\n  }\n}\n";
+}
+
+wstring RayPatternAnalysis::GetStatisticsString() const
+{
+    wstringstream stream;
+    double pixels = max(static_cast<double>(m_width) * m_height * m_frame, 1.0);
+    const Statistics& full = m_statistics[RayPatternFull];
+    double fullSeconds = full.traceSeconds + full.reconstructSeconds;
+    stream << L"Ray patterns, " << m_width << L"x" << m_height << L", " << m_frame << L" frames\n";
+    for (UINT pattern = 0; pattern < RayPattern::c_patternCount; pattern++)
+    {
+        const Statistics& statistics = m_statistics[pattern];
+        double seconds = statistics.traceSeconds + statistics.reconstructSeconds;
+        stream << fixed << setprecision(2)
+            << L"  " << setw(12) << left << RayPattern::GetPatternName(pattern) << right
+            << statistics.rays / pixels << L" rays per pixel, " << (seconds > 0.0 ? pixels / seconds / 1e6 : 0.0)
+            << L" effective Mrays/s (" << (seconds > 0.0 ? fullSeconds / seconds : 0.0) << L"x)"
+            << setprecision(5) << L", RMSE " << statistics.meanRmse << L" mean " << statistics.maxRmse << L" max, FLIP "
+            << statistics.meanFlip << L"\n";
+    }
+    return stream.str();
+}
@@ -0,0 +1,66 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+//
+// RayPatternAnalysis.h - Rays saved by the sparse ray patterns against their reconstruction error
+//
+
+#pragma once
+
+#include "RayPattern.h"
+#include "CpuRenderer.h"
+
+namespace DX
+{
+    // Follows the sample's camera for a number of frames with the CPU tracer. Every frame is
+    // traced in full, as the reference, and with each sparse pattern into its own image, which
+    // is then reconstructed from its last frame like on the GPU and compared with the reference.
+    // Tracing and reconstruction are timed, so the effective rays per second, pixels delivered
+    // over the time it took, can be set against the error.
+    class RayPatternAnalysis
+    {
+    public:
+        struct Statistics
+        {
+            UINT64  rays;
+            double  traceSeconds;
+            double  reconstructSeconds;
+            double  meanRmse;
+            double  maxRmse;
+            double  meanFlip;
+        };
+
+        RayPatternAnalysis();
+
+        void Reset(const RayPatternDesc& desc, UINT width, UINT height, UINT frameCount);
+        // history is the GPU's for this frame, RayPatternHistoryClamped once the camera moved.
+        void AddFrame(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            UINT frameIndex, UINT history, JobSystem* jobs = nullptr);
+
+        // Writes prefix_<pattern>.ppm with the last frame of each pattern and prefix_stats.json.
+        void Export(const std::wstring& prefix) const;
+        std::wstring GetStatisticsString() const;
+
+        // Accessors.
+        bool                IsComplete() const { return m_frame == m_frameCount; }
+        const Statistics&   GetStatistics(UINT pattern) const { return m_statistics[pattern]; }
+
+    private:
+        UINT                m_width;
+        UINT                m_height;
+        UINT                m_frameCount;
+        UINT                m_frame;
+        RayPatternDesc      m_desc;
+        CpuFramebuffer      m_images[RayPattern::c_patternCount];
+        Statistics          m_statistics[RayPattern::c_patternCount];
+    };
+}
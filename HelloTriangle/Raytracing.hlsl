@@ -19,51 +19,21 @@
 RaytracingAccelerationStructure SceneBVH : register(t0, space0); //SRV0
 //the register means the data is accessible in the first unordered access variable (UAV, identified by the letter u) bound to the shader.
 RWTexture2D<float4> RenderTarget : register(u0); // UAV0
+RWTexture2D<float4> AccumulationBuffer : register(u1); // UAV1, running average while the camera is still
 ByteAddressBuffer Indices : register(t1, space0); // SRV1
 StructuredBuffer<Vertex> Vertices : register(t2, space0); //SRV2
 
 //onstant buffers (CBV), can be accessed using the letter b.
 ConstantBuffer<RayGenConstantBuffer> g_rayGenCB : register(b0); //CBV0
 ConstantBuffer<SceneConstantBuffer> g_sceneCB : register(b1); //CBV1
+ConstantBuffer<MultiViewConstantBuffer> g_viewCB : register(b2); //CBV2, only read when g_sceneCB.viewCount isn't 0
 
 
 
-// Load three 16 bit indices from a byte addressed buffer.
-uint3 Load3x16BitIndices(uint offsetBytes)
-{
-	uint3 indices;
-
-	// ByteAdressBuffer loads must be aligned at a 4 byte boundary.
-	// Since we need to read three 16 bit indices: { 0, 1, 2 } 
-	// aligned at a 4 byte boundary as: { 0 1 } { 2 0 } { 1 2 } { 0 1 } ...
-	// we will load 8 bytes (~ 4 indices { a b | c d }) to handle two possible index triplet layouts,
-	// based on first index's offsetBytes being aligned at the 4 byte boundary or not:
-	//  Aligned:     { 0 1 | 2 - }
-	//  Not aligned: { - 0 | 1 2 }
-	const uint dwordAlignedOffset = offsetBytes & ~3;
-	const uint2 four16BitIndices = Indices.Load2(dwordAlignedOffset);
-
-	// Aligned: { 0 1 | 2 - } => retrieve first three 16bit indices
-	if (dwordAlignedOffset == offsetBytes)
-	{
-		indices.x = four16BitIndices.x & 0xffff;
-		indices.y = (four16BitIndices.x >> 16) & 0xffff;
-		indices.z = four16BitIndices.y & 0xffff;
-	}
-	else // Not aligned: { - 0 | 1 2 } => retrieve last three 16bit indices
-	{
-		indices.x = (four16BitIndices.x >> 16) & 0xffff;
-		indices.y = four16BitIndices.y & 0xffff;
-		indices.z = (four16BitIndices.y >> 16) & 0xffff;
-	}
-
-	return indices;
-}
-
 typedef BuiltInTriangleIntersectionAttributes MyAttributes;
 struct RayPayload
 {
-	float4 color;
+	float4 color;	// w is 1 for hits and -1 for misses, it goes in as the pixel's height down the screen.
 };
 
 bool IsInsideViewport(float2 p, Viewport viewport)
@@ -73,34 +43,42 @@ bool IsInsideViewport(float2 p, Viewport viewport)
 }
 
 // Generate a ray in world space for a camera pixel corresponding to an index from the dispatched 2D grid.
-inline void GenerateCameraRay(uint2 index, out float3 origin, out float3 direction) {
-	float2 xy = index + 0.5f; // center in the middle of the pixel
-	float2 screenPos = xy / DispatchRaysDimensions().xy * 2.0 - 1.0; // [0, 1] => [-1, 1]
+// A multi-view dispatch takes the camera of its view, the z of the index.
+inline void GenerateCameraRay(uint2 index, uint view, out float3 origin, out float3 direction) {
+	float4x4 projectionToWorld = g_sceneCB.projectionToWorld;
+	float3 cameraPosition = g_sceneCB.cameraPosition.xyz;
+	if (g_sceneCB.viewCount > 0)
+	{
+		projectionToWorld = g_viewCB.views[view].projectionToWorld;
+		cameraPosition = g_viewCB.views[view].cameraPosition.xyz;
+	}
+
+	float2 xy = index + 0.5f + g_sceneCB.subpixelJitter; // center in the middle of the pixel, jittered while accumulating
+	float2 screenPos = xy / float2(g_sceneCB.rayPattern.renderWidth, g_sceneCB.rayPattern.renderHeight) * 2.0 - 1.0; // [0, 1] => [-1, 1]
 
 	// Invert Y for DirectX-style coordinates.
 	screenPos.y = -screenPos.y;
 
 	// Unproject the pixel coordinate into a ray
-	float4 world = mul(float4(screenPos, 0, 1), g_sceneCB.projectionToWorld);
+	float4 world = mul(float4(screenPos, 0, 1), projectionToWorld);
 	world.xyz /= world.w;
 
-	origin = g_sceneCB.cameraPosition.xyz;
+	origin = cameraPosition;
 	direction = normalize(world.xyz - origin);
 }
 
 
-[shader("raygeneration")]
-void MyRaygenShader()
+// Trace the primary ray of a pixel of a view and store its color.
+void TracePixel(uint2 pixel, uint view)
 {
-	/*
-		DispatchRaysDimensions():	uint3(width, height, depth) values
-		DispatchRaysIndex(): Gets the current x and y location within the width and height obtained with DispatchRaysDimensions() system value intrinsic.
-	*/
-	float2 lerpValues = (float2)DispatchRaysIndex() / (float2)DispatchRaysDimensions();
+	if (pixel.x >= g_sceneCB.rayPattern.renderWidth || pixel.y >= g_sceneCB.rayPattern.renderHeight)
+	{
+		return;
+	}
 
 	float3 origin;
 	float3 rayDir;
-	GenerateCameraRay(DispatchRaysIndex().xy, origin, rayDir);
+	GenerateCameraRay(pixel, view, origin, rayDir);
 
 	// Trace the ray.
 	// Set the ray's extents.
@@ -111,7 +89,7 @@ void MyRaygenShader()
 	// TMin should be kept small to prevent missing geometry at close contact areas.
 	ray.TMin = 0.001;
 	ray.TMax = 10000.0;
-	RayPayload payload = { float4(0, 0, 0, 0) };
+	RayPayload payload = { float4(0, 0, 0, (g_sceneCB.tileTop + pixel.y) / (float)g_sceneCB.imageHeight) };
 
 	/*
 	RAY_FLAG_NONE : None
@@ -129,11 +107,58 @@ void TraceRay(RaytracingAccelerationStructure AccelerationStructure,
 	*/
 	TraceRay(SceneBVH, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, ~0, 0, 0, 0, ray, payload);
 
+	// The view's cell of the output.
+	uint2 renderSize = uint2(g_sceneCB.rayPattern.renderWidth, g_sceneCB.rayPattern.renderHeight);
+	pixel += g_sceneCB.viewCount > 0 ? uint2(view % g_sceneCB.viewColumns, view / g_sceneCB.viewColumns) * renderSize : uint2(0, 0);
+
+	// Average with the previous samples of this pixel, the first frame after a change overwrites them.
+	float4 color = payload.color;
+	if (g_sceneCB.accumulatedFrameCount > 0)
+	{
+		color = lerp(AccumulationBuffer[pixel], color, 1.0f / (g_sceneCB.accumulatedFrameCount + 1));
+	}
+	AccumulationBuffer[pixel] = color;
+
 	// Write the raytraced color to the output texture.
-	RenderTarget[DispatchRaysIndex().xy] = payload.color;
-	//RenderTarget[DispatchRaysIndex().xy] = float4(rayDir, 1.0f);
-	//RenderTarget[DispatchRaysIndex().xy] = float4(g_sceneCB.cameraPosition.y, 0, 0, 1.0f);
+	RenderTarget[pixel] = color;
+	//RenderTarget[pixel] = float4(rayDir, 1.0f);
+	//RenderTarget[pixel] = float4(g_sceneCB.cameraPosition.y, 0, 0, 1.0f);
+}
 
+[shader("raygeneration")]
+void MyRaygenShader()
+{
+	/*
+		DispatchRaysDimensions():	uint3(width, height, depth) values
+		DispatchRaysIndex(): Gets the current x and y location within the width and height obtained with DispatchRaysDimensions() system value intrinsic.
+	*/
+	RayPatternConstants pattern = g_sceneCB.rayPattern;
+	uint2 index = DispatchRaysIndex().xy;
+	uint view = DispatchRaysIndex().z;
+	if (pattern.pattern == RayPatternCheckerboard)
+	{
+		// Half as wide, each row's pixels of this frame.
+		TracePixel(uint2(2 * index.x + ((index.y + pattern.frameIndex) & 1), index.y), view);
+	}
+	else if (pattern.pattern == RayPatternFoveated)
+	{
+		// One thread per 4x4 tile, tracing its pixels on this frame's lattice. Neighbouring tiles
+		// mostly have the same rate, so the loops of a wave rarely diverge.
+		uint rate = FoveatedTileRate(pattern, index.x, index.y);
+		uint offset = RayPatternLatticeOffset(pattern.frameIndex);
+		uint2 tile = index * 4;
+		for (uint y = tile.y + ((offset >> 2) % rate); y < tile.y + 4; y += rate)
+		{
+			for (uint x = tile.x + ((offset & 3) % rate); x < tile.x + 4; x += rate)
+			{
+				TracePixel(uint2(x, y), view);
+			}
+		}
+	}
+	else
+	{
+		TracePixel(index, view);
+	}
 }
 
 [shader("closesthit")]
@@ -141,15 +166,15 @@ void MyClosestHitShader(inout RayPayload payload, in MyAttributes attr)
 {
 	float3 barycentrics = float3(1 - attr.barycentrics.x - attr.barycentrics.y, attr.barycentrics.x, attr.barycentrics.y);
 
-	// Get the base index of the triangle's first 16 bit index.
-	uint indexSizeInBytes = 2;
+	// Get the base index of the triangle's first 32 bit index.
+	uint indexSizeInBytes = 4;
 	uint indicesPerTriangle = 3;
 	uint triangleIndexStride = indicesPerTriangle * indexSizeInBytes;
 	//Retrieves the autogenerated index of the primitive within the geometry inside the bottom-level acceleration structure instance.
 	uint baseIndex = PrimitiveIndex() * triangleIndexStride;
 
-	// Load up 3 16 bit indices for the triangle.
-	const uint3 indices = Load3x16BitIndices(baseIndex);
+	// Load up 3 32 bit indices for the triangle.
+	const uint3 indices = Indices.Load3(baseIndex);
 
 	float3 colors[3] = {
 		Vertices[indices[0]].color,
@@ -168,10 +193,9 @@ void MyMissShader(inout RayPayload payload)
 {
 	//payload.color = float4(0, 0, 0, 1);
 
-	uint2 launchIndex = DispatchRaysIndex();
-	float2 dims = (float2)DispatchRaysDimensions();
-	float ramp = launchIndex.y / dims.y;
-	
+	// The pixel is no longer the dispatch index with a sparse ray pattern or a tile, the ray generation shader passes its height in.
+	float ramp = payload.color.w;
+
 	payload.color = float4(0.0, 0.2f, 0.7f - 0.3f * ramp, -1.0f);
 }
 
@@ -21,7 +21,8 @@ using namespace DirectX;
 
 
 // shader will use byte encoding to access indices.
-typedef UINT16 Index;
+// 32 bit, generated meshes go past 65536 vertices.
+typedef UINT32 Index;
 #endif
 
 struct Viewport
@@ -38,10 +39,66 @@ struct RayGenConstantBuffer
 	Viewport stencil;
 };
 
+// Which pixels DispatchRays() traces. Reconstruct.hlsl fills in the others.
+static const UINT RayPatternFull = 0;
+static const UINT RayPatternCheckerboard = 1;	// Every other pixel, swapping each frame.
+static const UINT RayPatternFoveated = 2;		// Every pixel near the focus, 1 in 2x2 and 1 in 4x4 further out.
+
+// What a pixel that wasn't traced keeps of its last value.
+static const UINT RayPatternHistoryNone = 0;	// Nothing, after a reset, only traced neighbours are used.
+static const UINT RayPatternHistoryClamped = 1;	// Clamped to its traced neighbours, the camera moved.
+static const UINT RayPatternHistoryExact = 2;	// All of it, the camera is still.
+
+struct RayPatternConstants
+{
+	UINT pattern;
+	UINT frameIndex;				// Moves the traced pixels, so a still camera gets them all.
+	UINT renderWidth;
+	UINT renderHeight;
+	XMFLOAT2 focus;					// Foveated, in pixels.
+	float innerRadius;				// Foveated, in pixels: every pixel is traced inside,
+	float outerRadius;				// 1 in 2x2 out to here and 1 in 4x4 beyond.
+	UINT history;					// Reconstruct.hlsl only.
+	UINT padding0;
+	UINT padding1;
+	UINT padding2;
+};
+
 struct SceneConstantBuffer
 {
 	XMMATRIX projectionToWorld;
 	XMVECTOR cameraPosition;
+	XMFLOAT2 subpixelJitter;		// Sample offset from the pixel center, in pixels.
+	UINT accumulatedFrameCount;		// Frames already averaged in the accumulation buffer, 0 restarts it.
+	UINT padding;
+	RayPatternConstants rayPattern;
+	UINT tileTop;					// The rendered rows start at this row of an imageHeight tall image,
+	UINT imageHeight;				// for the miss shader's ramp. 0 and the render height but in tiled renders.
+	UINT viewCount;					// Multi-view, 0 traces the camera above alone. Views are laid out in a
+	UINT viewColumns;				// grid viewColumns wide, each at the render size.
+};
+
+// Multi-view, the camera of each DispatchRaysIndex().z.
+static const UINT MaxViewCount = 64;
+
+struct ViewConstants
+{
+	XMMATRIX projectionToWorld;
+	XMVECTOR cameraPosition;
+};
+
+struct MultiViewConstantBuffer
+{
+	ViewConstants views[MaxViewCount];
+};
+
+// Upscale.hlsl, the top left sourceWidth x sourceHeight of the source fill the output.
+struct UpscaleConstantBuffer
+{
+	UINT sourceWidth;
+	UINT sourceHeight;
+	UINT outputWidth;
+	UINT outputHeight;
 };
 
 struct Vertex {
@@ -49,4 +106,50 @@ struct Vertex {
 	XMFLOAT3 color;
 };
 
+// The ray pattern's functions are shared with the CPU, which reconstructs and counts the same pixels.
+
+// The 4x4 lattice offset of a frame, x in the low two bits and y in the next two. Both 2x2 levels
+// step in Bayer order, the fine one every frame: the 1 in 2x2 lattice, the offset modulo 2, comes
+// around every 4 frames and the 1 in 4x4 one every 16. A coarser lattice is always part of a finer one.
+inline UINT RayPatternLatticeOffset(UINT frameIndex)
+{
+	UINT fine = frameIndex & 3;
+	UINT coarse = (frameIndex >> 2) & 3;
+	UINT x = ((fine ^ (fine >> 1)) & 1) | (((coarse ^ (coarse >> 1)) & 1) << 1);
+	UINT y = (fine & 1) | ((coarse & 1) << 1);
+	return x | (y << 2);
+}
+
+// Foveated, pixels per ray along each side of a 4x4 tile, by the distance of its center to the focus.
+inline UINT FoveatedTileRate(RayPatternConstants pattern, UINT tileX, UINT tileY)
+{
+	float dx = (tileX + 0.5f) * 4.0f - pattern.focus.x;
+	float dy = (tileY + 0.5f) * 4.0f - pattern.focus.y;
+	float distanceSquared = dx * dx + dy * dy;
+	UINT rate = 4;
+	if (distanceSquared <= pattern.outerRadius * pattern.outerRadius)
+	{
+		rate = distanceSquared <= pattern.innerRadius * pattern.innerRadius ? 1 : 2;
+	}
+	return rate;
+}
+
+// Pixels per ray along each side around pixel (x, y), the lattice spacing of the foveated pattern.
+inline UINT RayPatternRate(RayPatternConstants pattern, UINT x, UINT y)
+{
+	return pattern.pattern == RayPatternFoveated ? FoveatedTileRate(pattern, x / 4, y / 4) : 1;
+}
+
+// Whether pixel (x, y) gets a ray this frame.
+inline bool RayPatternTraces(RayPatternConstants pattern, UINT x, UINT y)
+{
+	if (pattern.pattern == RayPatternCheckerboard)
+	{
+		return ((x + y + pattern.frameIndex) & 1) == 0;
+	}
+	UINT rate = RayPatternRate(pattern, x, y);
+	UINT offset = RayPatternLatticeOffset(pattern.frameIndex);
+	return x % rate == (offset & 3) % rate && y % rate == (offset >> 2) % rate;
+}
+
 #endif // RAYTRACINGHLSLCOMPAT_H
\ No newline at end of file
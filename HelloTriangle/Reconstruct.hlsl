@@ -0,0 +1,116 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+#ifndef RECONSTRUCT_HLSL
+#define RECONSTRUCT_HLSL
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+RWTexture2D<float4> RenderTarget : register(u0); // UAV0, the raytracing output, this frame's traced pixels and the last frame's others
+ConstantBuffer<RayPatternConstants> g_patternCB : register(b0); // CBV0, root constants
+
+struct Neighbourhood
+{
+	float4 sum;
+	float weightSum;
+	float4 low;
+	float4 high;
+};
+
+bool IsTracedPixel(int2 pixel)
+{
+	return all(pixel >= 0) && pixel.x < (int)g_patternCB.renderWidth && pixel.y < (int)g_patternCB.renderHeight
+		&& RayPatternTraces(g_patternCB, pixel.x, pixel.y);
+}
+
+void AddNeighbour(int2 pixel, float weight, inout Neighbourhood neighbourhood)
+{
+	float4 color = RenderTarget[pixel];
+	neighbourhood.sum += weight * color;
+	neighbourhood.weightSum += weight;
+	neighbourhood.low = min(neighbourhood.low, color);
+	neighbourhood.high = max(neighbourhood.high, color);
+}
+
+// Bilinear weights of the four points of the rate x rate lattice around the pixel, for those that are traced.
+void AddLatticeNeighbours(int2 pixel, int rate, inout Neighbourhood neighbourhood)
+{
+	uint offset = RayPatternLatticeOffset(g_patternCB.frameIndex);
+	int2 topLeft = pixel - (pixel - int2(offset & 3, offset >> 2) % rate + rate) % rate;
+	float2 fraction = float2(pixel - topLeft) / rate;
+	[unroll] for (int j = 0; j < 2; j++)
+	{
+		[unroll] for (int i = 0; i < 2; i++)
+		{
+			int2 neighbour = topLeft + int2(i, j) * rate;
+			if (IsTracedPixel(neighbour))
+			{
+				AddNeighbour(neighbour, (i ? fraction.x : 1.0 - fraction.x) * (j ? fraction.y : 1.0 - fraction.y), neighbourhood);
+			}
+		}
+	}
+}
+
+// Fills in the pixels DispatchRays() skipped, in place: traced pixels are only read and the others
+// only read and write themselves. See RayPattern.h.
+[numthreads(8, 8, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+	int2 pixel = dispatchThreadId.xy;
+	if (pixel.x >= (int)g_patternCB.renderWidth || pixel.y >= (int)g_patternCB.renderHeight
+		|| RayPatternTraces(g_patternCB, pixel.x, pixel.y) || g_patternCB.history == RayPatternHistoryExact)
+	{
+		return;
+	}
+
+	Neighbourhood neighbourhood;
+	neighbourhood.sum = 0;
+	neighbourhood.weightSum = 0;
+	neighbourhood.low = 1e30;
+	neighbourhood.high = -1e30;
+	if (g_patternCB.pattern == RayPatternCheckerboard)
+	{
+		const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+		[unroll] for (int i = 0; i < 4; i++)
+		{
+			if (IsTracedPixel(pixel + offsets[i]))
+			{
+				AddNeighbour(pixel + offsets[i], 1.0, neighbourhood);
+			}
+		}
+	}
+	else
+	{
+		AddLatticeNeighbours(pixel, RayPatternRate(g_patternCB, pixel.x, pixel.y), neighbourhood);
+		// Next to a sparser tile, the 1 in 4x4 lattice is traced everywhere.
+		if (neighbourhood.weightSum == 0)
+		{
+			AddLatticeNeighbours(pixel, 4, neighbourhood);
+		}
+	}
+	if (neighbourhood.weightSum == 0)
+	{
+		return;
+	}
+
+	if (g_patternCB.history == RayPatternHistoryClamped)
+	{
+		RenderTarget[pixel] = clamp(RenderTarget[pixel], neighbourhood.low, neighbourhood.high);
+	}
+	else
+	{
+		RenderTarget[pixel] = neighbourhood.sum / neighbourhood.weightSum;
+	}
+}
+
+#endif // RECONSTRUCT_HLSL
@@ -0,0 +1,74 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+#include "stdafx.h"
+#include "Reconstructor.h"
+#include "CompiledShaders\Reconstruct.hlsl.h"
+
+using namespace DX;
+using namespace std;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    enum RootParameter
+    {
+        RootParameterOutput = 0,    // u0
+        RootParameterConstants,     // b0
+        RootParameterCount
+    };
+
+    const UINT c_groupSize = 8;
+}
+
+Reconstructor::Reconstructor()
+{
+}
+
+void Reconstructor::Create(ID3D12Device* device)
+{
+    CD3DX12_DESCRIPTOR_RANGE range;
+    range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+    CD3DX12_ROOT_PARAMETER rootParameters[RootParameterCount];
+    rootParameters[RootParameterOutput].InitAsDescriptorTable(1, &range);
+    rootParameters[RootParameterConstants].InitAsConstants(sizeof(RayPatternConstants) / sizeof(UINT32), 0);
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+
+    ComPtr<ID3DBlob> blob;
+    ComPtr<ID3DBlob> error;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &blob, &error),
+        error ? static_cast<wchar_t*>(error->GetBufferPointer()) : nullptr);
+    ThrowIfFailed(device->CreateRootSignature(1, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+    m_rootSignature->SetName(L"Reconstructor");
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc = {};
+    pipelineDesc.pRootSignature = m_rootSignature.Get();
+    pipelineDesc.CS = CD3DX12_SHADER_BYTECODE((void*)g_pReconstruct, ARRAYSIZE(g_pReconstruct));
+    ThrowIfFailed(device->CreateComputePipelineState(&pipelineDesc, IID_PPV_ARGS(&m_pipelineState)), L"Couldn't create the reconstruction pipeline state.\n");
+    m_pipelineState->SetName(L"Reconstructor");
+}
+
+void Reconstructor::Release()
+{
+    m_rootSignature.Reset();
+    m_pipelineState.Reset();
+}
+
+void Reconstructor::Dispatch(ID3D12GraphicsCommandList* commandList, D3D12_GPU_DESCRIPTOR_HANDLE output, const RayPatternConstants& constants)
+{
+    commandList->SetComputeRootSignature(m_rootSignature.Get());
+    commandList->SetPipelineState(m_pipelineState.Get());
+    commandList->SetComputeRootDescriptorTable(RootParameterOutput, output);
+    commandList->SetComputeRoot32BitConstants(RootParameterConstants, sizeof(constants) / sizeof(UINT32), &constants, 0);
+    commandList->Dispatch((constants.renderWidth + c_groupSize - 1) / c_groupSize, (constants.renderHeight + c_groupSize - 1) / c_groupSize, 1);
+}
@@ -0,0 +1,42 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+
+//
+// Reconstructor.h - Fills in the pixels a sparse ray pattern didn't trace
+//
+
+#pragma once
+
+#include "RaytracingHlslCompat.h"
+
+namespace DX
+{
+    // Runs Reconstruct.hlsl, one thread per pixel of the render size in 8x8 groups, in place on
+    // the raytracing output. See RayPattern for what it does.
+    class Reconstructor
+    {
+    public:
+        Reconstructor();
+
+        // Root signature and pipeline state, once per device.
+        void Create(ID3D12Device* device);
+        void Release();
+
+        // The descriptor heap must be set and output must be a table whose first descriptor is
+        // the raytracing output's UAV, in D3D12_RESOURCE_STATE_UNORDERED_ACCESS.
+        void Dispatch(ID3D12GraphicsCommandList* commandList, D3D12_GPU_DESCRIPTOR_HANDLE output, const RayPatternConstants& constants);
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12RootSignature>     m_rootSignature;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState>     m_pipelineState;
+    };
+}
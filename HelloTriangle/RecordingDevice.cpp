@@ -0,0 +1,1895 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "RecordingDevice.h"
+#include "CpuBvh.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    const UINT64 c_gpuAddressBase = 0x100000000;
+    const SIZE_T c_cpuDescriptorBase = 0x10000;
+    const UINT64 c_gpuDescriptorBase = 0x200000000;
+    const UINT c_descriptorSize = 32;
+
+    inline UINT64 Align(UINT64 size, UINT64 alignment)
+    {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    inline void LogCall(const char* name)
+    {
+        char buffer[128] = {};
+        sprintf_s(buffer, "D3D12: %s\n", name);
+        OutputDebugStringA(buffer);
+    }
+
+    UINT BitsPerPixel(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:     return 128;
+        case DXGI_FORMAT_R32G32B32_FLOAT:       return 96;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R32G32_FLOAT:          return 64;
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_UINT:
+        case DXGI_FORMAT_D16_UNORM:
+        case DXGI_FORMAT_R8G8_UNORM:            return 16;
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_R8_UINT:               return 8;
+        default:                                return 32;
+        }
+    }
+
+    UINT GetMipLevels(const D3D12_RESOURCE_DESC& desc)
+    {
+        if (desc.MipLevels != 0)
+        {
+            return desc.MipLevels;
+        }
+        UINT64 size = max(desc.Width, static_cast<UINT64>(desc.Height));
+        UINT levels = 1;
+        while (size > 1)
+        {
+            size >>= 1;
+            levels++;
+        }
+        return levels;
+    }
+
+    // Linear layout with D3D12_TEXTURE_DATA_PITCH_ALIGNMENT rows, close enough to what drivers report.
+    UINT64 GetAllocationSize(const D3D12_RESOURCE_DESC& desc)
+    {
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            return Align(desc.Width, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+        }
+
+        bool volume = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        UINT64 size = 0;
+        for (UINT mip = 0; mip < GetMipLevels(desc); mip++)
+        {
+            UINT64 width = max(desc.Width >> mip, 1ull);
+            UINT64 height = max(desc.Height >> mip, 1u);
+            UINT64 depth = volume ? max(desc.DepthOrArraySize >> mip, 1) : 1;
+            size += Align(width * BitsPerPixel(desc.Format) / 8, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) * height * depth;
+        }
+        size *= (volume ? 1 : desc.DepthOrArraySize) * max(desc.SampleDesc.Count, 1u);
+
+        UINT64 alignment = desc.SampleDesc.Count > 1 ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        return Align(size, alignment);
+    }
+
+    // The sizes of a CpuBvh over the same primitives stand in for the driver's.
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO EstimatePrebuildInfo(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs)
+    {
+        UINT primitiveCount = 0;
+        if (inputs.Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL)
+        {
+            primitiveCount = inputs.NumDescs;
+        }
+        else
+        {
+            for (UINT i = 0; i < inputs.NumDescs; i++)
+            {
+                const D3D12_RAYTRACING_GEOMETRY_DESC& geometry = inputs.DescsLayout == D3D12_ELEMENTS_LAYOUT_ARRAY ? inputs.pGeometryDescs[i] : *inputs.ppGeometryDescs[i];
+                if (geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
+                {
+                    primitiveCount += (geometry.Triangles.IndexBuffer ? geometry.Triangles.IndexCount : geometry.Triangles.VertexCount) / 3;
+                }
+                else
+                {
+                    primitiveCount += static_cast<UINT>(geometry.AABBs.AABBCount);
+                }
+            }
+        }
+
+        CpuBvhPrebuildInfo bvhInfo = CpuBvh::GetPrebuildInfo(primitiveCount);
+
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info = {};
+        info.ResultDataMaxSizeInBytes = Align(bvhInfo.resultDataMaxSize, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+        info.ScratchDataSizeInBytes = Align(bvhInfo.scratchDataSize, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+        if (inputs.Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE)
+        {
+            info.UpdateScratchDataSizeInBytes = info.ScratchDataSizeInBytes;
+        }
+        return info;
+    }
+
+    // A build's inputs, kept until the build executes: the descs only live through the call.
+    struct RecordedBuildInputs
+    {
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE    type;
+        UINT                                            instanceCount;
+        D3D12_ELEMENTS_LAYOUT                           instanceLayout;
+        D3D12_GPU_VIRTUAL_ADDRESS                       instanceDescs;
+        vector<D3D12_RAYTRACING_GEOMETRY_DESC>          geometries;
+        UINT64                                          resultMaxSize;
+    };
+
+    RecordedBuildInputs RecordBuildInputs(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs)
+    {
+        RecordedBuildInputs recorded = {};
+        recorded.type = inputs.Type;
+        recorded.resultMaxSize = EstimatePrebuildInfo(inputs).ResultDataMaxSizeInBytes;
+        if (inputs.Type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL)
+        {
+            recorded.instanceCount = inputs.NumDescs;
+            recorded.instanceLayout = inputs.DescsLayout;
+            recorded.instanceDescs = inputs.InstanceDescs;
+            return recorded;
+        }
+        for (UINT i = 0; i < inputs.NumDescs; i++)
+        {
+            recorded.geometries.push_back(inputs.DescsLayout == D3D12_ELEMENTS_LAYOUT_ARRAY ? inputs.pGeometryDescs[i] : *inputs.ppGeometryDescs[i]);
+        }
+        return recorded;
+    }
+
+    inline XMFLOAT3 TransformPoint(const XMFLOAT3X4& m, const XMFLOAT3& p)
+    {
+        return XMFLOAT3(
+            m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3],
+            m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3],
+            m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3]);
+    }
+
+    inline void Grow(XMFLOAT3* boundsMin, XMFLOAT3* boundsMax, const XMFLOAT3& p)
+    {
+        *boundsMin = XMFLOAT3(min(boundsMin->x, p.x), min(boundsMin->y, p.y), min(boundsMin->z, p.z));
+        *boundsMax = XMFLOAT3(max(boundsMax->x, p.x), max(boundsMax->y, p.y), max(boundsMax->z, p.z));
+    }
+
+    inline bool IsDeviceChild(REFIID riid)
+    {
+        return riid == __uuidof(IUnknown) || riid == __uuidof(ID3D12Object) || riid == __uuidof(ID3D12DeviceChild);
+    }
+
+    inline bool IsPageable(REFIID riid)
+    {
+        return IsDeviceChild(riid) || riid == __uuidof(ID3D12Pageable);
+    }
+
+    class RecordingDevice;
+
+    // IUnknown and ID3D12Object for all recording objects. Objects start with one reference.
+    template <class Interface>
+    class RecordingObject : public Interface
+    {
+    public:
+        RecordingObject() : m_refCount(1) {}
+        virtual ~RecordingObject() {}
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (ppvObject == nullptr)
+            {
+                return E_POINTER;
+            }
+            *ppvObject = Cast(riid);
+            if (*ppvObject == nullptr)
+            {
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            return S_OK;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return static_cast<ULONG>(InterlockedIncrement(&m_refCount));
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG refCount = static_cast<ULONG>(InterlockedDecrement(&m_refCount));
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+
+        HRESULT STDMETHODCALLTYPE SetName(LPCWSTR Name) override
+        {
+            m_name = Name ? Name : L"";
+            return S_OK;
+        }
+
+    protected:
+        // Returns this as the requested interface, nullptr if it isn't implemented.
+        virtual void* Cast(REFIID riid) = 0;
+
+        volatile LONG   m_refCount;
+        std::wstring    m_name;
+    };
+
+    // Children keep their device alive, as they do with a real device.
+    template <class Interface>
+    class RecordingDeviceChild : public RecordingObject<Interface>
+    {
+    public:
+        explicit RecordingDeviceChild(ID3D12Device5* device) : m_device(device) {}
+
+        HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** ppvDevice) override
+        {
+            return m_device->QueryInterface(riid, ppvDevice);
+        }
+
+    protected:
+        RecordingDevice* Device() const;
+
+        ComPtr<ID3D12Device5> m_device;
+    };
+
+    class RecordingHeap : public RecordingDeviceChild<ID3D12Heap>
+    {
+    public:
+        RecordingHeap(ID3D12Device5* device, const D3D12_HEAP_DESC& desc);
+        ~RecordingHeap();
+
+        D3D12_HEAP_DESC STDMETHODCALLTYPE GetDesc() override { return m_desc; }
+
+        BYTE*                       GetData() { return m_memory.empty() ? nullptr : m_memory.data(); }
+        D3D12_GPU_VIRTUAL_ADDRESS   GetGpuAddress() const { return m_gpuAddress; }
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12Heap) ? static_cast<ID3D12Heap*>(this) : nullptr; }
+
+    private:
+        D3D12_HEAP_DESC             m_desc;
+        std::vector<BYTE>           m_memory;
+        D3D12_GPU_VIRTUAL_ADDRESS   m_gpuAddress;
+    };
+
+    class RecordingResource : public RecordingDeviceChild<ID3D12Resource>
+    {
+    public:
+        // Committed if heap is null, placed at heapOffset otherwise.
+        RecordingResource(ID3D12Device5* device, const D3D12_RESOURCE_DESC& desc, const D3D12_HEAP_PROPERTIES& heapProperties, D3D12_HEAP_FLAGS heapFlags, RecordingHeap* heap, UINT64 heapOffset);
+        ~RecordingResource();
+
+        HRESULT STDMETHODCALLTYPE Map(UINT Subresource, const D3D12_RANGE* pReadRange, void** ppData) override;
+        void STDMETHODCALLTYPE Unmap(UINT Subresource, const D3D12_RANGE* pWrittenRange) override;
+        D3D12_RESOURCE_DESC STDMETHODCALLTYPE GetDesc() override { return m_desc; }
+        D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE GetGPUVirtualAddress() override { return m_gpuAddress; }
+        HRESULT STDMETHODCALLTYPE WriteToSubresource(UINT, const D3D12_BOX*, const void*, UINT, UINT) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE ReadFromSubresource(void*, UINT, UINT, UINT, const D3D12_BOX*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE GetHeapProperties(D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS* pHeapFlags) override;
+
+        // Buffers only, nullptr for textures.
+        BYTE*   GetData() const { return m_data; }
+        UINT64  GetSize() const { return m_desc.Width; }
+        bool    IsBuffer() const { return m_desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER; }
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12Resource) ? static_cast<ID3D12Resource*>(this) : nullptr; }
+
+    private:
+        D3D12_RESOURCE_DESC         m_desc;
+        D3D12_HEAP_PROPERTIES       m_heapProperties;
+        D3D12_HEAP_FLAGS            m_heapFlags;
+        ComPtr<ID3D12Heap>          m_heap;
+        UINT64                      m_allocationSize;   // Zero for placed resources, the heap owns the memory.
+        std::vector<BYTE>           m_memory;
+        BYTE*                       m_data;
+        D3D12_GPU_VIRTUAL_ADDRESS   m_gpuAddress;
+    };
+
+    // Work completes as soon as it is submitted, so fences only move forward through Signal().
+    class RecordingFence : public RecordingDeviceChild<ID3D12Fence>
+    {
+    public:
+        RecordingFence(ID3D12Device5* device, UINT64 initialValue) : RecordingDeviceChild(device), m_value(initialValue) {}
+
+        UINT64 STDMETHODCALLTYPE GetCompletedValue() override;
+        HRESULT STDMETHODCALLTYPE SetEventOnCompletion(UINT64 Value, HANDLE hEvent) override;
+        HRESULT STDMETHODCALLTYPE Signal(UINT64 Value) override;
+
+        void Complete(UINT64 value);
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12Fence) ? static_cast<ID3D12Fence*>(this) : nullptr; }
+
+    private:
+        std::mutex                                  m_mutex;
+        UINT64                                      m_value;
+        std::vector<std::pair<UINT64, HANDLE>>      m_events;
+    };
+
+    class RecordingCommandAllocator : public RecordingDeviceChild<ID3D12CommandAllocator>
+    {
+    public:
+        RecordingCommandAllocator(ID3D12Device5* device) : RecordingDeviceChild(device) {}
+
+        HRESULT STDMETHODCALLTYPE Reset() override;
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12CommandAllocator) ? static_cast<ID3D12CommandAllocator*>(this) : nullptr; }
+    };
+
+    class RecordingDescriptorHeap : public RecordingDeviceChild<ID3D12DescriptorHeap>
+    {
+    public:
+        RecordingDescriptorHeap(ID3D12Device5* device, const D3D12_DESCRIPTOR_HEAP_DESC& desc);
+
+        D3D12_DESCRIPTOR_HEAP_DESC STDMETHODCALLTYPE GetDesc() override { return m_desc; }
+        D3D12_CPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetCPUDescriptorHandleForHeapStart() override { return m_cpuStart; }
+        D3D12_GPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetGPUDescriptorHandleForHeapStart() override { return m_gpuStart; }
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12DescriptorHeap) ? static_cast<ID3D12DescriptorHeap*>(this) : nullptr; }
+
+    private:
+        D3D12_DESCRIPTOR_HEAP_DESC  m_desc;
+        D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart;
+        D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart;
+    };
+
+    class RecordingRootSignature : public RecordingDeviceChild<ID3D12RootSignature>
+    {
+    public:
+        RecordingRootSignature(ID3D12Device5* device) : RecordingDeviceChild(device) {}
+
+    protected:
+        void* Cast(REFIID riid) override { return IsDeviceChild(riid) || riid == __uuidof(ID3D12RootSignature) ? static_cast<ID3D12RootSignature*>(this) : nullptr; }
+    };
+
+    // Compute only, the bytecode is never looked at.
+    class RecordingPipelineState : public RecordingDeviceChild<ID3D12PipelineState>
+    {
+    public:
+        RecordingPipelineState(ID3D12Device5* device) : RecordingDeviceChild(device) {}
+
+        HRESULT STDMETHODCALLTYPE GetCachedBlob(ID3DBlob**) override { return E_NOTIMPL; }
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12PipelineState) ? static_cast<ID3D12PipelineState*>(this) : nullptr; }
+    };
+
+    // Hands out a distinct shader identifier for every export of the DXIL libraries and every hit
+    // group, and nullptr for unknown names, so misspelled exports fail like on a real device.
+    class RecordingStateObject : public RecordingDeviceChild<ID3D12StateObject>, public ID3D12StateObjectProperties
+    {
+    public:
+        RecordingStateObject(ID3D12Device5* device, const D3D12_STATE_OBJECT_DESC& desc);
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override { return RecordingDeviceChild::QueryInterface(riid, ppvObject); }
+        ULONG STDMETHODCALLTYPE AddRef() override { return RecordingDeviceChild::AddRef(); }
+        ULONG STDMETHODCALLTYPE Release() override { return RecordingDeviceChild::Release(); }
+
+        void* STDMETHODCALLTYPE GetShaderIdentifier(LPCWSTR pExportName) override;
+        UINT64 STDMETHODCALLTYPE GetShaderStackSize(LPCWSTR) override { return 0; }
+        UINT64 STDMETHODCALLTYPE GetPipelineStackSize() override { return m_pipelineStackSize; }
+        void STDMETHODCALLTYPE SetPipelineStackSize(UINT64 PipelineStackSizeInBytes) override { m_pipelineStackSize = PipelineStackSizeInBytes; }
+
+    protected:
+        void* Cast(REFIID riid) override;
+
+    private:
+        typedef std::array<BYTE, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES> ShaderIdentifier;
+
+        void AddExport(LPCWSTR name);
+
+        std::map<std::wstring, ShaderIdentifier>    m_shaderIdentifiers;
+        bool                                        m_exportsAll;   // A library or collection exports everything it has.
+        UINT64                                      m_pipelineStackSize;
+    };
+
+    // Records into a plain list of closures. Only the commands with an effect the CPU can observe
+    // (buffer copies, acceleration structure sizes) capture one, everything else is just counted.
+    class RecordingCommandList : public RecordingDeviceChild<ID3D12GraphicsCommandList4>
+    {
+    public:
+        RecordingCommandList(ID3D12Device5* device, D3D12_COMMAND_LIST_TYPE type, bool closed);
+
+        // Runs the recorded commands, called by the queue.
+        void Execute();
+        bool IsClosed() const { return m_closed; }
+
+        // ID3D12CommandList
+        D3D12_COMMAND_LIST_TYPE STDMETHODCALLTYPE GetType() override { return m_type; }
+
+        // ID3D12GraphicsCommandList
+        HRESULT STDMETHODCALLTYPE Close() override;
+        HRESULT STDMETHODCALLTYPE Reset(ID3D12CommandAllocator* pAllocator, ID3D12PipelineState* pInitialState) override;
+        void STDMETHODCALLTYPE ClearState(ID3D12PipelineState*) override { Count("CommandList::ClearState"); }
+        void STDMETHODCALLTYPE DrawInstanced(UINT, UINT, UINT, UINT) override { Count("CommandList::DrawInstanced"); }
+        void STDMETHODCALLTYPE DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT) override { Count("CommandList::DrawIndexedInstanced"); }
+        void STDMETHODCALLTYPE Dispatch(UINT, UINT, UINT) override { Count("CommandList::Dispatch"); }
+        void STDMETHODCALLTYPE CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 DstOffset, ID3D12Resource* pSrcBuffer, UINT64 SrcOffset, UINT64 NumBytes) override;
+        void STDMETHODCALLTYPE CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION*, UINT, UINT, UINT, const D3D12_TEXTURE_COPY_LOCATION*, const D3D12_BOX*) override { Count("CommandList::CopyTextureRegion"); }
+        void STDMETHODCALLTYPE CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource) override;
+        void STDMETHODCALLTYPE CopyTiles(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Resource*, UINT64, D3D12_TILE_COPY_FLAGS) override { Count("CommandList::CopyTiles"); }
+        void STDMETHODCALLTYPE ResolveSubresource(ID3D12Resource*, UINT, ID3D12Resource*, UINT, DXGI_FORMAT) override { Count("CommandList::ResolveSubresource"); }
+        void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY) override { Count("CommandList::IASetPrimitiveTopology"); }
+        void STDMETHODCALLTYPE RSSetViewports(UINT, const D3D12_VIEWPORT*) override { Count("CommandList::RSSetViewports"); }
+        void STDMETHODCALLTYPE RSSetScissorRects(UINT, const D3D12_RECT*) override { Count("CommandList::RSSetScissorRects"); }
+        void STDMETHODCALLTYPE OMSetBlendFactor(const FLOAT[4]) override { Count("CommandList::OMSetBlendFactor"); }
+        void STDMETHODCALLTYPE OMSetStencilRef(UINT) override { Count("CommandList::OMSetStencilRef"); }
+        void STDMETHODCALLTYPE SetPipelineState(ID3D12PipelineState*) override { Count("CommandList::SetPipelineState"); }
+        void STDMETHODCALLTYPE ResourceBarrier(UINT NumBarriers, const D3D12_RESOURCE_BARRIER*) override { Count("CommandList::ResourceBarrier"); Count("CommandList::ResourceBarrier (barriers)", NumBarriers); }
+        void STDMETHODCALLTYPE ExecuteBundle(ID3D12GraphicsCommandList*) override { Count("CommandList::ExecuteBundle"); }
+        void STDMETHODCALLTYPE SetDescriptorHeaps(UINT, ID3D12DescriptorHeap* const*) override { Count("CommandList::SetDescriptorHeaps"); }
+        void STDMETHODCALLTYPE SetComputeRootSignature(ID3D12RootSignature*) override { Count("CommandList::SetComputeRootSignature"); }
+        void STDMETHODCALLTYPE SetGraphicsRootSignature(ID3D12RootSignature*) override { Count("CommandList::SetGraphicsRootSignature"); }
+        void STDMETHODCALLTYPE SetComputeRootDescriptorTable(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) override { Count("CommandList::SetComputeRootDescriptorTable"); }
+        void STDMETHODCALLTYPE SetGraphicsRootDescriptorTable(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) override { Count("CommandList::SetGraphicsRootDescriptorTable"); }
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstant(UINT, UINT, UINT) override { Count("CommandList::SetComputeRoot32BitConstant"); }
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstant(UINT, UINT, UINT) override { Count("CommandList::SetGraphicsRoot32BitConstant"); }
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstants(UINT, UINT, const void*, UINT) override { Count("CommandList::SetComputeRoot32BitConstants"); }
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstants(UINT, UINT, const void*, UINT) override { Count("CommandList::SetGraphicsRoot32BitConstants"); }
+        void STDMETHODCALLTYPE SetComputeRootConstantBufferView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetComputeRootConstantBufferView"); }
+        void STDMETHODCALLTYPE SetGraphicsRootConstantBufferView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetGraphicsRootConstantBufferView"); }
+        void STDMETHODCALLTYPE SetComputeRootShaderResourceView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetComputeRootShaderResourceView"); }
+        void STDMETHODCALLTYPE SetGraphicsRootShaderResourceView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetGraphicsRootShaderResourceView"); }
+        void STDMETHODCALLTYPE SetComputeRootUnorderedAccessView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetComputeRootUnorderedAccessView"); }
+        void STDMETHODCALLTYPE SetGraphicsRootUnorderedAccessView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override { Count("CommandList::SetGraphicsRootUnorderedAccessView"); }
+        void STDMETHODCALLTYPE IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW*) override { Count("CommandList::IASetIndexBuffer"); }
+        void STDMETHODCALLTYPE IASetVertexBuffers(UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW*) override { Count("CommandList::IASetVertexBuffers"); }
+        void STDMETHODCALLTYPE SOSetTargets(UINT, UINT, const D3D12_STREAM_OUTPUT_BUFFER_VIEW*) override { Count("CommandList::SOSetTargets"); }
+        void STDMETHODCALLTYPE OMSetRenderTargets(UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, BOOL, const D3D12_CPU_DESCRIPTOR_HANDLE*) override { Count("CommandList::OMSetRenderTargets"); }
+        void STDMETHODCALLTYPE ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CLEAR_FLAGS, FLOAT, UINT8, UINT, const D3D12_RECT*) override { Count("CommandList::ClearDepthStencilView"); }
+        void STDMETHODCALLTYPE ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE, const FLOAT[4], UINT, const D3D12_RECT*) override { Count("CommandList::ClearRenderTargetView"); }
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const UINT[4], UINT, const D3D12_RECT*) override { Count("CommandList::ClearUnorderedAccessViewUint"); }
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const FLOAT[4], UINT, const D3D12_RECT*) override { Count("CommandList::ClearUnorderedAccessViewFloat"); }
+        void STDMETHODCALLTYPE DiscardResource(ID3D12Resource*, const D3D12_DISCARD_REGION*) override { Count("CommandList::DiscardResource"); }
+        void STDMETHODCALLTYPE BeginQuery(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT) override { Count("CommandList::BeginQuery"); }
+        void STDMETHODCALLTYPE EndQuery(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT) override { Count("CommandList::EndQuery"); }
+        void STDMETHODCALLTYPE ResolveQueryData(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT, UINT, ID3D12Resource*, UINT64) override { Count("CommandList::ResolveQueryData"); }
+        void STDMETHODCALLTYPE SetPredication(ID3D12Resource*, UINT64, D3D12_PREDICATION_OP) override { Count("CommandList::SetPredication"); }
+        void STDMETHODCALLTYPE SetMarker(UINT, const void*, UINT) override { Count("CommandList::SetMarker"); }
+        void STDMETHODCALLTYPE BeginEvent(UINT, const void*, UINT) override { Count("CommandList::BeginEvent"); }
+        void STDMETHODCALLTYPE EndEvent() override { Count("CommandList::EndEvent"); }
+        void STDMETHODCALLTYPE ExecuteIndirect(ID3D12CommandSignature*, UINT, ID3D12Resource*, UINT64, ID3D12Resource*, UINT64) override { Count("CommandList::ExecuteIndirect"); }
+
+        // ID3D12GraphicsCommandList1
+        void STDMETHODCALLTYPE AtomicCopyBufferUINT(ID3D12Resource*, UINT64, ID3D12Resource*, UINT64, UINT, ID3D12Resource* const*, const D3D12_SUBRESOURCE_RANGE_UINT64*) override { Count("CommandList::AtomicCopyBufferUINT"); }
+        void STDMETHODCALLTYPE AtomicCopyBufferUINT64(ID3D12Resource*, UINT64, ID3D12Resource*, UINT64, UINT, ID3D12Resource* const*, const D3D12_SUBRESOURCE_RANGE_UINT64*) override { Count("CommandList::AtomicCopyBufferUINT64"); }
+        void STDMETHODCALLTYPE OMSetDepthBounds(FLOAT, FLOAT) override { Count("CommandList::OMSetDepthBounds"); }
+        void STDMETHODCALLTYPE SetSamplePositions(UINT, UINT, D3D12_SAMPLE_POSITION*) override { Count("CommandList::SetSamplePositions"); }
+        void STDMETHODCALLTYPE ResolveSubresourceRegion(ID3D12Resource*, UINT, UINT, UINT, ID3D12Resource*, UINT, D3D12_RECT*, DXGI_FORMAT, D3D12_RESOLVE_MODE) override { Count("CommandList::ResolveSubresourceRegion"); }
+        void STDMETHODCALLTYPE SetViewInstanceMask(UINT) override { Count("CommandList::SetViewInstanceMask"); }
+
+        // ID3D12GraphicsCommandList2
+        void STDMETHODCALLTYPE WriteBufferImmediate(UINT, const D3D12_WRITEBUFFERIMMEDIATE_PARAMETER*, const D3D12_WRITEBUFFERIMMEDIATE_MODE*) override { Count("CommandList::WriteBufferImmediate"); }
+
+        // ID3D12GraphicsCommandList3
+        void STDMETHODCALLTYPE SetProtectedResourceSession(ID3D12ProtectedResourceSession*) override { Count("CommandList::SetProtectedResourceSession"); }
+
+        // ID3D12GraphicsCommandList4
+        void STDMETHODCALLTYPE BeginRenderPass(UINT, const D3D12_RENDER_PASS_RENDER_TARGET_DESC*, const D3D12_RENDER_PASS_DEPTH_STENCIL_DESC*, D3D12_RENDER_PASS_FLAGS) override { Count("CommandList::BeginRenderPass"); }
+        void STDMETHODCALLTYPE EndRenderPass() override { Count("CommandList::EndRenderPass"); }
+        void STDMETHODCALLTYPE InitializeMetaCommand(ID3D12MetaCommand*, const void*, SIZE_T) override { Count("CommandList::InitializeMetaCommand"); }
+        void STDMETHODCALLTYPE ExecuteMetaCommand(ID3D12MetaCommand*, const void*, SIZE_T) override { Count("CommandList::ExecuteMetaCommand"); }
+        void STDMETHODCALLTYPE BuildRaytracingAccelerationStructure(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC* pDesc, UINT NumPostbuildInfoDescs, const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC* pPostbuildInfoDescs) override;
+        void STDMETHODCALLTYPE EmitRaytracingAccelerationStructurePostbuildInfo(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC* pDesc, UINT NumSourceAccelerationStructures, const D3D12_GPU_VIRTUAL_ADDRESS* pSourceAccelerationStructureData) override;
+        void STDMETHODCALLTYPE CopyRaytracingAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS DestAccelerationStructureData, D3D12_GPU_VIRTUAL_ADDRESS SourceAccelerationStructureData, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE Mode) override;
+        void STDMETHODCALLTYPE SetPipelineState1(ID3D12StateObject*) override { Count("CommandList::SetPipelineState1"); }
+        void STDMETHODCALLTYPE DispatchRays(const D3D12_DISPATCH_RAYS_DESC*) override { Count("CommandList::DispatchRays"); }
+
+    protected:
+        void* Cast(REFIID riid) override;
+
+    private:
+        // Keyed by the name literal, each method has its own, so counting doesn't allocate.
+        void Count(const char* name, UINT64 count = 1);
+        void EmitPostbuildInfo(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC& desc, UINT sourceCount, const D3D12_GPU_VIRTUAL_ADDRESS* sources);
+
+        D3D12_COMMAND_LIST_TYPE                     m_type;
+        bool                                        m_closed;
+        RecordingStatistics::PendingCalls           m_calls;
+        std::vector<std::function<void()>>          m_commands;
+    };
+
+    class RecordingCommandQueue : public RecordingDeviceChild<ID3D12CommandQueue>
+    {
+    public:
+        RecordingCommandQueue(ID3D12Device5* device, const D3D12_COMMAND_QUEUE_DESC& desc) : RecordingDeviceChild(device), m_desc(desc) {}
+
+        void STDMETHODCALLTYPE UpdateTileMappings(ID3D12Resource*, UINT, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Heap*, UINT, const D3D12_TILE_RANGE_FLAGS*, const UINT*, const UINT*, D3D12_TILE_MAPPING_FLAGS) override;
+        void STDMETHODCALLTYPE CopyTileMappings(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, D3D12_TILE_MAPPING_FLAGS) override;
+        void STDMETHODCALLTYPE ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists) override;
+        void STDMETHODCALLTYPE SetMarker(UINT, const void*, UINT) override;
+        void STDMETHODCALLTYPE BeginEvent(UINT, const void*, UINT) override;
+        void STDMETHODCALLTYPE EndEvent() override;
+        HRESULT STDMETHODCALLTYPE Signal(ID3D12Fence* pFence, UINT64 Value) override;
+        HRESULT STDMETHODCALLTYPE Wait(ID3D12Fence* pFence, UINT64 Value) override;
+        HRESULT STDMETHODCALLTYPE GetTimestampFrequency(UINT64* pFrequency) override;
+        HRESULT STDMETHODCALLTYPE GetClockCalibration(UINT64* pGpuTimestamp, UINT64* pCpuTimestamp) override;
+        D3D12_COMMAND_QUEUE_DESC STDMETHODCALLTYPE GetDesc() override { return m_desc; }
+
+    protected:
+        void* Cast(REFIID riid) override { return IsPageable(riid) || riid == __uuidof(ID3D12CommandQueue) ? static_cast<ID3D12CommandQueue*>(this) : nullptr; }
+
+    private:
+        D3D12_COMMAND_QUEUE_DESC    m_desc;
+    };
+
+    class RecordingDevice : public RecordingObject<ID3D12Device5>
+    {
+    public:
+        explicit RecordingDevice(const std::shared_ptr<RecordingStatistics>& statistics);
+
+        RecordingStatistics& Statistics() { return *m_statistics; }
+
+        D3D12_GPU_VIRTUAL_ADDRESS AllocateGpuAddressRange(UINT64 size);
+        D3D12_CPU_DESCRIPTOR_HANDLE AllocateCpuDescriptors(UINT count);
+        D3D12_GPU_DESCRIPTOR_HANDLE AllocateGpuDescriptors(UINT count);
+
+        // Buffers are looked up by address for the commands that only get addresses.
+        void RegisterBuffer(RecordingResource* buffer);
+        void UnregisterBuffer(RecordingResource* buffer);
+        // nullptr unless size bytes at address are within one buffer.
+        BYTE* GetBufferData(D3D12_GPU_VIRTUAL_ADDRESS address, UINT64 size);
+
+        // What a build made at an address: its size, the size compaction shrinks it to and its
+        // bounds, which the top level builds over it read. size is 0 for unknown addresses.
+        struct AccelerationStructure
+        {
+            UINT64              size;
+            UINT64              compactedSize;
+            DirectX::XMFLOAT3   boundsMin;
+            DirectX::XMFLOAT3   boundsMax;
+        };
+        // Builds a CpuBvh over the primitives the inputs point to, as they are when it's called.
+        AccelerationStructure BuildAccelerationStructure(const RecordedBuildInputs& inputs);
+        void SetAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, const AccelerationStructure& structure);
+        AccelerationStructure GetAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address);
+
+        // ID3D12Device
+        UINT STDMETHODCALLTYPE GetNodeCount() override { return 1; }
+        HRESULT STDMETHODCALLTYPE CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC* pDesc, REFIID riid, void** ppCommandQueue) override;
+        HRESULT STDMETHODCALLTYPE CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE type, REFIID riid, void** ppCommandAllocator) override;
+        HRESULT STDMETHODCALLTYPE CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID, void**) override { return NotImplemented("Device::CreateGraphicsPipelineState"); }
+        HRESULT STDMETHODCALLTYPE CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc, REFIID riid, void** ppPipelineState) override;
+        HRESULT STDMETHODCALLTYPE CreateCommandList(UINT nodeMask, D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator* pCommandAllocator, ID3D12PipelineState* pInitialState, REFIID riid, void** ppCommandList) override;
+        HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D12_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize) override;
+        HRESULT STDMETHODCALLTYPE CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* pDescriptorHeapDesc, REFIID riid, void** ppvHeap) override;
+        UINT STDMETHODCALLTYPE GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE) override { return c_descriptorSize; }
+        HRESULT STDMETHODCALLTYPE CreateRootSignature(UINT nodeMask, const void* pBlobWithRootSignature, SIZE_T blobLengthInBytes, REFIID riid, void** ppvRootSignature) override;
+        void STDMETHODCALLTYPE CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateConstantBufferView"); }
+        void STDMETHODCALLTYPE CreateShaderResourceView(ID3D12Resource*, const D3D12_SHADER_RESOURCE_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateShaderResourceView"); }
+        void STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D12Resource*, ID3D12Resource*, const D3D12_UNORDERED_ACCESS_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateUnorderedAccessView"); }
+        void STDMETHODCALLTYPE CreateRenderTargetView(ID3D12Resource*, const D3D12_RENDER_TARGET_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateRenderTargetView"); }
+        void STDMETHODCALLTYPE CreateDepthStencilView(ID3D12Resource*, const D3D12_DEPTH_STENCIL_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateDepthStencilView"); }
+        void STDMETHODCALLTYPE CreateSampler(const D3D12_SAMPLER_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override { Record("Device::CreateSampler"); }
+        void STDMETHODCALLTYPE CopyDescriptors(UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, D3D12_DESCRIPTOR_HEAP_TYPE) override { Record("Device::CopyDescriptors"); }
+        void STDMETHODCALLTYPE CopyDescriptorsSimple(UINT, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_DESCRIPTOR_HEAP_TYPE) override { Record("Device::CopyDescriptorsSimple"); }
+        D3D12_RESOURCE_ALLOCATION_INFO STDMETHODCALLTYPE GetResourceAllocationInfo(UINT visibleMask, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs) override;
+        D3D12_HEAP_PROPERTIES STDMETHODCALLTYPE GetCustomHeapProperties(UINT nodeMask, D3D12_HEAP_TYPE heapType) override;
+        HRESULT STDMETHODCALLTYPE CreateCommittedResource(const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS HeapFlags, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES InitialResourceState, const D3D12_CLEAR_VALUE* pOptimizedClearValue, REFIID riidResource, void** ppvResource) override;
+        HRESULT STDMETHODCALLTYPE CreateHeap(const D3D12_HEAP_DESC* pDesc, REFIID riid, void** ppvHeap) override;
+        HRESULT STDMETHODCALLTYPE CreatePlacedResource(ID3D12Heap* pHeap, UINT64 HeapOffset, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES InitialState, const D3D12_CLEAR_VALUE* pOptimizedClearValue, REFIID riid, void** ppvResource) override;
+        HRESULT STDMETHODCALLTYPE CreateReservedResource(const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void**) override { return NotImplemented("Device::CreateReservedResource"); }
+        HRESULT STDMETHODCALLTYPE CreateSharedHandle(ID3D12DeviceChild*, const SECURITY_ATTRIBUTES*, DWORD, LPCWSTR, HANDLE*) override { return NotImplemented("Device::CreateSharedHandle"); }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandle(HANDLE, REFIID, void**) override { return NotImplemented("Device::OpenSharedHandle"); }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandleByName(LPCWSTR, DWORD, HANDLE*) override { return NotImplemented("Device::OpenSharedHandleByName"); }
+        HRESULT STDMETHODCALLTYPE MakeResident(UINT, ID3D12Pageable* const*) override { Record("Device::MakeResident"); return S_OK; }
+        HRESULT STDMETHODCALLTYPE Evict(UINT, ID3D12Pageable* const*) override { Record("Device::Evict"); return S_OK; }
+        HRESULT STDMETHODCALLTYPE CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS Flags, REFIID riid, void** ppFence) override;
+        HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override { return S_OK; }
+        void STDMETHODCALLTYPE GetCopyableFootprints(const D3D12_RESOURCE_DESC* pResourceDesc, UINT FirstSubresource, UINT NumSubresources, UINT64 BaseOffset, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* pLayouts, UINT* pNumRows, UINT64* pRowSizeInBytes, UINT64* pTotalBytes) override;
+        HRESULT STDMETHODCALLTYPE CreateQueryHeap(const D3D12_QUERY_HEAP_DESC*, REFIID, void**) override { return NotImplemented("Device::CreateQueryHeap"); }
+        HRESULT STDMETHODCALLTYPE SetStablePowerState(BOOL) override { Record("Device::SetStablePowerState"); return S_OK; }
+        HRESULT STDMETHODCALLTYPE CreateCommandSignature(const D3D12_COMMAND_SIGNATURE_DESC*, ID3D12RootSignature*, REFIID, void**) override { return NotImplemented("Device::CreateCommandSignature"); }
+        void STDMETHODCALLTYPE GetResourceTiling(ID3D12Resource*, UINT*, D3D12_PACKED_MIP_INFO*, D3D12_TILE_SHAPE*, UINT*, UINT, D3D12_SUBRESOURCE_TILING*) override { Record("Device::GetResourceTiling"); }
+        LUID STDMETHODCALLTYPE GetAdapterLuid() override { return LUID{}; }
+
+        // ID3D12Device1
+        HRESULT STDMETHODCALLTYPE CreatePipelineLibrary(const void*, SIZE_T, REFIID, void**) override { return NotImplemented("Device::CreatePipelineLibrary"); }
+        HRESULT STDMETHODCALLTYPE SetEventOnMultipleFenceCompletion(ID3D12Fence* const*, const UINT64*, UINT, D3D12_MULTIPLE_FENCE_WAIT_FLAGS, HANDLE) override { return NotImplemented("Device::SetEventOnMultipleFenceCompletion"); }
+        HRESULT STDMETHODCALLTYPE SetResidencyPriority(UINT, ID3D12Pageable* const*, const D3D12_RESIDENCY_PRIORITY*) override { Record("Device::SetResidencyPriority"); return S_OK; }
+
+        // ID3D12Device2
+        HRESULT STDMETHODCALLTYPE CreatePipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC*, REFIID, void**) override { return NotImplemented("Device::CreatePipelineState"); }
+
+        // ID3D12Device3
+        HRESULT STDMETHODCALLTYPE OpenExistingHeapFromAddress(const void*, REFIID, void**) override { return NotImplemented("Device::OpenExistingHeapFromAddress"); }
+        HRESULT STDMETHODCALLTYPE OpenExistingHeapFromFileMapping(HANDLE, REFIID, void**) override { return NotImplemented("Device::OpenExistingHeapFromFileMapping"); }
+        HRESULT STDMETHODCALLTYPE EnqueueMakeResident(D3D12_RESIDENCY_FLAGS Flags, UINT NumObjects, ID3D12Pageable* const* ppObjects, ID3D12Fence* pFenceToSignal, UINT64 FenceValueToSignal) override;
+
+        // ID3D12Device4
+        HRESULT STDMETHODCALLTYPE CreateCommandList1(UINT nodeMask, D3D12_COMMAND_LIST_TYPE type, D3D12_COMMAND_LIST_FLAGS flags, REFIID riid, void** ppCommandList) override;
+        HRESULT STDMETHODCALLTYPE CreateProtectedResourceSession(const D3D12_PROTECTED_RESOURCE_SESSION_DESC*, REFIID, void**) override { return NotImplemented("Device::CreateProtectedResourceSession"); }
+        HRESULT STDMETHODCALLTYPE CreateCommittedResource1(const D3D12_HEAP_PROPERTIES*, D3D12_HEAP_FLAGS, const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, ID3D12ProtectedResourceSession*, REFIID, void**) override { return NotImplemented("Device::CreateCommittedResource1"); }
+        HRESULT STDMETHODCALLTYPE CreateHeap1(const D3D12_HEAP_DESC*, ID3D12ProtectedResourceSession*, REFIID, void**) override { return NotImplemented("Device::CreateHeap1"); }
+        HRESULT STDMETHODCALLTYPE CreateReservedResource1(const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, ID3D12ProtectedResourceSession*, REFIID, void**) override { return NotImplemented("Device::CreateReservedResource1"); }
+        D3D12_RESOURCE_ALLOCATION_INFO STDMETHODCALLTYPE GetResourceAllocationInfo1(UINT visibleMask, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs, D3D12_RESOURCE_ALLOCATION_INFO1* pResourceAllocationInfo1) override;
+
+        // ID3D12Device5
+        HRESULT STDMETHODCALLTYPE CreateLifetimeTracker(ID3D12LifetimeOwner*, REFIID, void**) override { return NotImplemented("Device::CreateLifetimeTracker"); }
+        void STDMETHODCALLTYPE RemoveDevice() override { Record("Device::RemoveDevice"); }
+        HRESULT STDMETHODCALLTYPE EnumerateMetaCommands(UINT* pNumMetaCommands, D3D12_META_COMMAND_DESC*) override;
+        HRESULT STDMETHODCALLTYPE EnumerateMetaCommandParameters(REFGUID, D3D12_META_COMMAND_PARAMETER_STAGE, UINT*, UINT*, D3D12_META_COMMAND_PARAMETER_DESC*) override { return NotImplemented("Device::EnumerateMetaCommandParameters"); }
+        HRESULT STDMETHODCALLTYPE CreateMetaCommand(REFGUID, UINT, const void*, SIZE_T, REFIID, void**) override { return NotImplemented("Device::CreateMetaCommand"); }
+        HRESULT STDMETHODCALLTYPE CreateStateObject(const D3D12_STATE_OBJECT_DESC* pDesc, REFIID riid, void** ppStateObject) override;
+        void STDMETHODCALLTYPE GetRaytracingAccelerationStructurePrebuildInfo(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS* pDesc, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO* pInfo) override;
+        D3D12_DRIVER_MATCHING_IDENTIFIER_STATUS STDMETHODCALLTYPE CheckDriverMatchingIdentifier(D3D12_SERIALIZED_DATA_TYPE, const D3D12_SERIALIZED_DATA_DRIVER_MATCHING_IDENTIFIER*) override;
+
+    protected:
+        void* Cast(REFIID riid) override;
+
+    private:
+        void Record(const char* name) { m_statistics->RecordCall(name); }
+        HRESULT NotImplemented(const char* name) { Record(name); return E_NOTIMPL; }
+        // Per primitive bounds for CpuBvh, false when a buffer or format can't be read.
+        bool ReadGeometryBounds(const RecordedBuildInputs& inputs, std::vector<DirectX::XMFLOAT3>* boundsMin, std::vector<DirectX::XMFLOAT3>* boundsMax);
+        bool ReadInstanceBounds(const RecordedBuildInputs& inputs, std::vector<DirectX::XMFLOAT3>* boundsMin, std::vector<DirectX::XMFLOAT3>* boundsMax);
+
+        std::shared_ptr<RecordingStatistics>                        m_statistics;
+        std::mutex                                                  m_mutex;
+        D3D12_GPU_VIRTUAL_ADDRESS                                   m_nextGpuAddress;
+        SIZE_T                                                      m_nextCpuDescriptor;
+        UINT64                                                      m_nextGpuDescriptor;
+        std::map<D3D12_GPU_VIRTUAL_ADDRESS, RecordingResource*>     m_buffers;
+        std::unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, AccelerationStructure> m_accelerationStructures;
+    };
+
+    // Drops the creation reference once the caller holds its own.
+    template <class T>
+    HRESULT ReturnObject(T* object, REFIID riid, void** ppvObject)
+    {
+        HRESULT hr = ppvObject ? object->QueryInterface(riid, ppvObject) : S_FALSE;
+        object->Release();
+        return hr;
+    }
+
+    template <class Interface>
+    RecordingDevice* RecordingDeviceChild<Interface>::Device() const
+    {
+        return static_cast<RecordingDevice*>(m_device.Get());
+    }
+
+    //
+    // RecordingHeap
+    //
+
+    RecordingHeap::RecordingHeap(ID3D12Device5* device, const D3D12_HEAP_DESC& desc) :
+        RecordingDeviceChild(device),
+        m_desc(desc),
+        m_gpuAddress(0)
+    {
+        if (!(desc.Flags & D3D12_HEAP_FLAG_DENY_BUFFERS))
+        {
+            m_memory.resize(static_cast<size_t>(desc.SizeInBytes));
+            m_gpuAddress = Device()->AllocateGpuAddressRange(desc.SizeInBytes);
+        }
+        Device()->Statistics().RecordAllocation(desc.Properties.Type, desc.SizeInBytes);
+    }
+
+    RecordingHeap::~RecordingHeap()
+    {
+        Device()->Statistics().RecordRelease(m_desc.Properties.Type, m_desc.SizeInBytes);
+    }
+
+    //
+    // RecordingResource
+    //
+
+    RecordingResource::RecordingResource(ID3D12Device5* device, const D3D12_RESOURCE_DESC& desc, const D3D12_HEAP_PROPERTIES& heapProperties, D3D12_HEAP_FLAGS heapFlags, RecordingHeap* heap, UINT64 heapOffset) :
+        RecordingDeviceChild(device),
+        m_desc(desc),
+        m_heapProperties(heapProperties),
+        m_heapFlags(heapFlags),
+        m_heap(heap),
+        m_allocationSize(0),
+        m_data(nullptr),
+        m_gpuAddress(0)
+    {
+        if (heap)
+        {
+            if (IsBuffer() && heap->GetData())
+            {
+                m_data = heap->GetData() + heapOffset;
+                m_gpuAddress = heap->GetGpuAddress() + heapOffset;
+            }
+        }
+        else
+        {
+            m_allocationSize = GetAllocationSize(desc);
+            Device()->Statistics().RecordAllocation(heapProperties.Type, m_allocationSize);
+            if (IsBuffer())
+            {
+                m_memory.resize(static_cast<size_t>(desc.Width));
+                m_data = m_memory.data();
+                m_gpuAddress = Device()->AllocateGpuAddressRange(m_allocationSize);
+            }
+        }
+
+        if (m_data)
+        {
+            Device()->RegisterBuffer(this);
+        }
+    }
+
+    RecordingResource::~RecordingResource()
+    {
+        if (m_data)
+        {
+            Device()->UnregisterBuffer(this);
+        }
+        if (m_allocationSize)
+        {
+            Device()->Statistics().RecordRelease(m_heapProperties.Type, m_allocationSize);
+        }
+    }
+
+    HRESULT RecordingResource::Map(UINT, const D3D12_RANGE*, void** ppData)
+    {
+        Device()->Statistics().RecordCall("Resource::Map");
+
+        bool cpuAccessible = m_heapProperties.Type == D3D12_HEAP_TYPE_UPLOAD
+            || m_heapProperties.Type == D3D12_HEAP_TYPE_READBACK
+            || (m_heapProperties.Type == D3D12_HEAP_TYPE_CUSTOM && m_heapProperties.CPUPageProperty != D3D12_CPU_PAGE_PROPERTY_NOT_AVAILABLE);
+        if (!m_data || !cpuAccessible)
+        {
+            return E_INVALIDARG;
+        }
+        if (ppData)
+        {
+            *ppData = m_data;
+        }
+        return S_OK;
+    }
+
+    void RecordingResource::Unmap(UINT, const D3D12_RANGE*)
+    {
+        Device()->Statistics().RecordCall("Resource::Unmap");
+    }
+
+    HRESULT RecordingResource::GetHeapProperties(D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS* pHeapFlags)
+    {
+        if (pHeapProperties)
+        {
+            *pHeapProperties = m_heapProperties;
+        }
+        if (pHeapFlags)
+        {
+            *pHeapFlags = m_heapFlags;
+        }
+        return S_OK;
+    }
+
+    //
+    // RecordingFence
+    //
+
+    UINT64 RecordingFence::GetCompletedValue()
+    {
+        lock_guard<mutex> lock(m_mutex);
+        return m_value;
+    }
+
+    HRESULT RecordingFence::SetEventOnCompletion(UINT64 Value, HANDLE hEvent)
+    {
+        Device()->Statistics().RecordCall("Fence::SetEventOnCompletion");
+
+        unique_lock<mutex> lock(m_mutex);
+        if (m_value >= Value)
+        {
+            if (hEvent)
+            {
+                SetEvent(hEvent);
+            }
+            return S_OK;
+        }
+        if (hEvent)
+        {
+            m_events.push_back(make_pair(Value, hEvent));
+            return S_OK;
+        }
+
+        // No event means wait right here, until another thread signals the value.
+        HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (!event)
+        {
+            return E_FAIL;
+        }
+        m_events.push_back(make_pair(Value, event));
+        lock.unlock();
+        WaitForSingleObjectEx(event, INFINITE, FALSE);
+        CloseHandle(event);
+        return S_OK;
+    }
+
+    HRESULT RecordingFence::Signal(UINT64 Value)
+    {
+        Device()->Statistics().RecordCall("Fence::Signal");
+        Complete(Value);
+        return S_OK;
+    }
+
+    void RecordingFence::Complete(UINT64 value)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_value = value;
+        auto reached = partition(m_events.begin(), m_events.end(), [&](const pair<UINT64, HANDLE>& e) { return e.first > value; });
+        for (auto it = reached; it != m_events.end(); ++it)
+        {
+            SetEvent(it->second);
+        }
+        m_events.erase(reached, m_events.end());
+    }
+
+    //
+    // RecordingCommandAllocator, RecordingDescriptorHeap
+    //
+
+    HRESULT RecordingCommandAllocator::Reset()
+    {
+        Device()->Statistics().RecordCall("CommandAllocator::Reset");
+        return S_OK;
+    }
+
+    RecordingDescriptorHeap::RecordingDescriptorHeap(ID3D12Device5* device, const D3D12_DESCRIPTOR_HEAP_DESC& desc) :
+        RecordingDeviceChild(device),
+        m_desc(desc),
+        m_cpuStart(Device()->AllocateCpuDescriptors(desc.NumDescriptors)),
+        m_gpuStart{}
+    {
+        if (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+        {
+            m_gpuStart = Device()->AllocateGpuDescriptors(desc.NumDescriptors);
+        }
+    }
+
+    //
+    // RecordingStateObject
+    //
+
+    RecordingStateObject::RecordingStateObject(ID3D12Device5* device, const D3D12_STATE_OBJECT_DESC& desc) :
+        RecordingDeviceChild(device),
+        m_exportsAll(false),
+        m_pipelineStackSize(0)
+    {
+        for (UINT i = 0; i < desc.NumSubobjects; i++)
+        {
+            const D3D12_STATE_SUBOBJECT& subobject = desc.pSubobjects[i];
+            switch (subobject.Type)
+            {
+            case D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY:
+            {
+                auto library = static_cast<const D3D12_DXIL_LIBRARY_DESC*>(subobject.pDesc);
+                m_exportsAll |= library->NumExports == 0;
+                for (UINT e = 0; e < library->NumExports; e++)
+                {
+                    AddExport(library->pExports[e].Name);
+                }
+                break;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_EXISTING_COLLECTION:
+            {
+                auto collection = static_cast<const D3D12_EXISTING_COLLECTION_DESC*>(subobject.pDesc);
+                m_exportsAll |= collection->NumExports == 0;
+                for (UINT e = 0; e < collection->NumExports; e++)
+                {
+                    AddExport(collection->pExports[e].Name);
+                }
+                break;
+            }
+            case D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP:
+                AddExport(static_cast<const D3D12_HIT_GROUP_DESC*>(subobject.pDesc)->HitGroupExport);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void RecordingStateObject::AddExport(LPCWSTR name)
+    {
+        ShaderIdentifier identifier = {};
+        UINT index = static_cast<UINT>(m_shaderIdentifiers.size()) + 1;
+        memcpy(identifier.data(), &index, sizeof(index));
+        m_shaderIdentifiers.insert(make_pair(wstring(name), identifier));
+    }
+
+    void* RecordingStateObject::GetShaderIdentifier(LPCWSTR pExportName)
+    {
+        Device()->Statistics().RecordCall("StateObjectProperties::GetShaderIdentifier");
+
+        auto found = m_shaderIdentifiers.find(pExportName);
+        if (found == m_shaderIdentifiers.end())
+        {
+            if (!m_exportsAll)
+            {
+                return nullptr;
+            }
+            AddExport(pExportName);
+            found = m_shaderIdentifiers.find(pExportName);
+        }
+        return found->second.data();
+    }
+
+    void* RecordingStateObject::Cast(REFIID riid)
+    {
+        if (IsPageable(riid) || riid == __uuidof(ID3D12StateObject))
+        {
+            return static_cast<ID3D12StateObject*>(this);
+        }
+        if (riid == __uuidof(ID3D12StateObjectProperties))
+        {
+            return static_cast<ID3D12StateObjectProperties*>(this);
+        }
+        return nullptr;
+    }
+
+    //
+    // RecordingCommandList
+    //
+
+    RecordingCommandList::RecordingCommandList(ID3D12Device5* device, D3D12_COMMAND_LIST_TYPE type, bool closed) :
+        RecordingDeviceChild(device),
+        m_type(type),
+        m_closed(closed)
+    {
+    }
+
+    void* RecordingCommandList::Cast(REFIID riid)
+    {
+        if (IsDeviceChild(riid)
+            || riid == __uuidof(ID3D12CommandList)
+            || riid == __uuidof(ID3D12GraphicsCommandList)
+            || riid == __uuidof(ID3D12GraphicsCommandList1)
+            || riid == __uuidof(ID3D12GraphicsCommandList2)
+            || riid == __uuidof(ID3D12GraphicsCommandList3)
+            || riid == __uuidof(ID3D12GraphicsCommandList4))
+        {
+            return static_cast<ID3D12GraphicsCommandList4*>(this);
+        }
+        return nullptr;
+    }
+
+    void RecordingCommandList::Count(const char* name, UINT64 count)
+    {
+        m_calls[name] += count;
+        if (Device()->Statistics().IsLogging())
+        {
+            LogCall(name);
+        }
+    }
+
+    void RecordingCommandList::Execute()
+    {
+        for (auto& command : m_commands)
+        {
+            command();
+        }
+    }
+
+    HRESULT RecordingCommandList::Close()
+    {
+        Count("CommandList::Close");
+        if (m_closed)
+        {
+            return E_FAIL;
+        }
+        m_closed = true;
+
+        // Merged straight into the statistics, clearing keeps the buckets for the next recording.
+        Device()->Statistics().RecordCalls(m_calls);
+        m_calls.clear();
+        return S_OK;
+    }
+
+    HRESULT RecordingCommandList::Reset(ID3D12CommandAllocator* pAllocator, ID3D12PipelineState*)
+    {
+        Count("CommandList::Reset");
+        if (!m_closed || pAllocator == nullptr)
+        {
+            return E_FAIL;
+        }
+        m_closed = false;
+        m_commands.clear();
+        return S_OK;
+    }
+
+    void RecordingCommandList::CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 DstOffset, ID3D12Resource* pSrcBuffer, UINT64 SrcOffset, UINT64 NumBytes)
+    {
+        Count("CommandList::CopyBufferRegion");
+
+        auto dst = static_cast<RecordingResource*>(pDstBuffer);
+        auto src = static_cast<RecordingResource*>(pSrcBuffer);
+        if (dst->GetData() && src->GetData() && DstOffset + NumBytes <= dst->GetSize() && SrcOffset + NumBytes <= src->GetSize())
+        {
+            m_commands.push_back([=]() { memcpy(dst->GetData() + DstOffset, src->GetData() + SrcOffset, static_cast<size_t>(NumBytes)); });
+        }
+    }
+
+    void RecordingCommandList::CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource)
+    {
+        Count("CommandList::CopyResource");
+
+        auto dst = static_cast<RecordingResource*>(pDstResource);
+        auto src = static_cast<RecordingResource*>(pSrcResource);
+        if (dst->GetData() && src->GetData())
+        {
+            m_commands.push_back([=]() { memcpy(dst->GetData(), src->GetData(), static_cast<size_t>(min(dst->GetSize(), src->GetSize()))); });
+        }
+    }
+
+    void RecordingCommandList::BuildRaytracingAccelerationStructure(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC* pDesc, UINT NumPostbuildInfoDescs, const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC* pPostbuildInfoDescs)
+    {
+        Count("CommandList::BuildRaytracingAccelerationStructure");
+
+        RecordingDevice* device = Device();
+        D3D12_GPU_VIRTUAL_ADDRESS dest = pDesc->DestAccelerationStructureData;
+        RecordedBuildInputs inputs = RecordBuildInputs(pDesc->Inputs);
+        m_commands.push_back([=]() { device->SetAccelerationStructure(dest, device->BuildAccelerationStructure(inputs)); });
+
+        for (UINT i = 0; i < NumPostbuildInfoDescs; i++)
+        {
+            EmitPostbuildInfo(pPostbuildInfoDescs[i], 1, &dest);
+        }
+    }
+
+    void RecordingCommandList::EmitRaytracingAccelerationStructurePostbuildInfo(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC* pDesc, UINT NumSourceAccelerationStructures, const D3D12_GPU_VIRTUAL_ADDRESS* pSourceAccelerationStructureData)
+    {
+        Count("CommandList::EmitRaytracingAccelerationStructurePostbuildInfo");
+        EmitPostbuildInfo(*pDesc, NumSourceAccelerationStructures, pSourceAccelerationStructureData);
+    }
+
+    // Only the compacted size is written, the size of the CpuBvh built in place of the structure.
+    void RecordingCommandList::EmitPostbuildInfo(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC& desc, UINT sourceCount, const D3D12_GPU_VIRTUAL_ADDRESS* sources)
+    {
+        if (desc.InfoType != D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE)
+        {
+            return;
+        }
+
+        RecordingDevice* device = Device();
+        D3D12_GPU_VIRTUAL_ADDRESS destBuffer = desc.DestBuffer;
+        vector<D3D12_GPU_VIRTUAL_ADDRESS> sourceAddresses(sources, sources + sourceCount);
+        m_commands.push_back([=]()
+        {
+            for (UINT i = 0; i < sourceAddresses.size(); i++)
+            {
+                BYTE* data = device->GetBufferData(destBuffer + i * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC), sizeof(UINT64));
+                if (data)
+                {
+                    UINT64 size = device->GetAccelerationStructure(sourceAddresses[i]).compactedSize;
+                    memcpy(data, &size, sizeof(size));
+                }
+            }
+        });
+    }
+
+    void RecordingCommandList::CopyRaytracingAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS DestAccelerationStructureData, D3D12_GPU_VIRTUAL_ADDRESS SourceAccelerationStructureData, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE Mode)
+    {
+        Count("CommandList::CopyRaytracingAccelerationStructure");
+
+        RecordingDevice* device = Device();
+        m_commands.push_back([=]()
+        {
+            RecordingDevice::AccelerationStructure structure = device->GetAccelerationStructure(SourceAccelerationStructureData);
+            if (Mode == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT)
+            {
+                structure.size = structure.compactedSize;
+            }
+            device->SetAccelerationStructure(DestAccelerationStructureData, structure);
+        });
+    }
+
+    //
+    // RecordingCommandQueue
+    //
+
+    void RecordingCommandQueue::UpdateTileMappings(ID3D12Resource*, UINT, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Heap*, UINT, const D3D12_TILE_RANGE_FLAGS*, const UINT*, const UINT*, D3D12_TILE_MAPPING_FLAGS)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::UpdateTileMappings");
+    }
+
+    void RecordingCommandQueue::CopyTileMappings(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, D3D12_TILE_MAPPING_FLAGS)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::CopyTileMappings");
+    }
+
+    void RecordingCommandQueue::ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::ExecuteCommandLists");
+
+        for (UINT i = 0; i < NumCommandLists; i++)
+        {
+            auto commandList = static_cast<RecordingCommandList*>(static_cast<ID3D12GraphicsCommandList4*>(ppCommandLists[i]));
+            ThrowIfFalse(commandList->IsClosed(), L"RecordingDevice: executing a command list that is still open.\n");
+            commandList->Execute();
+        }
+    }
+
+    void RecordingCommandQueue::SetMarker(UINT, const void*, UINT)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::SetMarker");
+    }
+
+    void RecordingCommandQueue::BeginEvent(UINT, const void*, UINT)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::BeginEvent");
+    }
+
+    void RecordingCommandQueue::EndEvent()
+    {
+        Device()->Statistics().RecordCall("CommandQueue::EndEvent");
+    }
+
+    HRESULT RecordingCommandQueue::Signal(ID3D12Fence* pFence, UINT64 Value)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::Signal");
+        if (!pFence)
+        {
+            return E_INVALIDARG;
+        }
+        static_cast<RecordingFence*>(pFence)->Complete(Value);
+        return S_OK;
+    }
+
+    // Nothing is ever queued, so there's nothing to hold back.
+    HRESULT RecordingCommandQueue::Wait(ID3D12Fence*, UINT64)
+    {
+        Device()->Statistics().RecordCall("CommandQueue::Wait");
+        return S_OK;
+    }
+
+    HRESULT RecordingCommandQueue::GetTimestampFrequency(UINT64* pFrequency)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        *pFrequency = frequency.QuadPart;
+        return S_OK;
+    }
+
+    HRESULT RecordingCommandQueue::GetClockCalibration(UINT64* pGpuTimestamp, UINT64* pCpuTimestamp)
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        *pGpuTimestamp = counter.QuadPart;
+        *pCpuTimestamp = counter.QuadPart;
+        return S_OK;
+    }
+
+    //
+    // RecordingDevice
+    //
+
+    RecordingDevice::RecordingDevice(const std::shared_ptr<RecordingStatistics>& statistics) :
+        m_statistics(statistics),
+        m_nextGpuAddress(c_gpuAddressBase),
+        m_nextCpuDescriptor(c_cpuDescriptorBase),
+        m_nextGpuDescriptor(c_gpuDescriptorBase)
+    {
+    }
+
+    void* RecordingDevice::Cast(REFIID riid)
+    {
+        if (riid == __uuidof(IUnknown)
+            || riid == __uuidof(ID3D12Object)
+            || riid == __uuidof(ID3D12Device)
+            || riid == __uuidof(ID3D12Device1)
+            || riid == __uuidof(ID3D12Device2)
+            || riid == __uuidof(ID3D12Device3)
+            || riid == __uuidof(ID3D12Device4)
+            || riid == __uuidof(ID3D12Device5))
+        {
+            return static_cast<ID3D12Device5*>(this);
+        }
+        return nullptr;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS RecordingDevice::AllocateGpuAddressRange(UINT64 size)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        D3D12_GPU_VIRTUAL_ADDRESS address = m_nextGpuAddress;
+        m_nextGpuAddress += Align(max(size, 1ull), D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+        return address;
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE RecordingDevice::AllocateCpuDescriptors(UINT count)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        D3D12_CPU_DESCRIPTOR_HANDLE handle = { m_nextCpuDescriptor };
+        m_nextCpuDescriptor += max(count, 1u) * c_descriptorSize;
+        return handle;
+    }
+
+    D3D12_GPU_DESCRIPTOR_HANDLE RecordingDevice::AllocateGpuDescriptors(UINT count)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        D3D12_GPU_DESCRIPTOR_HANDLE handle = { m_nextGpuDescriptor };
+        m_nextGpuDescriptor += max(count, 1u) * c_descriptorSize;
+        return handle;
+    }
+
+    void RecordingDevice::RegisterBuffer(RecordingResource* buffer)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_buffers[buffer->GetGPUVirtualAddress()] = buffer;
+    }
+
+    void RecordingDevice::UnregisterBuffer(RecordingResource* buffer)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto found = m_buffers.find(buffer->GetGPUVirtualAddress());
+        // Placed buffers can start at the same address, only the last one created is found.
+        if (found != m_buffers.end() && found->second == buffer)
+        {
+            m_buffers.erase(found);
+        }
+    }
+
+    BYTE* RecordingDevice::GetBufferData(D3D12_GPU_VIRTUAL_ADDRESS address, UINT64 size)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto next = m_buffers.upper_bound(address);
+        if (next == m_buffers.begin())
+        {
+            return nullptr;
+        }
+        RecordingResource* buffer = prev(next)->second;
+        UINT64 offset = address - buffer->GetGPUVirtualAddress();
+        return offset + size <= buffer->GetSize() ? buffer->GetData() + offset : nullptr;
+    }
+
+    // Inputs that can't be read leave the structure at its prebuild size, as if it didn't compact.
+    RecordingDevice::AccelerationStructure RecordingDevice::BuildAccelerationStructure(const RecordedBuildInputs& inputs)
+    {
+        AccelerationStructure structure = {};
+        structure.size = inputs.resultMaxSize;
+        structure.compactedSize = inputs.resultMaxSize;
+        structure.boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        structure.boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        vector<XMFLOAT3> boundsMin, boundsMax;
+        bool read = inputs.type == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL ?
+            ReadInstanceBounds(inputs, &boundsMin, &boundsMax) : ReadGeometryBounds(inputs, &boundsMin, &boundsMax);
+        if (!read)
+        {
+            return structure;
+        }
+
+        CpuBvh bvh;
+        bvh.Build(boundsMin.data(), boundsMax.data(), static_cast<UINT>(boundsMin.size()));
+        UINT64 compactedSize = Align(max<UINT64>(bvh.GetCompactedSize(), sizeof(CpuBvhNode)), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+        structure.compactedSize = min(compactedSize, structure.size);
+        if (bvh.GetNodeCount() > 0)
+        {
+            structure.boundsMin = bvh.GetNodes()[0].boundsMin;
+            structure.boundsMax = bvh.GetNodes()[0].boundsMax;
+        }
+        return structure;
+    }
+
+    bool RecordingDevice::ReadGeometryBounds(const RecordedBuildInputs& inputs, vector<XMFLOAT3>* boundsMin, vector<XMFLOAT3>* boundsMax)
+    {
+        for (const D3D12_RAYTRACING_GEOMETRY_DESC& geometry : inputs.geometries)
+        {
+            if (geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS)
+            {
+                const D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE& aabbs = geometry.AABBs.AABBs;
+                for (UINT64 i = 0; i < geometry.AABBs.AABBCount; i++)
+                {
+                    const BYTE* data = GetBufferData(aabbs.StartAddress + i * aabbs.StrideInBytes, sizeof(D3D12_RAYTRACING_AABB));
+                    if (!data)
+                    {
+                        return false;
+                    }
+                    D3D12_RAYTRACING_AABB aabb;
+                    memcpy(&aabb, data, sizeof(aabb));
+                    boundsMin->push_back(XMFLOAT3(aabb.MinX, aabb.MinY, aabb.MinZ));
+                    boundsMax->push_back(XMFLOAT3(aabb.MaxX, aabb.MaxY, aabb.MaxZ));
+                }
+                continue;
+            }
+
+            const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC& triangles = geometry.Triangles;
+            UINT indexSize = triangles.IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : triangles.IndexFormat == DXGI_FORMAT_R32_UINT ? sizeof(UINT32) : 0;
+            if (triangles.VertexFormat != DXGI_FORMAT_R32G32B32_FLOAT || (triangles.IndexBuffer && indexSize == 0))
+            {
+                return false;
+            }
+            if (triangles.VertexCount == 0)
+            {
+                continue;
+            }
+
+            UINT64 stride = triangles.VertexBuffer.StrideInBytes;
+            const BYTE* vertices = GetBufferData(triangles.VertexBuffer.StartAddress, (triangles.VertexCount - 1) * stride + sizeof(XMFLOAT3));
+            const BYTE* indices = triangles.IndexBuffer ? GetBufferData(triangles.IndexBuffer, static_cast<UINT64>(triangles.IndexCount) * indexSize) : nullptr;
+            XMFLOAT3X4 transform(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0);
+            const BYTE* transformData = triangles.Transform3x4 ? GetBufferData(triangles.Transform3x4, sizeof(XMFLOAT3X4)) : nullptr;
+            if (!vertices || (triangles.IndexBuffer && !indices) || (triangles.Transform3x4 && !transformData))
+            {
+                return false;
+            }
+            if (transformData)
+            {
+                memcpy(&transform, transformData, sizeof(transform));
+            }
+
+            UINT triangleCount = (triangles.IndexBuffer ? triangles.IndexCount : triangles.VertexCount) / 3;
+            for (UINT i = 0; i < triangleCount; i++)
+            {
+                XMFLOAT3 triangleMin(FLT_MAX, FLT_MAX, FLT_MAX), triangleMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                for (UINT corner = 0; corner < 3; corner++)
+                {
+                    UINT index = 3 * i + corner;
+                    if (indices)
+                    {
+                        index = indexSize == sizeof(UINT16) ? reinterpret_cast<const UINT16*>(indices)[index] : reinterpret_cast<const UINT32*>(indices)[index];
+                    }
+                    if (index >= triangles.VertexCount)
+                    {
+                        return false;
+                    }
+                    XMFLOAT3 position;
+                    memcpy(&position, vertices + index * stride, sizeof(position));
+                    Grow(&triangleMin, &triangleMax, TransformPoint(transform, position));
+                }
+                boundsMin->push_back(triangleMin);
+                boundsMax->push_back(triangleMax);
+            }
+        }
+        return true;
+    }
+
+    // An instance's bounds are the corners of its bottom level structure's, transformed.
+    bool RecordingDevice::ReadInstanceBounds(const RecordedBuildInputs& inputs, vector<XMFLOAT3>* boundsMin, vector<XMFLOAT3>* boundsMax)
+    {
+        for (UINT i = 0; i < inputs.instanceCount; i++)
+        {
+            D3D12_GPU_VIRTUAL_ADDRESS address = inputs.instanceDescs + i * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+            if (inputs.instanceLayout == D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS)
+            {
+                const BYTE* pointer = GetBufferData(inputs.instanceDescs + i * sizeof(D3D12_GPU_VIRTUAL_ADDRESS), sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+                if (!pointer)
+                {
+                    return false;
+                }
+                memcpy(&address, pointer, sizeof(address));
+            }
+            const BYTE* data = GetBufferData(address, sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+            if (!data)
+            {
+                return false;
+            }
+            D3D12_RAYTRACING_INSTANCE_DESC instance;
+            memcpy(&instance, data, sizeof(instance));
+            AccelerationStructure bottomLevel = GetAccelerationStructure(instance.AccelerationStructure);
+            if (bottomLevel.size == 0)
+            {
+                return false;
+            }
+
+            // An empty bottom level structure leaves the instance a point at its origin.
+            XMFLOAT3 localMin = bottomLevel.boundsMin, localMax = bottomLevel.boundsMax;
+            if (localMin.x > localMax.x)
+            {
+                localMin = localMax = XMFLOAT3(0, 0, 0);
+            }
+            XMFLOAT3X4 transform;
+            memcpy(&transform, instance.Transform, sizeof(transform));
+            XMFLOAT3 instanceMin(FLT_MAX, FLT_MAX, FLT_MAX), instanceMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (UINT corner = 0; corner < 8; corner++)
+            {
+                XMFLOAT3 p(corner & 1 ? localMax.x : localMin.x, corner & 2 ? localMax.y : localMin.y, corner & 4 ? localMax.z : localMin.z);
+                Grow(&instanceMin, &instanceMax, TransformPoint(transform, p));
+            }
+            boundsMin->push_back(instanceMin);
+            boundsMax->push_back(instanceMax);
+        }
+        return true;
+    }
+
+    void RecordingDevice::SetAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address, const AccelerationStructure& structure)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_accelerationStructures[address] = structure;
+    }
+
+    RecordingDevice::AccelerationStructure RecordingDevice::GetAccelerationStructure(D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto found = m_accelerationStructures.find(address);
+        return found != m_accelerationStructures.end() ? found->second : AccelerationStructure();
+    }
+
+    HRESULT RecordingDevice::CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC* pDesc, REFIID riid, void** ppCommandQueue)
+    {
+        Record("Device::CreateCommandQueue");
+        if (!pDesc)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingCommandQueue(this, *pDesc), riid, ppCommandQueue);
+    }
+
+    HRESULT RecordingDevice::CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE, REFIID riid, void** ppCommandAllocator)
+    {
+        Record("Device::CreateCommandAllocator");
+        return ReturnObject(new RecordingCommandAllocator(this), riid, ppCommandAllocator);
+    }
+
+    HRESULT RecordingDevice::CreateCommandList(UINT, D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator* pCommandAllocator, ID3D12PipelineState*, REFIID riid, void** ppCommandList)
+    {
+        Record("Device::CreateCommandList");
+        if (!pCommandAllocator)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingCommandList(this, type, false), riid, ppCommandList);
+    }
+
+    HRESULT RecordingDevice::CreateCommandList1(UINT, D3D12_COMMAND_LIST_TYPE type, D3D12_COMMAND_LIST_FLAGS, REFIID riid, void** ppCommandList)
+    {
+        Record("Device::CreateCommandList1");
+        return ReturnObject(new RecordingCommandList(this, type, true), riid, ppCommandList);
+    }
+
+    // Reports a DXR tier 1.0 device at feature level 12.1.
+    HRESULT RecordingDevice::CheckFeatureSupport(D3D12_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize)
+    {
+        Record("Device::CheckFeatureSupport");
+
+        switch (Feature)
+        {
+        case D3D12_FEATURE_D3D12_OPTIONS:
+        {
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS))
+            {
+                return E_INVALIDARG;
+            }
+            auto options = static_cast<D3D12_FEATURE_DATA_D3D12_OPTIONS*>(pFeatureSupportData);
+            *options = {};
+            options->ResourceBindingTier = D3D12_RESOURCE_BINDING_TIER_3;
+            options->ResourceHeapTier = D3D12_RESOURCE_HEAP_TIER_2;
+            return S_OK;
+        }
+        case D3D12_FEATURE_FEATURE_LEVELS:
+        {
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_FEATURE_LEVELS))
+            {
+                return E_INVALIDARG;
+            }
+            auto levels = static_cast<D3D12_FEATURE_DATA_FEATURE_LEVELS*>(pFeatureSupportData);
+            levels->MaxSupportedFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+            for (UINT i = 0; i < levels->NumFeatureLevels; i++)
+            {
+                D3D_FEATURE_LEVEL level = levels->pFeatureLevelsRequested[i];
+                if (level <= D3D_FEATURE_LEVEL_12_1 && level > levels->MaxSupportedFeatureLevel)
+                {
+                    levels->MaxSupportedFeatureLevel = level;
+                }
+            }
+            return S_OK;
+        }
+        case D3D12_FEATURE_D3D12_OPTIONS5:
+        {
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS5))
+            {
+                return E_INVALIDARG;
+            }
+            auto options = static_cast<D3D12_FEATURE_DATA_D3D12_OPTIONS5*>(pFeatureSupportData);
+            *options = {};
+            options->RenderPassesTier = D3D12_RENDER_PASS_TIER_0;
+            options->RaytracingTier = D3D12_RAYTRACING_TIER_1_0;
+            return S_OK;
+        }
+        default:
+            return E_NOTIMPL;
+        }
+    }
+
+    HRESULT RecordingDevice::CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* pDescriptorHeapDesc, REFIID riid, void** ppvHeap)
+    {
+        Record("Device::CreateDescriptorHeap");
+        if (!pDescriptorHeapDesc)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingDescriptorHeap(this, *pDescriptorHeapDesc), riid, ppvHeap);
+    }
+
+    // The blob isn't parsed, D3D12SerializeRootSignature has validated it already.
+    HRESULT RecordingDevice::CreateRootSignature(UINT, const void* pBlobWithRootSignature, SIZE_T blobLengthInBytes, REFIID riid, void** ppvRootSignature)
+    {
+        Record("Device::CreateRootSignature");
+        if (!pBlobWithRootSignature || blobLengthInBytes == 0)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingRootSignature(this), riid, ppvRootSignature);
+    }
+
+    HRESULT RecordingDevice::CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc, REFIID riid, void** ppPipelineState)
+    {
+        Record("Device::CreateComputePipelineState");
+        if (!pDesc || !pDesc->pRootSignature || !pDesc->CS.pShaderBytecode)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingPipelineState(this), riid, ppPipelineState);
+    }
+
+    D3D12_RESOURCE_ALLOCATION_INFO RecordingDevice::GetResourceAllocationInfo(UINT visibleMask, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs)
+    {
+        return GetResourceAllocationInfo1(visibleMask, numResourceDescs, pResourceDescs, nullptr);
+    }
+
+    D3D12_RESOURCE_ALLOCATION_INFO RecordingDevice::GetResourceAllocationInfo1(UINT, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs, D3D12_RESOURCE_ALLOCATION_INFO1* pResourceAllocationInfo1)
+    {
+        Record("Device::GetResourceAllocationInfo");
+
+        D3D12_RESOURCE_ALLOCATION_INFO info = { 0, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+        for (UINT i = 0; i < numResourceDescs; i++)
+        {
+            const D3D12_RESOURCE_DESC& desc = pResourceDescs[i];
+            UINT64 alignment = desc.SampleDesc.Count > 1 ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+            UINT64 offset = Align(info.SizeInBytes, alignment);
+            UINT64 size = GetAllocationSize(desc);
+            if (pResourceAllocationInfo1)
+            {
+                pResourceAllocationInfo1[i].Offset = offset;
+                pResourceAllocationInfo1[i].Alignment = alignment;
+                pResourceAllocationInfo1[i].SizeInBytes = size;
+            }
+            info.SizeInBytes = offset + size;
+            info.Alignment = max(info.Alignment, alignment);
+        }
+        return info;
+    }
+
+    // Custom heaps as on a discrete adapter.
+    D3D12_HEAP_PROPERTIES RecordingDevice::GetCustomHeapProperties(UINT, D3D12_HEAP_TYPE heapType)
+    {
+        D3D12_HEAP_PROPERTIES properties = {};
+        properties.Type = D3D12_HEAP_TYPE_CUSTOM;
+        properties.CPUPageProperty =
+            heapType == D3D12_HEAP_TYPE_UPLOAD ? D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE :
+            heapType == D3D12_HEAP_TYPE_READBACK ? D3D12_CPU_PAGE_PROPERTY_WRITE_BACK :
+            D3D12_CPU_PAGE_PROPERTY_NOT_AVAILABLE;
+        properties.MemoryPoolPreference = heapType == D3D12_HEAP_TYPE_DEFAULT ? D3D12_MEMORY_POOL_L1 : D3D12_MEMORY_POOL_L0;
+        properties.CreationNodeMask = 1;
+        properties.VisibleNodeMask = 1;
+        return properties;
+    }
+
+    HRESULT RecordingDevice::CreateCommittedResource(const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS HeapFlags, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID riidResource, void** ppvResource)
+    {
+        Record("Device::CreateCommittedResource");
+        if (!pHeapProperties || !pDesc || pDesc->Width == 0)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingResource(this, *pDesc, *pHeapProperties, HeapFlags, nullptr, 0), riidResource, ppvResource);
+    }
+
+    HRESULT RecordingDevice::CreateHeap(const D3D12_HEAP_DESC* pDesc, REFIID riid, void** ppvHeap)
+    {
+        Record("Device::CreateHeap");
+        if (!pDesc || pDesc->SizeInBytes == 0)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingHeap(this, *pDesc), riid, ppvHeap);
+    }
+
+    HRESULT RecordingDevice::CreatePlacedResource(ID3D12Heap* pHeap, UINT64 HeapOffset, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID riid, void** ppvResource)
+    {
+        Record("Device::CreatePlacedResource");
+        if (!pHeap || !pDesc || pDesc->Width == 0)
+        {
+            return E_INVALIDARG;
+        }
+
+        auto heap = static_cast<RecordingHeap*>(pHeap);
+        D3D12_HEAP_DESC heapDesc = heap->GetDesc();
+        if (HeapOffset + GetAllocationSize(*pDesc) > heapDesc.SizeInBytes)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingResource(this, *pDesc, heapDesc.Properties, heapDesc.Flags, heap, HeapOffset), riid, ppvResource);
+    }
+
+    HRESULT RecordingDevice::CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS, REFIID riid, void** ppFence)
+    {
+        Record("Device::CreateFence");
+        return ReturnObject(new RecordingFence(this, InitialValue), riid, ppFence);
+    }
+
+    void RecordingDevice::GetCopyableFootprints(const D3D12_RESOURCE_DESC* pResourceDesc, UINT FirstSubresource, UINT NumSubresources, UINT64 BaseOffset, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* pLayouts, UINT* pNumRows, UINT64* pRowSizeInBytes, UINT64* pTotalBytes)
+    {
+        Record("Device::GetCopyableFootprints");
+
+        const D3D12_RESOURCE_DESC& desc = *pResourceDesc;
+        bool buffer = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+        bool volume = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        UINT mipLevels = buffer ? 1 : GetMipLevels(desc);
+
+        UINT64 end = BaseOffset;
+        for (UINT i = 0; i < NumSubresources; i++)
+        {
+            UINT mip = (FirstSubresource + i) % mipLevels;
+            UINT width = static_cast<UINT>(buffer ? desc.Width : max(desc.Width >> mip, 1ull));
+            UINT height = buffer ? 1 : max(desc.Height >> mip, 1u);
+            UINT depth = volume ? max(desc.DepthOrArraySize >> mip, 1) : 1;
+            UINT64 rowSize = buffer ? desc.Width : static_cast<UINT64>(width) * BitsPerPixel(desc.Format) / 8;
+            UINT64 rowPitch = buffer ? rowSize : Align(rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+            UINT64 offset = buffer ? end : Align(end, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+            if (pLayouts)
+            {
+                pLayouts[i].Offset = offset;
+                pLayouts[i].Footprint.Format = desc.Format;
+                pLayouts[i].Footprint.Width = width;
+                pLayouts[i].Footprint.Height = height;
+                pLayouts[i].Footprint.Depth = depth;
+                pLayouts[i].Footprint.RowPitch = static_cast<UINT>(rowPitch);
+            }
+            if (pNumRows)
+            {
+                pNumRows[i] = height;
+            }
+            if (pRowSizeInBytes)
+            {
+                pRowSizeInBytes[i] = rowSize;
+            }
+            end = offset + rowPitch * (static_cast<UINT64>(height) * depth - 1) + rowSize;
+        }
+        if (pTotalBytes)
+        {
+            *pTotalBytes = end - BaseOffset;
+        }
+    }
+
+    // Nothing to make resident, the fence is signaled right away.
+    HRESULT RecordingDevice::EnqueueMakeResident(D3D12_RESIDENCY_FLAGS, UINT, ID3D12Pageable* const*, ID3D12Fence* pFenceToSignal, UINT64 FenceValueToSignal)
+    {
+        Record("Device::EnqueueMakeResident");
+        if (!pFenceToSignal)
+        {
+            return E_INVALIDARG;
+        }
+        static_cast<RecordingFence*>(pFenceToSignal)->Complete(FenceValueToSignal);
+        return S_OK;
+    }
+
+    HRESULT RecordingDevice::EnumerateMetaCommands(UINT* pNumMetaCommands, D3D12_META_COMMAND_DESC*)
+    {
+        Record("Device::EnumerateMetaCommands");
+        if (!pNumMetaCommands)
+        {
+            return E_INVALIDARG;
+        }
+        *pNumMetaCommands = 0;
+        return S_OK;
+    }
+
+    HRESULT RecordingDevice::CreateStateObject(const D3D12_STATE_OBJECT_DESC* pDesc, REFIID riid, void** ppStateObject)
+    {
+        Record("Device::CreateStateObject");
+        if (!pDesc)
+        {
+            return E_INVALIDARG;
+        }
+        return ReturnObject(new RecordingStateObject(this, *pDesc), riid, ppStateObject);
+    }
+
+    void RecordingDevice::GetRaytracingAccelerationStructurePrebuildInfo(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS* pDesc, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO* pInfo)
+    {
+        Record("Device::GetRaytracingAccelerationStructurePrebuildInfo");
+        *pInfo = EstimatePrebuildInfo(*pDesc);
+    }
+
+    D3D12_DRIVER_MATCHING_IDENTIFIER_STATUS RecordingDevice::CheckDriverMatchingIdentifier(D3D12_SERIALIZED_DATA_TYPE, const D3D12_SERIALIZED_DATA_DRIVER_MATCHING_IDENTIFIER*)
+    {
+        Record("Device::CheckDriverMatchingIdentifier");
+        return D3D12_DRIVER_MATCHING_IDENTIFIER_UNRECOGNIZED;
+    }
+}
+
+//
+// RecordingStatistics
+//
+
+RecordingStatistics::RecordingStatistics() :
+    m_logging(false),
+    m_allocatedBytes{},
+    m_peakAllocatedBytes(0),
+    m_frameCount(0)
+{
+}
+
+void RecordingStatistics::RecordCall(const char* name)
+{
+    if (m_logging)
+    {
+        LogCall(name);
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+    m_totalCalls[name]++;
+    m_frameCalls[name]++;
+}
+
+void RecordingStatistics::RecordCalls(const PendingCalls& calls)
+{
+    lock_guard<mutex> lock(m_mutex);
+    for (auto& call : calls)
+    {
+        string name(call.first);
+        m_totalCalls[name] += call.second;
+        m_frameCalls[name] += call.second;
+    }
+}
+
+void RecordingStatistics::RecordAllocation(D3D12_HEAP_TYPE heapType, UINT64 size)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_allocatedBytes[min<UINT>(heapType, c_heapTypeCount - 1)] += size;
+
+    UINT64 total = 0;
+    for (UINT64 bytes : m_allocatedBytes)
+    {
+        total += bytes;
+    }
+    m_peakAllocatedBytes = max(m_peakAllocatedBytes, total);
+}
+
+void RecordingStatistics::RecordRelease(D3D12_HEAP_TYPE heapType, UINT64 size)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_allocatedBytes[min<UINT>(heapType, c_heapTypeCount - 1)] -= size;
+}
+
+void RecordingStatistics::EndFrame()
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_lastFrameCalls.swap(m_frameCalls);
+    m_frameCalls.clear();
+    m_frameCount++;
+}
+
+RecordingStatistics::CallCounts RecordingStatistics::GetTotalCallCounts() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_totalCalls;
+}
+
+RecordingStatistics::CallCounts RecordingStatistics::GetLastFrameCallCounts() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_lastFrameCalls;
+}
+
+UINT64 RecordingStatistics::GetLastFrameCallCount() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    UINT64 count = 0;
+    for (auto& call : m_lastFrameCalls)
+    {
+        count += call.second;
+    }
+    return count;
+}
+
+UINT64 RecordingStatistics::GetAllocatedBytes() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    UINT64 total = 0;
+    for (UINT64 bytes : m_allocatedBytes)
+    {
+        total += bytes;
+    }
+    return total;
+}
+
+UINT64 RecordingStatistics::GetAllocatedBytes(D3D12_HEAP_TYPE heapType) const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_allocatedBytes[min<UINT>(heapType, c_heapTypeCount - 1)];
+}
+
+UINT64 RecordingStatistics::GetPeakAllocatedBytes() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_peakAllocatedBytes;
+}
+
+UINT RecordingStatistics::GetFrameCount() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_frameCount;
+}
+
+std::wstring RecordingStatistics::GetStatisticsString() const
+{
+    const double MB = 1024.0 * 1024.0;
+
+    CallCounts lastFrameCalls = GetLastFrameCallCounts();
+    UINT64 lastFrameCallCount = GetLastFrameCallCount();
+
+    wstringstream stream;
+    stream << fixed << setprecision(2)
+        << L"Recording device: " << GetFrameCount() << L" frames\n"
+        << L"  memory:     " << GetAllocatedBytes() / MB << L" MB (peak " << GetPeakAllocatedBytes() / MB << L" MB)"
+        << L", default " << GetAllocatedBytes(D3D12_HEAP_TYPE_DEFAULT) / MB << L" MB"
+        << L", upload " << GetAllocatedBytes(D3D12_HEAP_TYPE_UPLOAD) / MB << L" MB"
+        << L", readback " << GetAllocatedBytes(D3D12_HEAP_TYPE_READBACK) / MB << L" MB\n"
+        << L"  last frame: " << lastFrameCallCount << L" calls\n";
+    for (auto& call : lastFrameCalls)
+    {
+        stream << L"    " << left << setw(56) << wstring(call.first.begin(), call.first.end()) << right << call.second << L"\n";
+    }
+    return stream.str();
+}
+
+std::wstring RecordingStatistics::GetReportString() const
+{
+    wstringstream stream;
+    stream << L"frames " << GetFrameCount() << L"\n"
+        << L"memory.bytes " << GetAllocatedBytes() << L"\n"
+        << L"memory.peak_bytes " << GetPeakAllocatedBytes() << L"\n"
+        << L"memory.default_bytes " << GetAllocatedBytes(D3D12_HEAP_TYPE_DEFAULT) << L"\n"
+        << L"memory.upload_bytes " << GetAllocatedBytes(D3D12_HEAP_TYPE_UPLOAD) << L"\n"
+        << L"memory.readback_bytes " << GetAllocatedBytes(D3D12_HEAP_TYPE_READBACK) << L"\n"
+        << L"last_frame.calls " << GetLastFrameCallCount() << L"\n";
+    for (auto& call : GetLastFrameCallCounts())
+    {
+        stream << L"last_frame.call " << wstring(call.first.begin(), call.first.end()) << L" " << call.second << L"\n";
+    }
+    for (auto& call : GetTotalCallCounts())
+    {
+        stream << L"total.call " << wstring(call.first.begin(), call.first.end()) << L" " << call.second << L"\n";
+    }
+    return stream.str();
+}
+
+HRESULT DX::CreateRecordingDevice(const std::shared_ptr<RecordingStatistics>& statistics, REFIID riid, void** ppDevice)
+{
+    if (!statistics)
+    {
+        return E_INVALIDARG;
+    }
+    return ReturnObject(new RecordingDevice(statistics), riid, ppDevice);
+}
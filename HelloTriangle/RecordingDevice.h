@@ -0,0 +1,78 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// RecordingDevice.h - A Direct3D 12 device that records API calls instead of driving a GPU
+//
+
+#pragma once
+
+namespace DX
+{
+    // API call counts and memory usage of the objects created from one recording device.
+    // Call counts are keyed by "Interface::Method". Command list calls are counted when the
+    // list is closed, so recording on several threads doesn't contend on the statistics.
+    class RecordingStatistics
+    {
+    public:
+        typedef std::map<std::string, UINT64> CallCounts;
+
+        RecordingStatistics();
+
+        // Pending command list calls, keyed by their literal names.
+        typedef std::unordered_map<const char*, UINT64> PendingCalls;
+
+        void RecordCall(const char* name);
+        void RecordCalls(const PendingCalls& calls);
+        void RecordAllocation(D3D12_HEAP_TYPE heapType, UINT64 size);
+        void RecordRelease(D3D12_HEAP_TYPE heapType, UINT64 size);
+
+        // Closes the current frame, its counts become the last frame counts.
+        void EndFrame();
+
+        // Writes every call to the debug output as it is recorded.
+        void SetLogging(bool enable) { m_logging = enable; }
+
+        // Accessors.
+        bool            IsLogging() const { return m_logging; }
+        CallCounts      GetTotalCallCounts() const;
+        CallCounts      GetLastFrameCallCounts() const;
+        UINT64          GetLastFrameCallCount() const;
+        UINT64          GetAllocatedBytes() const;
+        UINT64          GetAllocatedBytes(D3D12_HEAP_TYPE heapType) const;
+        UINT64          GetPeakAllocatedBytes() const;
+        UINT            GetFrameCount() const;
+        std::wstring    GetStatisticsString() const;
+        // Counts only, one "key value" line each in a fixed order, so the reports of two runs diff cleanly.
+        std::wstring    GetReportString() const;
+
+    private:
+        static const UINT c_heapTypeCount = D3D12_HEAP_TYPE_CUSTOM + 1;
+
+        mutable std::mutex  m_mutex;
+        std::atomic<bool>   m_logging;
+        CallCounts          m_totalCalls;
+        CallCounts          m_frameCalls;
+        CallCounts          m_lastFrameCalls;
+        UINT64              m_allocatedBytes[c_heapTypeCount];
+        UINT64              m_peakAllocatedBytes;
+        UINT                m_frameCount;
+    };
+
+    // Creates a device implementing ID3D12Device5 and the parts of the API the sample uses:
+    // queues, allocators, ID3D12GraphicsCommandList4, fences, committed and placed resources,
+    // heaps, descriptor heaps, root signatures and raytracing state objects. Nothing reaches a
+    // GPU, command lists only record and executing them completes immediately. Upload and
+    // readback buffers are backed by memory so the CPU side of the sample works unchanged,
+    // buffer copies and compacted size queries are carried out on that memory. Everything else
+    // (pipeline states, query heaps, tiled resources, ...) returns E_NOTIMPL.
+    HRESULT CreateRecordingDevice(const std::shared_ptr<RecordingStatistics>& statistics, REFIID riid, void** ppDevice);
+}
@@ -0,0 +1,768 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "RenderGraph.h"
+#include "FramePacer.h"
+#include "TraceRecorder.h"
+#include <queue>
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    inline bool Overlaps(UINT64 aBegin, UINT64 aEnd, UINT64 bBegin, UINT64 bEnd)
+    {
+        return aBegin < bEnd && bBegin < aEnd;
+    }
+
+    // Field by field, the padding after Dimension is undefined.
+    bool SameDesc(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b)
+    {
+        return a.Dimension == b.Dimension && a.Alignment == b.Alignment && a.Width == b.Width && a.Height == b.Height &&
+            a.DepthOrArraySize == b.DepthOrArraySize && a.MipLevels == b.MipLevels && a.Format == b.Format &&
+            a.SampleDesc.Count == b.SampleDesc.Count && a.SampleDesc.Quality == b.SampleDesc.Quality &&
+            a.Layout == b.Layout && a.Flags == b.Flags;
+    }
+}
+
+const UINT RenderGraph::c_invalidHandle;
+
+RenderGraph::RenderGraph() :
+    m_transientHeapSize(0),
+    m_transientFrame(0),
+    m_compiled(false)
+{
+    Reset();
+}
+
+void RenderGraph::Reset()
+{
+    m_passes.clear();
+    m_resources.clear();
+    m_plan = Plan();
+    m_compiled = false;
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportResource(LPCWSTR name, ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState)
+{
+    Resource r = {};
+    r.name = name;
+    r.resource = resource;
+    r.imported = true;
+    r.initialState = initialState;
+    r.finalState = finalState;
+    r.aliasedResource = c_invalidHandle;
+    m_resources.push_back(r);
+    m_compiled = false;
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransient(LPCWSTR name, const D3D12_RESOURCE_DESC& desc, UINT64 sizeInBytes, UINT64 alignment)
+{
+    ThrowIfFalse(sizeInBytes > 0 && alignment > 0);
+
+    Resource r = {};
+    r.name = name;
+    r.imported = false;
+    r.desc = desc;
+    r.size = sizeInBytes;
+    r.alignment = alignment;
+    r.aliasedResource = c_invalidHandle;
+    m_resources.push_back(r);
+    m_compiled = false;
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(LPCWSTR name, D3D12_COMMAND_LIST_TYPE queue, ExecuteFunction execute, bool sideEffects)
+{
+    ThrowIfFalse(queue == D3D12_COMMAND_LIST_TYPE_DIRECT || queue == D3D12_COMMAND_LIST_TYPE_COMPUTE, L"RenderGraph: passes run on the direct or the compute queue.\n");
+
+    Pass pass = {};
+    pass.name = name;
+    pass.queue = queue;
+    pass.execute = execute;
+    pass.sideEffects = sideEffects;
+    m_passes.push_back(pass);
+    m_compiled = false;
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+void RenderGraph::AddAccess(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state, bool write)
+{
+    ThrowIfFalse(pass < m_passes.size() && resource < m_resources.size());
+
+    // A pass sees a resource in one state, several reads combine into one read state.
+    for (auto& access : m_passes[pass].accesses)
+    {
+        if (access.resource != resource)
+        {
+            continue;
+        }
+        if (!access.write && !write && ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_GENERIC_READ, access.state | state))
+        {
+            access.state = access.state | state;
+            return;
+        }
+        ThrowIfFalse(access.state == state, L"RenderGraph: a pass accesses a resource in two incompatible states.\n");
+        access.write = access.write || write;
+        return;
+    }
+
+    Access access = { resource, state, write };
+    m_passes[pass].accesses.push_back(access);
+    m_compiled = false;
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state)
+{
+    AddAccess(pass, resource, state, false);
+}
+
+void RenderGraph::Write(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state)
+{
+    AddAccess(pass, resource, state, true);
+}
+
+// A read depends on the last writer, a write on the last writer and every read since.
+// Dependencies therefore only point at earlier passes.
+void RenderGraph::BuildDependencies()
+{
+    vector<PassHandle> lastWriter(m_resources.size(), c_invalidHandle);
+    vector<vector<PassHandle>> readersSinceWrite(m_resources.size());
+
+    for (PassHandle p = 0; p < m_passes.size(); p++)
+    {
+        auto& dependencies = m_passes[p].dependencies;
+        dependencies.clear();
+        for (const auto& access : m_passes[p].accesses)
+        {
+            if (lastWriter[access.resource] != c_invalidHandle && lastWriter[access.resource] != p)
+            {
+                dependencies.push_back(lastWriter[access.resource]);
+            }
+            if (access.write)
+            {
+                for (PassHandle reader : readersSinceWrite[access.resource])
+                {
+                    if (reader != p)
+                    {
+                        dependencies.push_back(reader);
+                    }
+                }
+                lastWriter[access.resource] = p;
+                readersSinceWrite[access.resource].clear();
+            }
+            else
+            {
+                readersSinceWrite[access.resource].push_back(p);
+            }
+        }
+        sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    }
+}
+
+// Passes writing an imported resource, and passes with side effects, are the outputs of the frame;
+// everything they don't depend on, directly or not, is dropped.
+void RenderGraph::CullPasses()
+{
+    for (auto& pass : m_passes)
+    {
+        pass.culled = !pass.sideEffects;
+        for (const auto& access : pass.accesses)
+        {
+            if (access.write && m_resources[access.resource].imported)
+            {
+                pass.culled = false;
+            }
+        }
+    }
+
+    // Walk backwards, dependencies always point at lower handles.
+    for (PassHandle p = static_cast<PassHandle>(m_passes.size()); p-- > 0;)
+    {
+        if (!m_passes[p].culled)
+        {
+            for (PassHandle d : m_passes[p].dependencies)
+            {
+                m_passes[d].culled = false;
+            }
+        }
+    }
+}
+
+// Kahn's algorithm over the kept passes. Of the passes whose dependencies have all run, a compute
+// pass goes first so the other queue gets its work as early as it can, otherwise the one declared
+// first; a graph without compute passes runs in declaration order.
+vector<RenderGraph::PassHandle> RenderGraph::SortPasses() const
+{
+    vector<UINT> pendingDependencies(m_passes.size(), 0);
+    vector<vector<PassHandle>> dependents(m_passes.size());
+    UINT keptCount = 0;
+    for (PassHandle p = 0; p < m_passes.size(); p++)
+    {
+        if (m_passes[p].culled)
+        {
+            continue;
+        }
+        keptCount++;
+        for (PassHandle d : m_passes[p].dependencies)
+        {
+            pendingDependencies[p]++;
+            dependents[d].push_back(p);
+        }
+    }
+
+    auto runsLater = [this](PassHandle a, PassHandle b)
+    {
+        bool aCompute = m_passes[a].queue == D3D12_COMMAND_LIST_TYPE_COMPUTE;
+        bool bCompute = m_passes[b].queue == D3D12_COMMAND_LIST_TYPE_COMPUTE;
+        return aCompute != bCompute ? bCompute : a > b;
+    };
+    priority_queue<PassHandle, vector<PassHandle>, decltype(runsLater)> ready(runsLater);
+    for (PassHandle p = 0; p < m_passes.size(); p++)
+    {
+        if (!m_passes[p].culled && pendingDependencies[p] == 0)
+        {
+            ready.push(p);
+        }
+    }
+
+    vector<PassHandle> order;
+    order.reserve(keptCount);
+    while (!ready.empty())
+    {
+        PassHandle p = ready.top();
+        ready.pop();
+        order.push_back(p);
+        for (PassHandle dependent : dependents[p])
+        {
+            if (--pendingDependencies[dependent] == 0)
+            {
+                ready.push(dependent);
+            }
+        }
+    }
+    ThrowIfFalse(order.size() == keptCount, L"RenderGraph: the passes' dependencies form a cycle.\n");
+    return order;
+}
+
+// Greedy placement, largest first. A resource goes at the lowest offset that doesn't overlap
+// the memory of any already placed resource whose lifetime overlaps its own.
+void RenderGraph::AllocateTransients()
+{
+    m_plan.transientHeapSize = 0;
+    m_plan.transientUnaliasedSize = 0;
+
+    vector<ResourceHandle> transients;
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        if (!m_resources[r].imported && m_resources[r].firstUse != c_invalidHandle)
+        {
+            transients.push_back(r);
+            m_plan.transientUnaliasedSize = AlignUp(m_plan.transientUnaliasedSize, m_resources[r].alignment) + m_resources[r].size;
+        }
+    }
+    stable_sort(transients.begin(), transients.end(), [&](ResourceHandle a, ResourceHandle b)
+    {
+        return m_resources[a].size > m_resources[b].size;
+    });
+
+    vector<ResourceHandle> placed;
+    for (ResourceHandle r : transients)
+    {
+        Resource& resource = m_resources[r];
+        auto LifetimeOverlaps = [&](const Resource& other)
+        {
+            return resource.firstUse <= other.lastUse && other.firstUse <= resource.lastUse;
+        };
+
+        // Candidates are the start of the heap and the end of every conflicting placement.
+        vector<UINT64> candidates(1, 0);
+        for (ResourceHandle o : placed)
+        {
+            if (LifetimeOverlaps(m_resources[o]))
+            {
+                candidates.push_back(AlignUp(m_resources[o].heapOffset + m_resources[o].size, resource.alignment));
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+
+        for (UINT64 offset : candidates)
+        {
+            bool fits = true;
+            for (ResourceHandle o : placed)
+            {
+                const Resource& other = m_resources[o];
+                if (LifetimeOverlaps(other) && Overlaps(offset, offset + resource.size, other.heapOffset, other.heapOffset + other.size))
+                {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits)
+            {
+                resource.heapOffset = offset;
+                break;
+            }
+        }
+
+        // The memory's previous occupant is the latest finished resource it overlaps.
+        resource.aliasedResource = c_invalidHandle;
+        for (ResourceHandle o : placed)
+        {
+            const Resource& other = m_resources[o];
+            if (other.lastUse < resource.firstUse &&
+                Overlaps(resource.heapOffset, resource.heapOffset + resource.size, other.heapOffset, other.heapOffset + other.size) &&
+                (resource.aliasedResource == c_invalidHandle || other.lastUse > m_resources[resource.aliasedResource].lastUse))
+            {
+                resource.aliasedResource = o;
+            }
+        }
+
+        m_plan.transientHeapSize = max(m_plan.transientHeapSize, resource.heapOffset + resource.size);
+        placed.push_back(r);
+    }
+
+    for (ResourceHandle r : placed)
+    {
+        Resource& resource = m_resources[r];
+        resource.sharesMemory = any_of(placed.begin(), placed.end(), [&](ResourceHandle o)
+        {
+            const Resource& other = m_resources[o];
+            return o != r && Overlaps(resource.heapOffset, resource.heapOffset + resource.size, other.heapOffset, other.heapOffset + other.size);
+        });
+    }
+}
+
+// Transients outlive the frame: each one starts in the state the frame leaves it in, which is
+// where the previous frame left it when it ran the same graph. At its first use its memory is
+// handed over with an aliasing barrier, from the resource placed there earlier in the frame or,
+// when there is none, from whatever the previous frame left there.
+void RenderGraph::ScheduleBarriers()
+{
+    vector<D3D12_RESOURCE_STATES> states(m_resources.size());
+    vector<bool> used(m_resources.size(), false);
+    vector<bool> uavWritten(m_resources.size(), false);
+    for (const auto& scheduled : m_plan.passes)
+    {
+        for (const auto& access : m_passes[scheduled.pass].accesses)
+        {
+            Resource& resource = m_resources[access.resource];
+            if (!resource.imported && (!used[access.resource] || !ResourceStateTracker::IsSatisfied(resource.initialState, access.state)))
+            {
+                resource.initialState = access.state;
+            }
+            used[access.resource] = true;
+        }
+    }
+    used.assign(m_resources.size(), false);
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        states[r] = m_resources[r].initialState;
+    }
+
+    for (auto& scheduled : m_plan.passes)
+    {
+        for (const auto& access : m_passes[scheduled.pass].accesses)
+        {
+            ResourceHandle r = access.resource;
+            const Resource& resource = m_resources[r];
+            Barrier barrier = { D3D12_RESOURCE_BARRIER_TYPE_TRANSITION, r, c_invalidHandle, states[r], access.state };
+
+            // The contents of a transient don't survive to its first use, so there is nothing
+            // for a UAV barrier to wait for either.
+            bool firstTransientUse = !resource.imported && !used[r];
+            if (firstTransientUse && (resource.aliasedResource != c_invalidHandle || resource.sharesMemory))
+            {
+                Barrier aliasing = { D3D12_RESOURCE_BARRIER_TYPE_ALIASING, r, resource.aliasedResource, access.state, access.state };
+                scheduled.barriers.push_back(aliasing);
+            }
+
+            if (!ResourceStateTracker::IsSatisfied(states[r], access.state))
+            {
+                scheduled.barriers.push_back(barrier);
+            }
+            else if (!firstTransientUse && access.state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS && (uavWritten[r] || access.write))
+            {
+                // Back to back UAV access, the previous pass' writes have to land first.
+                barrier.type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                scheduled.barriers.push_back(barrier);
+            }
+
+            if (!ResourceStateTracker::IsSatisfied(states[r], access.state))
+            {
+                states[r] = access.state;
+            }
+            used[r] = true;
+            uavWritten[r] = access.write && access.state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        }
+    }
+
+    for (ResourceHandle r = 0; r < m_resources.size(); r++)
+    {
+        const Resource& resource = m_resources[r];
+        if (resource.imported && !ResourceStateTracker::IsSatisfied(states[r], resource.finalState))
+        {
+            Barrier barrier = { D3D12_RESOURCE_BARRIER_TYPE_TRANSITION, r, c_invalidHandle, states[r], resource.finalState };
+            m_plan.finalBarriers.push_back(barrier);
+        }
+    }
+}
+
+// One wait per pass and queue is enough: waiting on the latest dependency from the other queue
+// covers the earlier ones, since each queue executes in order.
+void RenderGraph::FindQueueSyncs()
+{
+    vector<UINT> position(m_passes.size(), c_invalidHandle);
+    for (UINT i = 0; i < m_plan.passes.size(); i++)
+    {
+        position[m_plan.passes[i].pass] = i;
+    }
+
+    for (const auto& scheduled : m_plan.passes)
+    {
+        const Pass& pass = m_passes[scheduled.pass];
+        PassHandle latest = c_invalidHandle;
+        for (PassHandle d : pass.dependencies)
+        {
+            if (m_passes[d].queue != pass.queue && (latest == c_invalidHandle || position[d] > position[latest]))
+            {
+                latest = d;
+            }
+        }
+        if (latest != c_invalidHandle)
+        {
+            QueueSync sync = { latest, scheduled.pass };
+            m_plan.queueSyncs.push_back(sync);
+        }
+    }
+}
+
+void RenderGraph::Compile()
+{
+    m_plan = Plan();
+
+    BuildDependencies();
+    CullPasses();
+
+    for (PassHandle p = 0; p < m_passes.size(); p++)
+    {
+        if (m_passes[p].culled)
+        {
+            m_plan.culledPasses.push_back(p);
+        }
+    }
+    for (PassHandle p : SortPasses())
+    {
+        ScheduledPass scheduled;
+        scheduled.pass = p;
+        m_plan.passes.push_back(scheduled);
+    }
+
+    for (auto& resource : m_resources)
+    {
+        resource.firstUse = c_invalidHandle;
+        resource.lastUse = 0;
+    }
+    for (UINT i = 0; i < m_plan.passes.size(); i++)
+    {
+        for (const auto& access : m_passes[m_plan.passes[i].pass].accesses)
+        {
+            Resource& resource = m_resources[access.resource];
+            resource.firstUse = min(resource.firstUse, i);
+            resource.lastUse = max(resource.lastUse, i);
+        }
+    }
+
+    AllocateTransients();
+    ScheduleBarriers();
+    FindQueueSyncs();
+    m_compiled = true;
+}
+
+void RenderGraph::CreateTransientResources(ID3D12Device* device, ResourceStateTracker& resourceStates)
+{
+    ThrowIfFalse(m_compiled, L"RenderGraph: CreateTransientResources() called before Compile().\n");
+
+    m_transientFrame++;
+    auto expired = remove_if(m_retiredObjects.begin(), m_retiredObjects.end(), [this](const RetiredObject& retired)
+    {
+        return retired.frame + FramePacer::c_maxFrameLatency <= m_transientFrame;
+    });
+    m_retiredObjects.erase(expired, m_retiredObjects.end());
+
+    for (auto& placed : m_placedResources)
+    {
+        placed.used = false;
+    }
+
+    // A heap too small for the plan is replaced, together with everything placed in it.
+    UINT64 heapSize = AlignUp(m_plan.transientHeapSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    if (heapSize > m_transientHeapSize)
+    {
+        for (auto& placed : m_placedResources)
+        {
+            RetirePlacedResource(resourceStates, placed);
+        }
+        m_placedResources.clear();
+        if (m_transientHeap)
+        {
+            RetiredObject retired = { m_transientFrame, m_transientHeap, nullptr };
+            m_retiredObjects.push_back(retired);
+        }
+
+        // Mixing buffers and textures in one heap needs resource heap tier 2.
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = heapSize;
+        heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES;
+        ThrowIfFailed(device->CreateHeap(&heapDesc, IID_PPV_ARGS(m_transientHeap.ReleaseAndGetAddressOf())));
+        m_transientHeap->SetName(L"RenderGraphTransientHeap");
+        m_transientHeapSize = heapSize;
+    }
+
+    for (auto& resource : m_resources)
+    {
+        if (resource.imported || resource.firstUse == c_invalidHandle)
+        {
+            continue;
+        }
+
+        // A resource left in another state by a different graph would need a barrier the plan doesn't have.
+        auto placed = find_if(m_placedResources.begin(), m_placedResources.end(), [&](const PlacedResource& p)
+        {
+            return !p.used && p.name == resource.name && p.heapOffset == resource.heapOffset && SameDesc(p.desc, resource.desc) &&
+                resourceStates.IsTracked(p.resource.Get()) && resourceStates.GetState(p.resource.Get()) == resource.initialState;
+        });
+        if (placed == m_placedResources.end())
+        {
+            PlacedResource created = {};
+            created.name = resource.name;
+            created.desc = resource.desc;
+            created.heapOffset = resource.heapOffset;
+            ThrowIfFailed(device->CreatePlacedResource(
+                m_transientHeap.Get(),
+                resource.heapOffset,
+                &resource.desc,
+                resource.initialState,
+                nullptr,
+                IID_PPV_ARGS(&created.resource)));
+            created.resource->SetName(resource.name.c_str());
+            resourceStates.Register(created.resource.Get(), resource.initialState);
+            m_placedResources.push_back(created);
+            placed = m_placedResources.end() - 1;
+        }
+        placed->used = true;
+        resource.resource = placed->resource.Get();
+    }
+
+    // Whatever this plan doesn't use goes, so changing descs, e.g. on resize, don't pile up.
+    auto unused = partition(m_placedResources.begin(), m_placedResources.end(), [](const PlacedResource& p) { return p.used; });
+    for (auto it = unused; it != m_placedResources.end(); ++it)
+    {
+        RetirePlacedResource(resourceStates, *it);
+    }
+    m_placedResources.erase(unused, m_placedResources.end());
+}
+
+void RenderGraph::ReleaseTransientResources(ResourceStateTracker& resourceStates)
+{
+    for (auto& placed : m_placedResources)
+    {
+        resourceStates.Unregister(placed.resource.Get());
+    }
+    m_placedResources.clear();
+    m_retiredObjects.clear();
+    m_transientHeap.Reset();
+    m_transientHeapSize = 0;
+    for (auto& resource : m_resources)
+    {
+        if (!resource.imported)
+        {
+            resource.resource = nullptr;
+        }
+    }
+}
+
+void RenderGraph::RetirePlacedResource(ResourceStateTracker& resourceStates, PlacedResource& placed)
+{
+    resourceStates.Unregister(placed.resource.Get());
+    RetiredObject retired = { m_transientFrame, nullptr, placed.resource };
+    m_retiredObjects.push_back(retired);
+}
+
+// Transients stay registered from their creation on, the tracker carries their states from one
+// frame to the next.
+void RenderGraph::RegisterResources(ResourceStateTracker& resourceStates) const
+{
+    for (const auto& resource : m_resources)
+    {
+        if (!resource.imported && resource.firstUse != c_invalidHandle)
+        {
+            ThrowIfFalse(resource.resource != nullptr && resourceStates.IsTracked(resource.resource), L"RenderGraph: transient resources have not been created.\n");
+        }
+        else if (resource.imported && !resourceStates.IsTracked(resource.resource))
+        {
+            resourceStates.Register(resource.resource, resource.initialState);
+        }
+    }
+}
+
+// Transitions go through the tracker with the resource's current state rather than the
+// planned one, the tracker also knows about work recorded outside the graph.
+void RenderGraph::QueueBarriers(ResourceStateTracker& resourceStates, const vector<Barrier>& barriers) const
+{
+    for (const auto& barrier : barriers)
+    {
+        ID3D12Resource* resource = m_resources[barrier.resource].resource;
+        switch (barrier.type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            resourceStates.Transition(resource, barrier.stateAfter);
+            break;
+        case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+            resourceStates.UAVBarrier(resource);
+            break;
+        case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+            // Without a previous occupant in this frame, any resource overlapping the memory may be it.
+            resourceStates.AliasingBarrier(barrier.aliasedResource != c_invalidHandle ? m_resources[barrier.aliasedResource].resource : nullptr, resource);
+            break;
+        }
+    }
+}
+
+void RenderGraph::Execute(ResourceStateTracker& resourceStates, ID3D12GraphicsCommandList* directCommandList, ID3D12GraphicsCommandList* computeCommandList)
+{
+    ThrowIfFalse(m_compiled, L"RenderGraph: Execute() called before Compile().\n");
+
+    RegisterResources(resourceStates);
+
+    for (const auto& scheduled : m_plan.passes)
+    {
+        const Pass& pass = m_passes[scheduled.pass];
+        auto commandList = (pass.queue == D3D12_COMMAND_LIST_TYPE_COMPUTE && computeCommandList) ? computeCommandList : directCommandList;
+        QueueBarriers(resourceStates, scheduled.barriers);
+        resourceStates.Flush(commandList);
+        if (pass.execute)
+        {
+            pass.execute(commandList);
+        }
+    }
+    QueueBarriers(resourceStates, m_plan.finalBarriers);
+    resourceStates.Flush(directCommandList);
+}
+
+void RenderGraph::ExecuteParallel(ResourceStateTracker& resourceStates, JobSystem& jobs, CommandListPool& commandLists, vector<ID3D12CommandList*>& recorded)
+{
+    ThrowIfFalse(m_compiled, L"RenderGraph: ExecuteParallel() called before Compile().\n");
+    ThrowIfFalse(jobs.GetThreadCount() <= commandLists.GetThreadCount(), L"RenderGraph: the command list pool has fewer threads than the job system.\n");
+
+    RegisterResources(resourceStates);
+
+    // Each pass's barriers depend on the states the passes before it leave behind.
+    vector<vector<D3D12_RESOURCE_BARRIER>> passBarriers(m_plan.passes.size());
+    for (size_t i = 0; i < m_plan.passes.size(); i++)
+    {
+        QueueBarriers(resourceStates, m_plan.passes[i].barriers);
+        resourceStates.Flush(passBarriers[i]);
+    }
+    vector<D3D12_RESOURCE_BARRIER> finalBarriers;
+    QueueBarriers(resourceStates, m_plan.finalBarriers);
+    resourceStates.Flush(finalBarriers);
+
+    UINT passCount = static_cast<UINT>(m_plan.passes.size());
+    UINT listCount = max(min(passCount, jobs.GetThreadCount()), 1u);
+    vector<ID3D12GraphicsCommandList*> lists(listCount);
+
+    jobs.ParallelFor(listCount, [&](UINT list, UINT threadIndex)
+    {
+        TRACE_SCOPE("RecordPasses");
+        auto commandList = commandLists.Acquire(threadIndex);
+        for (UINT i = passCount * list / listCount; i < passCount * (list + 1) / listCount; i++)
+        {
+            if (!passBarriers[i].empty())
+            {
+                commandList->ResourceBarrier(static_cast<UINT>(passBarriers[i].size()), passBarriers[i].data());
+            }
+            const Pass& pass = m_passes[m_plan.passes[i].pass];
+            if (pass.execute)
+            {
+                pass.execute(commandList);
+            }
+        }
+        if (list == listCount - 1 && !finalBarriers.empty())
+        {
+            commandList->ResourceBarrier(static_cast<UINT>(finalBarriers.size()), finalBarriers.data());
+        }
+        ThrowIfFailed(commandList->Close());
+        lists[list] = commandList;
+    });
+
+    recorded.insert(recorded.end(), lists.begin(), lists.end());
+}
+
+std::wstring RenderGraph::GetPlanString() const
+{
+    auto StateName = [](D3D12_RESOURCE_STATES state)
+    {
+        wstringstream s;
+        s << L"0x" << hex << static_cast<UINT>(state);
+        return s.str();
+    };
+
+    wstringstream wstr;
+    wstr << L"|--------------------------------------------------------------------\n";
+    wstr << L"|Render graph: " << m_plan.passes.size() << L" passes, " << m_plan.culledPasses.size() << L" culled\n";
+    for (const auto& scheduled : m_plan.passes)
+    {
+        const Pass& pass = m_passes[scheduled.pass];
+        for (const auto& sync : m_plan.queueSyncs)
+        {
+            if (sync.waitPass == scheduled.pass)
+            {
+                wstr << L"|   wait for " << m_passes[sync.signalPass].name << L"\n";
+            }
+        }
+        for (const auto& barrier : scheduled.barriers)
+        {
+            const auto& name = m_resources[barrier.resource].name;
+            switch (barrier.type)
+            {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                wstr << L"|   transition " << name << L" " << StateName(barrier.stateBefore) << L" -> " << StateName(barrier.stateAfter) << L"\n";
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+                wstr << L"|   uav " << name << L"\n";
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                wstr << L"|   aliasing " << (barrier.aliasedResource != c_invalidHandle ? m_resources[barrier.aliasedResource].name.c_str() : L"(previous frame)") << L" -> " << name << L"\n";
+                break;
+            }
+        }
+        wstr << L"| " << (pass.queue == D3D12_COMMAND_LIST_TYPE_COMPUTE ? L"[compute] " : L"[direct]  ") << pass.name << L"\n";
+    }
+    for (const auto& barrier : m_plan.finalBarriers)
+    {
+        wstr << L"|   final " << m_resources[barrier.resource].name << L" " << StateName(barrier.stateBefore) << L" -> " << StateName(barrier.stateAfter) << L"\n";
+    }
+    wstr << L"| Transient heap: " << m_plan.transientHeapSize << L" bytes (" << m_plan.transientUnaliasedSize << L" without aliasing)\n";
+    wstr << L"|--------------------------------------------------------------------\n";
+    return wstr.str();
+}
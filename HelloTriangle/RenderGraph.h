@@ -0,0 +1,208 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// RenderGraph.h - Frame passes scheduled from their declared resource accesses
+//
+
+#pragma once
+
+#include "ResourceStateTracker.h"
+#include "JobSystem.h"
+#include "CommandListPool.h"
+
+namespace DX
+{
+    // Passes declare which resources they read and write and in which state. Compile() derives,
+    // without touching the GPU:
+    //  - the dependencies between passes and an execution order, dropping passes whose results
+    //    never reach an imported resource,
+    //  - the transition, UAV and aliasing barriers needed before each pass,
+    //  - offsets in one heap for the transient resources, resources whose lifetimes don't
+    //    overlap share memory. The placed resources outlive Reset() and are reused by the next
+    //    frame's graph when it declares them the same way, so their states carry over,
+    //  - the fence signal/wait pairs needed where a dependency crosses from one queue to the other.
+    // The result is available through GetPlan(). Execute() records the passes, emitting barriers
+    // through a ResourceStateTracker so states stay consistent with work recorded outside the graph.
+    class RenderGraph
+    {
+    public:
+        typedef UINT ResourceHandle;
+        typedef UINT PassHandle;
+        typedef std::function<void(ID3D12GraphicsCommandList* commandList)> ExecuteFunction;
+
+        static const UINT c_invalidHandle = UINT_MAX;
+
+        struct Barrier
+        {
+            D3D12_RESOURCE_BARRIER_TYPE type;
+            ResourceHandle              resource;
+            ResourceHandle              aliasedResource;    // Aliasing barriers: the previous occupant of the memory.
+            D3D12_RESOURCE_STATES       stateBefore;
+            D3D12_RESOURCE_STATES       stateAfter;
+        };
+
+        struct ScheduledPass
+        {
+            PassHandle                  pass;
+            std::vector<Barrier>        barriers;           // Emitted right before the pass.
+        };
+
+        // The pass `waitPass` must not start before `signalPass` has completed on the other queue.
+        struct QueueSync
+        {
+            PassHandle                  signalPass;
+            PassHandle                  waitPass;
+        };
+
+        struct Plan
+        {
+            std::vector<ScheduledPass>  passes;
+            std::vector<Barrier>        finalBarriers;      // Move imported resources to their final states.
+            std::vector<QueueSync>      queueSyncs;
+            std::vector<PassHandle>     culledPasses;
+            UINT64                      transientHeapSize;
+            UINT64                      transientUnaliasedSize;
+        };
+
+        RenderGraph();
+
+        // Clears all passes and resources, the graph is rebuilt each frame. The transient heap and
+        // placed resources are kept for the next CreateTransientResources().
+        void Reset();
+
+        // An existing resource, its state before the graph runs and the state it must be left in.
+        ResourceHandle ImportResource(LPCWSTR name, ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState);
+        // A resource only alive within the graph. sizeInBytes and alignment normally come from
+        // ID3D12Device::GetResourceAllocationInfo() for desc.
+        ResourceHandle CreateTransient(LPCWSTR name, const D3D12_RESOURCE_DESC& desc, UINT64 sizeInBytes, UINT64 alignment);
+
+        // A pass is kept by Compile() only if it writes an imported resource, has sideEffects, or
+        // if a kept pass depends on it. Passes that only read, or only write transients nobody
+        // reads, are culled. sideEffects is for passes whose output the graph can't see, such as a
+        // copy to a readback buffer.
+        PassHandle AddPass(LPCWSTR name, D3D12_COMMAND_LIST_TYPE queue, ExecuteFunction execute, bool sideEffects = false);
+        void Read(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state);
+        void Write(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state);
+
+        void Compile();
+
+        // Backs the transients of the compiled plan with placed resources, once per frame. A resource
+        // from an earlier frame is reused when its name, desc and heap offset match and the tracker
+        // has it in the state the plan starts from; new ones are created in that state and
+        // registered with resourceStates, and stay registered across frames. Resources and heaps
+        // that are replaced are only released FramePacer::c_maxFrameLatency calls later, when no
+        // frame in flight can use them anymore.
+        void CreateTransientResources(ID3D12Device* device, ResourceStateTracker& resourceStates);
+        // Releases the heap and all placed resources at once, the GPU must be idle.
+        void ReleaseTransientResources(ResourceStateTracker& resourceStates);
+
+        // Compute passes go to computeCommandList when one is given, otherwise everything is
+        // recorded on directCommandList. Waiting on the queueSyncs is up to the caller.
+        void Execute(ResourceStateTracker& resourceStates, ID3D12GraphicsCommandList* directCommandList, ID3D12GraphicsCommandList* computeCommandList = nullptr);
+
+        // Records the passes on the job system's threads, into command lists from commandLists,
+        // which must have a thread for each job system thread. Barriers are still resolved in
+        // execution order on the calling thread. Consecutive passes share a list, so there are at
+        // most as many lists as threads. The closed lists are appended to recorded in submission
+        // order. Everything goes to the direct queue, and pass functions must be safe to run
+        // concurrently with each other.
+        void ExecuteParallel(ResourceStateTracker& resourceStates, JobSystem& jobs, CommandListPool& commandLists, std::vector<ID3D12CommandList*>& recorded);
+
+        // Accessors.
+        const Plan&         GetPlan() const { return m_plan; }
+        bool                IsCompiled() const { return m_compiled; }
+        UINT                GetPassCount() const { return static_cast<UINT>(m_passes.size()); }
+        UINT                GetResourceCount() const { return static_cast<UINT>(m_resources.size()); }
+        LPCWSTR             GetPassName(PassHandle pass) const { return m_passes[pass].name.c_str(); }
+        LPCWSTR             GetResourceName(ResourceHandle resource) const { return m_resources[resource].name.c_str(); }
+        UINT64              GetTransientHeapOffset(ResourceHandle resource) const { return m_resources[resource].heapOffset; }
+        ID3D12Resource*     GetResource(ResourceHandle resource) const { return m_resources[resource].resource; }
+        std::wstring        GetPlanString() const;
+
+    private:
+        struct Access
+        {
+            ResourceHandle              resource;
+            D3D12_RESOURCE_STATES       state;
+            bool                        write;
+        };
+
+        struct Pass
+        {
+            std::wstring                name;
+            D3D12_COMMAND_LIST_TYPE     queue;
+            ExecuteFunction             execute;
+            std::vector<Access>         accesses;
+            std::vector<PassHandle>     dependencies;
+            bool                        sideEffects;        // Never culled.
+            bool                        culled;
+        };
+
+        struct Resource
+        {
+            std::wstring                name;
+            ID3D12Resource*             resource;
+            bool                        imported;
+            D3D12_RESOURCE_STATES       initialState;       // Transients: the state the frame leaves them in.
+            D3D12_RESOURCE_STATES       finalState;
+            D3D12_RESOURCE_DESC         desc;
+            UINT64                      size;
+            UINT64                      alignment;
+            // Compile results for transients.
+            UINT                        firstUse;           // Positions in the execution order.
+            UINT                        lastUse;
+            UINT64                      heapOffset;
+            ResourceHandle              aliasedResource;
+            bool                        sharesMemory;       // Overlaps another transient of the plan.
+        };
+
+        // A placed resource kept across frames for the transient declared with the same name.
+        struct PlacedResource
+        {
+            std::wstring                name;
+            D3D12_RESOURCE_DESC         desc;
+            UINT64                      heapOffset;
+            Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+            bool                        used;               // By the current plan.
+        };
+
+        // Released once no frame in flight can reference it, one of the two is set.
+        struct RetiredObject
+        {
+            UINT64                      frame;
+            Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+            Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        };
+
+        void AddAccess(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state, bool write);
+        void RegisterResources(ResourceStateTracker& resourceStates) const;
+        void RetirePlacedResource(ResourceStateTracker& resourceStates, PlacedResource& placed);
+        void QueueBarriers(ResourceStateTracker& resourceStates, const std::vector<Barrier>& barriers) const;
+        void BuildDependencies();
+        void CullPasses();
+        // The kept passes in an execution order that respects their dependencies.
+        std::vector<PassHandle> SortPasses() const;
+        void AllocateTransients();
+        void ScheduleBarriers();
+        void FindQueueSyncs();
+
+        std::vector<Pass>                           m_passes;
+        std::vector<Resource>                       m_resources;
+        Microsoft::WRL::ComPtr<ID3D12Heap>          m_transientHeap;
+        UINT64                                      m_transientHeapSize;
+        std::vector<PlacedResource>                 m_placedResources;
+        std::vector<RetiredObject>                  m_retiredObjects;
+        UINT64                                      m_transientFrame;  // CreateTransientResources() calls.
+        Plan                                        m_plan;
+        bool                                        m_compiled;
+    };
+}
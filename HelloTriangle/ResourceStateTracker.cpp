@@ -0,0 +1,210 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "ResourceStateTracker.h"
+
+using namespace DX;
+
+namespace
+{
+    // A resource can only be in one of these at a time, every other state bit is a read state that can be combined.
+    const UINT c_writeStates =
+        D3D12_RESOURCE_STATE_RENDER_TARGET |
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+        D3D12_RESOURCE_STATE_DEPTH_WRITE |
+        D3D12_RESOURCE_STATE_STREAM_OUT |
+        D3D12_RESOURCE_STATE_COPY_DEST |
+        D3D12_RESOURCE_STATE_RESOLVE_DEST;
+
+    inline ID3D12Resource* BarrierResource(const D3D12_RESOURCE_BARRIER& barrier)
+    {
+        switch (barrier.Type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION: return barrier.Transition.pResource;
+        case D3D12_RESOURCE_BARRIER_TYPE_UAV: return barrier.UAV.pResource;
+        default: return nullptr;
+        }
+    }
+}
+
+ResourceStateTracker::ResourceStateTracker() :
+    m_frameBarrierCount(0),
+    m_lastFrameBarrierCount(0),
+    m_droppedBarrierCount(0)
+{
+}
+
+void ResourceStateTracker::Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresourceCount)
+{
+    ThrowIfFalse(resource != nullptr && subresourceCount > 0);
+
+    TrackedResource& tracked = m_resources[resource];
+    tracked.subresourceStates.assign(subresourceCount, state);
+    tracked.uniform = true;
+}
+
+void ResourceStateTracker::Unregister(ID3D12Resource* resource)
+{
+    m_resources.erase(resource);
+}
+
+void ResourceStateTracker::Clear()
+{
+    m_resources.clear();
+    m_pendingBarriers.clear();
+}
+
+bool ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES requested)
+{
+    if (current == requested)
+    {
+        return true;
+    }
+    // A combined read state covers each of its parts, e.g. GENERIC_READ covers COPY_SOURCE.
+    bool readOnly = ((current | requested) & c_writeStates) == 0;
+    return readOnly && requested != D3D12_RESOURCE_STATE_COMMON && (current & requested) == requested;
+}
+
+// Merges with the last queued barrier on the same resource when that barrier is a transition of
+// the same subresource. Anything else on the resource in between (a UAV barrier, another
+// subresource) has to keep its place, so the new transition is appended instead.
+void ResourceStateTracker::QueueTransition(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+{
+    for (auto it = m_pendingBarriers.rbegin(); it != m_pendingBarriers.rend(); ++it)
+    {
+        if (BarrierResource(*it) != resource)
+        {
+            continue;
+        }
+        if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && it->Transition.Subresource == subresource)
+        {
+            it->Transition.StateAfter = stateAfter;
+            m_droppedBarrierCount++;
+            if (it->Transition.StateBefore == stateAfter)
+            {
+                m_pendingBarriers.erase(std::next(it).base());
+                m_droppedBarrierCount++;
+            }
+            return;
+        }
+        break;
+    }
+
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter, subresource));
+}
+
+void ResourceStateTracker::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource)
+{
+    auto found = m_resources.find(resource);
+    ThrowIfFalse(found != m_resources.end(), L"ResourceStateTracker: transition of an unregistered resource.\n");
+    TrackedResource& tracked = found->second;
+    auto& states = tracked.subresourceStates;
+
+    if (states.size() == 1)
+    {
+        subresource = c_allSubresources;
+    }
+
+    if (subresource == c_allSubresources)
+    {
+        if (tracked.uniform)
+        {
+            if (IsSatisfied(states[0], stateAfter))
+            {
+                m_droppedBarrierCount++;
+                return;
+            }
+            QueueTransition(resource, c_allSubresources, states[0], stateAfter);
+        }
+        else
+        {
+            // Subresources diverged, each one that isn't there yet needs its own barrier.
+            for (UINT i = 0; i < states.size(); i++)
+            {
+                if (!IsSatisfied(states[i], stateAfter))
+                {
+                    QueueTransition(resource, i, states[i], stateAfter);
+                }
+            }
+        }
+        states.assign(states.size(), stateAfter);
+        tracked.uniform = true;
+        return;
+    }
+
+    ThrowIfFalse(subresource < states.size());
+    if (IsSatisfied(states[subresource], stateAfter))
+    {
+        m_droppedBarrierCount++;
+        return;
+    }
+    QueueTransition(resource, subresource, states[subresource], stateAfter);
+    states[subresource] = stateAfter;
+    tracked.uniform = std::all_of(states.begin(), states.end(), [&](D3D12_RESOURCE_STATES s) { return s == states[0]; });
+}
+
+void ResourceStateTracker::UAVBarrier(ID3D12Resource* resource)
+{
+    for (auto it = m_pendingBarriers.rbegin(); it != m_pendingBarriers.rend(); ++it)
+    {
+        if (BarrierResource(*it) != resource)
+        {
+            continue;
+        }
+        if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_UAV)
+        {
+            m_droppedBarrierCount++;
+            return;
+        }
+        break;
+    }
+
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void ResourceStateTracker::AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter)
+{
+    m_pendingBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(resourceBefore, resourceAfter));
+}
+
+void ResourceStateTracker::Flush(ID3D12GraphicsCommandList* commandList)
+{
+    if (m_pendingBarriers.empty())
+    {
+        return;
+    }
+
+    commandList->ResourceBarrier(static_cast<UINT>(m_pendingBarriers.size()), m_pendingBarriers.data());
+    m_frameBarrierCount += static_cast<UINT>(m_pendingBarriers.size());
+    m_pendingBarriers.clear();
+}
+
+void ResourceStateTracker::Flush(std::vector<D3D12_RESOURCE_BARRIER>& barriers)
+{
+    barriers.insert(barriers.end(), m_pendingBarriers.begin(), m_pendingBarriers.end());
+    m_frameBarrierCount += static_cast<UINT>(m_pendingBarriers.size());
+    m_pendingBarriers.clear();
+}
+
+void ResourceStateTracker::BeginFrame()
+{
+    m_lastFrameBarrierCount = m_frameBarrierCount;
+    m_frameBarrierCount = 0;
+}
+
+D3D12_RESOURCE_STATES ResourceStateTracker::GetState(ID3D12Resource* resource, UINT subresource) const
+{
+    auto found = m_resources.find(resource);
+    ThrowIfFalse(found != m_resources.end(), L"ResourceStateTracker: state of an unregistered resource.\n");
+    const auto& states = found->second.subresourceStates;
+    return states[std::min<size_t>(subresource, states.size() - 1)];
+}
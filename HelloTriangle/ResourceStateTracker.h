@@ -0,0 +1,81 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// ResourceStateTracker.h - Tracks resource states and batches the barriers between them
+//
+
+#pragma once
+
+namespace DX
+{
+    // Remembers the state of every registered resource (per subresource if needed) and turns
+    // requests for a state into transition barriers. Barriers are queued until Flush(), which
+    // emits them with a single ResourceBarrier() call. While queued:
+    //  - requesting the state a resource is already in adds nothing,
+    //  - A -> B followed by B -> C becomes A -> C, and A -> B -> A disappears,
+    //  - repeated UAV barriers on the same resource are emitted once.
+    // The queued barriers can be inspected with GetPendingBarriers(), so the logic can be checked
+    // without a GPU.
+    class ResourceStateTracker
+    {
+    public:
+        static const UINT c_allSubresources = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+        ResourceStateTracker();
+
+        // Sets the state a resource is known to be in, e.g. its creation state.
+        // Registering an already tracked resource overrides its state.
+        void Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresourceCount = 1);
+        void Unregister(ID3D12Resource* resource);
+        void Clear();
+
+        void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter, UINT subresource = c_allSubresources);
+        // Pass nullptr for a barrier on all UAV accesses.
+        void UAVBarrier(ID3D12Resource* resource);
+        // For placed resources sharing memory, resourceAfter must be in its first-use state already.
+        void AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter);
+
+        // Emits all pending barriers in one call, does nothing if there are none.
+        void Flush(ID3D12GraphicsCommandList* commandList);
+        // Moves the pending barriers to the end of barriers instead, for command lists recorded later.
+        void Flush(std::vector<D3D12_RESOURCE_BARRIER>& barriers);
+
+        // Starts a new period for the barrier count metric.
+        void BeginFrame();
+
+        // True if a resource in state current can be used as requested without a transition.
+        static bool IsSatisfied(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES requested);
+
+        // Accessors.
+        D3D12_RESOURCE_STATES                       GetState(ID3D12Resource* resource, UINT subresource = 0) const;
+        bool                                        IsTracked(ID3D12Resource* resource) const { return m_resources.count(resource) != 0; }
+        const std::vector<D3D12_RESOURCE_BARRIER>&  GetPendingBarriers() const { return m_pendingBarriers; }
+        UINT                                        GetFrameBarrierCount() const { return m_frameBarrierCount; }
+        UINT                                        GetLastFrameBarrierCount() const { return m_lastFrameBarrierCount; }
+        UINT                                        GetDroppedBarrierCount() const { return m_droppedBarrierCount; }
+
+    private:
+        struct TrackedResource
+        {
+            std::vector<D3D12_RESOURCE_STATES>  subresourceStates;
+            bool                                uniform;    // All subresources share subresourceStates[0].
+        };
+
+        void QueueTransition(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter);
+
+        std::unordered_map<ID3D12Resource*, TrackedResource>    m_resources;
+        std::vector<D3D12_RESOURCE_BARRIER>                     m_pendingBarriers;
+        UINT                                                    m_frameBarrierCount;
+        UINT                                                    m_lastFrameBarrierCount;
+        UINT                                                    m_droppedBarrierCount;
+    };
+}
@@ -0,0 +1,411 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "SceneGenerator.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const LPCWSTR c_meshNames[SceneDesc::MeshCount] = { L"terrain", L"sphere", L"soup" };
+    const LPCWSTR c_layoutNames[SceneDesc::LayoutCount] = { L"grid", L"clustered", L"overlapping" };
+
+    // The std:: distributions differ between standard libraries, mt19937 itself doesn't.
+    float Uniform(mt19937& random, float low, float high)
+    {
+        return low + (high - low) * static_cast<float>(random() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float Hash(int x, int z, UINT seed)
+    {
+        UINT h = static_cast<UINT>(x) * 0x8da6b343u ^ static_cast<UINT>(z) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return static_cast<float>(h & 0xffffff) / 16777215.0f;
+    }
+
+    // Smoothly interpolated random values on an integer lattice, in [0, 1].
+    float ValueNoise(float x, float z, UINT seed)
+    {
+        float x0 = floor(x);
+        float z0 = floor(z);
+        int ix = static_cast<int>(x0);
+        int iz = static_cast<int>(z0);
+        float fx = x - x0;
+        float fz = z - z0;
+        fx = fx * fx * (3.0f - 2.0f * fx);
+        fz = fz * fz * (3.0f - 2.0f * fz);
+
+        float h0 = Hash(ix, iz, seed) + fx * (Hash(ix + 1, iz, seed) - Hash(ix, iz, seed));
+        float h1 = Hash(ix, iz + 1, seed) + fx * (Hash(ix + 1, iz + 1, seed) - Hash(ix, iz + 1, seed));
+        return h0 + fz * (h1 - h0);
+    }
+
+    void Grow(XMFLOAT3* boundsMin, XMFLOAT3* boundsMax, const XMFLOAT3& point)
+    {
+        boundsMin->x = min(boundsMin->x, point.x);
+        boundsMin->y = min(boundsMin->y, point.y);
+        boundsMin->z = min(boundsMin->z, point.z);
+        boundsMax->x = max(boundsMax->x, point.x);
+        boundsMax->y = max(boundsMax->y, point.y);
+        boundsMax->z = max(boundsMax->z, point.z);
+    }
+
+    // Bounds of the transformed corners of a box.
+    void TransformBounds(FXMMATRIX transform, const XMFLOAT3& inMin, const XMFLOAT3& inMax, XMFLOAT3* outMin, XMFLOAT3* outMax)
+    {
+        *outMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+        *outMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (UINT corner = 0; corner < 8; corner++)
+        {
+            XMVECTOR point = XMVectorSet(
+                corner & 1 ? inMax.x : inMin.x,
+                corner & 2 ? inMax.y : inMin.y,
+                corner & 4 ? inMax.z : inMin.z, 1.0f);
+            XMFLOAT3 transformed;
+            XMStoreFloat3(&transformed, XMVector3TransformCoord(point, transform));
+            Grow(outMin, outMax, transformed);
+        }
+    }
+
+    XMFLOAT3 ColorFromDirection(float x, float y, float z)
+    {
+        return XMFLOAT3(0.5f + 0.5f * x, 0.5f + 0.5f * y, 0.5f + 0.5f * z);
+    }
+}
+
+SceneGenerator::SceneGenerator() :
+    m_meshMin(0.0f, 0.0f, 0.0f),
+    m_meshMax(0.0f, 0.0f, 0.0f),
+    m_boundsMin(0.0f, 0.0f, 0.0f),
+    m_boundsMax(0.0f, 0.0f, 0.0f)
+{
+}
+
+void SceneGenerator::Clear()
+{
+    vector<SceneVertex>().swap(m_vertices);
+    vector<UINT32>().swap(m_indices);
+    vector<XMFLOAT3X4>().swap(m_instanceTransforms);
+    m_meshMin = m_meshMax = m_boundsMin = m_boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
+
+void SceneGenerator::Generate(const SceneDesc& desc)
+{
+    TRACE_SCOPE("SceneGenerator::Generate");
+    ThrowIfFalse(desc.mesh < SceneDesc::MeshCount && desc.layout < SceneDesc::LayoutCount, L"SceneGenerator: unknown mesh or layout.\n");
+    ThrowIfFalse(desc.triangleCount > 0 && desc.triangleCount <= c_maxTriangleCount, L"SceneGenerator: a mesh needs between 1 and 100M triangles.\n");
+    ThrowIfFalse(desc.instanceCount > 0 && desc.instanceCount <= D3D12_RAYTRACING_MAX_INSTANCES_PER_TOP_LEVEL_ACCELERATION_STRUCTURE,
+        L"SceneGenerator: instance count is out of range.\n");
+    ThrowIfFalse(desc.overlap >= 0.0f && desc.overlap < 1.0f && desc.aspectRatio > 0.0f, L"SceneGenerator: overlap must be in [0, 1) and the aspect ratio positive.\n");
+
+    Clear();
+    m_desc = desc;
+    mt19937 random(desc.seed);
+
+    m_indices.reserve(3 * static_cast<size_t>(desc.triangleCount));
+    switch (desc.mesh)
+    {
+    case SceneDesc::MeshTerrain:
+        GenerateTerrain();
+        break;
+    case SceneDesc::MeshSphere:
+        GenerateSphere();
+        break;
+    default:
+        GenerateSoup(random);
+        break;
+    }
+    FinishMesh();
+    GenerateLayout(random);
+}
+
+void SceneGenerator::GenerateTerrain()
+{
+    // Square cells in rows, the last row may be short and the last cell may have one triangle.
+    UINT cellCount = (m_desc.triangleCount + 1) / 2;
+    UINT columns = max<UINT>(static_cast<UINT>(ceil(sqrt(static_cast<double>(cellCount)))), 1);
+    UINT rows = (cellCount + columns - 1) / columns;
+
+    m_vertices.reserve(static_cast<size_t>(columns + 1) * (rows + 1));
+    for (UINT z = 0; z <= rows; z++)
+    {
+        for (UINT x = 0; x <= columns; x++)
+        {
+            float u = static_cast<float>(x) / columns;
+            float v = static_cast<float>(z) / rows;
+
+            // Five octaves, the finest features are still several cells wide up to ~10M triangles.
+            float height = 0.0f;
+            float amplitude = 0.5f;
+            float frequency = 4.0f;
+            for (UINT octave = 0; octave < 5; octave++)
+            {
+                height += amplitude * (2.0f * ValueNoise(u * frequency, v * frequency, m_desc.seed + octave) - 1.0f);
+                amplitude *= 0.5f;
+                frequency *= 2.0f;
+            }
+
+            SceneVertex vertex;
+            vertex.position = XMFLOAT3(2.0f * u - 1.0f, 0.25f * height, 2.0f * v - 1.0f);
+            vertex.color = XMFLOAT3(0.4f + 0.5f * height, 0.5f + 0.4f * height, 0.2f);
+            m_vertices.push_back(vertex);
+        }
+    }
+
+    // Wound so the front faces look up.
+    for (UINT cell = 0; GetTriangleCount() < m_desc.triangleCount; cell++)
+    {
+        UINT i0 = (cell / columns) * (columns + 1) + cell % columns;
+        UINT i1 = i0 + 1;
+        UINT i2 = i0 + columns + 1;
+        UINT i3 = i2 + 1;
+        m_indices.insert(m_indices.end(), { i0, i2, i1 });
+        if (GetTriangleCount() < m_desc.triangleCount)
+        {
+            m_indices.insert(m_indices.end(), { i1, i2, i3 });
+        }
+    }
+}
+
+void SceneGenerator::GenerateSphere()
+{
+    const float t = 1.618034f;
+    const XMFLOAT3 corners[12] =
+    {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+    };
+    const UINT faces[20][3] =
+    {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+    };
+
+    // Every face becomes a triangular grid of frequency^2 triangles, the last faces are left
+    // out or cut short to hit the exact count. Vertices aren't shared between faces.
+    UINT frequency = max<UINT>(static_cast<UINT>(ceil(sqrt(m_desc.triangleCount / 20.0))), 1);
+    auto RowStart = [frequency](UINT row) { return row * (frequency + 1) - row * (row - 1) / 2; };
+
+    for (UINT face = 0; face < 20 && GetTriangleCount() < m_desc.triangleCount; face++)
+    {
+        XMVECTOR a = XMLoadFloat3(&corners[faces[face][0]]);
+        XMVECTOR b = XMLoadFloat3(&corners[faces[face][1]]);
+        XMVECTOR c = XMLoadFloat3(&corners[faces[face][2]]);
+
+        // Front faces point out of the sphere.
+        if (XMVectorGetX(XMVector3Dot(XMVector3Cross(b - a, c - a), a + b + c)) < 0.0f)
+        {
+            swap(b, c);
+        }
+
+        UINT base = static_cast<UINT>(m_vertices.size());
+        for (UINT i = 0; i <= frequency; i++)
+        {
+            for (UINT j = 0; j <= frequency - i; j++)
+            {
+                XMVECTOR direction = XMVector3Normalize(a + (b - a) * (static_cast<float>(i) / frequency) + (c - a) * (static_cast<float>(j) / frequency));
+                SceneVertex vertex;
+                XMStoreFloat3(&vertex.position, direction);
+                vertex.color = ColorFromDirection(vertex.position.x, vertex.position.y, vertex.position.z);
+                m_vertices.push_back(vertex);
+            }
+        }
+
+        for (UINT i = 0; i < frequency && GetTriangleCount() < m_desc.triangleCount; i++)
+        {
+            for (UINT j = 0; j < frequency - i && GetTriangleCount() < m_desc.triangleCount; j++)
+            {
+                UINT v00 = base + RowStart(i) + j;
+                UINT v10 = base + RowStart(i + 1) + j;
+                m_indices.insert(m_indices.end(), { v00, v10, v00 + 1 });
+                if (j + 1 < frequency - i && GetTriangleCount() < m_desc.triangleCount)
+                {
+                    m_indices.insert(m_indices.end(), { v10, v10 + 1, v00 + 1 });
+                }
+            }
+        }
+    }
+}
+
+void SceneGenerator::GenerateSoup(mt19937& random)
+{
+    // Sized so the triangles fill the volume a few times over, whatever their number.
+    float size = 3.0f / static_cast<float>(cbrt(static_cast<double>(m_desc.triangleCount)));
+
+    m_vertices.reserve(3 * static_cast<size_t>(m_desc.triangleCount));
+    for (UINT triangle = 0; triangle < m_desc.triangleCount; triangle++)
+    {
+        XMFLOAT3 center(Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f), Uniform(random, -1.0f, 1.0f));
+        XMFLOAT3 color(Uniform(random, 0.0f, 1.0f), Uniform(random, 0.0f, 1.0f), Uniform(random, 0.0f, 1.0f));
+        for (UINT corner = 0; corner < 3; corner++)
+        {
+            SceneVertex vertex;
+            vertex.position = XMFLOAT3(
+                center.x + Uniform(random, -size, size),
+                center.y + Uniform(random, -size, size),
+                center.z + Uniform(random, -size, size));
+            vertex.color = color;
+            m_indices.push_back(static_cast<UINT32>(m_vertices.size()));
+            m_vertices.push_back(vertex);
+        }
+    }
+}
+
+// Centers the mesh on the origin, scales its longest half extent to one and stretches it.
+void SceneGenerator::FinishMesh()
+{
+    XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (auto& vertex : m_vertices)
+    {
+        Grow(&boundsMin, &boundsMax, vertex.position);
+    }
+
+    XMFLOAT3 center(0.5f * (boundsMin.x + boundsMax.x), 0.5f * (boundsMin.y + boundsMax.y), 0.5f * (boundsMin.z + boundsMax.z));
+    float halfExtent = 0.5f * max(max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+    float scale = halfExtent > 0.0f ? 1.0f / halfExtent : 1.0f;
+
+    m_meshMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+    m_meshMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (auto& vertex : m_vertices)
+    {
+        vertex.position.x = (vertex.position.x - center.x) * scale * m_desc.aspectRatio;
+        vertex.position.y = (vertex.position.y - center.y) * scale;
+        vertex.position.z = (vertex.position.z - center.z) * scale;
+        Grow(&m_meshMin, &m_meshMax, vertex.position);
+    }
+}
+
+void SceneGenerator::GenerateLayout(mt19937& random)
+{
+    const UINT count = m_desc.instanceCount;
+    const float spacing = 1.0f - m_desc.overlap;
+    XMFLOAT3 extent(m_meshMax.x - m_meshMin.x, m_meshMax.y - m_meshMin.y, m_meshMax.z - m_meshMin.z);
+    float maxExtent = max(max(extent.x, extent.y), extent.z);
+
+    m_boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+    m_boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    m_instanceTransforms.resize(count);
+
+    // Clusters sit on a grid three cluster widths apart, the grid layout is one instance per cluster.
+    UINT instancesPerCluster = 1;
+    float clusterSize = 0.0f;
+    if (m_desc.layout == SceneDesc::LayoutClustered)
+    {
+        UINT clusterCount = max<UINT>(static_cast<UINT>(sqrt(static_cast<double>(count)) / 2.0), 1);
+        instancesPerCluster = (count + clusterCount - 1) / clusterCount;
+        clusterSize = static_cast<float>(cbrt(static_cast<double>(instancesPerCluster))) * maxExtent * spacing;
+    }
+    UINT cellCount = (count + instancesPerCluster - 1) / instancesPerCluster;
+    UINT columns = max<UINT>(static_cast<UINT>(ceil(sqrt(static_cast<double>(cellCount)))), 1);
+    UINT rows = (cellCount + columns - 1) / columns;
+    float cellWidth = m_desc.layout == SceneDesc::LayoutClustered ? 3.0f * max(clusterSize, maxExtent) : extent.x * spacing;
+    float cellDepth = m_desc.layout == SceneDesc::LayoutClustered ? cellWidth : extent.z * spacing;
+
+    // The overlapping layout packs everything into a cube half as wide as touching instances would need.
+    float overlappingSize = 0.5f * static_cast<float>(cbrt(static_cast<double>(count))) * maxExtent * spacing;
+
+    for (UINT i = 0; i < count; i++)
+    {
+        UINT cell = i / instancesPerCluster;
+        float cellX = (static_cast<float>(cell % columns) - 0.5f * (columns - 1)) * cellWidth;
+        float cellZ = (static_cast<float>(cell / columns) - 0.5f * (rows - 1)) * cellDepth;
+
+        XMMATRIX transform;
+        switch (m_desc.layout)
+        {
+        case SceneDesc::LayoutGrid:
+            transform = XMMatrixTranslation(cellX, 0.0f, cellZ);
+            break;
+        case SceneDesc::LayoutClustered:
+        {
+            float yaw = Uniform(random, 0.0f, XM_2PI);
+            float x = cellX + Uniform(random, -0.5f, 0.5f) * clusterSize;
+            float y = Uniform(random, -0.5f, 0.5f) * clusterSize;
+            float z = cellZ + Uniform(random, -0.5f, 0.5f) * clusterSize;
+            transform = XMMatrixRotationY(yaw) * XMMatrixTranslation(x, y, z);
+            break;
+        }
+        default:
+        {
+            float pitch = Uniform(random, 0.0f, XM_2PI);
+            float yaw = Uniform(random, 0.0f, XM_2PI);
+            float roll = Uniform(random, 0.0f, XM_2PI);
+            float x = Uniform(random, -0.5f, 0.5f) * overlappingSize;
+            float y = Uniform(random, -0.5f, 0.5f) * overlappingSize;
+            float z = Uniform(random, -0.5f, 0.5f) * overlappingSize;
+            transform = XMMatrixRotationRollPitchYaw(pitch, yaw, roll) * XMMatrixTranslation(x, y, z);
+            break;
+        }
+        }
+
+        XMStoreFloat3x4(&m_instanceTransforms[i], transform);
+        XMFLOAT3 instanceMin, instanceMax;
+        TransformBounds(transform, m_meshMin, m_meshMax, &instanceMin, &instanceMax);
+        Grow(&m_boundsMin, &m_boundsMax, instanceMin);
+        Grow(&m_boundsMin, &m_boundsMax, instanceMax);
+    }
+}
+
+void SceneGenerator::GetInstanceBounds(vector<XMFLOAT3>* boundsMin, vector<XMFLOAT3>* boundsMax) const
+{
+    boundsMin->resize(m_instanceTransforms.size());
+    boundsMax->resize(m_instanceTransforms.size());
+    for (size_t i = 0; i < m_instanceTransforms.size(); i++)
+    {
+        TransformBounds(XMLoadFloat3x4(&m_instanceTransforms[i]), m_meshMin, m_meshMax, &(*boundsMin)[i], &(*boundsMax)[i]);
+    }
+}
+
+LPCWSTR SceneGenerator::GetMeshName(SceneDesc::Mesh mesh)
+{
+    return c_meshNames[mesh];
+}
+
+LPCWSTR SceneGenerator::GetLayoutName(SceneDesc::Layout layout)
+{
+    return c_layoutNames[layout];
+}
+
+bool SceneGenerator::ParseMesh(LPCWSTR name, SceneDesc::Mesh* mesh)
+{
+    for (UINT i = 0; i < SceneDesc::MeshCount; i++)
+    {
+        if (_wcsicmp(name, c_meshNames[i]) == 0)
+        {
+            *mesh = static_cast<SceneDesc::Mesh>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SceneGenerator::ParseLayout(LPCWSTR name, SceneDesc::Layout* layout)
+{
+    for (UINT i = 0; i < SceneDesc::LayoutCount; i++)
+    {
+        if (_wcsicmp(name, c_layoutNames[i]) == 0)
+        {
+            *layout = static_cast<SceneDesc::Layout>(i);
+            return true;
+        }
+    }
+    return false;
+}
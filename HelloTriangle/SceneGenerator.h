@@ -0,0 +1,118 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// SceneGenerator.h - Procedural meshes and instance layouts for scaling benchmarks
+//
+
+#pragma once
+
+#include <random>
+
+namespace DX
+{
+    // Same layout as the shader's Vertex.
+    struct SceneVertex
+    {
+        DirectX::XMFLOAT3   position;
+        DirectX::XMFLOAT3   color;
+    };
+
+    struct SceneDesc
+    {
+        enum Mesh
+        {
+            MeshTerrain,        // Height field of value noise, two triangles per cell.
+            MeshSphere,         // Icosahedron with every face subdivided, projected onto the sphere.
+            MeshSoup,           // Unconnected triangles at random positions and orientations.
+            MeshCount
+        };
+
+        enum Layout
+        {
+            LayoutGrid,         // Rows and columns on the ground plane.
+            LayoutClustered,    // Dense clumps with empty space between them.
+            LayoutOverlapping,  // One clump of randomly rotated instances, their bounds overlap heavily.
+            LayoutCount
+        };
+
+        SceneDesc() :
+            mesh(MeshTerrain),
+            triangleCount(1024),
+            layout(LayoutGrid),
+            instanceCount(1),
+            overlap(0.0f),
+            aspectRatio(1.0f),
+            seed(1)
+        {
+        }
+
+        Mesh    mesh;
+        UINT    triangleCount;  // Per mesh, exactly.
+        Layout  layout;
+        UINT    instanceCount;
+        float   overlap;        // [0, 1), how far neighbouring instances move into each other.
+        float   aspectRatio;    // Stretches the mesh, and with it every triangle, along x.
+        UINT    seed;
+    };
+
+    // Generates one mesh and places it instanceCount times. Meshes are scaled to fit [-1, 1] before
+    // being stretched, so layouts only depend on the bounds. The same desc gives the same scene.
+    // Sizes from one triangle up to c_maxTriangleCount per mesh, instancing takes the total further.
+    class SceneGenerator
+    {
+    public:
+        static const UINT c_maxTriangleCount = 100 * 1000 * 1000;
+
+        SceneGenerator();
+
+        void Generate(const SceneDesc& desc);
+        void Clear();
+
+        // Object space bounds of every instance, e.g. for building a top level CpuBvh.
+        void GetInstanceBounds(std::vector<DirectX::XMFLOAT3>* boundsMin, std::vector<DirectX::XMFLOAT3>* boundsMax) const;
+
+        static LPCWSTR GetMeshName(SceneDesc::Mesh mesh);
+        static LPCWSTR GetLayoutName(SceneDesc::Layout layout);
+        // Case insensitive, returns false for unknown names.
+        static bool ParseMesh(LPCWSTR name, SceneDesc::Mesh* mesh);
+        static bool ParseLayout(LPCWSTR name, SceneDesc::Layout* layout);
+
+        // Accessors.
+        const SceneDesc&                        GetDesc() const { return m_desc; }
+        const std::vector<SceneVertex>&         GetVertices() const { return m_vertices; }
+        const std::vector<UINT32>&              GetIndices() const { return m_indices; }
+        const std::vector<DirectX::XMFLOAT3X4>& GetInstanceTransforms() const { return m_instanceTransforms; }
+        UINT                                    GetTriangleCount() const { return static_cast<UINT>(m_indices.size() / 3); }
+        UINT                                    GetInstanceCount() const { return static_cast<UINT>(m_instanceTransforms.size()); }
+        UINT64                                  GetTotalTriangleCount() const { return static_cast<UINT64>(GetTriangleCount()) * GetInstanceCount(); }
+        DirectX::XMFLOAT3                       GetBoundsMin() const { return m_boundsMin; }
+        DirectX::XMFLOAT3                       GetBoundsMax() const { return m_boundsMax; }
+
+    private:
+        void GenerateTerrain();
+        void GenerateSphere();
+        void GenerateSoup(std::mt19937& random);
+        void FinishMesh();
+        void GenerateLayout(std::mt19937& random);
+
+        SceneDesc                               m_desc;
+        std::vector<SceneVertex>                m_vertices;
+        std::vector<UINT32>                     m_indices;
+        std::vector<DirectX::XMFLOAT3X4>        m_instanceTransforms;
+
+        // Bounds of the mesh, then of the whole scene.
+        DirectX::XMFLOAT3                       m_meshMin;
+        DirectX::XMFLOAT3                       m_meshMax;
+        DirectX::XMFLOAT3                       m_boundsMin;
+        DirectX::XMFLOAT3                       m_boundsMax;
+    };
+}
@@ -11,26 +11,26 @@
 
 #pragma once
 
+#include <chrono>
+
 // Helper class for animation and simulation timing.
 class StepTimer
 {
 public:
     StepTimer() :
+        m_lastTime(Clock::now()),
+        m_maxDelta(TicksPerSecond / 10),    // Initialize max delta to 1/10 of a second.
         m_elapsedTicks(0),
         m_totalTicks(0),
         m_leftOverTicks(0),
         m_frameCount(0),
         m_framesPerSecond(0),
         m_framesThisSecond(0),
-        m_qpcSecondCounter(0),
+        m_secondCounter(0),
         m_isFixedTimeStep(false),
+        m_isVirtualTime(false),
         m_targetElapsedTicks(TicksPerSecond / 60)
     {
-        QueryPerformanceFrequency(&m_qpcFrequency);
-        QueryPerformanceCounter(&m_qpcLastTime);
-
-        // Initialize max delta to 1/10 of a second.
-        m_qpcMaxDelta = m_qpcFrequency.QuadPart / 10;
     }
 
     // Get elapsed time since the previous Update call.
@@ -50,6 +50,10 @@ public:
     // Set whether to use fixed or variable timestep mode.
     void SetFixedTimeStep(bool isFixedTimestep)            { m_isFixedTimeStep = isFixedTimestep; }
 
+    // Set whether every Tick advances by exactly the target elapsed time, whatever the wall clock
+    // says, so runs are reproducible. The framerate still follows the wall clock.
+    void SetVirtualTime(bool isVirtualTime)                { m_isVirtualTime = isVirtualTime; }
+
     // Set how often to call Update when in fixed timestep mode.
     void SetTargetElapsedTicks(UINT64 targetElapsed)    { m_targetElapsedTicks = targetElapsed; }
     void SetTargetElapsedSeconds(double targetElapsed)    { m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
@@ -59,6 +63,15 @@ public:
 
     static double TicksToSeconds(UINT64 ticks)            { return static_cast<double>(ticks) / TicksPerSecond; }
     static UINT64 SecondsToTicks(double seconds)        { return static_cast<UINT64>(seconds * TicksPerSecond); }
+    static double TicksToMilliseconds(UINT64 ticks)        { return 1000.0 * ticks / TicksPerSecond; }
+
+    // Time source. steady_clock is monotonic everywhere: QueryPerformanceCounter on Windows,
+    // clock_gettime(CLOCK_MONOTONIC) on Linux.
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<INT64, std::ratio<1, TicksPerSecond>> Ticks;
+
+    // Current time in the canonical tick format, for timing intervals outside of Tick().
+    static UINT64 GetCurrentTicks()                        { return static_cast<UINT64>(std::chrono::duration_cast<Ticks>(Clock::now().time_since_epoch()).count()); }
 
     // After an intentional timing discontinuity (for instance a blocking IO operation)
     // call this to avoid having the fixed timestep logic attempt a set of catch-up 
@@ -66,12 +79,12 @@ public:
 
     void ResetElapsedTime()
     {
-        QueryPerformanceCounter(&m_qpcLastTime);
+        m_lastTime = Clock::now();
 
         m_leftOverTicks = 0;
         m_framesPerSecond = 0;
         m_framesThisSecond = 0;
-        m_qpcSecondCounter = 0;
+        m_secondCounter = 0;
     }
 
     typedef void(*LPUPDATEFUNC) (void);
@@ -79,25 +92,26 @@ public:
     // Update timer state, calling the specified Update function the appropriate number of times.
     void Tick(LPUPDATEFUNC update = nullptr)
     {
-        // Query the current time.
-        LARGE_INTEGER currentTime;
-
-        QueryPerformanceCounter(&currentTime);
+        // Query the current time, converted into the canonical tick format. The remainder below
+        // one tick stays in m_lastTime so it isn't lost.
+        Clock::time_point currentTime = Clock::now();
+        Ticks delta = std::chrono::duration_cast<Ticks>(currentTime - m_lastTime);
 
-        UINT64 timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
+        UINT64 timeDelta = static_cast<UINT64>(delta.count());
 
-        m_qpcLastTime = currentTime;
-        m_qpcSecondCounter += timeDelta;
+        m_lastTime += std::chrono::duration_cast<Clock::duration>(delta);
+        m_secondCounter += timeDelta;
 
         // Clamp excessively large time deltas (e.g. after paused in the debugger).
-        if (timeDelta > m_qpcMaxDelta)
+        if (timeDelta > m_maxDelta)
         {
-            timeDelta = m_qpcMaxDelta;
+            timeDelta = m_maxDelta;
         }
 
-        // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
-        timeDelta *= TicksPerSecond;
-        timeDelta /= m_qpcFrequency.QuadPart;
+        if (m_isVirtualTime)
+        {
+            timeDelta = m_targetElapsedTicks;
+        }
 
         UINT32 lastFrameCount = m_frameCount;
 
@@ -152,19 +166,18 @@ public:
             m_framesThisSecond++;
         }
 
-        if (m_qpcSecondCounter >= static_cast<UINT64>(m_qpcFrequency.QuadPart))
+        if (m_secondCounter >= TicksPerSecond)
         {
             m_framesPerSecond = m_framesThisSecond;
             m_framesThisSecond = 0;
-            m_qpcSecondCounter %= m_qpcFrequency.QuadPart;
+            m_secondCounter %= TicksPerSecond;
         }
     }
 
 private:
-    // Source timing data uses QPC units.
-    LARGE_INTEGER m_qpcFrequency;
-    LARGE_INTEGER m_qpcLastTime;
-    UINT64 m_qpcMaxDelta;
+    // Source timing data.
+    Clock::time_point m_lastTime;
+    UINT64 m_maxDelta;
 
     // Derived timing data uses a canonical tick format.
     UINT64 m_elapsedTicks;
@@ -175,9 +188,10 @@ private:
     UINT32 m_frameCount;
     UINT32 m_framesPerSecond;
     UINT32 m_framesThisSecond;
-    UINT64 m_qpcSecondCounter;
+    UINT64 m_secondCounter;
 
     // Members for configuring fixed timestep mode.
     bool m_isFixedTimeStep;
+    bool m_isVirtualTime;
     UINT64 m_targetElapsedTicks;
 };
@@ -0,0 +1,115 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "TextureReadback.h"
+
+using namespace DX;
+using namespace std;
+
+TextureReadback::TextureReadback() :
+    m_footprint(),
+    m_sliceSize(0),
+    m_frameIndex(0)
+{
+}
+
+void TextureReadback::Create(ID3D12Device* device, const D3D12_RESOURCE_DESC& texture, UINT frameCount)
+{
+    Release();
+
+    UINT64 totalBytes = 0;
+    device->GetCopyableFootprints(&texture, 0, 1, 0, &m_footprint, nullptr, nullptr, &totalBytes);
+    // Every slice starts where a placed footprint may.
+    m_sliceSize = (totalBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~static_cast<UINT64>(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+    auto readbackHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_sliceSize * frameCount);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readbackBuffer)));
+    m_readbackBuffer->SetName(L"TextureReadback");
+
+    m_recorded.assign(frameCount, false);
+    m_frameNumbers.assign(frameCount, 0);
+}
+
+void TextureReadback::Release()
+{
+    m_readbackBuffer.Reset();
+    m_recorded.clear();
+    m_frameNumbers.clear();
+    m_frameIndex = 0;
+}
+
+void TextureReadback::BeginFrame(UINT frameIndex, const Callback& callback)
+{
+    if (!IsCreated())
+    {
+        return;
+    }
+
+    m_frameIndex = frameIndex;
+    if (m_recorded[frameIndex])
+    {
+        Read(frameIndex, callback);
+    }
+}
+
+void TextureReadback::Copy(ID3D12GraphicsCommandList* commandList, ID3D12Resource* source, UINT64 frameNumber)
+{
+    if (!IsCreated())
+    {
+        return;
+    }
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = m_footprint;
+    footprint.Offset = m_frameIndex * m_sliceSize;
+    CD3DX12_TEXTURE_COPY_LOCATION destination(m_readbackBuffer.Get(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION sourceLocation(source, 0);
+    commandList->CopyTextureRegion(&destination, 0, 0, 0, &sourceLocation, nullptr);
+
+    m_recorded[m_frameIndex] = true;
+    m_frameNumbers[m_frameIndex] = frameNumber;
+}
+
+void TextureReadback::ReadAll(const Callback& callback)
+{
+    if (!IsCreated())
+    {
+        return;
+    }
+
+    vector<UINT> pending;
+    for (UINT i = 0; i < m_recorded.size(); i++)
+    {
+        if (m_recorded[i])
+        {
+            pending.push_back(i);
+        }
+    }
+    sort(pending.begin(), pending.end(), [this](UINT a, UINT b) { return m_frameNumbers[a] < m_frameNumbers[b]; });
+    for (UINT frameIndex : pending)
+    {
+        Read(frameIndex, callback);
+    }
+}
+
+void TextureReadback::Read(UINT frameIndex, const Callback& callback)
+{
+    m_recorded[frameIndex] = false;
+
+    D3D12_RANGE readRange = { static_cast<SIZE_T>(frameIndex * m_sliceSize), static_cast<SIZE_T>((frameIndex + 1) * m_sliceSize) };
+    D3D12_RANGE writtenRange = {};
+    void* data;
+    ThrowIfFailed(m_readbackBuffer->Map(0, &readRange, &data));
+    callback(m_frameNumbers[frameIndex], static_cast<BYTE*>(data) + readRange.Begin, m_footprint.Footprint.RowPitch);
+    m_readbackBuffer->Unmap(0, &writtenRange);
+}
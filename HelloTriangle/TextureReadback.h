@@ -0,0 +1,58 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// TextureReadback.h - Copy a 2D texture to the CPU once per frame without stalling
+//
+
+#pragma once
+
+namespace DX
+{
+    // Like GpuTimer, each frame index copies into its own slice of one readback buffer and the
+    // copy is read when the frame index comes around again, once its fence has completed. On the
+    // recording device the copies are recorded but never executed, the slices stay zero.
+    class TextureReadback
+    {
+    public:
+        // Row pitch is the footprint's, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT aligned.
+        typedef std::function<void(UINT64 frameNumber, const void* data, UINT rowPitch)> Callback;
+
+        TextureReadback();
+
+        // Texture is the description of the resources Copy() will be given, with one subresource.
+        void Create(ID3D12Device* device, const D3D12_RESOURCE_DESC& texture, UINT frameCount);
+        void Release();
+
+        // Call once the frame's fence has completed. Hands the copy the frame index last recorded
+        // to callback, if it recorded one.
+        void BeginFrame(UINT frameIndex, const Callback& callback);
+        // Source must be in D3D12_RESOURCE_STATE_COPY_SOURCE. frameNumber is passed back with the data.
+        void Copy(ID3D12GraphicsCommandList* commandList, ID3D12Resource* source, UINT64 frameNumber);
+        // Call after the GPU is idle: hands over every copy not read yet, oldest first.
+        void ReadAll(const Callback& callback);
+
+        // Accessors.
+        bool IsCreated() const { return m_readbackBuffer != nullptr; }
+        UINT GetWidth() const { return m_footprint.Footprint.Width; }
+        UINT GetHeight() const { return m_footprint.Footprint.Height; }
+
+    private:
+        void Read(UINT frameIndex, const Callback& callback);
+
+        Microsoft::WRL::ComPtr<ID3D12Resource>      m_readbackBuffer;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT          m_footprint;
+        UINT64                                      m_sliceSize;
+        UINT                                        m_frameIndex;
+        std::vector<bool>                           m_recorded;     // Per frame index, a copy is waiting to be read.
+        std::vector<UINT64>                         m_frameNumbers;
+    };
+}
@@ -0,0 +1,162 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "TiledImageWriter.h"
+#include "StepTimer.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const LPCWSTR c_extensions[TiledImageWriter::FormatCount] = { L".ppm", L".pfm" };
+}
+
+TiledImageWriter::TiledImageWriter() :
+    m_format(FormatPpm),
+    m_width(0),
+    m_height(0),
+    m_headerSize(0),
+    m_pixelSize(0),
+    m_bytesWritten(0),
+    m_writeSeconds(0.0)
+{
+}
+
+void TiledImageWriter::Create(const wstring& path, UINT width, UINT height)
+{
+    ThrowIfFalse(ParseFormat(path, &m_format), L"TiledImageWriter: the file must be a .ppm or a .pfm.\n");
+    ThrowIfFalse(width > 0 && height > 0, L"TiledImageWriter: the image has no pixels.\n");
+    Close();
+    m_file.open(path, ios::binary | ios::trunc);
+    ThrowIfFalse(m_file.is_open(), L"TiledImageWriter: couldn't open the file for writing.\n");
+
+    // The same headers as ImageFile writes.
+    string header = m_format == FormatPpm
+        ? "P6\n" + to_string(width) + " " + to_string(height) + "\n255\n"
+        : "PF\n" + to_string(width) + " " + to_string(height) + "\n-1.0\n";
+    m_file.write(header.data(), header.size());
+    m_width = width;
+    m_height = height;
+    m_headerSize = header.size();
+    m_pixelSize = m_format == FormatPpm ? 3 : 3 * sizeof(float);
+    m_bytesWritten = header.size();
+    m_writeSeconds = 0.0;
+}
+
+void TiledImageWriter::Close()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+        ThrowIfFalse(!m_file.fail(), L"TiledImageWriter: writing the file failed.\n");
+    }
+    m_file.clear();
+}
+
+void TiledImageWriter::WriteTile(UINT x, UINT y, UINT width, UINT height, const UINT32* rgba8, UINT rowPitch)
+{
+    CheckTile(x, y, width, height);
+    m_row.resize(static_cast<size_t>(width) * m_pixelSize);
+    for (UINT row = 0; row < height; row++)
+    {
+        const UINT32* pixels = reinterpret_cast<const UINT32*>(reinterpret_cast<const uint8_t*>(rgba8) + static_cast<size_t>(row) * rowPitch);
+        if (m_format == FormatPpm)
+        {
+            for (UINT i = 0; i < width; i++)
+            {
+                m_row[3 * i + 0] = static_cast<uint8_t>(pixels[i]);
+                m_row[3 * i + 1] = static_cast<uint8_t>(pixels[i] >> 8);
+                m_row[3 * i + 2] = static_cast<uint8_t>(pixels[i] >> 16);
+            }
+        }
+        else
+        {
+            float* destination = reinterpret_cast<float*>(m_row.data());
+            for (UINT i = 0; i < width; i++)
+            {
+                destination[3 * i + 0] = (pixels[i] & 0xff) / 255.0f;
+                destination[3 * i + 1] = ((pixels[i] >> 8) & 0xff) / 255.0f;
+                destination[3 * i + 2] = ((pixels[i] >> 16) & 0xff) / 255.0f;
+            }
+        }
+        WriteRow(x, y + row);
+    }
+}
+
+void TiledImageWriter::WriteTile(UINT x, UINT y, const CpuFramebuffer& source, const Tonemapper& tonemapper)
+{
+    UINT width = source.GetWidth();
+    CheckTile(x, y, width, source.GetHeight());
+    m_row.resize(static_cast<size_t>(width) * m_pixelSize);
+    for (UINT row = 0; row < source.GetHeight(); row++)
+    {
+        const XMFLOAT4* pixels = source.GetRow(row);
+        if (m_format == FormatPpm)
+        {
+            m_resolved.resize(width);
+            tonemapper.Resolve(pixels, m_resolved.data(), width);
+            for (UINT i = 0; i < width; i++)
+            {
+                m_row[3 * i + 0] = static_cast<uint8_t>(m_resolved[i]);
+                m_row[3 * i + 1] = static_cast<uint8_t>(m_resolved[i] >> 8);
+                m_row[3 * i + 2] = static_cast<uint8_t>(m_resolved[i] >> 16);
+            }
+        }
+        else
+        {
+            // x86 is little endian, the floats go as they are.
+            float* destination = reinterpret_cast<float*>(m_row.data());
+            for (UINT i = 0; i < width; i++)
+            {
+                destination[3 * i + 0] = pixels[i].x;
+                destination[3 * i + 1] = pixels[i].y;
+                destination[3 * i + 2] = pixels[i].z;
+            }
+        }
+        WriteRow(x, y + row);
+    }
+}
+
+bool TiledImageWriter::ParseFormat(const wstring& path, Format* format)
+{
+    for (UINT i = 0; i < FormatCount; i++)
+    {
+        size_t length = wcslen(c_extensions[i]);
+        if (path.size() > length && _wcsicmp(path.c_str() + path.size() - length, c_extensions[i]) == 0)
+        {
+            *format = static_cast<Format>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TiledImageWriter::CheckTile(UINT x, UINT y, UINT width, UINT height) const
+{
+    ThrowIfFalse(m_file.is_open(), L"TiledImageWriter: the file isn't open.\n");
+    ThrowIfFalse(x < m_width && y < m_height && width <= m_width - x && height <= m_height - y,
+        L"TiledImageWriter: the tile is outside the image.\n");
+}
+
+void TiledImageWriter::WriteRow(UINT x, UINT y)
+{
+    UINT64 start = StepTimer::GetCurrentTicks();
+    UINT fileRow = m_format == FormatPfm ? m_height - 1 - y : y;
+    UINT64 offset = m_headerSize + (static_cast<UINT64>(fileRow) * m_width + x) * m_pixelSize;
+    m_file.seekp(static_cast<streamoff>(offset));
+    m_file.write(reinterpret_cast<const char*>(m_row.data()), m_row.size());
+    ThrowIfFalse(m_file.good(), L"TiledImageWriter: writing the file failed.\n");
+    m_bytesWritten += m_row.size();
+    m_writeSeconds += StepTimer::TicksToSeconds(StepTimer::GetCurrentTicks() - start);
+}
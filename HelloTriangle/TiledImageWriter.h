@@ -0,0 +1,78 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// TiledImageWriter.h - Writes an image to disk a tile at a time
+//
+
+#pragma once
+
+#include "CpuFramebuffer.h"
+#include "Tonemapper.h"
+#include <fstream>
+
+namespace DX
+{
+    // PPM and PFM store fixed size pixels without compression, so every row of a tile has a known
+    // place in the file and is written straight there. Only one row is converted at a time, the
+    // memory used doesn't depend on the image size. Tiles can come in any order, but row major
+    // order grows the file a band of tiles at a time instead of leaving holes the file system has
+    // to fill. Pixels never written are zero, or missing from the end of the file.
+    class TiledImageWriter
+    {
+    public:
+        enum Format
+        {
+            FormatPpm,      // Binary 8-bit RGB.
+            FormatPfm,      // Little endian 32-bit float RGB, rows bottom to top.
+            FormatCount
+        };
+
+        TiledImageWriter();
+
+        // The format comes from the extension, .ppm or .pfm.
+        void Create(const std::wstring& path, UINT width, UINT height);
+        void Close();
+
+        // rgba8 is DXGI_FORMAT_R8G8B8A8_UNORM with rowPitch bytes between rows, e.g. a mapped
+        // readback footprint, and becomes [0, 1] floats in a PFM.
+        void WriteTile(UINT x, UINT y, UINT width, UINT height, const UINT32* rgba8, UINT rowPitch);
+        // All of source. tonemapper only applies to a PPM, a PFM keeps the linear values.
+        void WriteTile(UINT x, UINT y, const CpuFramebuffer& source, const Tonemapper& tonemapper = Tonemapper());
+
+        static bool ParseFormat(const std::wstring& path, Format* format);
+
+        // Accessors.
+        bool    IsOpen() const { return m_file.is_open(); }
+        Format  GetFormat() const { return m_format; }
+        UINT    GetWidth() const { return m_width; }
+        UINT    GetHeight() const { return m_height; }
+        UINT64  GetBytesWritten() const { return m_bytesWritten; }
+        double  GetWriteSeconds() const { return m_writeSeconds; }
+        size_t  GetBufferBytes() const { return m_row.capacity() + m_resolved.capacity() * sizeof(UINT32); }
+
+    private:
+        void CheckTile(UINT x, UINT y, UINT width, UINT height) const;
+        // m_row, converted from the image's row y at column x.
+        void WriteRow(UINT x, UINT y);
+
+        std::ofstream           m_file;
+        Format                  m_format;
+        UINT                    m_width;
+        UINT                    m_height;
+        UINT64                  m_headerSize;
+        UINT                    m_pixelSize;        // In the file.
+        std::vector<uint8_t>    m_row;
+        std::vector<UINT32>     m_resolved;         // A PPM row from float, before dropping alpha.
+        UINT64                  m_bytesWritten;
+        double                  m_writeSeconds;
+    };
+}
@@ -0,0 +1,187 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "TiledRenderer.h"
+#include "StepTimer.h"
+#include "TraceRecorder.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    float Halton(UINT index, UINT base)
+    {
+        float result = 0.0f;
+        float fraction = 1.0f / base;
+        for (; index > 0; index /= base, fraction /= base)
+        {
+            result += fraction * (index % base);
+        }
+        return result;
+    }
+}
+
+TiledRenderer::TiledRenderer() :
+    m_tileColumns(0),
+    m_tileCount(0),
+    m_writtenTileCount(0),
+    m_start(0),
+    m_seconds(0.0),
+    m_tileWriteSeconds(0.0),
+    m_peakBufferBytes(0)
+{
+}
+
+void TiledRenderer::Begin(const TiledRenderDesc& desc, const wstring& path)
+{
+    ThrowIfFalse(desc.width > 0 && desc.height > 0 && desc.tileWidth > 0 && desc.tileHeight > 0,
+        L"TiledRenderer: the image and its tiles need pixels.\n");
+    ThrowIfFalse(desc.samplesPerPixel > 0, L"TiledRenderer: at least one sample per pixel is needed.\n");
+    m_desc = desc;
+    m_tileColumns = (desc.width + desc.tileWidth - 1) / desc.tileWidth;
+    UINT tileRows = (desc.height + desc.tileHeight - 1) / desc.tileHeight;
+    ThrowIfFalse(static_cast<UINT64>(m_tileColumns) * tileRows <= UINT_MAX, L"TiledRenderer: too many tiles.\n");
+    m_tileCount = m_tileColumns * tileRows;
+    m_writtenTileCount = 0;
+    m_written.assign(m_tileCount, false);
+    m_file.Create(path, desc.width, desc.height);
+    m_start = StepTimer::GetCurrentTicks();
+    m_seconds = 0.0;
+    m_tileWriteSeconds = 0.0;
+    m_peakBufferBytes = 0;
+}
+
+void TiledRenderer::WriteTile(UINT index, const UINT32* rgba8, UINT rowPitch)
+{
+    TRACE_SCOPE("TiledRenderer::WriteTile");
+    UINT64 start = StepTimer::GetCurrentTicks();
+    TileRect tile = GetTile(index);
+    ThrowIfFalse(!m_written[index], L"TiledRenderer: the tile was already written.\n");
+    m_file.WriteTile(tile.x, tile.y, tile.width, tile.height, rgba8, rowPitch);
+    TileWritten(start, 0);
+    m_written[index] = true;
+}
+
+void TiledRenderer::WriteTile(UINT index, const CpuFramebuffer& source, const Tonemapper& tonemapper)
+{
+    TRACE_SCOPE("TiledRenderer::WriteTile");
+    UINT64 start = StepTimer::GetCurrentTicks();
+    TileRect tile = GetTile(index);
+    ThrowIfFalse(!m_written[index], L"TiledRenderer: the tile was already written.\n");
+    ThrowIfFalse(source.GetWidth() == tile.width && source.GetHeight() == tile.height, L"TiledRenderer: the tile has the wrong size.\n");
+    m_file.WriteTile(tile.x, tile.y, source, tonemapper);
+    TileWritten(start, source.GetPixelCount() * sizeof(XMFLOAT4));
+    m_written[index] = true;
+}
+
+void TiledRenderer::RenderCpu(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+    const Tonemapper& tonemapper, JobSystem* jobs)
+{
+    TRACE_SCOPE("TiledRenderer::RenderCpu");
+    CpuFramebuffer target;
+    for (UINT index = 0; index < m_tileCount; index++)
+    {
+        if (m_written[index])
+        {
+            continue;
+        }
+
+        TileRect tile = GetTile(index);
+        target.Resize(tile.width, tile.height);
+        auto job = [&](UINT y, UINT)
+        {
+            TRACE_SCOPE("TiledRenderer::TraceRow");
+            XMFLOAT4* row = target.GetRow(y);
+            for (UINT x = 0; x < tile.width; x++)
+            {
+                XMFLOAT4 sum(0.0f, 0.0f, 0.0f, 0.0f);
+                for (UINT sample = 0; sample < m_desc.samplesPerPixel; sample++)
+                {
+                    float offsetX = sample ? Halton(sample, 2) : 0.5f;
+                    float offsetY = sample ? Halton(sample, 3) : 0.5f;
+                    XMFLOAT4 color;
+                    CpuHit hit;
+                    CpuTraversalCounters counters = {};
+                    CpuRenderer::TraceSample(tracer, vertices, indices, camera, m_desc.width, m_desc.height,
+                        tile.x + x, tile.y + y, offsetX, offsetY, &color, &hit, &counters);
+                    sum = XMFLOAT4(sum.x + color.x, sum.y + color.y, sum.z + color.z, sum.w + color.w);
+                }
+                float scale = 1.0f / m_desc.samplesPerPixel;
+                row[x] = XMFLOAT4(sum.x * scale, sum.y * scale, sum.z * scale, sum.w * scale);
+            }
+        };
+        if (jobs)
+        {
+            jobs->ParallelFor(tile.height, job);
+        }
+        else
+        {
+            for (UINT y = 0; y < tile.height; y++)
+            {
+                job(y, 0);
+            }
+        }
+        WriteTile(index, target, tonemapper);
+    }
+}
+
+TileRect TiledRenderer::GetTile(UINT index) const
+{
+    ThrowIfFalse(index < m_tileCount, L"TiledRenderer: the tile index is out of range.\n");
+    TileRect tile;
+    tile.x = index % m_tileColumns * m_desc.tileWidth;
+    tile.y = index / m_tileColumns * m_desc.tileHeight;
+    tile.width = min(m_desc.tileWidth, m_desc.width - tile.x);
+    tile.height = min(m_desc.tileHeight, m_desc.height - tile.y);
+    return tile;
+}
+
+XMMATRIX TiledRenderer::GetTileProjectionToWorld(FXMMATRIX projectionToWorld, UINT width, UINT height, const TileRect& tile)
+{
+    // Screen positions run from -1 to 1 over the tile and have to over the image. Scale them
+    // to the tile's share of the image and move them to its center, y pointing up.
+    float scaleX = static_cast<float>(tile.width) / width;
+    float scaleY = static_cast<float>(tile.height) / height;
+    float centerX = static_cast<float>(2 * tile.x + tile.width) / width - 1.0f;
+    float centerY = 1.0f - static_cast<float>(2 * tile.y + tile.height) / height;
+    return XMMatrixScaling(scaleX, scaleY, 1.0f) * XMMatrixTranslation(centerX, centerY, 0.0f) * projectionToWorld;
+}
+
+wstring TiledRenderer::GetStatisticsString() const
+{
+    const double MB = 1024.0 * 1024.0;
+    double pixels = static_cast<double>(m_desc.width) * m_desc.height;
+    UINT64 fileBytes = m_file.GetBytesWritten();
+    wstringstream stream;
+    stream << fixed << setprecision(1)
+        << L"Tiled render: " << m_desc.width << L"x" << m_desc.height << L" in " << m_writtenTileCount << L" of " << m_tileCount
+        << L" tiles of " << m_desc.tileWidth << L"x" << m_desc.tileHeight << L", " << m_desc.samplesPerPixel << L" samples per pixel\n"
+        << L"  " << m_seconds << L" s, " << (m_seconds > 0.0 ? pixels / m_seconds / 1e6 : 0.0) << L" Mpixels/s\n"
+        << L"  write " << fileBytes / MB << L" MB, " << m_tileWriteSeconds << L" s converting and writing, "
+        << (m_file.GetWriteSeconds() > 0.0 ? fileBytes / MB / m_file.GetWriteSeconds() : 0.0) << L" MB/s to the file\n"
+        << L"  peak buffers " << m_peakBufferBytes / MB << L" MB, against " << pixels * 16.0 / MB << L" MB for the whole image in float\n";
+    return stream.str();
+}
+
+void TiledRenderer::TileWritten(UINT64 writeStart, size_t tileBytes)
+{
+    UINT64 now = StepTimer::GetCurrentTicks();
+    m_tileWriteSeconds += StepTimer::TicksToSeconds(now - writeStart);
+    m_peakBufferBytes = max(m_peakBufferBytes, tileBytes + m_file.GetBufferBytes());
+    if (++m_writtenTileCount == m_tileCount)
+    {
+        m_file.Close();
+        m_seconds = StepTimer::TicksToSeconds(now - m_start);
+    }
+}
@@ -0,0 +1,100 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// TiledRenderer.h - Renders images of any size a tile at a time, streaming tiles to disk
+//
+
+#pragma once
+
+#include "TiledImageWriter.h"
+#include "CpuRenderer.h"
+
+namespace DX
+{
+    struct TiledRenderDesc
+    {
+        TiledRenderDesc() :
+            width(0),
+            height(0),
+            tileWidth(1024),
+            tileHeight(1024),
+            samplesPerPixel(1)
+        {
+        }
+
+        UINT    width;              // Of the whole image.
+        UINT    height;
+        UINT    tileWidth;          // The last column and row of tiles are cut to the image.
+        UINT    tileHeight;
+        UINT    samplesPerPixel;    // At the accumulation's jitter: the pixel center, then Halton (2, 3).
+    };
+
+    struct TileRect
+    {
+        UINT    x;
+        UINT    y;
+        UINT    width;
+        UINT    height;
+    };
+
+    // Splits the image into tiles, numbered in row major order, and writes each one to the file
+    // as it comes in; the file is closed after the last. Nothing is kept of a tile once it is
+    // written, so memory only depends on the tile size. Tiles on the GPU trace the whole image's
+    // rays of their pixels through a tile sized dispatch with GetTileProjectionToWorld(); the
+    // jitter is in pixels and the same in every tile, so samples line up across tile borders.
+    class TiledRenderer
+    {
+    public:
+        TiledRenderer();
+
+        // The file is .ppm or .pfm, see TiledImageWriter.
+        void Begin(const TiledRenderDesc& desc, const std::wstring& path);
+
+        // Each tile once, in any order. rgba8 holds the tile at its top left, see TiledImageWriter.
+        void WriteTile(UINT index, const UINT32* rgba8, UINT rowPitch);
+        void WriteTile(UINT index, const CpuFramebuffer& tile, const Tonemapper& tonemapper = Tonemapper());
+
+        // Renders and writes every tile with the CPU tracer, shaded like CpuRenderer.
+        void RenderCpu(const CpuTracer& tracer, const SceneVertex* vertices, const UINT32* indices, const CpuCamera& camera,
+            const Tonemapper& tonemapper, JobSystem* jobs = nullptr);
+
+        TileRect GetTile(UINT index) const;
+
+        // Crops the projection of the whole image to the tile. Rays generated for a dispatch of
+        // the tile's size, like GenerateCameraRay does, go through the image's pixels of the tile.
+        static DirectX::XMMATRIX GetTileProjectionToWorld(DirectX::FXMMATRIX projectionToWorld, UINT width, UINT height, const TileRect& tile);
+
+        std::wstring GetStatisticsString() const;
+
+        // Accessors.
+        bool                    IsActive() const { return m_file.IsOpen(); }
+        bool                    IsComplete() const { return m_tileCount > 0 && m_writtenTileCount == m_tileCount; }
+        UINT                    GetTileCount() const { return m_tileCount; }
+        UINT                    GetWrittenTileCount() const { return m_writtenTileCount; }
+        const TiledRenderDesc&  GetDesc() const { return m_desc; }
+
+    private:
+        // tileBytes is the source's, when it is this class's buffer.
+        void TileWritten(UINT64 writeStart, size_t tileBytes);
+
+        TiledRenderDesc         m_desc;
+        UINT                    m_tileColumns;
+        UINT                    m_tileCount;
+        UINT                    m_writtenTileCount;
+        std::vector<bool>       m_written;
+        TiledImageWriter        m_file;
+        UINT64                  m_start;
+        double                  m_seconds;
+        double                  m_tileWriteSeconds;     // WriteTile() calls, conversion included.
+        size_t                  m_peakBufferBytes;      // Tile and conversion buffers.
+    };
+}
@@ -0,0 +1,318 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tonemapper.h"
+#include "TraceRecorder.h"
+#include <intrin.h>
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    // Rows per job.
+    const UINT c_rowsPerJob = 16;
+
+    // Inputs are clamped to the largest half float first, so infinities still map to white.
+    const float c_maxInput = 65504.0f;
+
+    // Narkowicz expects the input scaled by 0.6 to match the reference's exposure.
+    const float c_acesInputScale = 0.6f;
+    const float c_acesA = 2.51f;
+    const float c_acesB = 0.03f;
+    const float c_acesC = 2.43f;
+    const float c_acesD = 0.59f;
+    const float c_acesE = 0.14f;
+
+    // Linear to sRGB, one entry per exponent and top 3 mantissa bits from 2^-13 to 1. The high
+    // 16 bits are the bias in units of 512, rounding included, the low 16 bits the slope over the
+    // next 8 mantissa bits; the result is 8-bit with 16 fractional bits. Below 2^-13 everything
+    // encodes to 0. Fitted per bucket and checked against the exact curve for every float.
+    const UINT32 c_srgbMinBits = (127 - 13) << 23;
+    const UINT32 c_srgbAlmostOneBits = 0x3F7FFFFF;
+    const UINT32 c_srgbTable[104] =
+    {
+        0x006D000A, 0x0079000F, 0x0080000A, 0x0081000A, 0x0087000A, 0x008E000A, 0x0094000A, 0x009B000A,
+        0x00A10017, 0x00AE0017, 0x00BB0017, 0x00C80017, 0x00D40017, 0x00E10017, 0x00F50018, 0x01000017,
+        0x01080030, 0x01220030, 0x013B0030, 0x01550030, 0x01750033, 0x01890030, 0x01A20030, 0x01BC0030,
+        0x01DD0064, 0x02090064, 0x023D0064, 0x02760069, 0x02A40064, 0x02DE0065, 0x030B0064, 0x033E0064,
+        0x037800CB, 0x03DF00CC, 0x044600CD, 0x04AD00CD, 0x050E00CB, 0x057A00C2, 0x05DD00BB, 0x063C00B3,
+        0x06980155, 0x0743013F, 0x07E30130, 0x087A0121, 0x090C0110, 0x09950103, 0x0A1800F9, 0x0A9600EF,
+        0x0B1001C8, 0x0BF301B1, 0x0CCC0192, 0x0D97017D, 0x0E55016F, 0x0F0E015B, 0x0FBD014D, 0x10630143,
+        0x11080261, 0x1239023D, 0x1358021A, 0x14650204, 0x156601EA, 0x165A01D3, 0x174401BE, 0x182501AC,
+        0x18FE0330, 0x1A9702FB, 0x1C1602CF, 0x1D7D02AD, 0x1ED4028D, 0x201B026D, 0x21520256, 0x227C0242,
+        0x239F0441, 0x25C203FB, 0x27C003C1, 0x29A10392, 0x2B690368, 0x2D1E033E, 0x2EBE031D, 0x304D02FF,
+        0x31D105AD, 0x34A90553, 0x37520509, 0x39D504C2, 0x3C37048A, 0x3E7C0456, 0x40A80428, 0x42BD03FE,
+        0x44C30797, 0x488E071F, 0x4C1E06B3, 0x4F76065E, 0x52A5060E, 0x55AC05CA, 0x5892058D, 0x5B580556,
+        0x5E0B0A26, 0x631C097F, 0x67DC08F5, 0x6C55087E, 0x70950815, 0x74A107BC, 0x787C076E, 0x7C340724
+    };
+
+    const LPCWSTR c_operatorNames[Tonemapper::OperatorCount] = { L"none", L"reinhard", L"aces" };
+
+    typedef void (*Kernel)(const XMFLOAT4* source, UINT32* destination, size_t pixelCount, float scale);
+
+    inline float AsFloat(UINT32 bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    inline UINT32 AsBits(float value)
+    {
+        UINT32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // The scalar kernels are the reference: the AVX2 ones do the same operations in the same
+    // order, so both round identically.
+    template <Tonemapper::Operator op>
+    inline float ToneCurve(float value, float scale)
+    {
+        value *= scale;
+        // Written so NaN ends up as 0, like _mm256_max_ps with the constant second.
+        value = value > 0.0f ? (value < c_maxInput ? value : c_maxInput) : 0.0f;
+        switch (op)
+        {
+        case Tonemapper::OperatorReinhard:
+            return value / (1.0f + value);
+        case Tonemapper::OperatorAces:
+            return value * (c_acesA * value + c_acesB) / (value * (c_acesC * value + c_acesD) + c_acesE);
+        default:
+            return value;
+        }
+    }
+
+    inline UINT32 ToUnorm8(float value)
+    {
+        float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<UINT32>(clamped * 255.0f + 0.5f);
+    }
+
+    inline UINT32 ToSrgb8(float value)
+    {
+        const float minValue = AsFloat(c_srgbMinBits);
+        const float almostOne = AsFloat(c_srgbAlmostOneBits);
+        value = value > minValue ? (value < almostOne ? value : almostOne) : minValue;
+        UINT32 bits = AsBits(value);
+        UINT32 entry = c_srgbTable[(bits - c_srgbMinBits) >> 20];
+        UINT32 bias = (entry >> 16) << 9;
+        UINT32 slope = entry & 0xFFFF;
+        UINT32 t = (bits >> 12) & 0xFF;
+        return (bias + slope * t) >> 16;
+    }
+
+    template <Tonemapper::Operator op, bool encodeSrgb>
+    void ResolveScalar(const XMFLOAT4* source, UINT32* destination, size_t pixelCount, float scale)
+    {
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const XMFLOAT4& pixel = source[i];
+            float r = ToneCurve<op>(pixel.x, scale);
+            float g = ToneCurve<op>(pixel.y, scale);
+            float b = ToneCurve<op>(pixel.z, scale);
+            destination[i] = encodeSrgb
+                ? ToSrgb8(r) | ToSrgb8(g) << 8 | ToSrgb8(b) << 16 | 0xFF000000
+                : ToUnorm8(r) | ToUnorm8(g) << 8 | ToUnorm8(b) << 16 | 0xFF000000;
+        }
+    }
+
+    // A register holds two whole pixels, so the channels go through the curve interleaved and
+    // alpha is overwritten after packing.
+    template <Tonemapper::Operator op>
+    inline __m256 ToneCurveAvx2(__m256 value, __m256 scale)
+    {
+        value = _mm256_mul_ps(value, scale);
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(c_maxInput));
+        switch (op)
+        {
+        case Tonemapper::OperatorReinhard:
+            return _mm256_div_ps(value, _mm256_add_ps(_mm256_set1_ps(1.0f), value));
+        case Tonemapper::OperatorAces:
+        {
+            __m256 numerator = _mm256_mul_ps(value, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c_acesA), value), _mm256_set1_ps(c_acesB)));
+            __m256 denominator = _mm256_add_ps(_mm256_mul_ps(value, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(c_acesC), value), _mm256_set1_ps(c_acesD))), _mm256_set1_ps(c_acesE));
+            return _mm256_div_ps(numerator, denominator);
+        }
+        default:
+            return value;
+        }
+    }
+
+    inline __m256i ToUnorm8Avx2(__m256 value)
+    {
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+    }
+
+    inline __m256i ToSrgb8Avx2(__m256 value)
+    {
+        value = _mm256_max_ps(value, _mm256_castsi256_ps(_mm256_set1_epi32(c_srgbMinBits)));
+        value = _mm256_min_ps(value, _mm256_castsi256_ps(_mm256_set1_epi32(c_srgbAlmostOneBits)));
+        __m256i bits = _mm256_castps_si256(value);
+        __m256i index = _mm256_srli_epi32(_mm256_sub_epi32(bits, _mm256_set1_epi32(c_srgbMinBits)), 20);
+        __m256i entry = _mm256_i32gather_epi32(reinterpret_cast<const int*>(c_srgbTable), index, 4);
+        __m256i bias = _mm256_slli_epi32(_mm256_srli_epi32(entry, 16), 9);
+        __m256i slope = _mm256_and_si256(entry, _mm256_set1_epi32(0xFFFF));
+        __m256i t = _mm256_and_si256(_mm256_srli_epi32(bits, 12), _mm256_set1_epi32(0xFF));
+        return _mm256_srli_epi32(_mm256_add_epi32(bias, _mm256_mullo_epi32(slope, t)), 16);
+    }
+
+    template <Tonemapper::Operator op, bool encodeSrgb>
+    inline __m256i ResolveTwoPixels(const XMFLOAT4* source, __m256 scale)
+    {
+        __m256 value = ToneCurveAvx2<op>(_mm256_loadu_ps(&source->x), scale);
+        return encodeSrgb ? ToSrgb8Avx2(value) : ToUnorm8Avx2(value);
+    }
+
+    // Converts the pixels up to the first 32 byte aligned destination with the scalar kernel,
+    // then 8 at a time, then the rest.
+    template <Tonemapper::Operator op, bool encodeSrgb>
+    void ResolveAvx2(const XMFLOAT4* source, UINT32* destination, size_t pixelCount, float scale)
+    {
+        size_t head = min<size_t>((32 - (reinterpret_cast<uintptr_t>(destination) & 31)) / sizeof(UINT32) & 7, pixelCount);
+        ResolveScalar<op, encodeSrgb>(source, destination, head, scale);
+
+        const __m256 scaleVector = _mm256_set1_ps(scale);
+        const __m256i opaque = _mm256_set1_epi32(0xFF000000);
+        // The packs work within 128-bit lanes and leave the pixels as 0, 2, 4, 6, 1, 3, 5, 7.
+        const __m256i pixelOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        size_t i = head;
+        for (; i + 8 <= pixelCount; i += 8)
+        {
+            __m256i p01 = ResolveTwoPixels<op, encodeSrgb>(source + i + 0, scaleVector);
+            __m256i p23 = ResolveTwoPixels<op, encodeSrgb>(source + i + 2, scaleVector);
+            __m256i p45 = ResolveTwoPixels<op, encodeSrgb>(source + i + 4, scaleVector);
+            __m256i p67 = ResolveTwoPixels<op, encodeSrgb>(source + i + 6, scaleVector);
+            __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23), _mm256_packus_epi32(p45, p67));
+            packed = _mm256_or_si256(_mm256_permutevar8x32_epi32(packed, pixelOrder), opaque);
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i), packed);
+        }
+        // Streaming stores aren't ordered with other stores, the caller may hand the pixels on.
+        _mm_sfence();
+
+        ResolveScalar<op, encodeSrgb>(source + i, destination + i, pixelCount - i, scale);
+    }
+
+    const Kernel c_kernels[Tonemapper::PathCount][Tonemapper::OperatorCount][2] =
+    {
+        {
+            { ResolveScalar<Tonemapper::OperatorNone, false>, ResolveScalar<Tonemapper::OperatorNone, true> },
+            { ResolveScalar<Tonemapper::OperatorReinhard, false>, ResolveScalar<Tonemapper::OperatorReinhard, true> },
+            { ResolveScalar<Tonemapper::OperatorAces, false>, ResolveScalar<Tonemapper::OperatorAces, true> },
+        },
+        {
+            { ResolveAvx2<Tonemapper::OperatorNone, false>, ResolveAvx2<Tonemapper::OperatorNone, true> },
+            { ResolveAvx2<Tonemapper::OperatorReinhard, false>, ResolveAvx2<Tonemapper::OperatorReinhard, true> },
+            { ResolveAvx2<Tonemapper::OperatorAces, false>, ResolveAvx2<Tonemapper::OperatorAces, true> },
+        },
+    };
+
+    // AVX2 needs the OS to save the upper halves of the registers too.
+    bool DetectAvx2()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(info, 1);
+        const int osxsave = 1 << 27;
+        const int avx = 1 << 28;
+        if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+}
+
+Tonemapper::Tonemapper(Operator op, float exposure, bool encodeSrgb) :
+    m_operator(op),
+    m_exposure(exposure),
+    m_scale(exp2(exposure) * (op == OperatorAces ? c_acesInputScale : 1.0f)),
+    m_encodeSrgb(encodeSrgb)
+{
+    ThrowIfFalse(op < OperatorCount, L"Tonemapper: unknown operator.\n");
+}
+
+void Tonemapper::Resolve(const XMFLOAT4* source, UINT32* destination, size_t pixelCount) const
+{
+    Resolve(GetFastestPath(), source, destination, pixelCount);
+}
+
+void Tonemapper::Resolve(Path path, const XMFLOAT4* source, UINT32* destination, size_t pixelCount) const
+{
+    ThrowIfFalse(IsSupported(path), L"Tonemapper: the CPU doesn't support this path.\n");
+    c_kernels[path][m_operator][m_encodeSrgb](source, destination, pixelCount, m_scale);
+}
+
+void Tonemapper::Resolve(const CpuFramebuffer& source, UINT32* destination, JobSystem* jobs) const
+{
+    TRACE_SCOPE("Tonemapper::Resolve");
+    const UINT width = source.GetWidth();
+    const UINT height = source.GetHeight();
+    const Path path = GetFastestPath();
+    // Rows have no padding, so a band is one contiguous range.
+    auto job = [&](UINT index, UINT)
+    {
+        TRACE_SCOPE("Tonemapper::ResolveRows");
+        UINT firstRow = index * c_rowsPerJob;
+        UINT rowCount = min<UINT>(height - firstRow, c_rowsPerJob);
+        Resolve(path, source.GetRow(firstRow), destination + static_cast<size_t>(firstRow) * width, static_cast<size_t>(rowCount) * width);
+    };
+    UINT jobCount = (height + c_rowsPerJob - 1) / c_rowsPerJob;
+    if (jobs)
+    {
+        jobs->ParallelFor(jobCount, job);
+    }
+    else
+    {
+        for (UINT i = 0; i < jobCount; i++)
+        {
+            job(i, 0);
+        }
+    }
+}
+
+bool Tonemapper::IsSupported(Path path)
+{
+    static const bool avx2 = DetectAvx2();
+    return path == PathScalar || (path == PathAvx2 && avx2);
+}
+
+Tonemapper::Path Tonemapper::GetFastestPath()
+{
+    return IsSupported(PathAvx2) ? PathAvx2 : PathScalar;
+}
+
+bool Tonemapper::ParseOperator(const wstring& name, Operator* op)
+{
+    for (UINT i = 0; i < OperatorCount; i++)
+    {
+        if (_wcsicmp(name.c_str(), c_operatorNames[i]) == 0)
+        {
+            *op = static_cast<Operator>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+LPCWSTR Tonemapper::GetOperatorName(Operator op)
+{
+    return c_operatorNames[op];
+}
@@ -0,0 +1,77 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// Tonemapper.h - Exposure, tone curve and 8-bit encoding of HDR float color
+//
+
+#pragma once
+
+#include "CpuFramebuffer.h"
+#include "JobSystem.h"
+
+namespace DX
+{
+    // Resolves linear HDR color to DXGI_FORMAT_R8G8B8A8_UNORM with opaque alpha: scale by the
+    // exposure, apply the tone curve, clamp to [0, 1] and quantize, optionally sRGB encoded.
+    // NaN and negative values become black. The default reproduces what the sample's shaders do,
+    // writing linear color straight to the UNORM target, so only CpuFramebuffer's rounding applies.
+    //
+    // sRGB encoding looks up a line per exponent and top 3 mantissa bits and evaluates it in
+    // fixed point, off by at most one step from the exact curve and never more than 0.545 away.
+    // The AVX2 path converts 8 pixels at a time, gathers the lines and writes the destination
+    // with non temporal stores, since a frame is written once and read much later by someone
+    // else. It produces the same bytes as the scalar path.
+    class Tonemapper
+    {
+    public:
+        enum Operator
+        {
+            OperatorNone,       // Clamp only.
+            OperatorReinhard,   // x / (1 + x) per channel.
+            OperatorAces,       // Narkowicz's fit of the ACES reference and output transforms.
+            OperatorCount
+        };
+
+        enum Path
+        {
+            PathScalar,
+            PathAvx2,
+            PathCount
+        };
+
+        // exposure is in stops, the color is scaled by 2^exposure.
+        Tonemapper(Operator op = OperatorNone, float exposure = 0.0f, bool encodeSrgb = false);
+
+        // Any range of pixels, e.g. one band per job. Uses the fastest path the CPU supports.
+        void Resolve(const DirectX::XMFLOAT4* source, UINT32* destination, size_t pixelCount) const;
+        void Resolve(Path path, const DirectX::XMFLOAT4* source, UINT32* destination, size_t pixelCount) const;
+        // Bands of rows, spread over jobs when given.
+        void Resolve(const CpuFramebuffer& source, UINT32* destination, JobSystem* jobs = nullptr) const;
+
+        static bool IsSupported(Path path);
+        static Path GetFastestPath();
+
+        static bool ParseOperator(const std::wstring& name, Operator* op);
+        static LPCWSTR GetOperatorName(Operator op);
+
+        // Accessors.
+        Operator    GetOperator() const { return m_operator; }
+        float       GetExposure() const { return m_exposure; }
+        bool        IsEncodingSrgb() const { return m_encodeSrgb; }
+
+    private:
+        Operator    m_operator;
+        float       m_exposure;
+        float       m_scale;        // 2^exposure, with the operator's own input scale folded in.
+        bool        m_encodeSrgb;
+    };
+}
@@ -0,0 +1,138 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "TraceRecorder.h"
+#include <fstream>
+
+using namespace DX;
+using namespace std;
+
+atomic<bool> TraceRecorder::s_enabled(false);
+UINT64 TraceRecorder::s_calibrationTimestamp = 0;
+TraceRecorder::Clock::time_point TraceRecorder::s_calibrationTime;
+thread_local TraceRecorder::ThreadBuffer* TraceRecorder::t_buffer = nullptr;
+mutex TraceRecorder::s_mutex;
+vector<unique_ptr<TraceRecorder::ThreadBuffer>> TraceRecorder::s_threads;
+
+namespace
+{
+    // JSON string contents, names are plain identifiers in practice.
+    void WriteEscaped(ostream& stream, const char* text)
+    {
+        for (; *text; text++)
+        {
+            if (*text == '"' || *text == '\\')
+            {
+                stream << '\\';
+            }
+            stream << *text;
+        }
+    }
+}
+
+void TraceRecorder::Enable(bool enable)
+{
+    {
+        lock_guard<mutex> lock(s_mutex);
+        if (enable && s_calibrationTimestamp == 0)
+        {
+            s_calibrationTime = Clock::now();
+            s_calibrationTimestamp = ReadTimestamp();
+        }
+    }
+    s_enabled.store(enable, memory_order_relaxed);
+}
+
+TraceRecorder::ThreadBuffer* TraceRecorder::RegisterThread()
+{
+    lock_guard<mutex> lock(s_mutex);
+    s_threads.emplace_back(new ThreadBuffer(static_cast<UINT>(s_threads.size()) + 1));
+    t_buffer = s_threads.back().get();
+    return t_buffer;
+}
+
+void TraceRecorder::SetThreadName(const char* name)
+{
+    ThreadBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+    lock_guard<mutex> lock(s_mutex);
+    buffer->name = name;
+}
+
+void TraceRecorder::WriteChromeTrace(ostream& stream)
+{
+    lock_guard<mutex> lock(s_mutex);
+
+    // Timestamps advance at a fixed rate, measured against the clock since the recorder was enabled.
+#ifdef TRACE_USE_TSC
+    double elapsedMicroseconds = chrono::duration<double, micro>(Clock::now() - s_calibrationTime).count();
+    UINT64 elapsedTimestamps = ReadTimestamp() - s_calibrationTimestamp;
+    const double microsecondsPerTick = elapsedTimestamps ? elapsedMicroseconds / elapsedTimestamps : 0.0;
+#else
+    const double microsecondsPerTick = 1e6 * Clock::period::num / Clock::period::den;
+#endif
+    UINT64 origin = (numeric_limits<UINT64>::max)();
+    for (auto& thread : s_threads)
+    {
+        UINT64 end = thread->writeIndex.load(memory_order_acquire);
+        UINT64 begin = end > c_eventsPerThread ? end - c_eventsPerThread : 0;
+        if (begin < end)
+        {
+            origin = min(origin, thread->events[begin & (c_eventsPerThread - 1)].timestamp);
+        }
+    }
+
+    stream << "{\"traceEvents\":[" << fixed << setprecision(3);
+    bool first = true;
+    for (auto& thread : s_threads)
+    {
+        if (thread->name)
+        {
+            stream << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->threadId << ",\"args\":{\"name\":\"";
+            WriteEscaped(stream, thread->name);
+            stream << "\"}}";
+            first = false;
+        }
+
+        // After a wrap the ring can start with ends whose begins were overwritten, skip those.
+        UINT64 end = thread->writeIndex.load(memory_order_acquire);
+        UINT64 begin = end > c_eventsPerThread ? end - c_eventsPerThread : 0;
+        UINT depth = 0;
+        for (UINT64 index = begin; index < end; index++)
+        {
+            const Event& event = thread->events[index & (c_eventsPerThread - 1)];
+            if (!event.name && depth == 0)
+            {
+                continue;
+            }
+            depth = event.name ? depth + 1 : depth - 1;
+
+            stream << (first ? "" : ",") << "\n{\"ph\":\"" << (event.name ? 'B' : 'E') << "\",\"pid\":1,\"tid\":" << thread->threadId
+                << ",\"ts\":" << (event.timestamp - origin) * microsecondsPerTick;
+            if (event.name)
+            {
+                stream << ",\"name\":\"";
+                WriteEscaped(stream, event.name);
+                stream << '"';
+            }
+            stream << '}';
+            first = false;
+        }
+    }
+    stream << "\n]}\n";
+}
+
+void TraceRecorder::Export(const wstring& path)
+{
+    ofstream file(path);
+    ThrowIfFalse(file.is_open(), L"TraceRecorder: couldn't open the trace file.\n");
+    WriteChromeTrace(file);
+}
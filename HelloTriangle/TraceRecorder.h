@@ -0,0 +1,149 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// TraceRecorder.h - Scoped CPU events written out in the Chrome trace format
+//
+
+#pragma once
+
+#include <chrono>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define TRACE_USE_TSC
+#endif
+
+#ifdef USE_PIX
+#include <pix3.h>
+#endif
+
+namespace DX
+{
+    // Begin and end timestamps go into a ring buffer owned by the recording thread, so recording
+    // takes no lock and touches no shared cache line: a thread-local lookup, a timestamp read and
+    // two stores. On x64 the timestamp is the TSC, several times cheaper to read than the OS clock,
+    // and converted to time when the trace is written. A thread's buffer is registered on its first
+    // event and kept for the process, the oldest events are overwritten once it wraps. Names are
+    // stored as pointers and must outlive the recorder, string literals are what the TRACE_
+    // macros expect.
+    class TraceRecorder
+    {
+    public:
+        static const UINT c_eventsPerThread = 1 << 16;
+
+        static void Enable(bool enable);
+        static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // Shown for the calling thread in the trace viewer.
+        static void SetThreadName(const char* name);
+
+        static void BeginEvent(const char* name) { if (IsEnabled()) Record(name); }
+        static void EndEvent() { if (IsEnabled()) Record(nullptr); }
+
+        // Writes every thread's events as Chrome trace JSON, for chrome://tracing or Perfetto.
+        // Must not run while other threads record, e.g. call it at exit.
+        static void WriteChromeTrace(std::ostream& stream);
+        static void Export(const std::wstring& path);
+
+        // The clock events are stamped with, two reads are most of what a scope costs.
+        static UINT64 ReadTimestamp()
+        {
+#ifdef TRACE_USE_TSC
+            return __rdtsc();
+#else
+            return static_cast<UINT64>(Clock::now().time_since_epoch().count());
+#endif
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // A null name ends the innermost open event.
+        struct Event
+        {
+            UINT64          timestamp;
+            const char*     name;
+        };
+
+        struct ThreadBuffer
+        {
+            ThreadBuffer(UINT id) : events(new Event[c_eventsPerThread]), writeIndex(0), threadId(id), name(nullptr) {}
+
+            std::unique_ptr<Event[]>    events;
+            std::atomic<UINT64>         writeIndex;
+            UINT                        threadId;
+            const char*                 name;
+        };
+
+        static void Record(const char* name)
+        {
+            ThreadBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+            UINT64 index = buffer->writeIndex.load(std::memory_order_relaxed);
+            Event& event = buffer->events[index & (c_eventsPerThread - 1)];
+            event.timestamp = ReadTimestamp();
+            event.name = name;
+            buffer->writeIndex.store(index + 1, std::memory_order_release);
+        }
+
+        static ThreadBuffer* RegisterThread();
+
+        static std::atomic<bool>                            s_enabled;
+        static UINT64                                       s_calibrationTimestamp;     // Taken with s_calibrationTime
+        static Clock::time_point                            s_calibrationTime;          // when first enabled.
+        static thread_local ThreadBuffer*                   t_buffer;
+        static std::mutex                                   s_mutex;
+        static std::vector<std::unique_ptr<ThreadBuffer>>   s_threads;
+    };
+
+    // Takes the same arguments as PIXBeginEvent() without format arguments: an optional color,
+    // which only PIX uses, and the name. Built with USE_PIX the scope becomes a PIX event too.
+    class ScopedTraceEvent
+    {
+    public:
+        explicit ScopedTraceEvent(const char* name)
+        {
+            TraceRecorder::BeginEvent(name);
+#ifdef USE_PIX
+            PIXBeginEvent(PIX_COLOR_DEFAULT, name);
+#endif
+        }
+        ScopedTraceEvent(UINT64 color, const char* name)
+        {
+            UNREFERENCED_PARAMETER(color);
+            TraceRecorder::BeginEvent(name);
+#ifdef USE_PIX
+            PIXBeginEvent(color, name);
+#endif
+        }
+        ~ScopedTraceEvent()
+        {
+#ifdef USE_PIX
+            PIXEndEvent();
+#endif
+            TraceRecorder::EndEvent();
+        }
+
+    private:
+        ScopedTraceEvent(const ScopedTraceEvent&) = delete;
+        ScopedTraceEvent& operator=(const ScopedTraceEvent&) = delete;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// TRACE_SCOPE("name") or TRACE_SCOPE(color, "name"), the event lasts until the end of the scope.
+#define TRACE_SCOPE(...) DX::ScopedTraceEvent TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,108 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#ifndef UPSCALE_HLSL
+#define UPSCALE_HLSL
+
+#define HLSL
+#include "RaytracingHlslCompat.h"
+
+Texture2D<float4> Source : register(t0); // SRV0, the raytracing output, only its top left is rendered
+RWTexture2D<float4> Output : register(u0); // UAV0
+ConstantBuffer<UpscaleConstantBuffer> g_upscaleCB : register(b0); // CBV0, root constants
+
+float Luminance(float3 color)
+{
+	return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+float4 Fetch(int2 position)
+{
+	int2 last = int2(g_upscaleCB.sourceWidth, g_upscaleCB.sourceHeight) - 1;
+	return Source.Load(int3(clamp(position, int2(0, 0), last), 0));
+}
+
+// Polynomial fit of the Lanczos 2 kernel, as in FSR's EASU, of the squared distance. Zero past 2.
+float Lanczos2(float distanceSquared)
+{
+	float x2 = min(distanceSquared, 4.0);
+	float a = 0.4 * x2 - 1.0;
+	float b = 0.25 * x2 - 1.0;
+	return (25.0 / 16.0 * a * a - (25.0 / 16.0 - 1.0)) * b * b;
+}
+
+// Edge directed upscale from a 4x4 neighbourhood. The luminance gradient at the sample position
+// gives the edge direction; the kernel is rotated to it and stretched along the edge as the
+// gradient gets stronger, so edges are interpolated along their length rather than across,
+// staying sharp without stair steps. Flat areas get plain Lanczos 2. The result is clamped to the
+// nearest 2x2 pixels, which removes the ringing of the negative lobes.
+[numthreads(8, 8, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+	uint2 pixel = dispatchThreadId.xy;
+	if (pixel.x >= g_upscaleCB.outputWidth || pixel.y >= g_upscaleCB.outputHeight)
+	{
+		return;
+	}
+
+	float2 scale = float2(g_upscaleCB.sourceWidth, g_upscaleCB.sourceHeight) / float2(g_upscaleCB.outputWidth, g_upscaleCB.outputHeight);
+	float2 position = (pixel + 0.5) * scale - 0.5;
+	int2 base = int2(floor(position)) - 1;
+	float2 fraction = position - floor(position);
+
+	float4 taps[4][4];
+	float luminance[4][4];
+	[unroll] for (int y = 0; y < 4; y++)
+	{
+		[unroll] for (int x = 0; x < 4; x++)
+		{
+			taps[y][x] = Fetch(base + int2(x, y));
+			luminance[y][x] = Luminance(taps[y][x].rgb);
+		}
+	}
+
+	// Central differences at the 2x2 nearest pixels, bilinearly weighted.
+	float2 gradient = 0;
+	[unroll] for (int j = 1; j <= 2; j++)
+	{
+		[unroll] for (int i = 1; i <= 2; i++)
+		{
+			float weight = (i == 1 ? 1.0 - fraction.x : fraction.x) * (j == 1 ? 1.0 - fraction.y : fraction.y);
+			gradient += weight * float2(luminance[j][i + 1] - luminance[j][i - 1], luminance[j + 1][i] - luminance[j - 1][i]);
+		}
+	}
+	float edge = length(gradient);
+	float2 across = edge > 1e-5 ? gradient / edge : float2(1.0, 0.0);
+	float2 along = float2(-across.y, across.x);
+	// A luminance step of a quarter across two pixels is a full strength edge, the kernel is then
+	// twice as long along it.
+	float stretch = 1.0 / (1.0 + saturate(4.0 * edge));
+
+	float4 sum = 0;
+	float weightSum = 0;
+	[unroll] for (int v = 0; v < 4; v++)
+	{
+		[unroll] for (int u = 0; u < 4; u++)
+		{
+			float2 offset = float2(u - 1, v - 1) - fraction;
+			float2 rotated = float2(dot(offset, across), dot(offset, along) * stretch);
+			float weight = Lanczos2(dot(rotated, rotated));
+			sum += weight * taps[v][u];
+			weightSum += weight;
+		}
+	}
+
+	float4 nearestMin = min(min(taps[1][1], taps[1][2]), min(taps[2][1], taps[2][2]));
+	float4 nearestMax = max(max(taps[1][1], taps[1][2]), max(taps[2][1], taps[2][2]));
+	Output[pixel] = clamp(sum / weightSum, nearestMin, nearestMax);
+}
+
+#endif // UPSCALE_HLSL
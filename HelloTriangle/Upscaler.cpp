@@ -0,0 +1,114 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Upscaler.h"
+#include "RaytracingHlslCompat.h"
+#include "CompiledShaders\Upscale.hlsl.h"
+
+using namespace DX;
+using namespace std;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    enum RootParameter
+    {
+        RootParameterViews = 0,     // t0 source, u0 output
+        RootParameterConstants,     // b0
+        RootParameterCount
+    };
+
+    const UINT c_groupSize = 8;
+}
+
+Upscaler::Upscaler()
+{
+}
+
+void Upscaler::Create(ID3D12Device* device)
+{
+    CD3DX12_DESCRIPTOR_RANGE ranges[2];
+    ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+    ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+    CD3DX12_ROOT_PARAMETER rootParameters[RootParameterCount];
+    rootParameters[RootParameterViews].InitAsDescriptorTable(ARRAYSIZE(ranges), ranges);
+    rootParameters[RootParameterConstants].InitAsConstants(sizeof(UpscaleConstantBuffer) / sizeof(UINT32), 0);
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(ARRAYSIZE(rootParameters), rootParameters);
+
+    ComPtr<ID3DBlob> blob;
+    ComPtr<ID3DBlob> error;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &blob, &error),
+        error ? static_cast<wchar_t*>(error->GetBufferPointer()) : nullptr);
+    ThrowIfFailed(device->CreateRootSignature(1, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+    m_rootSignature->SetName(L"Upscaler");
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc = {};
+    pipelineDesc.pRootSignature = m_rootSignature.Get();
+    pipelineDesc.CS = CD3DX12_SHADER_BYTECODE((void*)g_pUpscale, ARRAYSIZE(g_pUpscale));
+    ThrowIfFailed(device->CreateComputePipelineState(&pipelineDesc, IID_PPV_ARGS(&m_pipelineState)), L"Couldn't create the upscaling pipeline state.\n");
+    m_pipelineState->SetName(L"Upscaler");
+}
+
+void Upscaler::Release()
+{
+    ReleaseOutput();
+    m_rootSignature.Reset();
+    m_pipelineState.Reset();
+    // The descriptors went with the heap.
+    m_descriptors = DescriptorRange();
+}
+
+void Upscaler::CreateOutput(ID3D12Device* device, DescriptorHeapAllocator* descriptorHeap, ID3D12Resource* source)
+{
+    D3D12_RESOURCE_DESC sourceDesc = source->GetDesc();
+    auto outputDesc = CD3DX12_RESOURCE_DESC::Tex2D(sourceDesc.Format, sourceDesc.Width, sourceDesc.Height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    auto defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &defaultHeapProperties, D3D12_HEAP_FLAG_NONE, &outputDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_output)));
+    m_output->SetName(L"UpscaledOutput");
+
+    if (!m_descriptors.IsValid())
+    {
+        m_descriptors = descriptorHeap->AllocatePersistent(2);
+    }
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = sourceDesc.Format;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Texture2D.MipLevels = 1;
+    device->CreateShaderResourceView(source, &srvDesc, m_descriptors.GetCpuHandle(0));
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+    uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+    device->CreateUnorderedAccessView(m_output.Get(), nullptr, &uavDesc, m_descriptors.GetCpuHandle(1));
+}
+
+void Upscaler::ReleaseOutput()
+{
+    m_output.Reset();
+}
+
+void Upscaler::Dispatch(ID3D12GraphicsCommandList* commandList, UINT sourceWidth, UINT sourceHeight)
+{
+    D3D12_RESOURCE_DESC outputDesc = m_output->GetDesc();
+    UpscaleConstantBuffer constants;
+    constants.sourceWidth = sourceWidth;
+    constants.sourceHeight = sourceHeight;
+    constants.outputWidth = static_cast<UINT>(outputDesc.Width);
+    constants.outputHeight = outputDesc.Height;
+
+    commandList->SetComputeRootSignature(m_rootSignature.Get());
+    commandList->SetPipelineState(m_pipelineState.Get());
+    commandList->SetComputeRootDescriptorTable(RootParameterViews, m_descriptors.GetGpuHandle());
+    commandList->SetComputeRoot32BitConstants(RootParameterConstants, sizeof(constants) / sizeof(UINT32), &constants, 0);
+    commandList->Dispatch((constants.outputWidth + c_groupSize - 1) / c_groupSize, (constants.outputHeight + c_groupSize - 1) / c_groupSize, 1);
+}
@@ -0,0 +1,54 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// Upscaler.h - Edge directed spatial upscaling of a render target's top left corner
+//
+
+#pragma once
+
+#include "DescriptorHeapAllocator.h"
+
+namespace DX
+{
+    // Runs Upscale.hlsl, one thread per output pixel in 8x8 groups. The source is rendered at
+    // the output size and traced into a smaller top left region when the resolution drops, so
+    // neither texture is recreated as it changes. The output is a UAV texture of the same size
+    // and format, to be copied to the back buffer.
+    class Upscaler
+    {
+    public:
+        Upscaler();
+
+        // Root signature and pipeline state, once per device.
+        void Create(ID3D12Device* device);
+        void Release();
+
+        // The output and the descriptor table of source and output. The descriptors are allocated
+        // once and rewritten when the size changes.
+        void CreateOutput(ID3D12Device* device, DescriptorHeapAllocator* descriptorHeap, ID3D12Resource* source);
+        void ReleaseOutput();
+
+        // The descriptor heap must be set. The source's top left sourceWidth x sourceHeight are
+        // read in D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, the output is written in
+        // D3D12_RESOURCE_STATE_UNORDERED_ACCESS.
+        void Dispatch(ID3D12GraphicsCommandList* commandList, UINT sourceWidth, UINT sourceHeight);
+
+        // Accessors.
+        ID3D12Resource*     GetOutput() const { return m_output.Get(); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12RootSignature>     m_rootSignature;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState>     m_pipelineState;
+        Microsoft::WRL::ComPtr<ID3D12Resource>          m_output;
+        DescriptorRange                                 m_descriptors;      // Source SRV, output UAV.
+    };
+}
@@ -28,6 +28,33 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 		pSample->ParseCommandLineArgs(argv, argc);
 		LocalFree(argv);
 
+		if (pSample->IsHeadless())
+		{
+			// No window and no message loop, frames are rendered back to back.
+			LARGE_INTEGER frequency, start, initialized, end;
+			QueryPerformanceFrequency(&frequency);
+			QueryPerformanceCounter(&start);
+			pSample->OnInit();
+			QueryPerformanceCounter(&initialized);
+
+			UINT frameCount = pSample->GetHeadlessFrameCount();
+			for (UINT frame = 0; frame < frameCount; frame++)
+			{
+				pSample->OnUpdate();
+				pSample->OnRender();
+			}
+			QueryPerformanceCounter(&end);
+
+			pSample->OnDestroy();
+
+			double initMs = 1000.0 * (initialized.QuadPart - start.QuadPart) / frequency.QuadPart;
+			double frameMs = 1000.0 * (end.QuadPart - initialized.QuadPart) / frequency.QuadPart / max(frameCount, 1u);
+			wchar_t buff[128] = {};
+			swprintf_s(buff, L"Headless: init %.2f ms, %u frames, %.3f ms/frame CPU\n", initMs, frameCount, frameMs);
+			OutputDebugStringW(buff);
+			return EXIT_SUCCESS;
+		}
+
 		// Initialize the window class.
 		WNDCLASSEX windowClass = { 0 };
 		windowClass.cbSize = sizeof(WNDCLASSEX);
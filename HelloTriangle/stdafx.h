@@ -23,6 +23,7 @@
 
 // C RunTime Header Files
 #include <stdlib.h>
+#include <float.h>
 #include <sstream>
 #include <iomanip>
 
@@ -33,6 +34,11 @@
 #include <memory>
 #include <unordered_map>
 #include <vector>
+#include <map>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include <atlbase.h>
 #include <assert.h>
 
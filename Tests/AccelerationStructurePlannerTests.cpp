@@ -0,0 +1,208 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "AccelerationStructurePlanner.h"
+#include "CpuBvh.h"
+
+using namespace DX;
+using namespace DirectX;
+using namespace std;
+
+namespace
+{
+    const UINT64 c_alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+
+    inline UINT64 Align(UINT64 size)
+    {
+        return (size + c_alignment - 1) & ~(c_alignment - 1);
+    }
+
+    // Sizes the build from the CpuBvh worst case, as the recording device does for the driver.
+    UINT AddBuild(AccelerationStructurePlanner* planner, UINT primitiveCount)
+    {
+        CpuBvhPrebuildInfo info = CpuBvh::GetPrebuildInfo(primitiveCount);
+        return planner->AddBuild(info.resultDataMaxSize, info.scratchDataSize);
+    }
+
+    // A size x size grid of quads in the xz plane, two triangles each.
+    void BuildGrid(CpuBvh* bvh, UINT size)
+    {
+        vector<XMFLOAT3> vertices;
+        for (UINT z = 0; z <= size; z++)
+        {
+            for (UINT x = 0; x <= size; x++)
+            {
+                vertices.push_back(XMFLOAT3(static_cast<float>(x), 0.0f, static_cast<float>(z)));
+            }
+        }
+
+        vector<UINT32> indices;
+        for (UINT z = 0; z < size; z++)
+        {
+            for (UINT x = 0; x < size; x++)
+            {
+                UINT32 corner = z * (size + 1) + x;
+                UINT32 quad[] = { corner, corner + 1, corner + size + 1, corner + 1, corner + size + 2, corner + size + 1 };
+                indices.insert(indices.end(), quad, quad + ARRAYSIZE(quad));
+            }
+        }
+        bvh->BuildTriangles(vertices.data(), sizeof(XMFLOAT3), indices.data(), 2 * size * size);
+    }
+}
+
+TEST(AccelerationStructurePlanner, SplitsBatchesAtTheScratchBudget)
+{
+    const UINT primitiveCounts[] = { 1000, 2000, 500, 3000, 100 };
+    UINT64 scratchSizes[ARRAYSIZE(primitiveCounts)];
+    AccelerationStructurePlanner planner;
+    for (UINT i = 0; i < ARRAYSIZE(primitiveCounts); i++)
+    {
+        AddBuild(&planner, primitiveCounts[i]);
+        scratchSizes[i] = Align(CpuBvh::GetPrebuildInfo(primitiveCounts[i]).scratchDataSize);
+    }
+
+    // The first three fit exactly, the fourth starts a new batch that the fifth joins.
+    UINT64 budget = scratchSizes[0] + scratchSizes[1] + scratchSizes[2];
+    planner.PlanBuilds(budget);
+    CHECK(planner.GetBatchCount() == 2);
+    CHECK(planner.GetBatch(0).firstBuild == 0 && planner.GetBatch(0).buildCount == 3);
+    CHECK(planner.GetBatch(1).firstBuild == 3 && planner.GetBatch(1).buildCount == 2);
+    CHECK(planner.GetBatch(0).scratchSize == budget);
+    CHECK(planner.GetBatch(1).scratchSize == scratchSizes[3] + scratchSizes[4]);
+
+    // Batches alias the same scratch memory, each one starts at offset 0.
+    CHECK(planner.GetBuild(2).batch == 0 && planner.GetBuild(2).scratchOffset == scratchSizes[0] + scratchSizes[1]);
+    CHECK(planner.GetBuild(3).batch == 1 && planner.GetBuild(3).scratchOffset == 0);
+    CHECK(planner.GetBuild(4).scratchOffset == scratchSizes[3]);
+    CHECK(planner.GetStatistics().scratchPoolSize == max(budget, scratchSizes[3] + scratchSizes[4]));
+
+    // One byte less and the third build moves to the second batch.
+    planner.PlanBuilds(budget - 1);
+    CHECK(planner.GetBatch(0).buildCount == 2);
+    CHECK(planner.GetBuild(2).batch == 1 && planner.GetBuild(2).scratchOffset == 0);
+}
+
+TEST(AccelerationStructurePlanner, OversizedBuildGetsItsOwnBatch)
+{
+    AccelerationStructurePlanner planner;
+    AddBuild(&planner, 100);
+    AddBuild(&planner, 100000);
+    AddBuild(&planner, 100);
+
+    UINT64 largeScratch = Align(CpuBvh::GetPrebuildInfo(100000).scratchDataSize);
+    UINT64 budget = largeScratch / 2;
+    planner.PlanBuilds(budget);
+    CHECK(planner.GetBatchCount() == 3);
+    CHECK(planner.GetBatch(1).firstBuild == 1 && planner.GetBatch(1).buildCount == 1);
+    CHECK(planner.GetBatch(1).scratchSize == largeScratch);
+
+    // The pool has to hold the oversized build even though it breaks the budget.
+    CHECK(planner.GetStatistics().scratchPoolSize == largeScratch);
+    CHECK(planner.GetStatistics().scratchPoolSize > budget);
+}
+
+TEST(AccelerationStructurePlanner, OffsetsAreAligned)
+{
+    // Primitive counts whose sizes are not multiples of 256 bytes.
+    const UINT primitiveCounts[] = { 1, 3, 7, 33, 129, 1001 };
+    AccelerationStructurePlanner planner;
+    vector<UINT64> compactedSizes;
+    for (UINT count : primitiveCounts)
+    {
+        AddBuild(&planner, count);
+        compactedSizes.push_back(CpuBvh::GetPrebuildInfo(count).resultDataMaxSize / 2 + 1);
+    }
+    planner.PlanBuilds(Align(CpuBvh::GetPrebuildInfo(1001).scratchDataSize));
+    planner.PlanCompaction(compactedSizes.data());
+
+    bool aligned = true;
+    bool disjoint = true;
+    for (UINT i = 0; i < planner.GetBuildCount(); i++)
+    {
+        const AccelerationStructurePlanner::Build& build = planner.GetBuild(i);
+        aligned = aligned && build.resultOffset % c_alignment == 0 && build.scratchOffset % c_alignment == 0 &&
+            build.compactedOffset % c_alignment == 0;
+        if (i > 0)
+        {
+            const AccelerationStructurePlanner::Build& previous = planner.GetBuild(i - 1);
+            disjoint = disjoint && previous.resultOffset + previous.resultDataMaxSize <= build.resultOffset &&
+                previous.compactedOffset + previous.compactedSize <= build.compactedOffset;
+        }
+    }
+    CHECK(aligned);
+    CHECK(disjoint);
+
+    AccelerationStructurePlanner::Statistics stats = planner.GetStatistics();
+    CHECK(stats.resultPoolSize % c_alignment == 0);
+    CHECK(stats.scratchPoolSize % c_alignment == 0);
+    CHECK(stats.compactedPoolSize % c_alignment == 0);
+}
+
+TEST(AccelerationStructurePlanner, CompactionShrinksTheSteadyState)
+{
+    // Real trees: a leaf holds up to four triangles, so the compacted size is well below the
+    // one primitive per leaf worst case.
+    const UINT gridSizes[] = { 4, 16, 40 };
+    AccelerationStructurePlanner planner;
+    vector<UINT64> compactedSizes;
+    for (UINT size : gridSizes)
+    {
+        CpuBvh bvh;
+        BuildGrid(&bvh, size);
+        AddBuild(&planner, 2 * size * size);
+        compactedSizes.push_back(bvh.GetCompactedSize());
+        CHECK(bvh.GetCompactedSize() < CpuBvh::GetPrebuildInfo(2 * size * size).resultDataMaxSize);
+    }
+    planner.PlanBuilds();
+
+    // Before compaction the results are all that is kept, the peak is results plus scratch.
+    AccelerationStructurePlanner::Statistics built = planner.GetStatistics();
+    CHECK(!planner.IsCompactionPlanned());
+    CHECK(built.compactedPoolSize == 0);
+    CHECK(built.steadyStateSize == built.resultPoolSize);
+    CHECK(built.peakSize == built.resultPoolSize + built.scratchPoolSize);
+
+    planner.PlanCompaction(compactedSizes.data());
+    AccelerationStructurePlanner::Statistics compacted = planner.GetStatistics();
+    UINT64 compactedPoolSize = 0;
+    for (UINT64 size : compactedSizes)
+    {
+        compactedPoolSize += Align(size);
+    }
+    CHECK(compacted.compactedPoolSize == compactedPoolSize);
+    CHECK(compacted.steadyStateSize == compactedPoolSize);
+    CHECK(compacted.steadyStateSize < built.steadyStateSize);
+
+    // The copies need the results and the compacted pool at once, scratch is gone by then.
+    CHECK(compacted.peakSize == max(built.resultPoolSize + built.scratchPoolSize, built.resultPoolSize + compactedPoolSize));
+    CHECK(compacted.peakSize >= built.peakSize);
+
+    // Adding a build invalidates the compaction plan.
+    AddBuild(&planner, 10);
+    CHECK(!planner.IsCompactionPlanned());
+    CHECK(planner.GetStatistics().compactedPoolSize == 0);
+}
+
+TEST(AccelerationStructurePlanner, BadSizesThrow)
+{
+    AccelerationStructurePlanner planner;
+    CHECK_THROWS(planner.AddBuild(0, 256));
+
+    UINT primitiveCount = 64;
+    AddBuild(&planner, primitiveCount);
+    planner.PlanBuilds();
+    UINT64 tooLarge = CpuBvh::GetPrebuildInfo(primitiveCount).resultDataMaxSize + 1;
+    CHECK_THROWS(planner.PlanCompaction(&tooLarge));
+    UINT64 zero = 0;
+    CHECK_THROWS(planner.PlanCompaction(&zero));
+}
@@ -0,0 +1,151 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "DescriptorHeapAllocator.h"
+
+using namespace DX;
+
+namespace
+{
+    // A mock heap: the allocator only ever offsets the base handles.
+    const SIZE_T c_cpuBase = 0x10000;
+    const UINT64 c_gpuBase = 0x800000;
+    const UINT c_descriptorSize = 32;
+
+    void Initialize(DescriptorHeapAllocator* allocator, UINT persistentCount, UINT transientCountPerFrame, UINT frameCount)
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE cpuBase = { c_cpuBase };
+        D3D12_GPU_DESCRIPTOR_HANDLE gpuBase = { c_gpuBase };
+        allocator->Initialize(cpuBase, gpuBase, c_descriptorSize, persistentCount, transientCountPerFrame, frameCount);
+    }
+}
+
+TEST(DescriptorHeapAllocator, HandlesOffsetTheMockHeap)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 16, 8, 2);
+    CHECK(allocator.GetNumDescriptors() == 32);
+
+    allocator.AllocatePersistent(3);
+    DescriptorRange range = allocator.AllocatePersistent();
+    CHECK(range.index == 3 && range.count == 1);
+    CHECK(range.cpuHandle.ptr == c_cpuBase + 3 * c_descriptorSize);
+    CHECK(range.gpuHandle.ptr == c_gpuBase + 3 * c_descriptorSize);
+}
+
+TEST(DescriptorHeapAllocator, FirstFit)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 16, 0, 1);
+    DescriptorRange a = allocator.AllocatePersistent(4);
+    DescriptorRange b = allocator.AllocatePersistent(4);
+    allocator.AllocatePersistent(4);
+    CHECK(a.index == 0 && b.index == 4);
+
+    // Free ranges are [0, 4) and [12, 16), the first one that fits wins.
+    allocator.FreePersistent(a);
+    CHECK(allocator.AllocatePersistent(2).index == 0);
+    CHECK(allocator.AllocatePersistent(3).index == 12);
+    CHECK(allocator.AllocatePersistent(2).index == 2);
+    CHECK(allocator.GetPersistentAllocatedCount() == 15);
+    CHECK(allocator.GetLargestFreePersistentRange() == 1);
+}
+
+TEST(DescriptorHeapAllocator, FreeCoalescesWithBothNeighbours)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 12, 0, 1);
+    DescriptorRange a = allocator.AllocatePersistent(4);
+    DescriptorRange b = allocator.AllocatePersistent(4);
+    DescriptorRange c = allocator.AllocatePersistent(4);
+    CHECK(allocator.GetLargestFreePersistentRange() == 0);
+
+    allocator.FreePersistent(a);
+    allocator.FreePersistent(c);
+    CHECK(allocator.GetLargestFreePersistentRange() == 4);
+
+    // b joins the ranges before and after it into one.
+    allocator.FreePersistent(b);
+    CHECK(allocator.GetPersistentAllocatedCount() == 0);
+    CHECK(allocator.GetLargestFreePersistentRange() == 12);
+    CHECK(allocator.AllocatePersistent(12).index == 0);
+}
+
+TEST(DescriptorHeapAllocator, FreeingAnInvalidRangeDoesNothing)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 4, 0, 1);
+    allocator.AllocatePersistent(2);
+    allocator.FreePersistent(DescriptorRange());
+    CHECK(allocator.GetPersistentAllocatedCount() == 2);
+}
+
+// The index buffer SRV and the vertex buffer SRV form one descriptor table.
+TEST(DescriptorHeapAllocator, TableRangesAreContiguous)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 8, 0, 1);
+    allocator.AllocatePersistent(1);
+    DescriptorRange table = allocator.AllocatePersistent(2);
+    CHECK(table.count == 2);
+    CHECK(table.GetCpuHandle(1).ptr == table.GetCpuHandle(0).ptr + c_descriptorSize);
+    CHECK(table.GetGpuHandle(1).ptr == table.GetGpuHandle(0).ptr + c_descriptorSize);
+    CHECK(allocator.GetRange(table.index + 1).cpuHandle.ptr == table.GetCpuHandle(1).ptr);
+}
+
+TEST(DescriptorHeapAllocator, TransientRingWrapsAroundTheFrames)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 4, 8, 2);
+
+    // Each frame's slice follows the persistent region.
+    allocator.BeginFrame(0);
+    CHECK(allocator.AllocateTransient(3).index == 4);
+    CHECK(allocator.AllocateTransient().index == 7);
+    CHECK(allocator.GetTransientAllocatedCount() == 4);
+
+    allocator.BeginFrame(1);
+    CHECK(allocator.GetTransientAllocatedCount() == 0);
+    CHECK(allocator.AllocateTransient(8).index == 12);
+
+    // Back at frame 0 its slice is recycled from the start.
+    allocator.BeginFrame(0);
+    CHECK(allocator.AllocateTransient(2).index == 4);
+
+    // The transient ring never touches the persistent region.
+    CHECK(allocator.GetPersistentAllocatedCount() == 0);
+    CHECK(allocator.AllocatePersistent(4).index == 0);
+}
+
+TEST(DescriptorHeapAllocator, ExhaustionThrows)
+{
+    DescriptorHeapAllocator allocator;
+    Initialize(&allocator, 4, 2, 2);
+
+    allocator.AllocatePersistent(3);
+    CHECK_THROWS(allocator.AllocatePersistent(2));
+    CHECK(allocator.GetPersistentAllocatedCount() == 3);
+    CHECK(allocator.AllocatePersistent(1).index == 3);
+    CHECK_THROWS(allocator.AllocatePersistent());
+
+    allocator.BeginFrame(1);
+    allocator.AllocateTransient(2);
+    CHECK_THROWS(allocator.AllocateTransient());
+    CHECK(allocator.GetTransientAllocatedCount() == 2);
+
+    CHECK_THROWS(allocator.BeginFrame(2));
+    CHECK_THROWS(allocator.AllocatePersistent(0));
+    // A transient range can't go back to the free-list.
+    allocator.BeginFrame(0);
+    CHECK_THROWS(allocator.FreePersistent(allocator.AllocateTransient()));
+}
@@ -0,0 +1,223 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "FramePacer.h"
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    // One tick is a millisecond, so latencies in ticks and in milliseconds are the same numbers.
+    const UINT64 c_ticksPerSecond = 1000;
+
+    // Runs the sample's frame loop against a simulated GPU: each frame waits until the pacer lets
+    // it begin, takes recordTicks of CPU time, then signals the next fence value. Like the sample,
+    // the loop only polls the fence when a frame begins.
+    struct FrameLoop
+    {
+        FramePacer              pacer;
+        SimulatedFenceTimeline  timeline;
+        UINT64                  ticks;
+        UINT64                  fenceValue;
+        UINT64                  waitTicks;
+        UINT                    maxFramesInFlight;
+
+        FrameLoop(UINT maxFrameLatency, UINT64 gpuTicks) : ticks(0), fenceValue(0), waitTicks(0), maxFramesInFlight(0)
+        {
+            pacer.Initialize(maxFrameLatency, c_ticksPerSecond);
+            timeline.SetDuration(gpuTicks);
+        }
+
+        void RunFrame(UINT64 recordTicks)
+        {
+            pacer.Update(timeline.GetCompletedValue(ticks), ticks);
+            UINT64 waitFor = pacer.GetFenceValueToWaitFor();
+            if (waitFor != 0)
+            {
+                UINT64 completionTicks = timeline.GetCompletionTicks(waitFor);
+                waitTicks += completionTicks - ticks;
+                ticks = completionTicks;
+                pacer.Update(timeline.GetCompletedValue(ticks), ticks);
+            }
+            CHECK(pacer.CanBeginFrame());
+            maxFramesInFlight = max(maxFramesInFlight, pacer.GetFramesInFlight() + 1);
+
+            ticks += recordTicks;
+            fenceValue++;
+            timeline.Signal(fenceValue, ticks);
+            pacer.FrameSubmitted(fenceValue, ticks);
+        }
+
+        // Sees every frame still in flight complete the moment it does.
+        void Drain()
+        {
+            for (UINT64 value = pacer.GetCompletedValue() + 1; value <= fenceValue; value++)
+            {
+                ticks = max(ticks, timeline.GetCompletionTicks(value));
+                pacer.Update(timeline.GetCompletedValue(ticks), ticks);
+            }
+        }
+    };
+}
+
+TEST(FramePacer, SimulatedTimelineRunsWorkInOrder)
+{
+    SimulatedFenceTimeline timeline;
+    timeline.SetDuration(10);
+
+    // The second signal queues behind the first, the third starts on an idle timeline.
+    timeline.Signal(1, 0);
+    timeline.Signal(2, 5);
+    timeline.Signal(3, 50);
+    CHECK(timeline.GetCompletionTicks(1) == 10);
+    CHECK(timeline.GetCompletionTicks(2) == 20);
+    CHECK(timeline.GetCompletionTicks(3) == 60);
+
+    CHECK(timeline.GetCompletedValue(9) == 0);
+    CHECK(timeline.GetCompletedValue(20) == 2);
+    CHECK(timeline.GetCompletionTicks(2) == 0);
+    CHECK(timeline.GetCompletedValue(60) == 3);
+    CHECK(timeline.GetCompletionTicks(4) == 0);
+}
+
+TEST(FramePacer, GpuBoundLoopKeepsTheLatencyLimit)
+{
+    // 10 ms of GPU work and 1 ms of recording a frame, with up to three frames in flight.
+    FrameLoop loop(3, 10);
+    const UINT frameCount = 100;
+    for (UINT frame = 0; frame < frameCount; frame++)
+    {
+        loop.RunFrame(1);
+    }
+    loop.Drain();
+
+    CHECK(loop.maxFramesInFlight == 3);
+    CHECK(loop.waitTicks > 0);
+    CHECK(loop.pacer.GetCompletedFrameCount() == frameCount);
+    CHECK(loop.pacer.GetFramesInFlight() == 0);
+
+    // The first three frames fill the queue and take 10, 19 and 28 ms. From then on each one is
+    // submitted 1 ms after the frame three before it completes, behind two frames of GPU work.
+    CHECK(loop.pacer.GetLatencyBucket(10) == 1);
+    CHECK(loop.pacer.GetLatencyBucket(19) == 1);
+    CHECK(loop.pacer.GetLatencyBucket(28) == 1);
+    CHECK(loop.pacer.GetLatencyBucket(29) == frameCount - 3);
+    CHECK(loop.pacer.GetMaxLatencyMilliseconds() == 29.0);
+
+    // The GPU never idles once it has started, so the frames are 10 ms apart.
+    CHECK(loop.ticks == 1 + 10 * frameCount);
+}
+
+TEST(FramePacer, CpuBoundLoopNeverWaits)
+{
+    FrameLoop loop(2, 3);
+    for (UINT frame = 0; frame < 50; frame++)
+    {
+        loop.RunFrame(10);
+    }
+    loop.Drain();
+
+    // The GPU is done 3 ms after each submission, but that is only seen when the next frame
+    // begins, 10 ms later. The previous frame is still in flight then.
+    CHECK(loop.waitTicks == 0);
+    CHECK(loop.maxFramesInFlight == 2);
+    CHECK(loop.pacer.GetLatencyBucket(10) == 49);
+    CHECK(loop.pacer.GetLatencyBucket(3) == 1);
+    CHECK(loop.pacer.GetMaxLatencyMilliseconds() == 10.0);
+}
+
+TEST(FramePacer, OneFrameInFlightSerializes)
+{
+    FrameLoop loop(1, 5);
+    loop.RunFrame(1);
+    CHECK(loop.pacer.GetFenceValueToWaitFor() == 1);
+    loop.RunFrame(1);
+    CHECK(loop.ticks == 7);
+    CHECK(loop.pacer.GetCompletedValue() == 1);
+    CHECK(loop.pacer.GetFenceValueToWaitFor() == 2);
+}
+
+TEST(FramePacer, CallbacksRunOnceTheirFenceCompletes)
+{
+    FramePacer pacer;
+    pacer.Initialize(2, c_ticksPerSecond);
+
+    vector<int> order;
+    pacer.OnCompletion(5, [&]() { order.push_back(5); });
+    pacer.OnCompletion(2, [&]()
+    {
+        order.push_back(2);
+        // Registered from a callback: one that has completed runs at once, a later one waits.
+        pacer.OnCompletion(1, [&]() { order.push_back(1); });
+        pacer.OnCompletion(4, [&]() { order.push_back(4); });
+    });
+
+    pacer.Update(1, 0);
+    CHECK(order.empty());
+    pacer.Update(3, 0);
+    CHECK((order == vector<int>{ 2, 1 }));
+    pacer.Update(3, 0);
+    CHECK(order.size() == 2);
+    pacer.Update(5, 0);
+    CHECK((order == vector<int>{ 2, 1, 4, 5 }));
+
+    pacer.OnCompletion(5, [&]() { order.push_back(6); });
+    CHECK(order.size() == 5);
+}
+
+TEST(FramePacer, ThrowingCallbackIsNotRunAgain)
+{
+    FramePacer pacer;
+    pacer.Initialize(2, c_ticksPerSecond);
+
+    int runs = 0;
+    pacer.OnCompletion(1, [&]() { runs++; throw runtime_error("callback"); });
+    CHECK_THROWS(pacer.Update(1, 0));
+    pacer.Update(2, 0);
+    CHECK(runs == 1);
+}
+
+TEST(FramePacer, LongFramesLandInTheLastBucket)
+{
+    FramePacer pacer;
+    pacer.Initialize(2, c_ticksPerSecond);
+    pacer.FrameSubmitted(1, 0);
+    pacer.FrameSubmitted(2, 0);
+    pacer.Update(1, 2);
+    pacer.Update(2, 100);
+
+    CHECK(pacer.GetLatencyBucket(2) == 1);
+    CHECK(pacer.GetLatencyBucket(FramePacer::c_latencyBucketCount - 1) == 1);
+    CHECK(pacer.GetAverageLatencyMilliseconds() == 51.0);
+    CHECK(pacer.GetMaxLatencyMilliseconds() == 100.0);
+    wstring histogram = pacer.GetLatencyHistogramString();
+    CHECK(histogram.find(L"2 frames") != wstring::npos);
+    CHECK(histogram.find(L">=  32 ms: 1") != wstring::npos);
+}
+
+TEST(FramePacer, BadArgumentsThrow)
+{
+    FramePacer pacer;
+    CHECK_THROWS(pacer.Initialize(0, c_ticksPerSecond));
+    CHECK_THROWS(pacer.Initialize(FramePacer::c_maxFrameLatency + 1, c_ticksPerSecond));
+    CHECK_THROWS(pacer.Initialize(2, 0));
+
+    pacer.Initialize(FramePacer::c_maxFrameLatency, c_ticksPerSecond);
+    pacer.FrameSubmitted(3, 0);
+    CHECK_THROWS(pacer.FrameSubmitted(3, 0));
+    pacer.Update(3, 0);
+    CHECK_THROWS(pacer.FrameSubmitted(2, 0));
+    pacer.FrameSubmitted(4, 0);
+    CHECK(pacer.GetFramesInFlight() == 1);
+}
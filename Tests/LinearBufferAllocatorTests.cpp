@@ -0,0 +1,226 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "LinearBufferAllocator.h"
+#include <algorithm>
+#include <thread>
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    const UINT64 c_pageSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+    // Pages without memory: page N, counting from 1 in creation order, starts at GPU address
+    // N << 32, so an address tells which page it is in.
+    class FakeHeapAllocator : public LinearBufferAllocator
+    {
+    public:
+        FakeHeapAllocator() : m_createdPageCount(0)
+        {
+            Create(nullptr, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_FLAG_NONE, c_pageSize);
+        }
+
+        UINT64 GetCreatedPageCount() const { return m_createdPageCount; }
+
+    protected:
+        void CreatePageResource(Page* page) override
+        {
+            page->gpuBase = ++m_createdPageCount << 32;
+            page->cpuBase = nullptr;
+        }
+
+    private:
+        UINT64 m_createdPageCount;
+    };
+
+    UINT64 PageOf(const BufferAllocation& allocation)
+    {
+        return allocation.gpuAddress >> 32;
+    }
+}
+
+TEST(LinearBufferAllocator, Alignments)
+{
+    FakeHeapAllocator allocator;
+    CHECK(BufferAlignment::ShaderResource(0) == 16);
+    CHECK(BufferAlignment::ShaderResource(12) == 48);
+    CHECK(BufferAlignment::ShaderResource(32) == 32);
+
+    // Each allocation starts at the next multiple of its alignment after the last one.
+    CHECK(allocator.Allocate(8, 1).offset == 0);
+    BufferAllocation constants = allocator.Allocate(100, BufferAlignment::ConstantBuffer);
+    CHECK(constants.offset == 256);
+    BufferAllocation vertices = allocator.Allocate(36, BufferAlignment::ShaderResource(12));
+    CHECK(vertices.offset == 384);
+    BufferAllocation raw = allocator.Allocate(4, BufferAlignment::ShaderResource(0));
+    CHECK(raw.offset == 432);
+    BufferAllocation accelerationStructure = allocator.Allocate(1000, BufferAlignment::AccelerationStructure);
+    CHECK(accelerationStructure.offset == 512);
+    BufferAllocation instanceDescs = allocator.Allocate(64, BufferAlignment::InstanceDescs);
+    CHECK(instanceDescs.offset == 1520);
+
+    CHECK(constants.gpuAddress % BufferAlignment::ConstantBuffer == 0);
+    CHECK(accelerationStructure.gpuAddress == (1ull << 32) + 512);
+    CHECK(allocator.GetAllocatedBytes() == 8 + 100 + 36 + 4 + 1000 + 64);
+    CHECK(allocator.GetPageCount() == 1);
+}
+
+TEST(LinearBufferAllocator, RollsOverToANewPage)
+{
+    FakeHeapAllocator allocator;
+    BufferAllocation first = allocator.Allocate(40000, 256);
+    BufferAllocation second = allocator.Allocate(40000, 256);
+    CHECK(PageOf(first) == 1 && first.offset == 0);
+    CHECK(PageOf(second) == 2 && second.offset == 0);
+
+    // The rest of page 1 is given up, page 2 is current now.
+    CHECK(PageOf(allocator.Allocate(16, 16)) == 2);
+    CHECK(allocator.GetPageCount() == 2);
+    CHECK(allocator.GetReservedBytes() == 2 * c_pageSize);
+}
+
+TEST(LinearBufferAllocator, ExactlyFullPage)
+{
+    FakeHeapAllocator allocator;
+    BufferAllocation whole = allocator.Allocate(c_pageSize, 256);
+    CHECK(PageOf(whole) == 1 && whole.offset == 0);
+    CHECK(PageOf(allocator.Allocate(1, 1)) == 2);
+
+    // A rewound page holds a whole page again, whatever the alignment.
+    allocator.Reset();
+    CHECK(PageOf(allocator.Allocate(c_pageSize, BufferAlignment::AccelerationStructure)) == 1);
+    CHECK(allocator.GetPageCount() == 2);
+}
+
+TEST(LinearBufferAllocator, OversizedAllocationsGetADedicatedPage)
+{
+    FakeHeapAllocator allocator;
+    allocator.Allocate(c_pageSize - 16, 256);
+
+    BufferAllocation large = allocator.Allocate(c_pageSize + 1, 256);
+    CHECK(PageOf(large) == 2 && large.offset == 0);
+    CHECK(allocator.GetReservedBytes() == 3 * c_pageSize);
+
+    // The current page is still page 1, and once it is full the dedicated page isn't used.
+    CHECK(PageOf(allocator.Allocate(16, 16)) == 1);
+    BufferAllocation next = allocator.Allocate(16, 16);
+    CHECK(PageOf(next) == 3 && next.offset == 0);
+    CHECK(allocator.GetPageCount() == 3);
+}
+
+TEST(LinearBufferAllocator, ResetReusesPages)
+{
+    FakeHeapAllocator allocator;
+    for (UINT i = 0; i < 3; i++)
+    {
+        allocator.Allocate(c_pageSize / 2 + 1, 256);
+    }
+    allocator.Allocate(3 * c_pageSize, 256);
+    CHECK(allocator.GetCreatedPageCount() == 4);
+
+    allocator.Reset();
+    CHECK(allocator.GetAllocatedBytes() == 0);
+
+    // Same requests, same pages in the same order, and nothing new is created.
+    for (UINT64 page = 1; page <= 3; page++)
+    {
+        BufferAllocation allocation = allocator.Allocate(c_pageSize / 2 + 1, 256);
+        CHECK(PageOf(allocation) == page && allocation.offset == 0);
+    }
+    BufferAllocation large = allocator.Allocate(2 * c_pageSize, 256);
+    CHECK(PageOf(large) == 4);
+    CHECK(allocator.GetCreatedPageCount() == 4);
+
+    // The dedicated page is taken until the next Reset().
+    CHECK(PageOf(allocator.Allocate(2 * c_pageSize, 256)) == 5);
+    CHECK(allocator.GetReservedBytes() == 3 * c_pageSize + 3 * c_pageSize + 2 * c_pageSize);
+}
+
+TEST(LinearBufferAllocator, ConcurrentAllocationsDontOverlap)
+{
+    const UINT threadCount = 8;
+    const UINT allocationsPerThread = 20000;
+    const UINT64 alignments[] = { BufferAlignment::ConstantBuffer, BufferAlignment::ShaderResource(12),
+        BufferAlignment::RawBuffer, BufferAlignment::AccelerationStructure };
+
+    FakeHeapAllocator allocator;
+    vector<vector<BufferAllocation>> allocations(threadCount);
+    vector<UINT64> requestedBytes(threadCount, 0);
+    vector<thread> threads;
+    for (UINT t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (UINT i = 0; i < allocationsPerThread; i++)
+            {
+                UINT64 alignment = alignments[(i + t) % ARRAYSIZE(alignments)];
+                UINT64 size = 16 + (i * 7919 + t * 104729) % 1024;
+                allocations[t].push_back(allocator.Allocate(size, alignment));
+                if (allocations[t].back().offset % alignment != 0)
+                {
+                    allocations[t].back().size = 0;
+                }
+                requestedBytes[t] += size;
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    vector<BufferAllocation> all;
+    UINT64 totalBytes = 0;
+    for (UINT t = 0; t < threadCount; t++)
+    {
+        all.insert(all.end(), allocations[t].begin(), allocations[t].end());
+        totalBytes += requestedBytes[t];
+    }
+    sort(all.begin(), all.end(), [](const BufferAllocation& a, const BufferAllocation& b) { return a.gpuAddress < b.gpuAddress; });
+
+    bool aligned = true;
+    bool disjoint = true;
+    bool inPage = true;
+    for (size_t i = 0; i < all.size(); i++)
+    {
+        aligned = aligned && all[i].size > 0;
+        inPage = inPage && all[i].offset + all[i].size <= c_pageSize;
+        if (i > 0)
+        {
+            disjoint = disjoint && all[i - 1].gpuAddress + all[i - 1].size <= all[i].gpuAddress;
+        }
+    }
+    CHECK(aligned);
+    CHECK(disjoint);
+    CHECK(inPage);
+    CHECK(allocator.GetAllocatedBytes() == totalBytes);
+    CHECK(allocator.GetReservedBytes() == allocator.GetCreatedPageCount() * c_pageSize);
+}
+
+TEST(LinearBufferAllocator, BadRequestsThrow)
+{
+    LinearBufferAllocator uncreated;
+    CHECK_THROWS(uncreated.Allocate(16, 16));
+
+    FakeHeapAllocator allocator;
+    CHECK_THROWS(allocator.Allocate(0, 16));
+    CHECK_THROWS(allocator.Allocate(16, 0));
+    CHECK_THROWS(allocator.Allocate(16, 2 * D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+
+    // Without a device, the base class can't make pages.
+    LinearBufferAllocator deviceless;
+    deviceless.Create(nullptr, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+    CHECK_THROWS(deviceless.Allocate(16, 16));
+}
@@ -0,0 +1,403 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "RenderGraph.h"
+#include "RecordingDevice.h"
+
+using namespace DX;
+using namespace std;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    typedef RenderGraph::Barrier Barrier;
+
+    const D3D12_COMMAND_LIST_TYPE c_direct = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    const D3D12_COMMAND_LIST_TYPE c_compute = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    const UINT64 c_bufferSize = 64 * 1024;
+
+    // Imported resources are only compared and handed to the tracker, never called.
+    ID3D12Resource* FakeResource(UINT id)
+    {
+        return reinterpret_cast<ID3D12Resource*>(static_cast<UINT_PTR>(id) * 0x100);
+    }
+
+    RenderGraph::ResourceHandle CreateBuffer(RenderGraph& graph, LPCWSTR name, UINT64 size = c_bufferSize)
+    {
+        D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        return graph.CreateTransient(name, desc, size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    }
+
+    // The position of a pass in the execution order, UINT_MAX when it was culled.
+    UINT PositionOf(const RenderGraph& graph, RenderGraph::PassHandle pass)
+    {
+        const auto& passes = graph.GetPlan().passes;
+        for (UINT i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].pass == pass)
+            {
+                return i;
+            }
+        }
+        return UINT_MAX;
+    }
+
+    const vector<Barrier>& BarriersBefore(const RenderGraph& graph, RenderGraph::PassHandle pass)
+    {
+        return graph.GetPlan().passes[PositionOf(graph, pass)].barriers;
+    }
+
+    bool IsBarrier(const Barrier& barrier, D3D12_RESOURCE_BARRIER_TYPE type, RenderGraph::ResourceHandle resource)
+    {
+        return barrier.type == type && barrier.resource == resource;
+    }
+
+    bool IsTransition(const Barrier& barrier, RenderGraph::ResourceHandle resource, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+    {
+        return IsBarrier(barrier, D3D12_RESOURCE_BARRIER_TYPE_TRANSITION, resource) && barrier.stateBefore == stateBefore && barrier.stateAfter == stateAfter;
+    }
+
+    UINT CountBarriers(const RenderGraph::Plan& plan)
+    {
+        size_t count = plan.finalBarriers.size();
+        for (const auto& scheduled : plan.passes)
+        {
+            count += scheduled.barriers.size();
+        }
+        return static_cast<UINT>(count);
+    }
+
+    // A recording device and one command list to execute graphs on.
+    struct RecordingContext
+    {
+        ComPtr<ID3D12Device>                device;
+        ComPtr<ID3D12CommandAllocator>      commandAllocator;
+        ComPtr<ID3D12GraphicsCommandList>   commandList;
+
+        RecordingContext()
+        {
+            ThrowIfFailed(CreateRecordingDevice(make_shared<RecordingStatistics>(), IID_PPV_ARGS(&device)));
+            ThrowIfFailed(device->CreateCommandAllocator(c_direct, IID_PPV_ARGS(&commandAllocator)));
+            ThrowIfFailed(device->CreateCommandList(0, c_direct, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
+        }
+    };
+}
+
+TEST(RenderGraph, CullsPassesWithoutOutputs)
+{
+    RenderGraph graph;
+    auto output = graph.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto input = graph.ImportResource(L"Input", FakeResource(2), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_GENERIC_READ);
+    auto used = CreateBuffer(graph, L"Used");
+    auto unused = CreateBuffer(graph, L"Unused");
+
+    auto produce = graph.AddPass(L"Produce", c_direct, nullptr);
+    graph.Write(produce, used, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto deadEnd = graph.AddPass(L"DeadEnd", c_direct, nullptr);
+    graph.Read(deadEnd, input, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(deadEnd, unused, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto readOnly = graph.AddPass(L"ReadOnly", c_direct, nullptr);
+    graph.Read(readOnly, input, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    auto readback = graph.AddPass(L"Readback", c_direct, nullptr, true);
+    graph.Read(readback, input, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    auto consume = graph.AddPass(L"Consume", c_direct, nullptr);
+    graph.Read(consume, used, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.Write(consume, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+
+    // Produce feeds an imported resource and Readback has side effects, the other two go.
+    const auto& plan = graph.GetPlan();
+    CHECK(plan.culledPasses.size() == 2);
+    CHECK(plan.culledPasses[0] == deadEnd && plan.culledPasses[1] == readOnly);
+    CHECK(plan.passes.size() == 3);
+    CHECK(PositionOf(graph, produce) == 0 && PositionOf(graph, readback) == 1 && PositionOf(graph, consume) == 2);
+
+    // A transient only culled passes touch gets no memory.
+    CHECK(plan.transientHeapSize == c_bufferSize);
+}
+
+TEST(RenderGraph, DependenciesOrderThePasses)
+{
+    RenderGraph graph;
+    auto output = graph.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto a = CreateBuffer(graph, L"A");
+    auto b = CreateBuffer(graph, L"B");
+
+    // Final is declared before the passes writing what it reads.
+    auto final = graph.AddPass(L"Final", c_direct, nullptr);
+    auto first = graph.AddPass(L"First", c_direct, nullptr);
+    auto second = graph.AddPass(L"Second", c_direct, nullptr);
+    graph.Write(first, a, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    graph.Read(second, a, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(second, b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    graph.Compile();
+    // Final has no accesses yet, so it is culled.
+    CHECK(graph.GetPlan().culledPasses.size() == 3);
+
+    graph.Read(final, b, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.Write(final, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+    // Declaration order is the order of the accesses, so Final reads B before Second writes it.
+    // It doesn't depend on the other two, which feed nothing and are culled.
+    CHECK(graph.GetPlan().passes.size() == 1 && PositionOf(graph, final) == 0);
+
+    RenderGraph ordered;
+    output = ordered.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    a = CreateBuffer(ordered, L"A");
+    b = CreateBuffer(ordered, L"B");
+    first = ordered.AddPass(L"First", c_direct, nullptr);
+    ordered.Write(first, a, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    second = ordered.AddPass(L"Second", c_direct, nullptr);
+    ordered.Read(second, a, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    ordered.Write(second, b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    final = ordered.AddPass(L"Final", c_direct, nullptr);
+    ordered.Read(final, b, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    ordered.Write(final, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    ordered.Compile();
+    CHECK(ordered.GetPlan().culledPasses.empty());
+    CHECK(PositionOf(ordered, first) == 0 && PositionOf(ordered, second) == 1 && PositionOf(ordered, final) == 2);
+}
+
+TEST(RenderGraph, TransitionAndUAVBarriers)
+{
+    RenderGraph graph;
+    auto buffer = graph.ImportResource(L"Buffer", FakeResource(1), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    auto output = graph.ImportResource(L"Output", FakeResource(2), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    auto write1 = graph.AddPass(L"Write1", c_direct, nullptr);
+    graph.Write(write1, buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto write2 = graph.AddPass(L"Write2", c_direct, nullptr);
+    graph.Write(write2, buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto read1 = graph.AddPass(L"Read1", c_direct, nullptr);
+    graph.Read(read1, buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(read1, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto read2 = graph.AddPass(L"Read2", c_direct, nullptr);
+    graph.Read(read2, buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(read2, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+
+    // Into UAV once, then a UAV barrier between the back to back writes.
+    CHECK(BarriersBefore(graph, write1).size() == 1);
+    CHECK(IsTransition(BarriersBefore(graph, write1)[0], buffer, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    CHECK(BarriersBefore(graph, write2).size() == 1);
+    CHECK(IsBarrier(BarriersBefore(graph, write2)[0], D3D12_RESOURCE_BARRIER_TYPE_UAV, buffer));
+
+    // The output is already a copy destination, the second read needs nothing.
+    CHECK(BarriersBefore(graph, read1).size() == 1);
+    CHECK(IsTransition(BarriersBefore(graph, read1)[0], buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    CHECK(BarriersBefore(graph, read2).empty());
+
+    // The buffer goes back to where it has to be left.
+    const auto& finalBarriers = graph.GetPlan().finalBarriers;
+    CHECK(finalBarriers.size() == 1);
+    CHECK(IsTransition(finalBarriers[0], buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+}
+
+TEST(RenderGraph, TransientsShareMemory)
+{
+    RenderGraph graph;
+    auto output = graph.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto a = CreateBuffer(graph, L"A", 2 * c_bufferSize);
+    auto b = CreateBuffer(graph, L"B");
+    auto c = CreateBuffer(graph, L"C", 2 * c_bufferSize);
+
+    // A and B are alive at once, C only after both, so it can take A's memory.
+    auto pass1 = graph.AddPass(L"Pass1", c_direct, nullptr);
+    graph.Write(pass1, a, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    graph.Write(pass1, b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto pass2 = graph.AddPass(L"Pass2", c_direct, nullptr);
+    graph.Read(pass2, a, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Read(pass2, b, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(pass2, c, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto pass3 = graph.AddPass(L"Pass3", c_direct, nullptr);
+    graph.Read(pass3, c, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.Write(pass3, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+
+    // Pass2 still reads A while C is written, so the two lifetimes overlap there.
+    const auto& plan = graph.GetPlan();
+    CHECK(plan.transientUnaliasedSize == 5 * c_bufferSize);
+    CHECK(plan.transientHeapSize == 5 * c_bufferSize);
+
+    // Without that overlap C takes A's place.
+    RenderGraph aliased;
+    output = aliased.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    a = CreateBuffer(aliased, L"A", 2 * c_bufferSize);
+    b = CreateBuffer(aliased, L"B");
+    c = CreateBuffer(aliased, L"C", 2 * c_bufferSize);
+    pass1 = aliased.AddPass(L"Pass1", c_direct, nullptr);
+    aliased.Write(pass1, a, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    aliased.Write(pass1, b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    pass2 = aliased.AddPass(L"Pass2", c_direct, nullptr);
+    aliased.Read(pass2, a, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    aliased.Write(pass2, b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    pass3 = aliased.AddPass(L"Pass3", c_direct, nullptr);
+    aliased.Read(pass3, b, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    aliased.Write(pass3, c, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto pass4 = aliased.AddPass(L"Pass4", c_direct, nullptr);
+    aliased.Read(pass4, c, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    aliased.Write(pass4, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    aliased.Compile();
+
+    const auto& aliasedPlan = aliased.GetPlan();
+    CHECK(aliasedPlan.transientUnaliasedSize == 5 * c_bufferSize);
+    CHECK(aliasedPlan.transientHeapSize == 3 * c_bufferSize);
+    CHECK(aliased.GetTransientHeapOffset(a) == 0);
+    CHECK(aliased.GetTransientHeapOffset(b) == 2 * c_bufferSize);
+    CHECK(aliased.GetTransientHeapOffset(c) == 0);
+
+    // C takes the memory over from A, then leaves the copy source state the last frame left it in.
+    const auto& pass3Barriers = BarriersBefore(aliased, pass3);
+    CHECK(pass3Barriers.size() == 3);
+    CHECK(IsTransition(pass3Barriers[0], b, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    CHECK(IsBarrier(pass3Barriers[1], D3D12_RESOURCE_BARRIER_TYPE_ALIASING, c) && pass3Barriers[1].aliasedResource == a);
+    CHECK(IsTransition(pass3Barriers[2], c, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+    // A is first in its range, it takes over from whatever the previous frame left there. B
+    // shares memory with nobody and needs no aliasing barrier.
+    const auto& pass1Barriers = BarriersBefore(aliased, pass1);
+    CHECK(pass1Barriers.size() == 3);
+    CHECK(IsBarrier(pass1Barriers[0], D3D12_RESOURCE_BARRIER_TYPE_ALIASING, a) && pass1Barriers[0].aliasedResource == RenderGraph::c_invalidHandle);
+    CHECK(IsTransition(pass1Barriers[1], a, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    CHECK(IsTransition(pass1Barriers[2], b, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+}
+
+TEST(RenderGraph, TransientsStartWhereTheFrameLeavesThem)
+{
+    RenderGraph graph;
+    auto output = graph.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto scratch = CreateBuffer(graph, L"Scratch");
+    auto write = graph.AddPass(L"Write", c_direct, nullptr);
+    graph.Write(write, scratch, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto read = graph.AddPass(L"Read", c_direct, nullptr);
+    graph.Read(read, scratch, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.Write(read, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+
+    // Left as a copy source by Read, the next frame's Write moves it back, without a UAV barrier.
+    const auto& writeBarriers = BarriersBefore(graph, write);
+    CHECK(writeBarriers.size() == 1);
+    CHECK(IsTransition(writeBarriers[0], scratch, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    CHECK(IsTransition(BarriersBefore(graph, read)[0], scratch, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    CHECK(graph.GetPlan().finalBarriers.empty());
+}
+
+TEST(RenderGraph, ComputePassesSyncWithTheDirectQueue)
+{
+    RenderGraph graph;
+    auto output = graph.ImportResource(L"Output", FakeResource(1), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+    auto instances = CreateBuffer(graph, L"Instances");
+    auto tlas = CreateBuffer(graph, L"Tlas");
+    auto image = CreateBuffer(graph, L"Image");
+
+    auto update = graph.AddPass(L"UpdateInstances", c_direct, nullptr);
+    graph.Write(update, instances, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto build = graph.AddPass(L"BuildTlas", c_compute, nullptr);
+    graph.Read(build, instances, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.Write(build, tlas, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+    auto independent = graph.AddPass(L"Independent", c_direct, nullptr);
+    graph.Write(independent, image, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto trace = graph.AddPass(L"Trace", c_direct, nullptr);
+    graph.Read(trace, tlas, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+    graph.Write(trace, image, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    auto copy = graph.AddPass(L"Copy", c_direct, nullptr);
+    graph.Read(copy, image, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.Write(copy, output, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.Compile();
+
+    // The compute pass runs as soon as its input is ready, ahead of the independent direct work.
+    CHECK(PositionOf(graph, update) == 0);
+    CHECK(PositionOf(graph, build) == 1);
+    CHECK(PositionOf(graph, independent) == 2);
+
+    // The build waits for the direct queue, the trace for the build, nothing else crosses queues.
+    const auto& queueSyncs = graph.GetPlan().queueSyncs;
+    CHECK(queueSyncs.size() == 2);
+    CHECK(queueSyncs[0].signalPass == update && queueSyncs[0].waitPass == build);
+    CHECK(queueSyncs[1].signalPass == build && queueSyncs[1].waitPass == trace);
+}
+
+TEST(RenderGraph, TransientStatesCarryOverFrames)
+{
+    RecordingContext context;
+    ResourceStateTracker resourceStates;
+    RenderGraph graph;
+    ID3D12Resource* output = FakeResource(1);
+    resourceStates.Register(output, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    auto BuildFrame = [&](D3D12_RESOURCE_STATES readState)
+    {
+        graph.Reset();
+        auto outputHandle = graph.ImportResource(L"Output", output, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+        auto scratch = CreateBuffer(graph, L"Scratch");
+        auto write = graph.AddPass(L"Write", c_direct, nullptr);
+        graph.Write(write, scratch, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        auto read = graph.AddPass(L"Read", c_direct, nullptr);
+        graph.Read(read, scratch, readState);
+        graph.Write(read, outputHandle, D3D12_RESOURCE_STATE_COPY_DEST);
+        graph.Compile();
+        graph.CreateTransientResources(context.device.Get(), resourceStates);
+        return scratch;
+    };
+
+    // Created in the state the frame ends in, so the first frame emits what the plan says.
+    auto scratch = BuildFrame(D3D12_RESOURCE_STATE_COPY_SOURCE);
+    ID3D12Resource* placed = graph.GetResource(scratch);
+    CHECK(resourceStates.GetState(placed) == D3D12_RESOURCE_STATE_COPY_SOURCE);
+    for (UINT frame = 0; frame < 3; frame++)
+    {
+        if (frame > 0)
+        {
+            scratch = BuildFrame(D3D12_RESOURCE_STATE_COPY_SOURCE);
+        }
+        // The same placed resource every frame, still tracked from the frame before.
+        CHECK(graph.GetResource(scratch) == placed);
+        resourceStates.BeginFrame();
+        graph.Execute(resourceStates, context.commandList.Get());
+        resourceStates.BeginFrame();
+        CHECK(resourceStates.GetLastFrameBarrierCount() == CountBarriers(graph.GetPlan()));
+        CHECK(resourceStates.GetState(placed) == D3D12_RESOURCE_STATE_COPY_SOURCE);
+    }
+
+    // A graph that starts from another state gets a new resource, the old one is no longer tracked.
+    scratch = BuildFrame(D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    CHECK(graph.GetResource(scratch) != placed);
+    CHECK(!resourceStates.IsTracked(placed));
+    CHECK(resourceStates.GetState(graph.GetResource(scratch)) == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+    placed = graph.GetResource(scratch);
+    graph.ReleaseTransientResources(resourceStates);
+    CHECK(!resourceStates.IsTracked(placed));
+    CHECK_THROWS(graph.Execute(resourceStates, context.commandList.Get()));
+}
+
+TEST(RenderGraph, BadGraphsThrow)
+{
+    RenderGraph graph;
+    auto buffer = graph.ImportResource(L"Buffer", FakeResource(1), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON);
+    CHECK_THROWS(graph.AddPass(L"Copy", D3D12_COMMAND_LIST_TYPE_COPY, nullptr));
+
+    // Two states in one pass, one of them a write.
+    auto pass = graph.AddPass(L"Pass", c_direct, nullptr);
+    graph.Write(pass, buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    CHECK_THROWS(graph.Read(pass, buffer, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    CHECK_THROWS(graph.Write(pass, buffer + 1, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    // Transients need memory before the graph can run.
+    ResourceStateTracker resourceStates;
+    auto transient = CreateBuffer(graph, L"Transient");
+    graph.Read(pass, transient, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    CHECK_THROWS(graph.Execute(resourceStates, nullptr));
+    graph.Compile();
+    CHECK_THROWS(graph.Execute(resourceStates, nullptr));
+}
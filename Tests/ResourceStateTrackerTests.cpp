@@ -0,0 +1,221 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "ResourceStateTracker.h"
+
+using namespace DX;
+using namespace std;
+
+namespace
+{
+    // The tracker only compares resource pointers, it never calls through them.
+    ID3D12Resource* FakeResource(UINT id)
+    {
+        return reinterpret_cast<ID3D12Resource*>(static_cast<UINT_PTR>(id) * 0x100);
+    }
+
+    bool IsTransition(const D3D12_RESOURCE_BARRIER& barrier, ID3D12Resource* resource, UINT subresource,
+        D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+    {
+        return barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+            barrier.Transition.pResource == resource &&
+            barrier.Transition.Subresource == subresource &&
+            barrier.Transition.StateBefore == stateBefore &&
+            barrier.Transition.StateAfter == stateAfter;
+    }
+}
+
+TEST(ResourceStateTracker, ChainedTransitionsMerge)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* texture = FakeResource(1);
+    tracker.Register(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    // RENDER_TARGET -> UNORDERED_ACCESS -> COPY_SOURCE -> PIXEL_SHADER_RESOURCE is one barrier.
+    const auto& pending = tracker.GetPendingBarriers();
+    CHECK(pending.size() == 1);
+    CHECK(IsTransition(pending[0], texture, ResourceStateTracker::c_allSubresources,
+        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    CHECK(tracker.GetState(texture) == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    CHECK(tracker.GetDroppedBarrierCount() == 2);
+}
+
+TEST(ResourceStateTracker, RoundTripCancels)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* texture = FakeResource(1);
+    ID3D12Resource* buffer = FakeResource(2);
+    tracker.Register(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    // The texture went back where it started, only the buffer's barrier is left.
+    const auto& pending = tracker.GetPendingBarriers();
+    CHECK(pending.size() == 1);
+    CHECK(IsTransition(pending[0], buffer, ResourceStateTracker::c_allSubresources,
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+    CHECK(tracker.GetState(texture) == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+TEST(ResourceStateTracker, UAVBarrierKeepsTransitionsApart)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* buffer = FakeResource(1);
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    tracker.UAVBarrier(buffer);
+    tracker.UAVBarrier(buffer);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    // The writes between the barriers must finish, so nothing merges across the UAV barrier.
+    const auto& pending = tracker.GetPendingBarriers();
+    CHECK(pending.size() == 3);
+    CHECK(IsTransition(pending[0], buffer, ResourceStateTracker::c_allSubresources,
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    CHECK(pending[1].Type == D3D12_RESOURCE_BARRIER_TYPE_UAV && pending[1].UAV.pResource == buffer);
+    CHECK(IsTransition(pending[2], buffer, ResourceStateTracker::c_allSubresources,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
+    CHECK(tracker.GetDroppedBarrierCount() == 1);
+}
+
+TEST(ResourceStateTracker, SatisfiedReadStatesAreDropped)
+{
+    CHECK(ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    CHECK(ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_INDEX_BUFFER));
+    CHECK(!ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_GENERIC_READ));
+    CHECK(!ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COMMON));
+    CHECK(!ResourceStateTracker::IsSatisfied(D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+    ResourceStateTracker tracker;
+    ID3D12Resource* buffer = FakeResource(1);
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    CHECK(tracker.GetPendingBarriers().empty());
+    CHECK(tracker.GetDroppedBarrierCount() == 2);
+
+    // A satisfied request doesn't narrow the state either.
+    CHECK(tracker.GetState(buffer) == D3D12_RESOURCE_STATE_GENERIC_READ);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    CHECK(tracker.GetPendingBarriers().empty());
+
+    // Writes are never covered by the current state.
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    CHECK(tracker.GetPendingBarriers().size() == 1);
+}
+
+TEST(ResourceStateTracker, SubresourceTransitions)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* texture = FakeResource(1);
+    tracker.Register(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 4);
+
+    // Mip 1 is rendered to, the others stay readable.
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET, 1);
+    CHECK(tracker.GetState(texture, 1) == D3D12_RESOURCE_STATE_RENDER_TARGET);
+    CHECK(tracker.GetState(texture, 2) == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    // Another subresource doesn't merge with it.
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, 3);
+    vector<D3D12_RESOURCE_BARRIER> barriers;
+    tracker.Flush(barriers);
+    CHECK(barriers.size() == 2);
+    CHECK(IsTransition(barriers[0], texture, 1, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+    CHECK(IsTransition(barriers[1], texture, 3, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    // Back to one state for the whole resource: only the two subresources that diverged move.
+    barriers.clear();
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    tracker.Flush(barriers);
+    CHECK(barriers.size() == 2);
+    CHECK(IsTransition(barriers[0], texture, 1, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    CHECK(IsTransition(barriers[1], texture, 3, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+    // With every subresource in the same state again, one barrier covers them all.
+    barriers.clear();
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    tracker.Flush(barriers);
+    CHECK(barriers.size() == 1);
+    CHECK(IsTransition(barriers[0], texture, ResourceStateTracker::c_allSubresources,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+    // A subresource sent back before the flush cancels like a whole resource does.
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET, 2);
+    tracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    CHECK(tracker.GetPendingBarriers().empty());
+    CHECK(tracker.GetState(texture, 2) == D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+    // A resource with a single subresource always uses the whole resource form.
+    ID3D12Resource* buffer = FakeResource(2);
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    tracker.Transition(buffer, D3D12_RESOURCE_STATE_GENERIC_READ, 0);
+    CHECK(tracker.GetPendingBarriers().back().Transition.Subresource == ResourceStateTracker::c_allSubresources);
+    CHECK_THROWS(tracker.Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, 4));
+}
+
+TEST(ResourceStateTracker, CountsBarriersPerFrame)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* a = FakeResource(1);
+    ID3D12Resource* b = FakeResource(2);
+    tracker.Register(a, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    tracker.Register(b, D3D12_RESOURCE_STATE_COPY_DEST);
+    vector<D3D12_RESOURCE_BARRIER> barriers;
+
+    tracker.BeginFrame();
+    tracker.Transition(a, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    tracker.Transition(b, D3D12_RESOURCE_STATE_GENERIC_READ);
+    tracker.Flush(barriers);
+    tracker.AliasingBarrier(a, b);
+    tracker.UAVBarrier(nullptr);
+    tracker.Flush(barriers);
+    // Merged and dropped barriers are never emitted, so they don't count.
+    tracker.Transition(a, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    tracker.Transition(a, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    tracker.Flush(barriers);
+    CHECK(tracker.GetFrameBarrierCount() == 4);
+    CHECK(barriers.size() == 4);
+    CHECK(barriers[2].Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING && barriers[2].Aliasing.pResourceAfter == b);
+
+    tracker.BeginFrame();
+    CHECK(tracker.GetLastFrameBarrierCount() == 4);
+    CHECK(tracker.GetFrameBarrierCount() == 0);
+    tracker.Transition(b, D3D12_RESOURCE_STATE_COPY_DEST);
+    tracker.Flush(barriers);
+    tracker.BeginFrame();
+    CHECK(tracker.GetLastFrameBarrierCount() == 1);
+}
+
+TEST(ResourceStateTracker, RegisterOverridesAndUnregisteredThrows)
+{
+    ResourceStateTracker tracker;
+    ID3D12Resource* buffer = FakeResource(1);
+    CHECK_THROWS(tracker.Transition(buffer, D3D12_RESOURCE_STATE_COPY_DEST));
+    CHECK_THROWS(tracker.GetState(buffer));
+    CHECK_THROWS(tracker.Register(nullptr, D3D12_RESOURCE_STATE_COMMON));
+
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    tracker.Register(buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    CHECK(tracker.GetState(buffer) == D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    tracker.Unregister(buffer);
+    CHECK(!tracker.IsTracked(buffer));
+}
@@ -0,0 +1,102 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// Tests.cpp - Unit tests for the allocators, planners and schedulers of the sample. None of them
+// needs a GPU: they run over mock heaps, fake resource pointers and simulated fences, and the
+// results are checked on the plans, barrier lists and offsets they produce. The test files of
+// this project each cover one class and register their tests with TEST().
+//
+// The exit code is 1 when any check fails or a test throws.
+//
+// Usage: Tests [-filter text]
+//
+
+#include "stdafx.h"
+#include "Tests.h"
+
+using namespace std;
+
+namespace
+{
+    struct TestCase
+    {
+        const char*         suite;
+        const char*         name;
+        Tests::TestFunction function;
+    };
+
+    // Function local, registrations run during static initialization of the other files.
+    vector<TestCase>& GetTestCases()
+    {
+        static vector<TestCase> testCases;
+        return testCases;
+    }
+
+    UINT g_failedChecks;
+}
+
+Tests::Registration::Registration(const char* suite, const char* name, TestFunction function)
+{
+    TestCase testCase = { suite, name, function };
+    GetTestCases().push_back(testCase);
+}
+
+void Tests::Fail(const char* file, int line, const char* expression)
+{
+    printf("    %s(%d): CHECK(%s) failed\n", file, line, expression);
+    g_failedChecks++;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    string filter;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((_wcsnicmp(argv[i], L"-filter", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/filter", wcslen(argv[i])) == 0) && i + 1 < argc)
+        {
+            wstring text = argv[++i];
+            filter.assign(text.begin(), text.end());
+        }
+    }
+
+    UINT runCount = 0;
+    UINT failedCount = 0;
+    for (const auto& testCase : GetTestCases())
+    {
+        string name = string(testCase.suite) + "." + testCase.name;
+        if (name.find(filter) == string::npos)
+        {
+            continue;
+        }
+
+        printf("%s\n", name.c_str());
+        UINT failedChecks = g_failedChecks;
+        try
+        {
+            testCase.function();
+        }
+        catch (const exception& e)
+        {
+            printf("    threw: %s\n", e.what());
+            g_failedChecks++;
+        }
+        runCount++;
+        if (g_failedChecks != failedChecks)
+        {
+            failedCount++;
+        }
+    }
+
+    printf("%u tests, %u failed\n", runCount, failedCount);
+    return failedCount == 0 && runCount > 0 ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+//
+// Tests.h - A minimal test harness for the parts of the sample that run without a GPU
+//
+
+#pragma once
+
+namespace Tests
+{
+    typedef void (*TestFunction)();
+
+    // Adds a test to the list Tests.exe runs, TEST() declares one at static initialization.
+    struct Registration
+    {
+        Registration(const char* suite, const char* name, TestFunction function);
+    };
+
+    // Marks the running test as failed, it keeps running so every failed check is reported.
+    void Fail(const char* file, int line, const char* expression);
+}
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static Tests::Registration suite##_##name##_registration(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do { if (!(expression)) { Tests::Fail(__FILE__, __LINE__, #expression); } } while (false)
+
+#define CHECK_THROWS(statement) \
+    do \
+    { \
+        bool thrown = false; \
+        try { statement; } catch (const std::exception&) { thrown = true; } \
+        if (!thrown) { Tests::Fail(__FILE__, __LINE__, "throws: " #statement); } \
+    } while (false)